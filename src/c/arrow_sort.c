@@ -0,0 +1,268 @@
+#include "arrow_sort.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libradix.h"
+
+enum { COL_INT, COL_FLOAT };
+
+typedef struct {
+    int bits;                /* 32 or 64 */
+    int kind;                /* COL_INT or COL_FLOAT */
+    char *values;            /* first value, past the array offset */
+    int64_t n;
+} arrow_column;
+
+/* Accepts only what arrow_sort.h promises: a primitive numeric column
+   without nulls. */
+static int open_column(const struct ArrowSchema *schema, const struct ArrowArray *array,
+                       arrow_column *col) {
+    if (!schema || !array || !schema->format || !array->release || !schema->release) {
+        errno = EINVAL;
+        return -1;
+    }
+    const char *f = schema->format;
+    if (f[0] == '\0' || f[1] != '\0') {
+        errno = EINVAL;
+        return -1;
+    }
+    switch (f[0]) {
+    case 'i':
+        col->bits = 32;
+        col->kind = COL_INT;
+        break;
+    case 'l':
+        col->bits = 64;
+        col->kind = COL_INT;
+        break;
+    case 'f':
+        col->bits = 32;
+        col->kind = COL_FLOAT;
+        break;
+    case 'g':
+        col->bits = 64;
+        col->kind = COL_FLOAT;
+        break;
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+    if (array->n_buffers != 2 || array->n_children != 0 || array->dictionary ||
+        array->length < 0 || array->offset < 0 ||
+        (array->buffers[0] && array->null_count != 0) ||
+        (array->length > 0 && !array->buffers[1])) {
+        errno = EINVAL;
+        return -1;
+    }
+    col->n = array->length;
+    col->values = (char *)array->buffers[1] + (size_t)array->offset * (col->bits / 8);
+    return 0;
+}
+
+/* Order-preserving maps between values and unsigned keys. */
+static uint32_t key32(uint32_t bits, int kind) {
+    if (kind == COL_INT) {
+        return bits ^ 0x80000000u;
+    }
+    return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+static uint32_t value32(uint32_t key, int kind) {
+    if (kind == COL_INT) {
+        return key ^ 0x80000000u;
+    }
+    return (key & 0x80000000u) ? key ^ 0x80000000u : ~key;
+}
+
+static uint64_t key64(uint64_t bits, int kind) {
+    uint64_t sign = 1ull << 63;
+    if (kind == COL_INT) {
+        return bits ^ sign;
+    }
+    return (bits & sign) ? ~bits : bits | sign;
+}
+
+static uint64_t value64(uint64_t key, int kind) {
+    uint64_t sign = 1ull << 63;
+    if (kind == COL_INT) {
+        return key ^ sign;
+    }
+    return (key & sign) ? key ^ sign : ~key;
+}
+
+static void to_keys(arrow_column *col) {
+    if (col->bits == 32) {
+        uint32_t *v = (uint32_t *)col->values;
+        for (int64_t i = 0; i < col->n; ++i) {
+            v[i] = key32(v[i], col->kind);
+        }
+    } else {
+        uint64_t *v = (uint64_t *)col->values;
+        for (int64_t i = 0; i < col->n; ++i) {
+            v[i] = key64(v[i], col->kind);
+        }
+    }
+}
+
+static void to_values(arrow_column *col) {
+    if (col->bits == 32) {
+        uint32_t *v = (uint32_t *)col->values;
+        for (int64_t i = 0; i < col->n; ++i) {
+            v[i] = value32(v[i], col->kind);
+        }
+    } else {
+        uint64_t *v = (uint64_t *)col->values;
+        for (int64_t i = 0; i < col->n; ++i) {
+            v[i] = value64(v[i], col->kind);
+        }
+    }
+}
+
+int arrow_sort(const struct ArrowSchema *schema, struct ArrowArray *array, ext_sort_fn sort,
+               void *arg) {
+    arrow_column col;
+    if (open_column(schema, array, &col) != 0) {
+        return -1;
+    }
+    if (col.n < 2) {
+        return 0;
+    }
+    to_keys(&col);
+    int rc = sort(col.values, (long)col.n, col.bits, arg);
+    int saved = errno;
+    to_values(&col);
+    if (rc != 0) {
+        errno = saved ? saved : EIO;
+        return -1;
+    }
+    return 0;
+}
+
+/* ---- Export ------------------------------------------------------------ */
+
+typedef struct {
+    const void *buffers[2];
+    void *values;
+} export_data;
+
+static void release_array(struct ArrowArray *array) {
+    export_data *d = (export_data *)array->private_data;
+    free(d->values);
+    free(d);
+    array->release = NULL;
+}
+
+static void release_schema(struct ArrowSchema *schema) {
+    schema->release = NULL;
+}
+
+int arrow_export(void *values, int64_t n, const char *format, struct ArrowSchema *out_schema,
+                 struct ArrowArray *out) {
+    /* The schema's format must outlive it, so it points at a literal. */
+    static const char *formats[] = {"i", "l", "f", "g", "L"};
+    const char *fmt = NULL;
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f) {
+        if (format && strcmp(format, formats[f]) == 0) {
+            fmt = formats[f];
+        }
+    }
+    if (!fmt || n < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    export_data *d = (export_data *)malloc(sizeof(export_data));
+    if (!d) {
+        errno = ENOMEM;
+        return -1;
+    }
+    d->buffers[0] = NULL;
+    d->buffers[1] = values;
+    d->values = values;
+
+    memset(out_schema, 0, sizeof(*out_schema));
+    out_schema->format = fmt;
+    out_schema->name = "";
+    out_schema->release = release_schema;
+
+    memset(out, 0, sizeof(*out));
+    out->length = n;
+    out->n_buffers = 2;
+    out->buffers = d->buffers;
+    out->release = release_array;
+    out->private_data = d;
+    return 0;
+}
+
+/* ---- Argsort ----------------------------------------------------------- */
+
+int arrow_argsort(const struct ArrowSchema *schema,
+                  const struct ArrowArray *array,
+                  ext_sort_fn sort,
+                  void *arg,
+                  struct ArrowSchema *out_schema,
+                  struct ArrowArray *out) {
+    arrow_column col;
+    if (open_column(schema, array, &col) != 0) {
+        return -1;
+    }
+    int64_t n = col.n;
+    uint64_t *idx = (uint64_t *)malloc(sizeof(uint64_t) * (size_t)(n > 0 ? n : 1));
+    if (!idx) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if (col.bits == 32 && n <= (int64_t)1 << 32) {
+        /* Key in the high half, row in the low half: the 64-bit sort orders
+           by value and then by row, which keeps it stable. */
+        const uint32_t *v = (const uint32_t *)col.values;
+        for (int64_t i = 0; i < n; ++i) {
+            idx[i] = (uint64_t)key32(v[i], col.kind) << 32 | (uint64_t)i;
+        }
+        if (n > 1 && sort(idx, (long)n, 64, arg) != 0) {
+            int saved = errno;
+            free(idx);
+            errno = saved ? saved : EIO;
+            return -1;
+        }
+        for (int64_t i = 0; i < n; ++i) {
+            idx[i] &= 0xffffffffull;
+        }
+    } else {
+        uint64_t *keys = (uint64_t *)malloc(sizeof(uint64_t) * (size_t)(n > 0 ? n : 1));
+        if (!keys) {
+            free(idx);
+            errno = ENOMEM;
+            return -1;
+        }
+        for (int64_t i = 0; i < n; ++i) {
+            uint64_t bits;
+            if (col.bits == 64) {
+                memcpy(&bits, col.values + (size_t)i * 8, sizeof(bits));
+                keys[i] = key64(bits, col.kind);
+            } else {
+                uint32_t b32;
+                memcpy(&b32, col.values + (size_t)i * 4, sizeof(b32));
+                keys[i] = key32(b32, col.kind);
+            }
+            idx[i] = (uint64_t)i;
+        }
+        int rc = radix_sort_kv_u64(keys, idx, (size_t)n, NULL);
+        free(keys);
+        if (rc != RADIX_OK) {
+            free(idx);
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+
+    if (arrow_export(idx, n, "L", out_schema, out) != 0) {
+        int saved = errno;
+        free(idx);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+#ifndef ARROW_SORT_H
+#define ARROW_SORT_H
+
+#include <stdint.h>
+
+#include "ext_sort.h"
+
+/* Sorting Arrow arrays through the Arrow C Data Interface.
+
+   The interface is two plain C structs, declared below exactly as the
+   Arrow specification gives them, so no Arrow library is needed. Supported
+   columns are int32, int64, float32 and float64 ("i", "l", "f", "g") with
+   no nulls. Values are sorted in place in the array's own data buffer: each
+   value is mapped to an unsigned key that orders the same way (the sign bit
+   flipped for integers; for IEEE floats the sign bit flipped on positives
+   and all bits on negatives), the keys are radix-sorted by the caller's
+   kernel, and the mapping is undone. Floats end up in IEEE total order:
+   -NaN, -inf, ..., -0.0, +0.0, ..., +inf, +NaN. An argsort leaves the
+   array alone and exports a new uint64 ("L") array of row indices, stable
+   for equal values. Functions return 0 on success and -1 with errno set:
+   EINVAL for an array they cannot sort, ENOMEM. */
+
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+    const char *format;
+    const char *name;
+    const char *metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema **children;
+    struct ArrowSchema *dictionary;
+    void (*release)(struct ArrowSchema *);
+    void *private_data;
+};
+
+struct ArrowArray {
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void **buffers;
+    struct ArrowArray **children;
+    struct ArrowArray *dictionary;
+    void (*release)(struct ArrowArray *);
+    void *private_data;
+};
+
+#endif
+
+/* Sorts the values of array ascending in place; the 32- or 64-bit keys go
+   through sort(keys, n, key_bits, arg). */
+int arrow_sort(const struct ArrowSchema *schema, struct ArrowArray *array, ext_sort_fn sort,
+               void *arg);
+
+/* Exports the indices that would sort array as a new "L" array in out,
+   which the caller releases. 32-bit values are paired with their index in
+   one 64-bit key and sorted through sort; 64-bit values are sorted as
+   (key, index) pairs by radix_sort_kv_u64 of libradix.h. */
+int arrow_argsort(const struct ArrowSchema *schema,
+                  const struct ArrowArray *array,
+                  ext_sort_fn sort,
+                  void *arg,
+                  struct ArrowSchema *out_schema,
+                  struct ArrowArray *out);
+
+/* Hands values[0, n), a malloc'd buffer in the given Arrow format ("i",
+   "l", "f", "g" or "L"), to a new Arrow array without copying. Its release
+   callback frees the buffer. */
+int arrow_export(void *values, int64_t n, const char *format, struct ArrowSchema *out_schema,
+                 struct ArrowArray *out);
+
+#endif
@@ -0,0 +1,1073 @@
+#ifndef _WIN32
+#define _XOPEN_SOURCE 700
+#endif
+
+#include "ext_sort.h"
+#include "io_engine.h"
+#include "key_codec.h"
+#include "sort_util.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* Chunk buffers in the run-generation ring: one being read, one being
+   sorted, one being written. */
+#define EXT_STAGES 3
+#define EXT_MIN_CHUNK (64L * 1024)
+/* Merge buffers below this size turn sequential I/O into seeks, so the
+   fan-in and the merge thread count are cut until each buffer reaches it. */
+#define EXT_MIN_MERGE_BUFFER (256L * 1024)
+#define EXT_MAX_MERGE_BUFFER (8L * 1024 * 1024)
+#define EXT_MAX_FANIN 1024
+/* Splitter keys sampled from each run, per merge thread. */
+#define EXT_SAMPLES_PER_THREAD 32
+/* Fewest keys a merge thread is given. */
+#define EXT_MIN_MERGE_KEYS (1L << 20)
+#define EXT_PATH_MAX 1024
+
+size_t ext_chunk_bytes(size_t mem_bytes, int key_bits) {
+    size_t key_bytes = (size_t)key_bits / 8;
+    /* The ring holds EXT_STAGES chunks and the kernel's scratch one more. */
+    size_t chunk_bytes = mem_bytes / (EXT_STAGES + 1);
+    chunk_bytes = chunk_bytes > EXT_MIN_CHUNK ? chunk_bytes : EXT_MIN_CHUNK;
+    if (chunk_bytes / key_bytes > INT_MAX) {
+        chunk_bytes = (size_t)INT_MAX * key_bytes;
+    }
+    return chunk_bytes - chunk_bytes % IO_ALIGN;   /* a multiple of both key sizes */
+}
+
+#ifndef _WIN32
+
+typedef struct {
+    char path[EXT_PATH_MAX];
+    long keys;
+    int fd;
+    size_t bytes;            /* file size */
+    key_block *index;        /* blocks of a compressed run; NULL if raw */
+    long blocks;
+    int keep;                /* the caller's file: merged, never removed */
+} ext_run;
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t ua = *(const uint64_t *)a;
+    uint64_t ub = *(const uint64_t *)b;
+    return (ua > ub) - (ua < ub);
+}
+
+static int run_path(char *path, const char *tmpdir, int index) {
+    int len = snprintf(path, EXT_PATH_MAX, "%s/radix_run_%ld_%d.tmp",
+                       tmpdir, (long)getpid(), index);
+    if (len < 0 || len >= EXT_PATH_MAX) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    return 0;
+}
+
+static void remove_runs(ext_run *runs, int count) {
+    for (int r = 0; r < count; ++r) {
+        if (runs[r].fd >= 0) {
+            close(runs[r].fd);
+            runs[r].fd = -1;
+        }
+        if (runs[r].path[0] != '\0') {
+            if (!runs[r].keep) {
+                unlink(runs[r].path);
+            }
+            runs[r].path[0] = '\0';
+        }
+        free(runs[r].index);
+        runs[r].index = NULL;
+    }
+}
+
+/* ---- Run generation ---------------------------------------------------- */
+
+typedef struct {
+    char *data;
+    io_request rd;
+    io_request wr;
+    int reading;
+    int writing;
+    int run;                 /* run whose write is in flight */
+    int direct;              /* that run's file was opened O_DIRECT */
+} stage_buf;
+
+static size_t align_up(size_t bytes) {
+    return (bytes + IO_ALIGN - 1) / IO_ALIGN * IO_ALIGN;
+}
+
+/* Waits for the run write in flight from b, if any, and closes the run. An
+   O_DIRECT write was padded to IO_ALIGN, so the file is cut back to size. */
+static int finish_write(io_engine *io, stage_buf *b, ext_run *runs, double *write_time) {
+    if (!b->writing) {
+        return 0;
+    }
+    b->writing = 0;
+    ext_run *run = &runs[b->run];
+    int rc = io_wait(io, &b->wr);
+    int saved = errno;
+    *write_time += b->wr.completed - b->wr.submitted;
+    if (rc == 0 && b->direct && ftruncate(run->fd, (off_t)run->bytes) != 0) {
+        rc = -1;
+        saved = errno;
+    }
+    if (close(run->fd) != 0 && rc == 0) {
+        rc = -1;
+        saved = errno;
+    }
+    run->fd = -1;
+    errno = saved;
+    return rc;
+}
+
+/* Reads the input in chunk_bytes pieces and leaves one sorted run file per
+   chunk in runs[0, chunks). Chunk c + 1 is read into the buffer that chunk
+   c - 2 was written from, so its read waits for that write only. Every
+   request is drained before returning, and every run that was created is
+   recorded in runs for cleanup. */
+static int generate_runs(io_engine *io,
+                         int in_fd,
+                         int in_direct,
+                         size_t in_bytes,
+                         size_t chunk_bytes,
+                         int chunks,
+                         ext_run *runs,
+                         const ext_sort_config *cfg,
+                         ext_sort_stats *stats) {
+    int key_bytes = cfg->key_bits / 8;
+    int stages = chunks < EXT_STAGES ? chunks : EXT_STAGES;
+    size_t buf_bytes = in_bytes < chunk_bytes ? align_up(in_bytes) : chunk_bytes;
+    stage_buf bufs[EXT_STAGES];
+    void *ptrs[EXT_STAGES];
+    size_t lens[EXT_STAGES];
+    memset(bufs, 0, sizeof(bufs));
+    for (int s = 0; s < stages; ++s) {
+        bufs[s].data = (char *)io_alloc(buf_bytes);
+        if (!bufs[s].data) {
+            for (int f = 0; f < s; ++f) {
+                io_free(bufs[f].data);
+            }
+            errno = ENOMEM;
+            return -1;
+        }
+        ptrs[s] = bufs[s].data;
+        lens[s] = buf_bytes;
+    }
+    int registered = io_engine_register(io, ptrs, lens, stages) == stages;
+    stats->registered = registered;
+
+    double t0 = sort_wall_time();
+    double read_time = 0.0;
+    double write_time = 0.0;
+    double sort_time = 0.0;
+    double sort_wait = 0.0;
+    double encode_time = 0.0;
+    size_t run_bytes = 0;
+    int err = 0;
+
+    size_t first = in_bytes < chunk_bytes ? in_bytes : chunk_bytes;
+    io_read(io, &bufs[0].rd, in_fd, bufs[0].data, in_direct ? align_up(first) : first, 0,
+            registered ? 0 : -1);
+    bufs[0].reading = 1;
+    for (int c = 0; c < chunks; ++c) {
+        int slot = c % EXT_STAGES;
+        stage_buf *b = &bufs[slot];
+        size_t off = (size_t)c * chunk_bytes;
+        size_t len = in_bytes - off < chunk_bytes ? in_bytes - off : chunk_bytes;
+
+        double w0 = sort_wall_time();
+        int rc = io_wait(io, &b->rd);
+        b->reading = 0;
+        sort_wait += sort_wall_time() - w0;
+        read_time += b->rd.completed - b->rd.submitted;
+        if (rc != 0 || b->rd.bytes < len) {
+            err = rc != 0 ? errno : EIO;   /* a short read: the file shrank */
+            break;
+        }
+
+        if (c + 1 < chunks) {
+            int next_slot = (c + 1) % EXT_STAGES;
+            stage_buf *nb = &bufs[next_slot];
+            if (finish_write(io, nb, runs, &write_time) != 0) {
+                err = errno;
+                break;
+            }
+            size_t next_off = off + chunk_bytes;
+            size_t next_len = in_bytes - next_off < chunk_bytes ? in_bytes - next_off : chunk_bytes;
+            io_read(io, &nb->rd, in_fd, nb->data, in_direct ? align_up(next_len) : next_len,
+                    (off_t)next_off, registered ? next_slot : -1);
+            nb->reading = 1;
+        }
+
+        double s0 = sort_wall_time();
+        long n = (long)(len / (size_t)key_bytes);
+        if (cfg->sort_chunk(b->data, n, cfg->key_bits, cfg->sort_arg) != 0) {
+            err = errno ? errno : EIO;
+            break;
+        }
+        sort_time += sort_wall_time() - s0;
+
+        ext_run *run = &runs[c];
+        run->keys = n;
+        run->bytes = len;
+        if (cfg->compress_runs) {
+            /* Packed in place, so the run is written from the same buffer. */
+            double e0 = sort_wall_time();
+            run->blocks = key_codec_blocks(n);
+            run->index = (key_block *)malloc(sizeof(key_block) * (size_t)run->blocks);
+            if (!run->index) {
+                err = ENOMEM;
+                break;
+            }
+            run->bytes = key_codec_encode(b->data, n, cfg->key_bits, run->index);
+            encode_time += sort_wall_time() - e0;
+        }
+        run_bytes += run->bytes;
+        if (run_path(run->path, cfg->tmpdir, c) != 0) {
+            run->path[0] = '\0';
+            err = errno;
+            break;
+        }
+        run->fd = io_open(run->path, O_WRONLY | O_CREAT | O_EXCL, 0600, cfg->direct, &b->direct);
+        if (run->fd < 0) {
+            run->path[0] = '\0';
+            err = errno;
+            break;
+        }
+        io_write(io, &b->wr, run->fd, b->data, b->direct ? align_up(run->bytes) : run->bytes, 0,
+                 registered ? slot : -1);
+        b->writing = 1;
+        b->run = c;
+    }
+
+    for (int s = 0; s < stages; ++s) {
+        if (bufs[s].reading) {
+            io_wait(io, &bufs[s].rd);
+        }
+        if (finish_write(io, &bufs[s], runs, &write_time) != 0 && err == 0) {
+            err = errno;
+        }
+    }
+    if (registered) {
+        io_engine_unregister(io);
+    }
+    for (int s = 0; s < stages; ++s) {
+        io_free(bufs[s].data);
+    }
+
+    stats->run_time = sort_wall_time() - t0;
+    stats->read_time = read_time;
+    stats->sort_time = sort_time;
+    stats->write_time = write_time;
+    stats->sort_wait = sort_wait;
+    stats->encode_time = encode_time;
+    stats->run_bytes = run_bytes;
+    if (err != 0) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+/* ---- Parallel k-way merge ---------------------------------------------- */
+
+/* A run slice being merged. The cursor consumes buf[cur] while the next
+   keys are read ahead into the other buffer. A compressed run is read in
+   whole blocks, which are decoded one at a time into dec. */
+typedef struct {
+    int fd;
+    long pos;        /* next key to request from the file */
+    long end;        /* one past this thread's last key in the run */
+    char *buf[2];
+    int cur;
+    char *keys;      /* current keys: buf[cur], or dec for a compressed run */
+    long buf_keys;
+    long buf_pos;
+    io_request req;
+    int pending;     /* a read into buf[1 - cur] is in flight */
+    long ahead;      /* keys, or bytes of blocks, being read ahead */
+    const ext_run *run;
+    long lo;             /* first key of this slice */
+    char *dec;
+    long block;          /* next block to read ahead */
+    long last_block;     /* one past the slice's last block */
+    long ahead_blocks;
+    long next_decode;    /* next block to decode from buf[cur] */
+    long held_end;       /* one past the last block in buf[cur] */
+    uint64_t held_off;   /* file offset of buf[cur] */
+} run_cursor;
+
+typedef struct {
+    io_engine *io;
+    const ext_run *runs;
+    int k;
+    int key_bytes;
+    int out_fd;
+    long buf_keys;           /* capacity of every buffer, in keys */
+    const long *lo;          /* lo[r], hi[r]: this part's keys of run r */
+    const long *hi;
+    long out_pos;            /* first output key of this part */
+    int error;
+} merge_part;
+
+static void cursor_prefetch(io_engine *io, run_cursor *c, long cap, int key_bytes) {
+    long n = c->end - c->pos < cap ? c->end - c->pos : cap;
+    c->ahead = n;
+    if (n == 0) {
+        return;
+    }
+    io_read(io, &c->req, c->fd, c->buf[1 - c->cur], (size_t)n * key_bytes,
+            (off_t)c->pos * key_bytes, -1);
+    c->pending = 1;
+    c->pos += n;
+}
+
+/* Reads ahead as many whole blocks as fit in cap keys' worth of bytes, and
+   at least one. Blocks of equal keys pack to nothing and need no read. */
+static void cursor_prefetch_packed(io_engine *io, run_cursor *c, long cap, int key_bytes) {
+    const key_block *index = c->run->index;
+    size_t cap_bytes = (size_t)cap * key_bytes;
+    size_t bytes = 0;
+    long b = c->block;
+    while (b < c->last_block) {
+        size_t packed = key_block_bytes(&index[b]);
+        if (b > c->block && bytes + packed > cap_bytes) {
+            break;
+        }
+        bytes += packed;
+        ++b;
+    }
+    c->ahead_blocks = b - c->block;
+    c->ahead = (long)bytes;
+    if (bytes > 0) {
+        io_read(io, &c->req, c->fd, c->buf[1 - c->cur], bytes, (off_t)index[c->block].offset, -1);
+        c->pending = 1;
+    }
+}
+
+/* Waits for the read ahead, if any; 0 when it delivered what was asked. */
+static int cursor_wait(io_engine *io, run_cursor *c, size_t want) {
+    if (!c->pending) {
+        return 0;
+    }
+    c->pending = 0;
+    if (io_wait(io, &c->req) != 0) {
+        return -1;
+    }
+    if (c->req.bytes != want) {
+        errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
+/* Decodes the next block of a compressed slice, switching to the read-ahead
+   buffer and starting the next read when buf[cur] is used up. */
+static int cursor_advance_packed(io_engine *io, run_cursor *c, long cap, int key_bytes) {
+    const key_block *index = c->run->index;
+    c->buf_pos = 0;
+    if (c->next_decode == c->held_end) {
+        c->buf_keys = 0;
+        if (c->ahead_blocks == 0) {
+            return 0;
+        }
+        if (cursor_wait(io, c, (size_t)c->ahead) != 0) {
+            return -1;
+        }
+        c->cur = 1 - c->cur;
+        c->next_decode = c->block;
+        c->held_end = c->block + c->ahead_blocks;
+        c->held_off = index[c->block].offset;
+        c->block = c->held_end;
+        cursor_prefetch_packed(io, c, cap, key_bytes);
+    }
+    long b = c->next_decode++;
+    const key_block *blk = &index[b];
+    key_block_decode(c->buf[c->cur] + (blk->offset - c->held_off), blk, key_bytes * 8, c->dec);
+    long first = b * KEY_BLOCK_KEYS;
+    long from = c->lo > first ? c->lo - first : 0;
+    long to = c->end - first < (long)blk->keys ? c->end - first : (long)blk->keys;
+    c->keys = c->dec + (size_t)from * key_bytes;
+    c->buf_keys = to - from;
+    return 0;
+}
+
+/* Switches to the read-ahead buffer and starts reading the next one. */
+static int cursor_advance(io_engine *io, run_cursor *c, long cap, int key_bytes) {
+    if (c->run->index) {
+        return cursor_advance_packed(io, c, cap, key_bytes);
+    }
+    c->buf_pos = 0;
+    c->buf_keys = c->ahead;
+    if (c->ahead == 0) {
+        return 0;
+    }
+    if (cursor_wait(io, c, (size_t)c->ahead * key_bytes) != 0) {
+        return -1;
+    }
+    c->ahead = 0;
+    c->cur = 1 - c->cur;
+    c->keys = c->buf[c->cur];
+    cursor_prefetch(io, c, cap, key_bytes);
+    return 0;
+}
+
+/* Two output buffers: one fills while the other is being written. */
+static int merge_part_run(merge_part *part) {
+    io_engine *io = part->io;
+    int k = part->k;
+    int kb = part->key_bytes;
+    long cap = part->buf_keys;
+    size_t buf_bytes = (size_t)cap * kb;
+    run_cursor *cur = (run_cursor *)calloc((size_t)k, sizeof(run_cursor));
+    int *heap = (int *)malloc(sizeof(int) * k);
+    uint64_t *top = (uint64_t *)malloc(sizeof(uint64_t) * k);
+    char *out[2] = {(char *)malloc(buf_bytes), (char *)malloc(buf_bytes)};
+    io_request out_req[2];
+    int out_busy[2] = {0, 0};
+    int o = 0;
+    int rc = -1;
+    errno = 0;
+    if (!cur || !heap || !top || !out[0] || !out[1]) {
+        errno = ENOMEM;
+        goto done;
+    }
+
+    int size = 0;
+    for (int r = 0; r < k; ++r) {
+        const ext_run *run = &part->runs[r];
+        run_cursor *c = &cur[r];
+        c->fd = run->fd;
+        c->run = run;
+        c->pos = part->lo[r];
+        c->lo = part->lo[r];
+        c->end = part->hi[r];
+        if (c->pos == c->end) {
+            continue;
+        }
+        /* A compressed block may be read past its end by KEY_CODEC_PAD. */
+        size_t in_bytes = run->index ? buf_bytes + KEY_CODEC_PAD : buf_bytes;
+        c->buf[0] = (char *)malloc(in_bytes);
+        c->buf[1] = (char *)malloc(in_bytes);
+        if (run->index) {
+            c->dec = (char *)malloc((size_t)KEY_BLOCK_KEYS * kb);
+        }
+        if (!c->buf[0] || !c->buf[1] || (run->index && !c->dec)) {
+            errno = ENOMEM;
+            goto done;
+        }
+        if (run->index) {
+            c->block = c->lo / KEY_BLOCK_KEYS;
+            c->last_block = (c->end + KEY_BLOCK_KEYS - 1) / KEY_BLOCK_KEYS;
+            c->next_decode = c->held_end = c->block;
+            cursor_prefetch_packed(io, c, cap, kb);
+        } else {
+            cursor_prefetch(io, c, cap, kb);
+        }
+        if (cursor_advance(io, c, cap, kb) != 0) {
+            goto done;
+        }
+        top[r] = sort_load_key(c->keys, kb);
+        heap[size++] = r;
+    }
+    for (int i = size / 2 - 1; i >= 0; --i) {
+        sort_heap_sift(heap, top, size, i);
+    }
+
+    off_t out_off = (off_t)part->out_pos * kb;
+    long out_n = 0;
+    while (size > 0) {
+        int r = heap[0];
+        run_cursor *c = &cur[r];
+        memcpy(out[o] + (size_t)out_n * kb, c->keys + (size_t)c->buf_pos * kb, (size_t)kb);
+        if (++out_n == cap) {
+            io_write(io, &out_req[o], part->out_fd, out[o], buf_bytes, out_off, -1);
+            out_busy[o] = 1;
+            out_off += (off_t)buf_bytes;
+            out_n = 0;
+            o = 1 - o;
+            if (out_busy[o]) {
+                out_busy[o] = 0;
+                if (io_wait(io, &out_req[o]) != 0) {
+                    goto done;
+                }
+            }
+        }
+        if (++c->buf_pos == c->buf_keys && cursor_advance(io, c, cap, kb) != 0) {
+            goto done;
+        }
+        if (c->buf_pos < c->buf_keys) {
+            top[r] = sort_load_key(c->keys + (size_t)c->buf_pos * kb, kb);
+        } else {
+            heap[0] = heap[--size];
+        }
+        sort_heap_sift(heap, top, size, 0);
+    }
+    if (out_n > 0) {
+        io_write(io, &out_req[o], part->out_fd, out[o], (size_t)out_n * kb, out_off, -1);
+        out_busy[o] = 1;
+    }
+    rc = 0;
+
+done:
+    if (rc != 0) {
+        part->error = errno ? errno : EIO;
+    }
+    /* Nothing may be freed while a request still points into it. */
+    for (int b = 0; b < 2; ++b) {
+        if (out_busy[b] && io_wait(io, &out_req[b]) != 0 && part->error == 0) {
+            part->error = errno;
+            rc = -1;
+        }
+    }
+    if (cur) {
+        for (int r = 0; r < k; ++r) {
+            if (cur[r].pending) {
+                io_wait(io, &cur[r].req);
+            }
+            free(cur[r].buf[0]);
+            free(cur[r].buf[1]);
+            free(cur[r].dec);
+        }
+    }
+    free(cur);
+    free(heap);
+    free(top);
+    free(out[0]);
+    free(out[1]);
+    return rc;
+}
+
+static void *merge_worker(void *arg) {
+    merge_part_run((merge_part *)arg);
+    return NULL;
+}
+
+/* Reads and decodes block b of a compressed run into keys. */
+static int disk_block(const ext_run *run, int key_bytes, long b, char *keys) {
+    const key_block *blk = &run->index[b];
+    char packed[KEY_BLOCK_KEYS * 8 + KEY_CODEC_PAD];
+    if (sort_read_full(run->fd, packed, key_block_bytes(blk), (off_t)blk->offset) != 0) {
+        return -1;
+    }
+    key_block_decode(packed, blk, key_bytes * 8, keys);
+    return 0;
+}
+
+static int disk_key(const ext_run *run, int key_bytes, long index, uint64_t *key) {
+    if (run->index) {
+        long b = index / KEY_BLOCK_KEYS;
+        if (index % KEY_BLOCK_KEYS == 0) {
+            *key = run->index[b].first;
+            return 0;
+        }
+        char keys[KEY_BLOCK_KEYS * 8];
+        if (disk_block(run, key_bytes, b, keys) != 0) {
+            return -1;
+        }
+        *key = sort_load_key(keys + (size_t)(index % KEY_BLOCK_KEYS) * key_bytes, key_bytes);
+        return 0;
+    }
+    char raw[8];
+    if (sort_read_full(run->fd, raw, (size_t)key_bytes, (off_t)index * key_bytes) != 0) {
+        return -1;
+    }
+    *key = sort_load_key(raw, key_bytes);
+    return 0;
+}
+
+/* First index in the run whose key is >= key, by binary search on disk. A
+   compressed run is searched in its block index and then in one block. */
+static int disk_lower_bound(const ext_run *run, int key_bytes, uint64_t key, long *pos) {
+    if (run->index) {
+        long b = key_codec_find_block(run->index, run->blocks, key);
+        char keys[KEY_BLOCK_KEYS * 8];
+        if (disk_block(run, key_bytes, b, keys) != 0) {
+            return -1;
+        }
+        long i = 0;
+        long m = run->index[b].keys;
+        while (i < m && sort_load_key(keys + (size_t)i * key_bytes, key_bytes) < key) {
+            ++i;
+        }
+        *pos = b * KEY_BLOCK_KEYS + i;
+        return 0;
+    }
+    long lo = 0;
+    long hi = run->keys;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        uint64_t k;
+        if (disk_key(run, key_bytes, mid, &k) != 0) {
+            return -1;
+        }
+        if (k < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *pos = lo;
+    return 0;
+}
+
+/* bounds[t * k + r] is where part t starts in run r; row `parts` holds the
+   run lengths. Splitters are quantiles of keys sampled evenly from every
+   run, and each run is cut at the splitter's lower bound, so equal keys
+   never straddle two parts and the parts concatenate in order. */
+static int split_runs(const ext_run *runs, int k, int key_bytes, int parts, long *bounds) {
+    for (int r = 0; r < k; ++r) {
+        bounds[r] = 0;
+        bounds[(size_t)parts * k + r] = runs[r].keys;
+    }
+    if (parts == 1) {
+        return 0;
+    }
+    long per_run = (long)parts * EXT_SAMPLES_PER_THREAD;
+    uint64_t *sample = (uint64_t *)malloc(sizeof(uint64_t) * per_run * k);
+    if (!sample) {
+        errno = ENOMEM;
+        return -1;
+    }
+    long s = 0;
+    for (int r = 0; r < k; ++r) {
+        long take = runs[r].keys < per_run ? runs[r].keys : per_run;
+        for (long i = 0; i < take; ++i) {
+            long index = (long)((double)(i + 0.5) * (double)runs[r].keys / (double)take);
+            if (disk_key(&runs[r], key_bytes, index, &sample[s++]) != 0) {
+                free(sample);
+                return -1;
+            }
+        }
+    }
+    qsort(sample, (size_t)s, sizeof(uint64_t), cmp_u64);
+    for (int t = 1; t < parts; ++t) {
+        uint64_t splitter = sample[(long)t * s / parts];
+        for (int r = 0; r < k; ++r) {
+            if (disk_lower_bound(&runs[r], key_bytes, splitter, &bounds[(size_t)t * k + r]) != 0) {
+                free(sample);
+                return -1;
+            }
+        }
+    }
+    free(sample);
+    return 0;
+}
+
+/* Merges runs[0, k) into path with up to `threads` threads inside mem_bytes. */
+static int merge_runs(io_engine *io,
+                      ext_run *runs,
+                      int k,
+                      const char *path,
+                      int key_bytes,
+                      size_t mem_bytes,
+                      int threads,
+                      ext_sort_stats *stats) {
+    long total = 0;
+    for (int r = 0; r < k; ++r) {
+        total += runs[r].keys;
+    }
+    /* Every part double-buffers each run and its output. */
+    long max_parts = (long)(mem_bytes / ((size_t)2 * (k + 1) * EXT_MIN_MERGE_BUFFER));
+    long parts = threads;
+    parts = parts < max_parts ? parts : max_parts;
+    parts = parts < total / EXT_MIN_MERGE_KEYS ? parts : total / EXT_MIN_MERGE_KEYS;
+    parts = parts < 1 ? 1 : parts;
+    size_t buf_bytes = mem_bytes / ((size_t)parts * 2 * (k + 1));
+    buf_bytes = buf_bytes < EXT_MAX_MERGE_BUFFER ? buf_bytes : EXT_MAX_MERGE_BUFFER;
+    buf_bytes = buf_bytes > EXT_MIN_MERGE_BUFFER ? buf_bytes : EXT_MIN_MERGE_BUFFER;
+    long buf_keys = (long)(buf_bytes / key_bytes);
+
+    int out_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out_fd < 0) {
+        return -1;
+    }
+    for (int r = 0; r < k; ++r) {
+        runs[r].fd = open(runs[r].path, O_RDONLY);
+        if (runs[r].fd < 0) {
+            goto fail;
+        }
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(runs[r].fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+    /* Sized up front so every part writes its own region independently. */
+    if (ftruncate(out_fd, (off_t)total * key_bytes) != 0) {
+        goto fail;
+    }
+
+    long *bounds = (long *)malloc(sizeof(long) * (size_t)(parts + 1) * k);
+    merge_part *part = (merge_part *)calloc((size_t)parts, sizeof(merge_part));
+    pthread_t *tids = (pthread_t *)malloc(sizeof(pthread_t) * parts);
+    int *started = (int *)calloc((size_t)parts, sizeof(int));
+    if (!bounds || !part || !tids || !started) {
+        free(bounds);
+        free(part);
+        free(tids);
+        free(started);
+        errno = ENOMEM;
+        goto fail;
+    }
+    int err = 0;
+    if (split_runs(runs, k, key_bytes, (int)parts, bounds) != 0) {
+        err = errno;
+    }
+    long out_pos = 0;
+    for (long t = 0; t < parts && err == 0; ++t) {
+        part[t].io = io;
+        part[t].runs = runs;
+        part[t].k = k;
+        part[t].key_bytes = key_bytes;
+        part[t].out_fd = out_fd;
+        part[t].buf_keys = buf_keys;
+        part[t].lo = &bounds[(size_t)t * k];
+        part[t].hi = &bounds[(size_t)(t + 1) * k];
+        part[t].out_pos = out_pos;
+        for (int r = 0; r < k; ++r) {
+            out_pos += part[t].hi[r] - part[t].lo[r];
+        }
+        if (t > 0) {
+            started[t] = pthread_create(&tids[t], NULL, merge_worker, &part[t]) == 0;
+        }
+    }
+    if (err == 0) {
+        merge_part_run(&part[0]);
+        for (long t = 1; t < parts; ++t) {
+            if (started[t]) {
+                pthread_join(tids[t], NULL);
+            } else {
+                merge_part_run(&part[t]);
+            }
+        }
+        for (long t = 0; t < parts && err == 0; ++t) {
+            err = part[t].error;
+        }
+    }
+    free(bounds);
+    free(part);
+    free(tids);
+    free(started);
+    if (err != 0) {
+        errno = err;
+        goto fail;
+    }
+
+    if (close(out_fd) != 0) {
+        out_fd = -1;
+        goto fail;
+    }
+    for (int r = 0; r < k; ++r) {
+        close(runs[r].fd);
+        runs[r].fd = -1;
+    }
+    stats->merge_threads = (int)parts;
+    stats->merge_buffer_bytes = (size_t)buf_keys * key_bytes;
+    return 0;
+
+fail:;
+    int saved = errno;
+    if (out_fd >= 0) {
+        close(out_fd);
+    }
+    for (int r = 0; r < k; ++r) {
+        if (runs[r].fd >= 0) {
+            close(runs[r].fd);
+            runs[r].fd = -1;
+        }
+    }
+    errno = saved;
+    return -1;
+}
+
+/* Runs whose count exceeds the fan-in the budget allows are merged in
+   groups into longer runs first; the last merge writes the output. */
+static int merge_all(io_engine *io,
+                     ext_run *runs,
+                     int count,
+                     const char *output,
+                     const ext_sort_config *cfg,
+                     ext_sort_stats *stats) {
+    int key_bytes = cfg->key_bits / 8;
+    long fanin = (long)(cfg->mem_bytes / (2 * EXT_MIN_MERGE_BUFFER)) - 1;
+    fanin = fanin < EXT_MAX_FANIN ? fanin : EXT_MAX_FANIN;
+    fanin = fanin > 2 ? fanin : 2;
+    int next_index = count;
+
+    while (count > fanin) {
+        int merged = 0;
+        for (int g = 0; g < count; g += (int)fanin) {
+            int k = count - g < fanin ? count - g : (int)fanin;
+            ext_run *group = &runs[g];
+            /* Longer runs are written raw: merge threads write their parts at
+               offsets known only from key counts. */
+            ext_run longer;
+            memset(&longer, 0, sizeof(longer));
+            longer.fd = -1;
+            if (run_path(longer.path, cfg->tmpdir, next_index++) != 0) {
+                remove_runs(runs, count);
+                return -1;
+            }
+            for (int r = 0; r < k; ++r) {
+                longer.keys += group[r].keys;
+            }
+            longer.bytes = (size_t)longer.keys * key_bytes;
+            if (merge_runs(io, group, k, longer.path, key_bytes, cfg->mem_bytes,
+                           cfg->merge_threads, stats) != 0) {
+                int saved = errno;
+                unlink(longer.path);
+                remove_runs(runs, count);
+                remove_runs(runs, merged);
+                errno = saved;
+                return -1;
+            }
+            remove_runs(group, k);
+            runs[merged++] = longer;
+        }
+        count = merged;
+    }
+
+    int rc = merge_runs(io, runs, count, output, key_bytes, cfg->mem_bytes, cfg->merge_threads,
+                        stats);
+    int saved = errno;
+    remove_runs(runs, count);
+    errno = saved;
+    return rc;
+}
+
+/* Reads input and leaves it sorted in run files. *runs has room for
+   `extra` more entries; with no keys it is NULL and *io too. */
+static int sort_into_runs(const char *input,
+                          const ext_sort_config *cfg,
+                          int extra,
+                          io_engine **io_out,
+                          ext_run **runs_out,
+                          int *count,
+                          ext_sort_stats *stats) {
+    *io_out = NULL;
+    *runs_out = NULL;
+    *count = 0;
+    size_t key_bytes = (size_t)cfg->key_bits / 8;
+    int in_direct = 0;
+    int in_fd = io_open(input, O_RDONLY, 0, cfg->direct, &in_direct);
+    if (in_fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(in_fd, &st) != 0) {
+        int saved = errno;
+        close(in_fd);
+        errno = saved;
+        return -1;
+    }
+    size_t in_bytes = (size_t)st.st_size;
+    if (in_bytes % key_bytes != 0) {
+        close(in_fd);
+        errno = EINVAL;
+        return -1;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(in_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    size_t chunk_bytes = ext_chunk_bytes(cfg->mem_bytes, cfg->key_bits);
+    size_t chunks = (in_bytes + chunk_bytes - 1) / chunk_bytes;
+    stats->keys = (long)(in_bytes / key_bytes);
+    stats->chunk_bytes = chunk_bytes;
+    stats->runs = (int)chunks;
+    if (chunks == 0) {
+        close(in_fd);
+        return 0;
+    }
+
+    io_engine *io = NULL;
+    if (io_engine_create(&io, cfg->io_kind, cfg->io_depth, 0) != 0) {
+        int saved = errno;
+        close(in_fd);
+        errno = saved;
+        return -1;
+    }
+    stats->io_kind = io_engine_kind(io);
+    stats->direct = in_direct;
+
+    ext_run *runs = (ext_run *)calloc(chunks + (size_t)extra, sizeof(ext_run));
+    if (!runs) {
+        io_engine_destroy(io);
+        close(in_fd);
+        errno = ENOMEM;
+        return -1;
+    }
+    for (size_t c = 0; c < chunks + (size_t)extra; ++c) {
+        runs[c].fd = -1;
+    }
+
+    int rc = generate_runs(io, in_fd, in_direct, in_bytes, chunk_bytes, (int)chunks, runs, cfg,
+                           stats);
+    int saved = errno;
+    close(in_fd);
+    if (rc != 0) {
+        remove_runs(runs, (int)chunks);
+        free(runs);
+        io_engine_destroy(io);
+        errno = saved;
+        return -1;
+    }
+    *io_out = io;
+    *runs_out = runs;
+    *count = (int)chunks;
+    return 0;
+}
+
+/* Merges runs[0, count) into output and releases them, the array and io. */
+static int finish_runs(io_engine *io,
+                       ext_run *runs,
+                       int count,
+                       const char *output,
+                       const ext_sort_config *cfg,
+                       ext_sort_stats *stats) {
+    double t0 = sort_wall_time();
+    int rc = 0;
+    int saved = 0;
+    if (count == 0) {
+        int fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        rc = fd < 0 ? -1 : close(fd);
+        saved = errno;
+    } else if (count == 1 && !runs[0].index && !runs[0].keep && rename(runs[0].path, output) == 0) {
+        /* A single raw run is already the answer when it can simply be renamed. */
+        runs[0].path[0] = '\0';
+    } else {
+        rc = merge_all(io, runs, count, output, cfg, stats);
+        saved = errno;
+    }
+    stats->merge_time = sort_wall_time() - t0;
+    free(runs);
+    io_engine_destroy(io);
+    errno = saved;
+    return rc;
+}
+
+static int check_config(const ext_sort_config *cfg) {
+    if ((cfg->key_bits != 32 && cfg->key_bits != 64) || !cfg->sort_chunk || !cfg->tmpdir) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+int ext_sort_file(const char *input,
+                  const char *output,
+                  const ext_sort_config *cfg,
+                  ext_sort_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    io_engine *io;
+    ext_run *runs;
+    int count;
+    if (check_config(cfg) != 0 || sort_into_runs(input, cfg, 0, &io, &runs, &count, stats) != 0) {
+        return -1;
+    }
+    return finish_runs(io, runs, count, output, cfg, stats);
+}
+
+int ext_merge_into(const char *base,
+                   const char *batch,
+                   const ext_sort_config *cfg,
+                   ext_sort_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    size_t key_bytes = (size_t)cfg->key_bits / 8;
+    if (check_config(cfg) != 0) {
+        return -1;
+    }
+    /* A missing base starts out empty. */
+    struct stat st;
+    int have_base = stat(base, &st) == 0;
+    if (!have_base && errno != ENOENT) {
+        return -1;
+    }
+    size_t base_bytes = have_base ? (size_t)st.st_size : 0;
+    if (base_bytes % key_bytes != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    io_engine *io;
+    ext_run *runs;
+    int count;
+    if (sort_into_runs(batch, cfg, 1, &io, &runs, &count, stats) != 0) {
+        return -1;
+    }
+    stats->base_keys = (long)(base_bytes / key_bytes);
+    if (count == 0 && have_base) {
+        return 0;   /* nothing new */
+    }
+    if (base_bytes > 0) {
+        ext_run *old = &runs[count++];
+        snprintf(old->path, EXT_PATH_MAX, "%s", base);
+        old->keys = stats->base_keys;
+        old->bytes = base_bytes;
+        old->keep = 1;
+    }
+
+    /* Merged next to base and renamed over it, so base stays whole until
+       the merge has succeeded. */
+    char tmp[EXT_PATH_MAX];
+    int len = snprintf(tmp, sizeof(tmp), "%s.merge_%ld.tmp", base, (long)getpid());
+    if (len < 0 || len >= (int)sizeof(tmp)) {
+        remove_runs(runs, count);
+        free(runs);
+        io_engine_destroy(io);
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if (finish_runs(io, runs, count, tmp, cfg, stats) != 0) {
+        int saved = errno;
+        unlink(tmp);
+        errno = saved;
+        return -1;
+    }
+    if (rename(tmp, base) != 0) {
+        int saved = errno;
+        unlink(tmp);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+#else
+
+int ext_merge_into(const char *base,
+                   const char *batch,
+                   const ext_sort_config *cfg,
+                   ext_sort_stats *stats) {
+    (void)base;
+    (void)batch;
+    (void)cfg;
+    memset(stats, 0, sizeof(*stats));
+    errno = ENOSYS;
+    return -1;
+}
+
+int ext_sort_file(const char *input,
+                  const char *output,
+                  const ext_sort_config *cfg,
+                  ext_sort_stats *stats) {
+    (void)input;
+    (void)output;
+    (void)cfg;
+    memset(stats, 0, sizeof(*stats));
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif
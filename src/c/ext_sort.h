@@ -0,0 +1,83 @@
+#ifndef EXT_SORT_H
+#define EXT_SORT_H
+
+#include <stddef.h>
+
+/* External (out-of-core) sort of raw little-endian key files.
+
+   Run generation is a three-stage pipeline over a ring of chunk buffers.
+   While the calling thread sorts the current chunk with the caller's
+   kernel, the read of the next chunk and the write of the previous one as a
+   sorted run file are in flight on the asynchronous I/O engine (io_engine.h).
+   The runs are then merged by several threads at once. Splitter keys sampled
+   from the runs cut the key space into one range per thread, and each thread
+   k-way merges its slice of every run into its own region of the output.
+   Every run cursor reads ahead into a second buffer, and output buffers are
+   written behind. All buffers together stay within mem_bytes, except the
+   scratch the sort kernel allocates for the chunk it is sorting, which is
+   counted as one chunk. With compress_runs each sorted chunk is packed in
+   place into delta/bit-packed blocks before it is written, and the merge
+   reads whole blocks and decodes them as it goes, which trades disk traffic
+   for a little CPU on dense key spaces. Functions return 0 on success and
+   -1 with errno set. */
+
+/* Sorts keys[0, n) ascending; returns 0 on success. */
+typedef int (*ext_sort_fn)(void *keys, long n, int key_bits, void *arg);
+
+typedef struct {
+    size_t mem_bytes;        /* budget for chunk, scratch and merge buffers */
+    int key_bits;            /* 32 or 64 */
+    int merge_threads;
+    const char *tmpdir;      /* where run files go; removed after the merge */
+    int io_kind;             /* IO_AUTO, IO_URING or IO_THREADS */
+    int io_depth;            /* pieces in flight; 0: IO_DEFAULT_DEPTH */
+    int direct;              /* O_DIRECT for the input and run files where allowed */
+    int compress_runs;       /* write runs as compressed blocks (key_codec.h) */
+    ext_sort_fn sort_chunk;
+    void *sort_arg;
+} ext_sort_config;
+
+typedef struct {
+    long keys;
+    int runs;
+    size_t chunk_bytes;
+    int merge_threads;
+    size_t merge_buffer_bytes;   /* per run, per merge thread */
+    int io_kind;                 /* backend used: IO_URING or IO_THREADS */
+    int direct;                  /* 1 if O_DIRECT was in effect */
+    int registered;              /* chunk buffers registered with the ring */
+    double run_time;             /* wall time of run generation */
+    double read_time;            /* submit-to-completion time of reads and writes, */
+    double sort_time;            /* and busy time of the sorter */
+    double write_time;
+    double sort_wait;            /* time the sorter waited for a read */
+    double encode_time;          /* compressing runs, on the sorter thread */
+    size_t run_bytes;            /* bytes of the initial run files */
+    long base_keys;              /* ext_merge_into: keys already in the base file */
+    double merge_time;
+} ext_sort_stats;
+
+/* Bytes of each run-generation chunk under a mem_bytes budget: a quarter
+   of it, at least 64 KiB, rounded down to whole I/O blocks and never more
+   than INT_MAX keys, so a budget beyond 32 GiB (64 GiB for 64-bit keys)
+   gives more runs instead of chunks longer than the sort kernels take. */
+size_t ext_chunk_bytes(size_t mem_bytes, int key_bits);
+
+int ext_sort_file(const char *input,
+                  const char *output,
+                  const ext_sort_config *cfg,
+                  ext_sort_stats *stats);
+
+/* Sorts the keys of batch the same way and merges them into base, a file
+   of keys already sorted ascending, which is then replaced. The keys of
+   base are only read and merged, never sorted again, so adding a batch
+   costs a sort of the batch plus one sequential pass over base. The merge
+   goes to a temporary file next to base that is renamed over it at the
+   end; a missing base counts as empty and is created. stats->keys counts
+   the batch. */
+int ext_merge_into(const char *base,
+                   const char *batch,
+                   const ext_sort_config *cfg,
+                   ext_sort_stats *stats);
+
+#endif
@@ -0,0 +1,694 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#elif !defined(_WIN32)
+#define _XOPEN_SOURCE 700
+#endif
+
+#include "io_engine.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sort_util.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#define IO_POOL_THREADS 4
+#define IO_MAX_DEPTH 4096
+#define SHUTDOWN_TAG 0ull    /* user_data of the NOP that stops the reaper */
+
+#ifndef _WIN32
+
+typedef struct {
+    io_request *req;
+    int fd;
+    char *buf;
+    size_t len;
+    off_t off;
+    int write;
+    int buf_index;
+    int next_free;
+} io_piece;
+
+#ifdef HAVE_IO_URING
+typedef struct {
+    int fd;
+    void *sq_map;
+    void *cq_map;
+    size_t sq_map_bytes;
+    size_t cq_map_bytes;
+    struct io_uring_sqe *sqes;
+    size_t sqes_bytes;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    pthread_mutex_t sq_lock;
+    pthread_t reaper;
+    int registered;
+} uring;
+#endif
+
+struct io_engine {
+    int kind;
+    int depth;
+    io_piece *pieces;
+    int free_head;               /* free piece slots, linked by next_free */
+    pthread_mutex_t lock;        /* slots, request counters */
+    pthread_cond_t changed;
+    /* Thread pool: a ring of piece indices waiting for a worker. */
+    int *queue;
+    int queue_head;
+    int queue_count;
+    int stopping;
+    pthread_cond_t queued;
+    pthread_t *workers;
+    int workers_started;
+#ifdef HAVE_IO_URING
+    uring ring;
+#endif
+};
+
+/* Called with the result of one piece: bytes moved, 0 for end of file, or
+   -errno. Releases the slot and completes the request with its last piece. */
+static void piece_done(io_engine *io, int slot, long result) {
+    pthread_mutex_lock(&io->lock);
+    io_piece *p = &io->pieces[slot];
+    io_request *req = p->req;
+    if (result < 0) {
+        if (req->error == 0) {
+            req->error = (int)-result;
+        }
+    } else {
+        req->bytes += (size_t)result;
+    }
+    if (--req->pending == 0) {
+        req->completed = sort_wall_time();
+    }
+    p->next_free = io->free_head;
+    io->free_head = slot;
+    pthread_cond_broadcast(&io->changed);
+    pthread_mutex_unlock(&io->lock);
+}
+
+/* Runs a piece to completion with pread/pwrite; the result as for piece_done. */
+static long run_piece_sync(io_piece *p) {
+    size_t done = 0;
+    while (done < p->len) {
+        ssize_t rc = p->write ? pwrite(p->fd, p->buf + done, p->len - done, p->off + (off_t)done)
+                              : pread(p->fd, p->buf + done, p->len - done, p->off + (off_t)done);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -(long)errno;
+        }
+        if (rc == 0) {
+            if (p->write) {
+                return -(long)EIO;
+            }
+            break;
+        }
+        done += (size_t)rc;
+    }
+    return (long)done;
+}
+
+/* ---- Thread-pool backend ----------------------------------------------- */
+
+static void *pool_worker(void *arg) {
+    io_engine *io = (io_engine *)arg;
+    for (;;) {
+        pthread_mutex_lock(&io->lock);
+        while (io->queue_count == 0 && !io->stopping) {
+            pthread_cond_wait(&io->queued, &io->lock);
+        }
+        if (io->queue_count == 0) {
+            pthread_mutex_unlock(&io->lock);
+            return NULL;
+        }
+        int slot = io->queue[io->queue_head];
+        io->queue_head = (io->queue_head + 1) % io->depth;
+        io->queue_count--;
+        pthread_mutex_unlock(&io->lock);
+        piece_done(io, slot, run_piece_sync(&io->pieces[slot]));
+    }
+}
+
+static int pool_start(io_engine *io, int threads) {
+    threads = threads > 0 ? threads : IO_POOL_THREADS;
+    threads = threads < io->depth ? threads : io->depth;
+    io->queue = (int *)malloc(sizeof(int) * io->depth);
+    io->workers = (pthread_t *)malloc(sizeof(pthread_t) * threads);
+    if (!io->queue || !io->workers || pthread_cond_init(&io->queued, NULL) != 0) {
+        free(io->queue);
+        free(io->workers);
+        io->queue = NULL;
+        io->workers = NULL;
+        errno = ENOMEM;
+        return -1;
+    }
+    for (int t = 0; t < threads; ++t) {
+        if (pthread_create(&io->workers[t], NULL, pool_worker, io) != 0) {
+            break;
+        }
+        io->workers_started++;
+    }
+    if (io->workers_started == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+    return 0;
+}
+
+static void pool_stop(io_engine *io) {
+    if (io->queue) {
+        pthread_mutex_lock(&io->lock);
+        io->stopping = 1;
+        pthread_cond_broadcast(&io->queued);
+        pthread_mutex_unlock(&io->lock);
+        for (int t = 0; t < io->workers_started; ++t) {
+            pthread_join(io->workers[t], NULL);
+        }
+        pthread_cond_destroy(&io->queued);
+    }
+    free(io->queue);
+    free(io->workers);
+}
+
+static void pool_submit(io_engine *io, int slot) {
+    pthread_mutex_lock(&io->lock);
+    io->queue[(io->queue_head + io->queue_count) % io->depth] = slot;
+    io->queue_count++;
+    pthread_cond_signal(&io->queued);
+    pthread_mutex_unlock(&io->lock);
+}
+
+/* ---- io_uring backend -------------------------------------------------- */
+
+#ifdef HAVE_IO_URING
+
+static int uring_enter(int fd, unsigned submit, unsigned wait, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, submit, wait, flags, NULL, 0);
+}
+
+/* Queues one SQE and submits it. A slot is held for every SQE that is not
+   the shutdown NOP, and depth never exceeds the ring, so the ring has room. */
+static int uring_push(uring *r, int slot, const io_piece *p) {
+    pthread_mutex_lock(&r->sq_lock);
+    unsigned tail = *r->sq_tail;
+    unsigned index = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    if (p) {
+        int fixed = r->registered && p->buf_index >= 0;
+        if (p->write) {
+            sqe->opcode = fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        } else {
+            sqe->opcode = fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        }
+        sqe->fd = p->fd;
+        sqe->addr = (uint64_t)(uintptr_t)p->buf;
+        sqe->len = (uint32_t)p->len;
+        sqe->off = (uint64_t)p->off;
+        sqe->buf_index = fixed ? (uint16_t)p->buf_index : 0;
+        sqe->user_data = (uint64_t)slot + 1;
+    } else {
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = SHUTDOWN_TAG;
+    }
+    r->sq_array[index] = index;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    int rc;
+    do {
+        rc = uring_enter(r->fd, 1, 0, 0);
+    } while (rc < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY));
+    pthread_mutex_unlock(&r->sq_lock);
+    return rc < 0 ? -1 : 0;
+}
+
+/* Reaps completions until the shutdown NOP comes back. A short transfer is
+   resubmitted for its remainder; a read returning 0 has hit end of file. */
+static void *uring_reaper(void *arg) {
+    io_engine *io = (io_engine *)arg;
+    uring *r = &io->ring;
+    int stopping = 0;
+    while (!stopping) {
+        if (uring_enter(r->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+            /* Nothing sensible left to wait for; fail what is in flight. */
+            stopping = 1;
+        }
+        unsigned head = *r->cq_head;
+        unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+            if (cqe->user_data == SHUTDOWN_TAG) {
+                stopping = 1;
+                continue;
+            }
+            int slot = (int)(cqe->user_data - 1);
+            io_piece *p = &io->pieces[slot];
+            long res = cqe->res;
+            if (res == -EINTR || res == -EAGAIN) {
+                if (uring_push(r, slot, p) == 0) {
+                    continue;
+                }
+                res = -(long)errno;
+            } else if (res > 0 && (size_t)res < p->len) {
+                /* Finish the remainder synchronously instead of tracking
+                   partial progress; short transfers are rare. */
+                io_piece rest = *p;
+                rest.buf += res;
+                rest.len -= (size_t)res;
+                rest.off += res;
+                long more = run_piece_sync(&rest);
+                res = more < 0 ? more : res + more;
+            }
+            piece_done(io, slot, res);
+        }
+        __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+static void uring_unmap(uring *r) {
+    if (r->sqes && r->sqes != MAP_FAILED) {
+        munmap(r->sqes, r->sqes_bytes);
+    }
+    if (r->cq_map && r->cq_map != MAP_FAILED && r->cq_map != r->sq_map) {
+        munmap(r->cq_map, r->cq_map_bytes);
+    }
+    if (r->sq_map && r->sq_map != MAP_FAILED) {
+        munmap(r->sq_map, r->sq_map_bytes);
+    }
+    if (r->fd >= 0) {
+        close(r->fd);
+    }
+    r->fd = -1;
+}
+
+static int uring_start(io_engine *io) {
+    uring *r = &io->ring;
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    r->fd = (int)syscall(__NR_io_uring_setup, (unsigned)io->depth, &params);
+    if (r->fd < 0) {
+        return -1;
+    }
+
+    r->sq_map_bytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    r->cq_map_bytes = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    int single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) {
+        r->sq_map_bytes = r->sq_map_bytes > r->cq_map_bytes ? r->sq_map_bytes : r->cq_map_bytes;
+        r->cq_map_bytes = r->sq_map_bytes;
+    }
+    r->sq_map = mmap(NULL, r->sq_map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     r->fd, IORING_OFF_SQ_RING);
+    r->cq_map = single ? r->sq_map
+                       : mmap(NULL, r->cq_map_bytes, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+    r->sqes_bytes = params.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = (struct io_uring_sqe *)mmap(NULL, r->sqes_bytes, PROT_READ | PROT_WRITE,
+                                          MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sq_map == MAP_FAILED || r->cq_map == MAP_FAILED || r->sqes == MAP_FAILED) {
+        int saved = errno;
+        uring_unmap(r);
+        errno = saved;
+        return -1;
+    }
+
+    char *sq = (char *)r->sq_map;
+    char *cq = (char *)r->cq_map;
+    r->sq_head = (unsigned *)(sq + params.sq_off.head);
+    r->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    r->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + params.sq_off.array);
+    r->cq_head = (unsigned *)(cq + params.cq_off.head);
+    r->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    r->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    /* Never more pieces in flight than the ring holds. */
+    io->depth = io->depth < (int)params.sq_entries ? io->depth : (int)params.sq_entries;
+
+    pthread_mutex_init(&r->sq_lock, NULL);
+    if (pthread_create(&r->reaper, NULL, uring_reaper, io) != 0) {
+        pthread_mutex_destroy(&r->sq_lock);
+        uring_unmap(r);
+        errno = EAGAIN;
+        return -1;
+    }
+    return 0;
+}
+
+static void uring_stop(io_engine *io) {
+    uring *r = &io->ring;
+    uring_push(r, -1, NULL);
+    pthread_join(r->reaper, NULL);
+    pthread_mutex_destroy(&r->sq_lock);
+    uring_unmap(r);
+}
+
+#endif
+
+/* ---- Engine ------------------------------------------------------------ */
+
+int io_engine_create(io_engine **out, int kind, int depth, int threads) {
+    *out = NULL;
+    depth = depth > 0 ? depth : IO_DEFAULT_DEPTH;
+    depth = depth < IO_MAX_DEPTH ? depth : IO_MAX_DEPTH;
+    io_engine *io = (io_engine *)calloc(1, sizeof(io_engine));
+    if (!io) {
+        errno = ENOMEM;
+        return -1;
+    }
+    io->depth = depth;
+#ifdef HAVE_IO_URING
+    io->ring.fd = -1;
+#endif
+    pthread_mutex_init(&io->lock, NULL);
+    pthread_cond_init(&io->changed, NULL);
+
+    int started = 0;
+#ifdef HAVE_IO_URING
+    if (kind == IO_AUTO || kind == IO_URING) {
+        started = uring_start(io) == 0;
+        io->kind = IO_URING;
+    }
+#endif
+    if (!started && kind == IO_URING) {
+#ifndef HAVE_IO_URING
+        errno = ENOSYS;
+#endif
+        int saved = errno;
+        pthread_cond_destroy(&io->changed);
+        pthread_mutex_destroy(&io->lock);
+        free(io);
+        errno = saved;
+        return -1;
+    }
+    if (!started) {
+        io->kind = IO_THREADS;
+        if (pool_start(io, threads) != 0) {
+            int saved = errno;
+            pool_stop(io);
+            pthread_cond_destroy(&io->changed);
+            pthread_mutex_destroy(&io->lock);
+            free(io);
+            errno = saved;
+            return -1;
+        }
+    }
+
+    io->pieces = (io_piece *)malloc(sizeof(io_piece) * io->depth);
+    if (!io->pieces) {
+        io_engine_destroy(io);
+        errno = ENOMEM;
+        return -1;
+    }
+    for (int s = 0; s < io->depth; ++s) {
+        io->pieces[s].next_free = s + 1 < io->depth ? s + 1 : -1;
+    }
+    io->free_head = 0;
+    *out = io;
+    return 0;
+}
+
+void io_engine_destroy(io_engine *io) {
+    if (!io) {
+        return;
+    }
+#ifdef HAVE_IO_URING
+    if (io->kind == IO_URING) {
+        uring_stop(io);
+    }
+#endif
+    if (io->kind == IO_THREADS) {
+        pool_stop(io);
+    }
+    pthread_cond_destroy(&io->changed);
+    pthread_mutex_destroy(&io->lock);
+    free(io->pieces);
+    free(io);
+}
+
+int io_engine_kind(const io_engine *io) {
+    return io->kind;
+}
+
+const char *io_engine_name(int kind) {
+    switch (kind) {
+    case IO_URING:
+        return "io_uring";
+    case IO_THREADS:
+        return "threads";
+    default:
+        return "auto";
+    }
+}
+
+int io_engine_register(io_engine *io, void *const *bufs, const size_t *lens, int count) {
+#ifdef HAVE_IO_URING
+    if (io->kind != IO_URING || count <= 0) {
+        return 0;
+    }
+    io_engine_unregister(io);
+    struct iovec *iov = (struct iovec *)malloc(sizeof(struct iovec) * count);
+    if (!iov) {
+        return 0;
+    }
+    for (int i = 0; i < count; ++i) {
+        iov[i].iov_base = bufs[i];
+        iov[i].iov_len = lens[i];
+    }
+    io->ring.registered = syscall(__NR_io_uring_register, io->ring.fd, IORING_REGISTER_BUFFERS,
+                                  iov, (unsigned)count) == 0;
+    free(iov);
+    return io->ring.registered ? count : 0;
+#else
+    (void)io;
+    (void)bufs;
+    (void)lens;
+    (void)count;
+    return 0;
+#endif
+}
+
+void io_engine_unregister(io_engine *io) {
+#ifdef HAVE_IO_URING
+    if (io->kind == IO_URING && io->ring.registered) {
+        syscall(__NR_io_uring_register, io->ring.fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+        io->ring.registered = 0;
+    }
+#else
+    (void)io;
+#endif
+}
+
+static int acquire_slot(io_engine *io) {
+    pthread_mutex_lock(&io->lock);
+    while (io->free_head < 0) {
+        pthread_cond_wait(&io->changed, &io->lock);
+    }
+    int slot = io->free_head;
+    io->free_head = io->pieces[slot].next_free;
+    pthread_mutex_unlock(&io->lock);
+    return slot;
+}
+
+static int submit(io_engine *io, io_request *req, int fd, char *buf, size_t len, off_t off,
+                  int buf_index, int write) {
+    size_t pieces = len == 0 ? 0 : (len + IO_PIECE_BYTES - 1) / IO_PIECE_BYTES;
+    pthread_mutex_lock(&io->lock);
+    req->pending = (int)pieces;
+    req->error = 0;
+    req->bytes = 0;
+    req->submitted = sort_wall_time();
+    req->completed = req->submitted;
+    pthread_mutex_unlock(&io->lock);
+
+    for (size_t i = 0; i < pieces; ++i) {
+        int slot = acquire_slot(io);
+        io_piece *p = &io->pieces[slot];
+        size_t start = i * IO_PIECE_BYTES;
+        p->req = req;
+        p->fd = fd;
+        p->buf = buf + start;
+        p->len = len - start < (size_t)IO_PIECE_BYTES ? len - start : (size_t)IO_PIECE_BYTES;
+        p->off = off + (off_t)start;
+        p->write = write;
+        p->buf_index = buf_index;
+#ifdef HAVE_IO_URING
+        if (io->kind == IO_URING) {
+            if (uring_push(&io->ring, slot, p) != 0) {
+                piece_done(io, slot, -(long)errno);
+            }
+            continue;
+        }
+#endif
+        pool_submit(io, slot);
+    }
+    return 0;
+}
+
+int io_read(io_engine *io, io_request *req, int fd, void *buf, size_t len, off_t off, int buf_index) {
+    return submit(io, req, fd, (char *)buf, len, off, buf_index, 0);
+}
+
+int io_write(io_engine *io, io_request *req, int fd, const void *buf, size_t len, off_t off,
+             int buf_index) {
+    return submit(io, req, fd, (char *)buf, len, off, buf_index, 1);
+}
+
+int io_wait(io_engine *io, io_request *req) {
+    pthread_mutex_lock(&io->lock);
+    while (req->pending > 0) {
+        pthread_cond_wait(&io->changed, &io->lock);
+    }
+    int err = req->error;
+    pthread_mutex_unlock(&io->lock);
+    if (err != 0) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+int io_open(const char *path, int flags, int mode, int direct, int *is_direct) {
+    *is_direct = 0;
+#ifdef O_DIRECT
+    if (direct) {
+        int fd = open(path, flags | O_DIRECT, mode);
+        if (fd >= 0) {
+            *is_direct = 1;
+            return fd;
+        }
+        if (errno != EINVAL) {
+            return -1;
+        }
+    }
+#else
+    (void)direct;
+#endif
+    return open(path, flags, mode);
+}
+
+void *io_alloc(size_t bytes) {
+    void *p = NULL;
+    if (posix_memalign(&p, IO_ALIGN, bytes ? bytes : IO_ALIGN) != 0) {
+        return NULL;
+    }
+    return p;
+}
+
+void io_free(void *p) {
+    free(p);
+}
+
+#else
+
+int io_engine_create(io_engine **out, int kind, int depth, int threads) {
+    (void)kind;
+    (void)depth;
+    (void)threads;
+    *out = NULL;
+    errno = ENOSYS;
+    return -1;
+}
+
+void io_engine_destroy(io_engine *io) {
+    (void)io;
+}
+
+int io_engine_kind(const io_engine *io) {
+    (void)io;
+    return IO_THREADS;
+}
+
+const char *io_engine_name(int kind) {
+    return kind == IO_URING ? "io_uring" : kind == IO_THREADS ? "threads" : "auto";
+}
+
+int io_engine_register(io_engine *io, void *const *bufs, const size_t *lens, int count) {
+    (void)io;
+    (void)bufs;
+    (void)lens;
+    (void)count;
+    return 0;
+}
+
+void io_engine_unregister(io_engine *io) {
+    (void)io;
+}
+
+int io_read(io_engine *io, io_request *req, int fd, void *buf, size_t len, off_t off, int buf_index) {
+    (void)io;
+    (void)req;
+    (void)fd;
+    (void)buf;
+    (void)len;
+    (void)off;
+    (void)buf_index;
+    errno = ENOSYS;
+    return -1;
+}
+
+int io_write(io_engine *io, io_request *req, int fd, const void *buf, size_t len, off_t off,
+             int buf_index) {
+    (void)io;
+    (void)req;
+    (void)fd;
+    (void)buf;
+    (void)len;
+    (void)off;
+    (void)buf_index;
+    errno = ENOSYS;
+    return -1;
+}
+
+int io_wait(io_engine *io, io_request *req) {
+    (void)io;
+    (void)req;
+    errno = ENOSYS;
+    return -1;
+}
+
+int io_open(const char *path, int flags, int mode, int direct, int *is_direct) {
+    (void)path;
+    (void)flags;
+    (void)mode;
+    (void)direct;
+    *is_direct = 0;
+    errno = ENOSYS;
+    return -1;
+}
+
+void *io_alloc(size_t bytes) {
+    return malloc(bytes);
+}
+
+void io_free(void *p) {
+    free(p);
+}
+
+#endif
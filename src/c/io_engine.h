@@ -0,0 +1,66 @@
+#ifndef IO_ENGINE_H
+#define IO_ENGINE_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/* Asynchronous file I/O for the external sort.
+
+   Every request is cut into pieces of at most IO_PIECE_BYTES, and at most
+   `depth` pieces are in flight across all callers. The preferred backend is
+   an io_uring, driven through the raw system calls, with buffers registered
+   for fixed-buffer reads and writes. A completion thread reaps it. When the
+   kernel or a seccomp filter refuses io_uring, a pool of threads runs the
+   pieces with pread/pwrite instead. Submitting never waits for the disk,
+   only for a free queue slot. io_wait blocks until every piece of one
+   request has completed. Functions return 0 on success and -1 with errno
+   set. */
+
+#define IO_PIECE_BYTES (1L << 20)
+/* Buffer, offset and length alignment for O_DIRECT. */
+#define IO_ALIGN 4096
+#define IO_DEFAULT_DEPTH 64
+
+enum { IO_AUTO, IO_URING, IO_THREADS };
+
+typedef struct io_engine io_engine;
+
+/* Owned by the caller and must stay put until io_wait returns. A read that
+   reaches end of file completes early; `bytes` says how much was moved. */
+typedef struct {
+    int pending;             /* pieces still in flight */
+    int error;               /* first errno of any piece */
+    size_t bytes;
+    double submitted;        /* wall time of submission and completion */
+    double completed;
+} io_request;
+
+/* kind is IO_AUTO (io_uring, else threads), IO_URING (fail without it) or
+   IO_THREADS. `threads` sizes the fallback pool (0: a default). */
+int io_engine_create(io_engine **out, int kind, int depth, int threads);
+void io_engine_destroy(io_engine *io);
+/* The backend actually in use: IO_URING or IO_THREADS. */
+int io_engine_kind(const io_engine *io);
+const char *io_engine_name(int kind);
+
+/* Registers buffers with the ring so submissions naming their index skip
+   the per-I/O page pinning. Returns how many were registered: 0 for the
+   thread pool, or when the memlock limit refuses them, in which case the
+   indices are ignored. Only one set can be registered at a time. */
+int io_engine_register(io_engine *io, void *const *bufs, const size_t *lens, int count);
+void io_engine_unregister(io_engine *io);
+
+/* buf_index names a registered buffer containing buf, or is -1. */
+int io_read(io_engine *io, io_request *req, int fd, void *buf, size_t len, off_t off, int buf_index);
+int io_write(io_engine *io, io_request *req, int fd, const void *buf, size_t len, off_t off,
+             int buf_index);
+int io_wait(io_engine *io, io_request *req);
+
+/* open(2) that adds O_DIRECT when `direct` is set, falling back to buffered
+   I/O on file systems that reject it; *is_direct says which one it got. */
+int io_open(const char *path, int flags, int mode, int direct, int *is_direct);
+/* IO_ALIGN-aligned allocation, as O_DIRECT buffers need. */
+void *io_alloc(size_t bytes);
+void io_free(void *p);
+
+#endif
@@ -0,0 +1,158 @@
+#include "key_codec.h"
+
+#include <string.h>
+
+#include "sort_util.h"
+
+/* Packed bytes are little-endian so files read the same on any host. */
+static uint64_t load64(const char *p) {
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    return w;
+}
+
+static void store64(char *p, uint64_t w) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    memcpy(p, &w, sizeof(w));
+}
+
+long key_codec_blocks(long n) {
+    return (n + KEY_BLOCK_KEYS - 1) / KEY_BLOCK_KEYS;
+}
+
+size_t key_block_bytes(const key_block *block) {
+    return ((size_t)(block->keys - 1) * block->width + 7) / 8;
+}
+
+/* Writes exactly the packed bytes, never past them: when encoding in place
+   the bytes after them are still unread keys of the next block. */
+static size_t pack_bits(const uint64_t *v, long m, int w, char *out) {
+    uint64_t acc = 0;
+    int used = 0;
+    size_t o = 0;
+    for (long i = 0; i < m; ++i) {
+        uint64_t x = v[i];
+        acc |= x << used;
+        if (used + w >= 64) {
+            store64(out + o, acc);
+            o += 8;
+            int spill = used + w - 64;
+            acc = spill ? x >> (w - spill) : 0;
+            used = spill;
+        } else {
+            used += w;
+        }
+    }
+    char tail[8];
+    store64(tail, acc);
+    memcpy(out + o, tail, (size_t)(used + 7) / 8);
+    return o + (size_t)(used + 7) / 8;
+}
+
+size_t key_codec_encode(void *keys, long n, int key_bits, key_block *index) {
+    char *buf = (char *)keys;
+    int kb = key_bits / 8;
+    uint64_t block[KEY_BLOCK_KEYS];
+    size_t out = 0;
+    for (long b = 0; b * KEY_BLOCK_KEYS < n; ++b) {
+        long start = b * KEY_BLOCK_KEYS;
+        long m = n - start < KEY_BLOCK_KEYS ? n - start : KEY_BLOCK_KEYS;
+        const char *raw = buf + (size_t)start * kb;
+        if (kb == 8) {
+            memcpy(block, raw, (size_t)m * sizeof(uint64_t));
+        } else {
+            for (long i = 0; i < m; ++i) {
+                uint32_t k;
+                memcpy(&k, raw + (size_t)i * 4, sizeof(k));
+                block[i] = k;
+            }
+        }
+        /* block[i] becomes the gap before key i + 1. */
+        uint64_t lo = UINT64_MAX;
+        uint64_t hi = 0;
+        for (long i = 0; i + 1 < m; ++i) {
+            uint64_t gap = block[i + 1] - block[i];
+            block[i] = gap;
+            lo = gap < lo ? gap : lo;
+            hi = gap > hi ? gap : hi;
+        }
+        key_block *blk = &index[b];
+        if (kb == 8) {
+            memcpy(&blk->first, raw, sizeof(uint64_t));
+        } else {
+            uint32_t k;
+            memcpy(&k, raw, sizeof(k));
+            blk->first = k;
+        }
+        blk->base = m > 1 ? lo : 0;
+        blk->offset = out;
+        blk->keys = (uint32_t)m;
+        blk->width = (uint32_t)sort_bit_width(hi - blk->base);
+        if (m > 1 && blk->width > 0) {
+            for (long i = 0; i + 1 < m; ++i) {
+                block[i] -= blk->base;
+            }
+            out += pack_bits(block, m - 1, (int)blk->width, buf + out);
+        }
+    }
+    return out;
+}
+
+/* Gap i starts at bit i * w; a gap wider than 56 bits may straddle the
+   64-bit word loaded at its first byte, and then takes one more byte. */
+void key_block_decode(const char *packed, const key_block *block, int key_bits, void *keys) {
+    long m = block->keys;
+    int w = (int)block->width;
+    uint64_t mask = w == 64 ? ~0ull : (1ull << w) - 1;
+    uint64_t k = block->first;
+    if (key_bits == 64) {
+        uint64_t *out = (uint64_t *)keys;
+        out[0] = k;
+        if (w == 0) {
+            for (long i = 1; i < m; ++i) {
+                k += block->base;
+                out[i] = k;
+            }
+            return;
+        }
+        for (long i = 1; i < m; ++i) {
+            uint64_t bit = (uint64_t)(i - 1) * w;
+            int s = (int)(bit & 7);
+            uint64_t v = load64(packed + (bit >> 3)) >> s;
+            if (s + w > 64) {
+                v |= (uint64_t)(unsigned char)packed[(bit >> 3) + 8] << (64 - s);
+            }
+            k += block->base + (v & mask);
+            out[i] = k;
+        }
+        return;
+    }
+    /* 32-bit gaps never straddle: s + w <= 7 + 32. */
+    uint32_t *out = (uint32_t *)keys;
+    out[0] = (uint32_t)k;
+    for (long i = 1; i < m; ++i) {
+        uint64_t bit = (uint64_t)(i - 1) * w;
+        uint64_t v = w ? (load64(packed + (bit >> 3)) >> (bit & 7)) & mask : 0;
+        k += block->base + v;
+        out[i] = (uint32_t)k;
+    }
+}
+
+long key_codec_find_block(const key_block *index, long blocks, uint64_t key) {
+    long lo = 0;
+    long hi = blocks;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (index[mid].first < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo > 0 ? lo - 1 : 0;
+}
@@ -0,0 +1,49 @@
+#ifndef KEY_CODEC_H
+#define KEY_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Block compression of sorted 32- or 64-bit keys.
+
+   Keys are cut into blocks of KEY_BLOCK_KEYS. Within a block the gaps
+   between neighbouring keys are taken (delta coding), the smallest gap is
+   subtracted from all of them (frame of reference), and what is left is
+   bit-packed at the width of the largest. Dense sorted key spaces need a
+   few bits per key instead of 32 or 64. The per-block header lives in a
+   key_block index entry rather than in the packed bytes, so the packed form
+   of a block is never larger than the raw keys and a buffer can be encoded
+   in place. The decoder unpacks with unaligned 64-bit word loads, one
+   shift and mask per key, and needs KEY_CODEC_PAD readable bytes past a
+   block's end. Packed bytes are little-endian on every host. */
+
+#define KEY_BLOCK_KEYS 1024
+#define KEY_CODEC_PAD 16
+
+typedef struct {
+    uint64_t first;          /* the block's first key */
+    uint64_t base;           /* smallest gap, subtracted before packing */
+    uint64_t offset;         /* byte offset of the packed gaps */
+    uint32_t keys;           /* KEY_BLOCK_KEYS except in the last block */
+    uint32_t width;          /* bits per packed gap, 0 to key_bits */
+} key_block;
+
+/* Number of blocks for n keys. */
+long key_codec_blocks(long n);
+
+/* Packed bytes of one block. */
+size_t key_block_bytes(const key_block *block);
+
+/* Encodes sorted keys[0, n) in place: the buffer then holds the packed
+   blocks back to back, described by index[0, key_codec_blocks(n)]. Returns
+   the packed size in bytes. */
+size_t key_codec_encode(void *keys, long n, int key_bits, key_block *index);
+
+/* Decodes the block whose packed bytes start at packed into keys[0, block->keys). */
+void key_block_decode(const char *packed, const key_block *block, int key_bits, void *keys);
+
+/* Block holding the first key >= key, unless that key starts the next
+   block: the block before the first one starting at or above key, or 0. */
+long key_codec_find_block(const key_block *index, long blocks, uint64_t key);
+
+#endif
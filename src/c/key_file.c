@@ -0,0 +1,243 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#elif !defined(_WIN32)
+#define _XOPEN_SOURCE 700
+#endif
+
+#include "key_file.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define PAGE_BYTES 4096
+
+typedef struct {
+    char *dst;
+    const char *src;   /* NULL: touch dst instead of copying */
+    size_t bytes;
+    int write;
+} slice_job;
+
+static void run_slice(slice_job *job) {
+    if (job->src) {
+        memcpy(job->dst, job->src, job->bytes);
+        return;
+    }
+    volatile char *p = job->dst;
+    char sink = 0;
+    for (size_t off = 0; off < job->bytes; off += PAGE_BYTES) {
+        if (job->write) {
+            p[off] = 0;
+        } else {
+            sink ^= p[off];
+        }
+    }
+    (void)sink;
+}
+
+static void *slice_worker(void *arg) {
+    run_slice((slice_job *)arg);
+    return NULL;
+}
+
+/* Splits [0, bytes) into page-aligned slices, one per thread; the caller
+   runs the first slice and any slice whose thread failed to start. */
+static void run_sliced(char *dst, const char *src, size_t bytes, int threads, int write) {
+    if (bytes == 0) {
+        return;
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+    size_t pages = (bytes + PAGE_BYTES - 1) / PAGE_BYTES;
+    if ((size_t)threads > pages) {
+        threads = (int)pages;
+    }
+    pthread_t *tids = (pthread_t *)malloc(sizeof(pthread_t) * threads);
+    slice_job *jobs = (slice_job *)malloc(sizeof(slice_job) * threads);
+    int *started = (int *)calloc((size_t)threads, sizeof(int));
+    if (!tids || !jobs || !started) {
+        free(tids);
+        free(jobs);
+        free(started);
+        slice_job whole = {dst, src, bytes, write};
+        run_slice(&whole);
+        return;
+    }
+
+    size_t slice = (pages + threads - 1) / threads * PAGE_BYTES;
+    for (int t = 0; t < threads; ++t) {
+        size_t start = (size_t)t * slice < bytes ? (size_t)t * slice : bytes;
+        size_t end = start + slice < bytes ? start + slice : bytes;
+        jobs[t].dst = dst + start;
+        jobs[t].src = src ? src + start : NULL;
+        jobs[t].bytes = end - start;
+        jobs[t].write = write;
+        if (t > 0) {
+            started[t] = pthread_create(&tids[t], NULL, slice_worker, &jobs[t]) == 0;
+        }
+    }
+    run_slice(&jobs[0]);
+    for (int t = 1; t < threads; ++t) {
+        if (started[t]) {
+            pthread_join(tids[t], NULL);
+        } else {
+            run_slice(&jobs[t]);
+        }
+    }
+    free(tids);
+    free(jobs);
+    free(started);
+}
+
+void key_map_touch(void *buf, size_t bytes, int threads, int write) {
+    run_sliced((char *)buf, NULL, bytes, threads, write);
+}
+
+void key_map_copy(void *dst, const void *src, size_t bytes, int threads) {
+    run_sliced((char *)dst, (const char *)src, bytes, threads, 1);
+}
+
+#ifndef _WIN32
+/* A fresh output file is left unpopulated so that the threads copying into
+   it take the faults in parallel. */
+static int map_fd(key_map *map, int fd, size_t bytes, int writable, int populate) {
+    map->fd = fd;
+    map->bytes = bytes;
+    map->writable = writable;
+    map->data = NULL;
+    if (bytes == 0) {
+        return 0;
+    }
+    int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+    if (populate) {
+        flags |= MAP_POPULATE;
+    }
+#else
+    (void)populate;
+#endif
+    void *p = mmap(NULL, bytes, writable ? PROT_READ | PROT_WRITE : PROT_READ, flags, fd, 0);
+    if (p == MAP_FAILED) {
+        int saved = errno;
+        close(fd);
+        map->fd = -1;
+        errno = saved;
+        return -1;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(p, bytes, MADV_SEQUENTIAL);
+#endif
+#ifdef MADV_WILLNEED
+    madvise(p, bytes, MADV_WILLNEED);
+#endif
+    map->data = p;
+    return 0;
+}
+#endif
+
+/* Key files are little-endian on disk and are sorted without conversion. */
+static int host_is_little_endian(void) {
+    unsigned int probe = 1;
+    return *(unsigned char *)&probe == 1;
+}
+
+int key_map_open(key_map *map, const char *path, int writable, int threads) {
+    memset(map, 0, sizeof(*map));
+    map->fd = -1;
+    if (!host_is_little_endian()) {
+        errno = ENOTSUP;
+        return -1;
+    }
+#ifndef _WIN32
+    int fd = open(path, writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    if (map_fd(map, fd, (size_t)st.st_size, writable, 1) != 0) {
+        return -1;
+    }
+#ifndef MAP_POPULATE
+    key_map_touch(map->data, map->bytes, threads, 0);
+#else
+    (void)threads;
+#endif
+    return 0;
+#else
+    (void)path;
+    (void)writable;
+    (void)threads;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+int key_map_create(key_map *map, const char *path, size_t bytes) {
+    memset(map, 0, sizeof(*map));
+    map->fd = -1;
+    if (!host_is_little_endian()) {
+        errno = ENOTSUP;
+        return -1;
+    }
+#ifndef _WIN32
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    if (ftruncate(fd, (off_t)bytes) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return map_fd(map, fd, bytes, 1, 0);
+#else
+    (void)path;
+    (void)bytes;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+int key_file_same(const char *a, const char *b) {
+#ifndef _WIN32
+    struct stat sa;
+    struct stat sb;
+    if (stat(a, &sa) != 0 || stat(b, &sb) != 0) {
+        return 0;
+    }
+    return sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+#else
+    return strcmp(a, b) == 0;
+#endif
+}
+
+void key_map_close(key_map *map) {
+#ifndef _WIN32
+    if (map->data) {
+        munmap(map->data, map->bytes);
+    }
+    if (map->fd >= 0) {
+        close(map->fd);
+    }
+#endif
+    map->data = NULL;
+    map->bytes = 0;
+    map->fd = -1;
+}
@@ -0,0 +1,42 @@
+#ifndef KEY_FILE_H
+#define KEY_FILE_H
+
+#include <stddef.h>
+
+/* Memory-mapped raw key files for --input / --output.
+
+   A key file is a headerless array of little-endian unsigned 32- or 64-bit
+   keys. Mappings are populated up front (MAP_POPULATE where available) and
+   advised for sequential access; the copy and touch helpers split their
+   work over threads so page faults are taken in parallel and, for a fresh
+   output mapping, land on the node of the thread that will sort the chunk.
+   Functions return 0 on success and -1 with errno set on failure. */
+
+typedef struct {
+    int fd;
+    void *data;      /* NULL for an empty file */
+    size_t bytes;
+    int writable;
+} key_map;
+
+/* Maps an existing file. With `writable` the mapping is shared, so sorting
+   it rewrites the file in place; otherwise it is read-only. Without
+   MAP_POPULATE the pages are read in by `threads` threads instead. */
+int key_map_open(key_map *map, const char *path, int writable, int threads);
+
+/* Creates or truncates path to `bytes` bytes and maps it shared and writable. */
+int key_map_create(key_map *map, const char *path, size_t bytes);
+
+/* 1 if both paths exist and name the same file, so --output would clobber --input. */
+int key_file_same(const char *a, const char *b);
+
+/* Unmaps and closes; calling it again on the same map is harmless. */
+void key_map_close(key_map *map);
+
+/* Faults in every page of buf with `threads` threads, writing if `write`. */
+void key_map_touch(void *buf, size_t bytes, int threads, int write);
+
+/* memcpy split over `threads` threads, each copying one contiguous slice. */
+void key_map_copy(void *dst, const void *src, size_t bytes, int threads);
+
+#endif
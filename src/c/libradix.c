@@ -0,0 +1,742 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#elif !defined(_WIN32)
+#define _XOPEN_SOURCE 700
+#endif
+
+#include "libradix.h"
+#include "radix_kernel.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define RADIX_BITS 8
+#define RADIX (1 << RADIX_BITS)
+
+/* Each thread gets at least this many keys; below that the per-thread
+   histograms and barrier waits cost more than the keys it would sort. */
+#define MIN_KEYS_PER_THREAD 65536
+
+/* ---- LSD kernel -------------------------------------------------------- */
+
+/* first_touch writes one byte this far apart, the smallest page size. */
+#define TOUCH_STRIDE 4096
+
+static void histogram(const char *keys, int key_bytes, size_t start, size_t end, int shift,
+                      size_t *counts) {
+    memset(counts, 0, sizeof(size_t) * RADIX);
+    if (key_bytes == 4) {
+        const uint32_t *k = (const uint32_t *)keys;
+        for (size_t i = start; i < end; ++i) {
+            counts[(k[i] >> shift) & (RADIX - 1)]++;
+        }
+    } else {
+        const uint64_t *k = (const uint64_t *)keys;
+        for (size_t i = start; i < end; ++i) {
+            counts[(k[i] >> shift) & (RADIX - 1)]++;
+        }
+    }
+}
+
+/* One scatter loop per key and value width, so the loops carry no width
+   test of their own. */
+#define DEFINE_SCATTER_KEYS(name, KT)                                                   \
+    static void name(const char *sk, char *dk, size_t start, size_t end, int shift,     \
+                     size_t *offsets) {                                                 \
+        const KT *s = (const KT *)sk;                                                   \
+        KT *d = (KT *)dk;                                                               \
+        for (size_t i = start; i < end; ++i) {                                          \
+            d[offsets[(s[i] >> shift) & (RADIX - 1)]++] = s[i];                         \
+        }                                                                               \
+    }
+
+#define DEFINE_SCATTER_PAIRS(name, KT, VT)                                              \
+    static void name(const char *sk, char *dk, const char *sv, char *dv, size_t start,  \
+                     size_t end, int shift, size_t *offsets) {                          \
+        const KT *s = (const KT *)sk;                                                   \
+        KT *d = (KT *)dk;                                                               \
+        const VT *v = (const VT *)sv;                                                   \
+        VT *w = (VT *)dv;                                                               \
+        for (size_t i = start; i < end; ++i) {                                          \
+            size_t at = offsets[(s[i] >> shift) & (RADIX - 1)]++;                       \
+            d[at] = s[i];                                                               \
+            w[at] = v[i];                                                               \
+        }                                                                               \
+    }
+
+DEFINE_SCATTER_KEYS(scatter_k32, uint32_t)
+DEFINE_SCATTER_KEYS(scatter_k64, uint64_t)
+DEFINE_SCATTER_PAIRS(scatter_k32_v32, uint32_t, uint32_t)
+DEFINE_SCATTER_PAIRS(scatter_k32_v64, uint32_t, uint64_t)
+DEFINE_SCATTER_PAIRS(scatter_k64_v32, uint64_t, uint32_t)
+DEFINE_SCATTER_PAIRS(scatter_k64_v64, uint64_t, uint64_t)
+
+static void scatter(const radix_lsd_job *j, const char *sk, char *dk, const char *sv, char *dv,
+                    size_t start, size_t end, int shift, size_t *offsets) {
+    if (j->val_bytes == 0) {
+        if (j->key_bytes == 4) {
+            scatter_k32(sk, dk, start, end, shift, offsets);
+        } else {
+            scatter_k64(sk, dk, start, end, shift, offsets);
+        }
+    } else if (j->key_bytes == 4) {
+        if (j->val_bytes == 4) {
+            scatter_k32_v32(sk, dk, sv, dv, start, end, shift, offsets);
+        } else {
+            scatter_k32_v64(sk, dk, sv, dv, start, end, shift, offsets);
+        }
+    } else if (j->val_bytes == 4) {
+        scatter_k64_v32(sk, dk, sv, dv, start, end, shift, offsets);
+    } else {
+        scatter_k64_v64(sk, dk, sv, dv, start, end, shift, offsets);
+    }
+}
+
+static void touch_slice(char *p, size_t bytes) {
+    for (size_t off = 0; off < bytes; off += TOUCH_STRIDE) {
+        ((volatile char *)p)[off] = 0;
+    }
+}
+
+void radix_worker_slice(long n, int workers, int t, long *start, long *end) {
+    long chunk = (n + workers - 1) / workers;
+    *start = t * chunk < n ? t * chunk : n;
+    *end = *start + chunk < n ? *start + chunk : n;
+}
+
+/* Thread tid's share of the sort: a histogram of its slice, a prefix over
+   all slices by thread 0 (digit-major, so equal digits stay in slice order
+   and the sort is stable), then the scatter. After an odd number of
+   scatters the data is in tmp, and each thread copies its slice back. */
+void radix_lsd_run(radix_lsd_job *j, int tid) {
+    if (j->worker_begin) {
+        j->worker_begin(j->worker_arg, tid);
+    }
+    long first, last;
+    radix_worker_slice((long)j->n, j->threads, tid, &first, &last);
+    size_t start = (size_t)first;
+    size_t end = (size_t)last;
+    size_t *local = j->counts + (size_t)tid * RADIX;
+    size_t kb = (size_t)j->key_bytes;
+    size_t vb = (size_t)j->val_bytes;
+    char *sk = j->keys;
+    char *dk = j->tmp_keys;
+    char *sv = j->vals;
+    char *dv = j->tmp_vals;
+    double bytes = 0.0;
+
+    /* This thread reads tmp[start, end) after every odd scatter; fault it
+       in here so the pages live on its node. */
+    if (j->first_touch) {
+        touch_slice(dk + start * kb, (end - start) * kb);
+        if (vb) {
+            touch_slice(dv + start * vb, (end - start) * vb);
+        }
+    }
+
+    for (int shift = 0; shift < j->key_bytes * 8; shift += RADIX_BITS) {
+        if (j->digits && !((j->digits >> (shift / RADIX_BITS)) & 1u)) {
+            continue;
+        }
+        histogram(sk, j->key_bytes, start, end, shift, local);
+        j->sync(j);
+        if (tid == 0) {
+            size_t total = 0;
+            j->skip = 0;
+            for (int d = 0; d < RADIX; ++d) {
+                size_t first = total;
+                for (int t = 0; t < j->threads; ++t) {
+                    size_t c = j->counts[(size_t)t * RADIX + (size_t)d];
+                    j->counts[(size_t)t * RADIX + (size_t)d] = total;
+                    total += c;
+                }
+                j->skip |= total - first == j->n;
+            }
+        }
+        j->sync(j);
+        int skip = j->skip;
+        if (!skip) {
+            scatter(j, sk, dk, sv, dv, start, end, shift, local);
+        }
+        j->sync(j);
+        /* The histogram's read, then the scatter's read and write. */
+        bytes += (double)((end - start) * kb);
+        if (!skip) {
+            bytes += 2.0 * (double)((end - start) * (kb + vb));
+            char *swap = sk;
+            sk = dk;
+            dk = swap;
+            swap = sv;
+            sv = dv;
+            dv = swap;
+        }
+    }
+    if (sk != j->keys) {
+        memcpy(j->keys + start * kb, sk + start * kb, (end - start) * kb);
+        if (vb) {
+            memcpy(j->vals + start * vb, sv + start * vb, (end - start) * vb);
+        }
+        bytes += 2.0 * (double)((end - start) * (kb + vb));
+    }
+    if (j->worker_end) {
+        j->worker_end(j->worker_arg, tid, bytes);
+    }
+}
+
+void radix_lsd_sync_none(radix_lsd_job *j) {
+    (void)j;
+}
+
+void radix_lsd_sync_barrier(radix_lsd_job *j) {
+    pthread_barrier_wait(j->barrier);
+}
+
+typedef struct {
+    radix_lsd_job *job;
+    int tid;
+    pthread_mutex_t *lock;
+    pthread_cond_t *wake;
+    int *gate;               /* 0: wait, 1: run, -1: give up */
+} lsd_thread_arg;
+
+/* Workers wait at a gate until every one of them exists, because the
+   barrier counts the whole team; if one cannot be started the rest leave
+   and the caller sorts alone. */
+static void *lsd_thread(void *arg) {
+    lsd_thread_arg *a = (lsd_thread_arg *)arg;
+    pthread_mutex_lock(a->lock);
+    while (*a->gate == 0) {
+        pthread_cond_wait(a->wake, a->lock);
+    }
+    int go = *a->gate > 0;
+    pthread_mutex_unlock(a->lock);
+    if (go) {
+        radix_lsd_run(a->job, a->tid);
+    }
+    return NULL;
+}
+
+static void run_pthreads(radix_lsd_job *j) {
+    int threads = j->threads;
+    size_t tids_bytes = sizeof(pthread_t) * (size_t)threads;
+    size_t args_bytes = sizeof(lsd_thread_arg) * (size_t)threads;
+    pthread_t *tids = (pthread_t *)radix_scratch_alloc(j->alloc, tids_bytes);
+    lsd_thread_arg *args = (lsd_thread_arg *)radix_scratch_alloc(j->alloc, args_bytes);
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+    pthread_barrier_t barrier;
+    int gate = 0;
+    int started = 0;
+    if (tids && args) {
+        for (int t = 1; t < threads; ++t) {
+            args[t] = (lsd_thread_arg){j, t, &lock, &wake, &gate};
+            if (pthread_create(&tids[t], NULL, lsd_thread, &args[t]) != 0) {
+                break;
+            }
+            started = t;
+        }
+    }
+    int team = started == threads - 1 && pthread_barrier_init(&barrier, NULL,
+                                                              (unsigned)threads) == 0;
+    j->barrier = &barrier;
+    j->sync = radix_lsd_sync_barrier;
+    pthread_mutex_lock(&lock);
+    gate = team ? 1 : -1;
+    pthread_cond_broadcast(&wake);
+    pthread_mutex_unlock(&lock);
+    if (team) {
+        radix_lsd_run(j, 0);
+    }
+    for (int t = 1; t <= started; ++t) {
+        pthread_join(tids[t], NULL);
+    }
+    if (team) {
+        pthread_barrier_destroy(&barrier);
+    } else {
+        j->threads = 1;
+        j->sync = radix_lsd_sync_none;
+        radix_lsd_run(j, 0);
+    }
+    radix_scratch_free(j->alloc, args, args_bytes);
+    radix_scratch_free(j->alloc, tids, tids_bytes);
+}
+
+#ifdef _OPENMP
+static void sync_omp(radix_lsd_job *j) {
+    (void)j;
+#pragma omp barrier
+}
+
+static void run_openmp(radix_lsd_job *j) {
+    j->sync = sync_omp;
+#pragma omp parallel num_threads(j->threads)
+    {
+        /* The runtime may hand out a smaller team than asked for. */
+#pragma omp single
+        j->threads = omp_get_num_threads();
+        radix_lsd_run(j, omp_get_thread_num());
+    }
+}
+#endif
+
+/* ---- CPUs -------------------------------------------------------------- */
+
+#ifdef __linux__
+static long read_long_file(const char *path, long fallback) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return fallback;
+    }
+    long value = fallback;
+    if (fscanf(f, "%ld", &value) != 1) {
+        value = fallback;
+    }
+    fclose(f);
+    return value;
+}
+
+/* Quota in CPUs from a cgroup v2 `cpu.max` ("max 100000" or "<quota> <period>"). */
+static double read_cpu_max(const char *dir) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/cpu.max", dir);
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return 0.0;
+    }
+    char quota[32];
+    long period = 0;
+    double cpus = 0.0;
+    if (fscanf(f, "%31s %ld", quota, &period) == 2 && strcmp(quota, "max") != 0 && period > 0) {
+        cpus = strtod(quota, NULL) / (double)period;
+    }
+    fclose(f);
+    return cpus;
+}
+
+/* Quota in CPUs from cgroup v1 `cpu.cfs_quota_us` / `cpu.cfs_period_us`. */
+static double read_cfs_quota(const char *dir) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/cpu.cfs_quota_us", dir);
+    long quota = read_long_file(path, -1);
+    snprintf(path, sizeof(path), "%s/cpu.cfs_period_us", dir);
+    long period = read_long_file(path, 0);
+    if (quota <= 0 || period <= 0) {
+        return 0.0;
+    }
+    return (double)quota / (double)period;
+}
+
+/* Tightest quota from `leaf` up to and including `root`; 0 if none. */
+static double tightest_quota(const char *root, const char *rel, double (*reader)(const char *)) {
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s%s", root, rel);
+    if (access(dir, F_OK) != 0) {
+        /* Inside a cgroup namespace the path may not exist under our mount. */
+        snprintf(dir, sizeof(dir), "%s", root);
+    }
+    size_t root_len = strlen(root);
+    double best = 0.0;
+    for (;;) {
+        double q = reader(dir);
+        if (q > 0.0 && (best == 0.0 || q < best)) {
+            best = q;
+        }
+        char *slash = strrchr(dir, '/');
+        if (strlen(dir) <= root_len || !slash || (size_t)(slash - dir) < root_len) {
+            break;
+        }
+        *slash = '\0';
+    }
+    return best;
+}
+
+static int has_controller(const char *list, const char *name) {
+    size_t len = strlen(name);
+    const char *p = list;
+    while (*p) {
+        const char *comma = strchr(p, ',');
+        size_t tok = comma ? (size_t)(comma - p) : strlen(p);
+        if (tok == len && strncmp(p, name, len) == 0) {
+            return 1;
+        }
+        if (!comma) {
+            break;
+        }
+        p = comma + 1;
+    }
+    return 0;
+}
+#endif
+
+int radix_cgroup_cpu_quota(void) {
+#ifdef __linux__
+    FILE *f = fopen("/proc/self/cgroup", "r");
+    if (!f) {
+        return 0;
+    }
+    double best = 0.0;
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\n")] = '\0';
+        char *first = strchr(line, ':');
+        char *second = first ? strchr(first + 1, ':') : NULL;
+        if (!second) {
+            continue;
+        }
+        *first = '\0';
+        *second = '\0';
+        const char *controllers = first + 1;
+        const char *rel = strcmp(second + 1, "/") == 0 ? "" : second + 1;
+
+        double q = 0.0;
+        if (controllers[0] == '\0') {
+            q = tightest_quota("/sys/fs/cgroup", rel, read_cpu_max);
+            if (q == 0.0) {
+                q = tightest_quota("/sys/fs/cgroup/unified", rel, read_cpu_max);
+            }
+        } else if (has_controller(controllers, "cpu")) {
+            static const char *mounts[] = {"/sys/fs/cgroup/cpu",
+                                           "/sys/fs/cgroup/cpu,cpuacct",
+                                           "/sys/fs/cgroup/cpuacct,cpu"};
+            for (size_t m = 0; m < sizeof(mounts) / sizeof(mounts[0]) && q == 0.0; ++m) {
+                if (access(mounts[m], F_OK) == 0) {
+                    q = tightest_quota(mounts[m], rel, read_cfs_quota);
+                }
+            }
+        }
+        if (q > 0.0 && (best == 0.0 || q < best)) {
+            best = q;
+        }
+    }
+    fclose(f);
+    if (best <= 0.0) {
+        return 0;
+    }
+    int cpus = (int)best;
+    return (double)cpus < best ? cpus + 1 : cpus;
+#else
+    return 0;
+#endif
+}
+
+int radix_usable_cpus(void) {
+    int cpus = 0;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        cpus = CPU_COUNT(&set);
+    }
+#endif
+#ifndef _WIN32
+    if (cpus < 1) {
+        cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+#endif
+    if (cpus < 1) {
+        cpus = 1;
+    }
+    int quota = radix_cgroup_cpu_quota();
+    if (quota > 0 && quota < cpus) {
+        cpus = quota;
+    }
+    return cpus;
+}
+
+/* ---- Options ----------------------------------------------------------- */
+
+/* Copies the fields the caller's radix_options has over the defaults. */
+static int read_options(const radix_options *opt, radix_options *out) {
+    radix_options_init(out);
+    if (!opt) {
+        return RADIX_OK;
+    }
+    if (opt->size < offsetof(radix_options, threads) + sizeof(int)) {
+        return RADIX_EINVAL;
+    }
+    memcpy(out, opt, opt->size < sizeof(*out) ? opt->size : sizeof(*out));
+    out->size = sizeof(*out);
+    if (!radix_backend_available(out->backend) || out->threads < 0 ||
+        out->min_keys_per_thread < 0) {
+        return RADIX_EINVAL;
+    }
+    if (out->threads == 0) {
+        out->threads = radix_usable_cpus();
+    }
+    return RADIX_OK;
+}
+
+void radix_options_init(radix_options *opt) {
+    memset(opt, 0, sizeof(*opt));
+    opt->size = sizeof(*opt);
+    opt->backend = RADIX_BACKEND_AUTO;
+    opt->threads = radix_usable_cpus();
+}
+
+int radix_api_version(void) {
+    return RADIX_API_VERSION;
+}
+
+int radix_backend_available(int backend) {
+#ifdef _OPENMP
+    return backend >= RADIX_BACKEND_AUTO && backend <= RADIX_BACKEND_OPENMP;
+#else
+    return backend >= RADIX_BACKEND_AUTO && backend <= RADIX_BACKEND_PTHREADS;
+#endif
+}
+
+const char *radix_backend_name(int backend) {
+    static const char *names[] = {"auto", "serial", "pthreads", "openmp"};
+    return backend >= RADIX_BACKEND_AUTO && backend <= RADIX_BACKEND_OPENMP ? names[backend]
+                                                                            : "unknown";
+}
+
+/* ---- Entry points ------------------------------------------------------ */
+
+static int sort_threads(size_t n, const radix_options *o) {
+    size_t cap = n / (o->min_keys_per_thread > 0 ? (size_t)o->min_keys_per_thread
+                                                 : MIN_KEYS_PER_THREAD);
+    return o->backend == RADIX_BACKEND_SERIAL ? 1
+           : (size_t)o->threads < cap         ? o->threads
+           : cap > 1                          ? (int)cap
+                                              : 1;
+}
+
+int radix_sort_threads(size_t n, const radix_options *opt) {
+    radix_options o;
+    if (read_options(opt, &o) != RADIX_OK) {
+        return 1;
+    }
+    return sort_threads(n, &o);
+}
+
+static int lsd_sort(void *keys, int key_bytes, void *vals, int val_bytes, size_t n,
+                    const radix_options *opt) {
+    radix_options o;
+    int rc = read_options(opt, &o);
+    if (rc != RADIX_OK) {
+        return rc;
+    }
+    if (n > 0 && !keys) {
+        return RADIX_EINVAL;
+    }
+    if (n <= 1) {
+        return RADIX_OK;
+    }
+    if (o.ctx && key_bytes == 4 && val_bytes == 0 && o.backend != RADIX_BACKEND_SERIAL &&
+        o.backend != RADIX_BACKEND_OPENMP && n <= (size_t)radix_ctx_max_n(o.ctx) &&
+        !o.digits && !o.worker_begin && !o.worker_end) {
+        return radix_ctx_sort(o.ctx, (int *)keys, (long)n);
+    }
+
+    int threads = sort_threads(n, &o);
+    radix_lsd_job j;
+    memset(&j, 0, sizeof(j));
+    j.key_bytes = key_bytes;
+    j.val_bytes = val_bytes;
+    j.n = n;
+    j.threads = threads;
+    j.keys = (char *)keys;
+    j.vals = (char *)vals;
+    j.alloc = o.alloc;
+    j.digits = o.digits;
+    j.first_touch = o.first_touch;
+    j.worker_begin = o.worker_begin;
+    j.worker_end = o.worker_end;
+    j.worker_arg = o.worker_arg;
+    size_t counts_bytes = sizeof(size_t) * RADIX * (size_t)threads;
+    j.tmp_keys = o.scratch_keys ? (char *)o.scratch_keys
+                                : (char *)radix_scratch_alloc(o.alloc, n * (size_t)key_bytes);
+    j.tmp_vals = val_bytes ? (char *)radix_scratch_alloc(o.alloc, n * (size_t)val_bytes) : NULL;
+    j.counts = (size_t *)radix_scratch_alloc(o.alloc, counts_bytes);
+
+    if (!j.tmp_keys || (val_bytes && !j.tmp_vals) || !j.counts) {
+        rc = RADIX_ENOMEM;
+    } else if (threads == 1) {
+        j.sync = radix_lsd_sync_none;
+        radix_lsd_run(&j, 0);
+#ifdef _OPENMP
+    } else if (o.backend == RADIX_BACKEND_OPENMP) {
+        run_openmp(&j);
+#endif
+    } else {
+        run_pthreads(&j);
+    }
+    radix_scratch_free(o.alloc, j.counts, counts_bytes);
+    radix_scratch_free(o.alloc, j.tmp_vals, n * (size_t)val_bytes);
+    if (!o.scratch_keys) {
+        radix_scratch_free(o.alloc, j.tmp_keys, n * (size_t)key_bytes);
+    }
+    return rc;
+}
+
+int radix_sort_u32(uint32_t *keys, size_t n, const radix_options *opt) {
+    return lsd_sort(keys, 4, NULL, 0, n, opt);
+}
+
+int radix_sort_u64(uint64_t *keys, size_t n, const radix_options *opt) {
+    return lsd_sort(keys, 8, NULL, 0, n, opt);
+}
+
+int radix_sort_kv_u32(uint32_t *keys, uint32_t *values, size_t n, const radix_options *opt) {
+    return lsd_sort(keys, 4, values, values ? 4 : 0, n, opt);
+}
+
+int radix_sort_kv_u64(uint64_t *keys, uint64_t *values, size_t n, const radix_options *opt) {
+    return lsd_sort(keys, 8, values, values ? 8 : 0, n, opt);
+}
+
+/* Sorts a copy of the keys with the row numbers riding along as values. */
+static int argsort(const void *keys, int key_bytes, size_t n, uint64_t *order,
+                   const radix_options *opt) {
+    radix_options o;
+    int rc = read_options(opt, &o);
+    if (rc != RADIX_OK) {
+        return rc;
+    }
+    if (n > 0 && (!keys || !order)) {
+        return RADIX_EINVAL;
+    }
+    size_t bytes = n * (size_t)key_bytes;
+    void *copy = radix_scratch_alloc(o.alloc, bytes);
+    if (!copy) {
+        return RADIX_ENOMEM;
+    }
+    memcpy(copy, keys, bytes);
+    for (size_t i = 0; i < n; ++i) {
+        order[i] = (uint64_t)i;
+    }
+    rc = lsd_sort(copy, key_bytes, order, 8, n, opt);
+    radix_scratch_free(o.alloc, copy, bytes);
+    return rc;
+}
+
+int radix_argsort_u32(const uint32_t *keys, size_t n, uint64_t *order, const radix_options *opt) {
+    return argsort(keys, 4, n, order, opt);
+}
+
+int radix_argsort_u64(const uint64_t *keys, size_t n, uint64_t *order, const radix_options *opt) {
+    return argsort(keys, 8, n, order, opt);
+}
+
+/* ---- Driver helpers ---------------------------------------------------- */
+
+unsigned int radix_lcg_next(unsigned int *state) {
+    *state = 1664525u * (*state) + 1013904223u;
+    return *state;
+}
+
+void radix_fill_random(int *dst, long n, unsigned int seed) {
+    unsigned int state = seed ? seed : 1u;
+    for (long i = 0; i < n; ++i) {
+        dst[i] = (int)(radix_lcg_next(&state) % 1000000000u);
+    }
+}
+
+int radix_verify_sorted(const int *arr, long n) {
+    for (long i = 1; i < n; ++i) {
+        if (arr[i - 1] > arr[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int radix_verify_sorted_keys(const void *keys, long n, int key_bits) {
+    if (key_bits == 64) {
+        const uint64_t *k = (const uint64_t *)keys;
+        for (long i = 1; i < n; ++i) {
+            if (k[i - 1] > k[i]) {
+                return 0;
+            }
+        }
+        return 1;
+    }
+    const uint32_t *k = (const uint32_t *)keys;
+    for (long i = 1; i < n; ++i) {
+        if (k[i - 1] > k[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int radix_cmp_int(const void *a, const void *b) {
+    int ia = *(const int *)a;
+    int ib = *(const int *)b;
+    return (ia > ib) - (ia < ib);
+}
+
+static const int cases[][RADIX_CASE_MAX] = {
+    {0},
+    {5},
+    {3, 1, 2},
+    {1, 2, 3, 4},
+    {4, 3, 2, 1},
+    {5, 5, 5, 5},
+    {10, 0, 100, 7, 7, 3, 999},
+    {170, 45, 75, 90, 802, 24, 2, 66}
+};
+static const int case_lens[] = {0, 1, 3, 4, 4, 4, 7, 8};
+
+int radix_case_count(void) {
+    return (int)(sizeof(case_lens) / sizeof(case_lens[0]));
+}
+
+const int *radix_case(int i, int *len) {
+    *len = case_lens[i];
+    return cases[i];
+}
+
+int radix_run_cases(radix_case_fn sort, void *arg) {
+    int failed = 0;
+    for (int t = 0; t < radix_case_count(); ++t) {
+        int len;
+        const int *keys = radix_case(t, &len);
+        int buf[RADIX_CASE_MAX];
+        memcpy(buf, keys, sizeof(int) * (size_t)len);
+        double elapsed = sort(buf, len, arg);
+
+        int expected[RADIX_CASE_MAX];
+        memcpy(expected, keys, sizeof(int) * (size_t)len);
+        qsort(expected, (size_t)len, sizeof(int), radix_cmp_int);
+
+        int ok = memcmp(expected, buf, sizeof(int) * (size_t)len) == 0;
+        failed += !ok;
+        printf("[correctness] test %d (n=%d): %s (%.6f s)\n",
+               t, len, ok ? "PASS" : "FAIL", elapsed);
+    }
+    return failed;
+}
+
+static void print_array(const int *arr, int n) {
+    for (int i = 0; i < n; ++i) {
+        printf("%d%s", arr[i], (i + 1 == n) ? "\n" : " ");
+    }
+}
+
+void radix_print_sample(radix_case_fn sort, void *arg, unsigned int seed) {
+    int sample_n = 20;
+    int sample[20];
+    int sorted_sample[20];
+    radix_fill_random(sample, sample_n, seed);
+    memcpy(sorted_sample, sample, sizeof(int) * (size_t)sample_n);
+    (void)sort(sorted_sample, sample_n, arg);
+
+    printf("\n=== Sample of 20 integers ===\nUnsorted: ");
+    print_array(sample, sample_n);
+    printf("Sorted:   ");
+    print_array(sorted_sample, sample_n);
+    puts("");
+}
@@ -0,0 +1,150 @@
+#ifndef LIBRADIX_H
+#define LIBRADIX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "radix_ctx.h"
+
+/* libradix: the sort kernels behind one C API, built as libradix.a or
+   libradix.so from libradix.c and radix_ctx.c.
+
+   Keys are sorted ascending as unsigned integers by a stable LSD radix sort
+   of 8-bit digits. Every pass first builds per-thread histograms; a digit
+   that is the same in every key skips its scatter, so narrow keys cost
+   fewer passes. The work runs on a backend: serial, a team of pthreads, or
+   an OpenMP team when the library was compiled with -fopenmp. A radix_ctx
+   from radix_ctx.h lends its persistent worker pool to 32-bit key-only
+   sorts. Functions return RADIX_OK or one of the RADIX_E* codes of
+   radix_ctx.h; nothing prints or exits, except the driver helpers at the
+   end, which print test results. Scratch memory comes from malloc, or from
+   the radix_allocator in the options (see radix_alloc.h): with an arena, a
+   serial sort or a sort through a radix_ctx takes nothing from the heap.
+   The pthreads backend still starts its threads, which allocate inside
+   libc; a radix_ctx avoids that as well.
+
+   The ABI is kept stable: radix_options only grows at the end, and callers
+   built against an older header set `size` to the size they know. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__) && !defined(_WIN32)
+#define RADIX_API __attribute__((visibility("default")))
+#else
+#define RADIX_API
+#endif
+
+#define RADIX_API_VERSION 3
+
+enum {
+    RADIX_BACKEND_AUTO,      /* pthreads for large inputs, otherwise serial */
+    RADIX_BACKEND_SERIAL,
+    RADIX_BACKEND_PTHREADS,
+    RADIX_BACKEND_OPENMP     /* RADIX_EINVAL unless built with -fopenmp */
+};
+
+/* Called on every thread of a sort: begin before it reads a key, end once
+   its share is done, with the bytes it streamed. Thread 0 is the caller. */
+typedef void (*radix_worker_begin_fn)(void *arg, int worker);
+typedef void (*radix_worker_end_fn)(void *arg, int worker, double bytes);
+
+typedef struct {
+    size_t size;             /* sizeof(radix_options) as the caller knows it */
+    int backend;             /* RADIX_BACKEND_* */
+    int threads;             /* 0: every CPU the process may run on */
+    radix_ctx *ctx;          /* optional pool for 32-bit key-only sorts */
+    const radix_allocator *alloc;  /* scratch memory; NULL: malloc (since version 2) */
+    /* Since version 3. A sort that sets digits or a hook never goes
+       through ctx. */
+    unsigned int digits;     /* bit d set: sort on bits 8d..8d+7; 0: every digit */
+    long min_keys_per_thread;  /* fewest keys per thread; 0: 65536 */
+    int first_touch;         /* each thread faults in its slice of the scratch first */
+    radix_worker_begin_fn worker_begin;
+    radix_worker_end_fn worker_end;
+    void *worker_arg;
+    void *scratch_keys;      /* n keys of ping-pong space the caller lends; NULL: from alloc */
+} radix_options;
+
+/* Fills opt with the defaults: the auto backend on every usable CPU
+   (radix_usable_cpus), no context. A NULL radix_options pointer means the
+   same. */
+RADIX_API void radix_options_init(radix_options *opt);
+
+RADIX_API int radix_api_version(void);
+RADIX_API int radix_backend_available(int backend);
+RADIX_API const char *radix_backend_name(int backend);
+
+/* CPUs granted by the cgroup CPU quota (v2 cpu.max or v1 cfs_quota_us /
+   cfs_period_us, the tightest along the cgroup's ancestors), rounded up.
+   Returns 0 when there is no quota or it cannot be read. */
+RADIX_API int radix_cgroup_cpu_quota(void);
+
+/* CPUs this process can actually use: the sched_getaffinity mask, further
+   limited by the cgroup CPU quota. Always at least 1. */
+RADIX_API int radix_usable_cpus(void);
+
+/* Keys [*start, *end) of n that thread t of `workers` sorts: slices of
+   ceil(n / workers) keys, so the last ones may be short or empty. Callers
+   that place memory per thread split the same way. */
+RADIX_API void radix_worker_slice(long n, int workers, int t, long *start, long *end);
+
+/* Threads the kernel runs an n-key sort with opt on: opt->threads, but at
+   most one per min_keys_per_thread keys (65536 when 0), and 1 for the
+   serial backend or invalid options. Callers that place memory per thread
+   size their teams with it. */
+RADIX_API int radix_sort_threads(size_t n, const radix_options *opt);
+
+RADIX_API int radix_sort_u32(uint32_t *keys, size_t n, const radix_options *opt);
+RADIX_API int radix_sort_u64(uint64_t *keys, size_t n, const radix_options *opt);
+
+/* Sorts keys and moves values[i] along with keys[i]; equal keys keep their
+   order. values may be NULL. */
+RADIX_API int radix_sort_kv_u32(uint32_t *keys, uint32_t *values, size_t n,
+                                const radix_options *opt);
+RADIX_API int radix_sort_kv_u64(uint64_t *keys, uint64_t *values, size_t n,
+                                const radix_options *opt);
+
+/* Stores in order[0, n) the indices that sort keys, which stay untouched;
+   stable for equal keys. */
+RADIX_API int radix_argsort_u32(const uint32_t *keys, size_t n, uint64_t *order,
+                                const radix_options *opt);
+RADIX_API int radix_argsort_u64(const uint64_t *keys, size_t n, uint64_t *order,
+                                const radix_options *opt);
+
+/* ---- Driver helpers ----------------------------------------------------
+
+   Shared by the pthread, OpenMP and MPI drivers so their inputs and
+   --correctness output stay identical. */
+
+RADIX_API unsigned int radix_lcg_next(unsigned int *state);
+
+/* dst[i] in [0, 1e9) from the LCG seeded with seed (0 acts as 1). */
+RADIX_API void radix_fill_random(int *dst, long n, unsigned int seed);
+
+RADIX_API int radix_verify_sorted(const int *arr, long n);
+/* 1 if keys[0, n) ascend as unsigned key_bits-bit (32 or 64) integers. */
+RADIX_API int radix_verify_sorted_keys(const void *keys, long n, int key_bits);
+RADIX_API int radix_cmp_int(const void *a, const void *b);
+
+/* The canonical small cases of --correctness: case i has *len <= 10 keys. */
+#define RADIX_CASE_MAX 10
+RADIX_API int radix_case_count(void);
+RADIX_API const int *radix_case(int i, int *len);
+
+/* Sorts arr[0, n) the driver's way and returns the seconds it took. */
+typedef double (*radix_case_fn)(int *arr, long n, void *arg);
+
+/* Runs every case through sort, checks it against qsort and prints one
+   "[correctness] test" line per case; returns the number that failed. */
+RADIX_API int radix_run_cases(radix_case_fn sort, void *arg);
+
+/* Prints 20 random keys before and after sorting them through sort. */
+RADIX_API void radix_print_sample(radix_case_fn sort, void *arg, unsigned int seed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,47 +1,46 @@
 #include <mpi.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
-static int cmp_int(const void *a, const void *b) {
-    int ia = *(const int *)a;
-    int ib = *(const int *)b;
-    return (ia > ib) - (ia < ib);
-}
+#include "libradix.h"
 
-/* Counting sort by the digit represented by exp (1, 10, 100, ...). */
-static void count_sort(int *a, int n, int exp) {
-    int count[10] = {0};
-    int *output = (int *)malloc(sizeof(int) * (n > 0 ? n : 1));
-    if (!output) {
+/* Each rank is one process, so the local sort runs on the libradix serial
+   backend. Keys are 0..1e9-1, so sorting them as unsigned is exact. */
+static void radix_sort(int *a, int n, const radix_allocator *alloc) {
+    radix_options opt;
+    radix_options_init(&opt);
+    opt.backend = RADIX_BACKEND_SERIAL;
+    opt.alloc = alloc;
+    if (radix_sort_u32((uint32_t *)a, (size_t)n, &opt) != RADIX_OK) {
         fprintf(stderr, "Allocation failed\n");
         MPI_Abort(MPI_COMM_WORLD, 1);
     }
+}
 
-    for (int i = 0; i < n; ++i) {
-        int digit = (a[i] / exp) % 10;
-        count[digit]++;
-    }
+/* The staging buffers of a call and the local sort's scratch come from
+   one arena that lives across calls. It is emptied at the start of each
+   call and replaced only when a larger n needs more room, so repeated
+   sorts of the same size take nothing from the heap. */
+static radix_arena *staging;
 
-    for (int i = 1; i < 10; ++i) {
-        count[i] += count[i - 1];
+static const radix_allocator *staging_reserve(size_t bytes, MPI_Comm comm) {
+    radix_arena_stats st;
+    if (staging) {
+        radix_arena_get_stats(staging, &st);
     }
-
-    for (int i = n - 1; i >= 0; --i) { /* stable */
-        int digit = (a[i] / exp) % 10;
-        output[count[digit] - 1] = a[i];
-        count[digit]--;
-    }
-
-    memcpy(a, output, sizeof(int) * n);
-    free(output);
-}
-
-static void radix_sort(int *a, int n, int global_max) {
-    for (int exp = 1; global_max / exp > 0; exp *= 10) {
-        count_sort(a, n, exp);
+    if (!staging || st.capacity < bytes) {
+        radix_arena_destroy(staging);
+        staging = NULL;
+        if (radix_arena_create(&staging, bytes) != RADIX_OK) {
+            fprintf(stderr, "Allocation failed for staging arena\n");
+            MPI_Abort(comm, 1);
+        }
     }
+    radix_arena_reset(staging);
+    return radix_arena_allocator(staging);
 }
 
 /* mpi_radix_sort_buffer: scatter -> local radix -> gather+merge (root).
@@ -58,9 +57,19 @@ static int mpi_radix_sort_buffer(const int *root_data,
     MPI_Comm_rank(comm, &rank);
     MPI_Comm_size(comm, &size);
 
+    /* Every block below plus the local sort's scratch: its keys and one
+       histogram. 16 bytes of alignment slack per block. */
+    size_t max_local = (size_t)(n / size + 1);
+    size_t need = sizeof(int) * 3 * (size_t)size + 2 * sizeof(int) * max_local +
+                  sizeof(size_t) * 256 + 16 * 8;
+    if (rank == 0) {
+        need += 2 * sizeof(int) * (size_t)(n > 0 ? n : 1);
+    }
+    const radix_allocator *alloc = staging_reserve(need, comm);
+
     /* counts/displs for Scatterv/Gatherv */
-    int *counts = (int *)malloc(sizeof(int) * size);
-    int *displs = (int *)malloc(sizeof(int) * size);
+    int *counts = (int *)radix_scratch_alloc(alloc, sizeof(int) * size);
+    int *displs = (int *)radix_scratch_alloc(alloc, sizeof(int) * size);
     if (!counts || !displs) {
         fprintf(stderr, "Allocation failed for counts/displs\n");
         MPI_Abort(comm, 1);
@@ -74,7 +83,7 @@ static int mpi_radix_sort_buffer(const int *root_data,
     }
 
     int local_n = counts[rank];
-    int *local = (int *)malloc(sizeof(int) * (local_n > 0 ? local_n : 1));
+    int *local = (int *)radix_scratch_alloc(alloc, sizeof(int) * (local_n > 0 ? local_n : 1));
     if (!local) {
         fprintf(stderr, "Allocation failed for local buffer\n");
         MPI_Abort(comm, 1);
@@ -83,8 +92,8 @@ static int mpi_radix_sort_buffer(const int *root_data,
     int *input = NULL;
     int *gathered = NULL;
     if (rank == 0) {
-        input = (int *)malloc(sizeof(int) * (n > 0 ? n : 1));
-        gathered = (int *)malloc(sizeof(int) * (n > 0 ? n : 1));
+        input = (int *)radix_scratch_alloc(alloc, sizeof(int) * (n > 0 ? n : 1));
+        gathered = (int *)radix_scratch_alloc(alloc, sizeof(int) * (n > 0 ? n : 1));
         if (!input || !gathered) {
             fprintf(stderr, "Allocation failed for input/gathered buffers\n");
             MPI_Abort(comm, 1);
@@ -110,17 +119,7 @@ static int mpi_radix_sort_buffer(const int *root_data,
 
     MPI_Scatterv(input, counts, displs, MPI_INT, local, local_n, MPI_INT, 0, comm);
 
-    int local_max = 0;
-    for (int i = 0; i < local_n; ++i) {
-        if (local[i] > local_max) local_max = local[i];
-    }
-
-    int global_max = 0;
-    MPI_Allreduce(&local_max, &global_max, 1, MPI_INT, MPI_MAX, comm);
-
-    if (global_max > 0 && local_n > 0) {
-        radix_sort(local, local_n, global_max);
-    }
+    radix_sort(local, local_n, alloc);
 
     MPI_Gatherv(local, local_n, MPI_INT, gathered, counts, displs, MPI_INT, 0, comm);
 
@@ -129,11 +128,12 @@ static int mpi_radix_sort_buffer(const int *root_data,
     int ok = 1;
     if (rank == 0) {
         /* k-way merge of sorted chunks into input buffer. */
-        int *idx = (int *)calloc(size, sizeof(int));
+        int *idx = (int *)radix_scratch_alloc(alloc, sizeof(int) * size);
         if (!idx) {
             fprintf(stderr, "Allocation failed for idx\n");
             MPI_Abort(comm, 1);
         }
+        memset(idx, 0, sizeof(int) * size);
 
         for (long out = 0; out < n; ++out) {
             int min_rank = -1;
@@ -166,21 +166,13 @@ static int mpi_radix_sort_buffer(const int *root_data,
             memcpy(root_output, input, sizeof(int) * n);
         }
 
-        free(idx);
     }
 
     if (elapsed && rank == 0) {
         *elapsed = t1 - t0;
     }
 
-    free(counts);
-    free(displs);
-    free(local);
-    if (rank == 0) {
-        free(input);
-        free(gathered);
-    }
-
+    /* The blocks go back all at once when the next call resets the arena. */
     return ok;
 }
 
@@ -188,7 +180,35 @@ static void usage(int rank) {
     if (rank == 0) {
         fprintf(stderr,
                 "Usage: mpiexec -n <p> ./mpi_radix [--n <count>] [--verify] [--seed <s>] "
-                "[--bench] [--correctness]\n");
+                "[--bench] [--correctness] [--stats]\n");
+    }
+}
+
+/* --stats: libradix scratch blocks summed over the ranks, and the largest
+   rank's staging arena high-water mark. Every rank must call it. */
+static void print_alloc_stats(MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    radix_alloc_stats as;
+    radix_alloc_get_stats(&as);
+    radix_arena_stats st;
+    memset(&st, 0, sizeof(st));
+    if (staging) {
+        radix_arena_get_stats(staging, &st);
+    }
+    unsigned long counts[5] = {as.heap_allocs, as.custom_allocs, as.frees, as.failures,
+                              (unsigned long)as.bytes};
+    unsigned long arena[3] = {(unsigned long)st.peak, (unsigned long)st.capacity, st.failures};
+    unsigned long count_sums[5];
+    unsigned long arena_max[3];
+    MPI_Reduce(counts, count_sums, 5, MPI_UNSIGNED_LONG, MPI_SUM, 0, comm);
+    MPI_Reduce(arena, arena_max, 3, MPI_UNSIGNED_LONG, MPI_MAX, 0, comm);
+    if (rank == 0) {
+        printf("[alloc] heap = %lu | custom = %lu | frees = %lu | failures = %lu | bytes = %lu\n",
+               count_sums[0], count_sums[1], count_sums[2], count_sums[3], count_sums[4]);
+        printf("[staging] peak = %.1f MB of %.1f MB | failures = %lu\n",
+               (double)arena_max[0] / (1024.0 * 1024.0), (double)arena_max[1] / (1024.0 * 1024.0),
+               arena_max[2]);
     }
 }
 
@@ -204,6 +224,7 @@ int main(int argc, char **argv) {
     unsigned int seed = (unsigned int)time(NULL);
     int bench = 0;
     int correctness = 0;
+    int show_stats = 0;
 
     for (int i = 1; i < argc; ++i) {
         if (strcmp(argv[i], "--n") == 0 && i + 1 < argc) {
@@ -216,6 +237,8 @@ int main(int argc, char **argv) {
             bench = 1;
         } else if (strcmp(argv[i], "--correctness") == 0) {
             correctness = 1;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            show_stats = 1;
         } else if (strcmp(argv[i], "--help") == 0) {
             usage(rank);
             MPI_Finalize();
@@ -237,41 +260,32 @@ int main(int argc, char **argv) {
 
     /* Correctness tests mimic sequential.py small cases + sample of 20. */
     if (correctness) {
-        int tests[][10] = {
-            {0}, /* placeholder; size handled separately */
-            {5},
-            {3,1,2},
-            {1,2,3,4},
-            {4,3,2,1},
-            {5,5,5,5},
-            {10,0,100,7,7,3,999},
-            {170,45,75,90,802,24,2,66}
-        };
-        int lens[] = {0,1,3,4,4,4,7,8};
-        int num_tests = sizeof(lens) / sizeof(lens[0]);
+        int num_tests = radix_case_count();
 
         for (int t = 0; t < num_tests; ++t) {
             double elapsed = 0.0;
-            int sorted_buf[10];
-            int *sorted_ptr = lens[t] > 0 ? sorted_buf : NULL;
-            int ok = mpi_radix_sort_buffer(t == 0 ? NULL : tests[t],
-                                           lens[t],
+            int len;
+            const int *keys = radix_case(t, &len);
+            int sorted_buf[RADIX_CASE_MAX];
+            int *sorted_ptr = len > 0 ? sorted_buf : NULL;
+            int ok = mpi_radix_sort_buffer(len == 0 ? NULL : keys,
+                                           len,
                                            1,
                                            seed + (unsigned int)t,
                                            &elapsed,
                                            sorted_ptr,
                                            MPI_COMM_WORLD);
-            if (rank == 0 && lens[t] > 0) {
-                int expected[10];
-                memcpy(expected, tests[t], sizeof(int) * lens[t]);
-                qsort(expected, lens[t], sizeof(int), cmp_int);
-                if (memcmp(expected, sorted_ptr, sizeof(int) * lens[t]) != 0) {
+            if (rank == 0 && len > 0) {
+                int expected[RADIX_CASE_MAX];
+                memcpy(expected, keys, sizeof(int) * len);
+                qsort(expected, len, sizeof(int), radix_cmp_int);
+                if (memcmp(expected, sorted_ptr, sizeof(int) * len) != 0) {
                     ok = 0;
                 }
             }
             if (rank == 0) {
                 printf("[correctness] test %d (n=%d): %s (%.6f s)\n",
-                       t, lens[t], ok ? "PASS" : "FAIL", elapsed);
+                       t, len, ok ? "PASS" : "FAIL", elapsed);
             }
         }
 
@@ -297,6 +311,7 @@ int main(int argc, char **argv) {
             }
         }
 
+        radix_arena_destroy(staging);
         MPI_Finalize();
         return 0;
     }
@@ -319,6 +334,10 @@ int main(int argc, char **argv) {
                        sizes[i], size, elapsed, verify && !ok ? " (verify FAILED)" : "");
             }
         }
+        if (show_stats) {
+            print_alloc_stats(MPI_COMM_WORLD);
+        }
+        radix_arena_destroy(staging);
         MPI_Finalize();
         return 0;
     }
@@ -332,7 +351,11 @@ int main(int argc, char **argv) {
             fprintf(stderr, "Verification failed.\n");
         }
     }
+    if (show_stats) {
+        print_alloc_stats(MPI_COMM_WORLD);
+    }
 
+    radix_arena_destroy(staging);
     MPI_Finalize();
     return 0;
 }
@@ -0,0 +1,258 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include "numa_place.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef MPOL_INTERLEAVE
+#define MPOL_INTERLEAVE 3
+#endif
+#endif
+
+#define PAGE_BYTES 4096
+
+static int read_int_file(const char *path, int fallback) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return fallback;
+    }
+    int value = fallback;
+    if (fscanf(f, "%d", &value) != 1) {
+        value = fallback;
+    }
+    fclose(f);
+    return value;
+}
+
+int topology_load(cpu_topology *topo) {
+    memset(topo, 0, sizeof(*topo));
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    int have_mask = sched_getaffinity(0, sizeof(set), &set) == 0;
+    int count = have_mask ? CPU_COUNT(&set) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    int count = 1;
+#endif
+    if (count < 1) {
+        count = 1;
+    }
+
+    topo->cpu_ids = (int *)malloc(sizeof(int) * count);
+    topo->socket_ids = (int *)malloc(sizeof(int) * count);
+    if (!topo->cpu_ids || !topo->socket_ids) {
+        topology_free(topo);
+        return -1;
+    }
+
+    int filled = 0;
+#ifdef __linux__
+    for (int cpu = 0; cpu < CPU_SETSIZE && filled < count; ++cpu) {
+        if (have_mask && !CPU_ISSET(cpu, &set)) {
+            continue;
+        }
+        char path[128];
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+        int socket = read_int_file(path, 0);
+        if (socket < 0 || socket >= NUMA_MAX_SOCKETS) {
+            socket = 0;
+        }
+        topo->cpu_ids[filled] = cpu;
+        topo->socket_ids[filled] = socket;
+        ++filled;
+    }
+#endif
+    if (filled == 0) {
+        topo->cpu_ids[0] = 0;
+        topo->socket_ids[0] = 0;
+        filled = 1;
+    }
+    topo->cpus = filled;
+
+    for (int i = 0; i < filled; ++i) {
+        if (topo->socket_ids[i] + 1 > topo->sockets) {
+            topo->sockets = topo->socket_ids[i] + 1;
+        }
+    }
+    return 0;
+}
+
+void topology_free(cpu_topology *topo) {
+    free(topo->cpu_ids);
+    free(topo->socket_ids);
+    memset(topo, 0, sizeof(*topo));
+}
+
+int topology_worker_cpu(const cpu_topology *topo, int affinity, int worker) {
+    if (affinity == AFFINITY_NONE || topo->cpus == 0) {
+        return -1;
+    }
+    if (affinity == AFFINITY_COMPACT || topo->sockets <= 1) {
+        return topo->cpu_ids[worker % topo->cpus];
+    }
+
+    /* Scatter: socket = worker % sockets, then the k-th CPU of that socket. */
+    int socket = worker % topo->sockets;
+    int k = worker / topo->sockets;
+    int in_socket = 0;
+    for (int i = 0; i < topo->cpus; ++i) {
+        in_socket += topo->socket_ids[i] == socket;
+    }
+    if (in_socket == 0) {
+        return topo->cpu_ids[worker % topo->cpus];
+    }
+    k %= in_socket;
+    for (int i = 0; i < topo->cpus; ++i) {
+        if (topo->socket_ids[i] == socket && k-- == 0) {
+            return topo->cpu_ids[i];
+        }
+    }
+    return -1;
+}
+
+int topology_socket_of(const cpu_topology *topo, int cpu) {
+    for (int i = 0; i < topo->cpus; ++i) {
+        if (topo->cpu_ids[i] == cpu) {
+            return topo->socket_ids[i];
+        }
+    }
+    return 0;
+}
+
+int pin_to_cpu(int cpu) {
+#ifdef __linux__
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return -1;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0 ? 0 : -1;
+#else
+    (void)cpu;
+    return -1;
+#endif
+}
+
+#ifdef __linux__
+_Static_assert(sizeof(cpu_set_t) <= sizeof(((cpu_mask *)0)->bits), "cpu_mask too small");
+#endif
+
+int save_cpu_mask(cpu_mask *mask) {
+    mask->valid = 0;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        memcpy(mask->bits, &set, sizeof(set));
+        mask->valid = 1;
+    }
+#endif
+    return mask->valid ? 0 : -1;
+}
+
+void restore_cpu_mask(const cpu_mask *mask) {
+#ifdef __linux__
+    if (mask->valid) {
+        cpu_set_t set;
+        memcpy(&set, mask->bits, sizeof(set));
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+#else
+    (void)mask;
+#endif
+}
+
+int current_cpu(void) {
+#ifdef __linux__
+    int cpu = sched_getcpu();
+    return cpu < 0 ? 0 : cpu;
+#else
+    return 0;
+#endif
+}
+
+int numa_interleave(void *buf, size_t bytes) {
+#if defined(__linux__) && defined(SYS_mbind)
+    int nodes = 0;
+    char path[64];
+    for (int node = 0; node < 64; ++node) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", node);
+        if (access(path, F_OK) == 0) {
+            nodes = node + 1;
+        }
+    }
+    if (nodes <= 1) {
+        return -1;
+    }
+
+    unsigned long mask = nodes >= 64 ? ~0ul : (1ul << nodes) - 1;
+    unsigned long start = ((unsigned long)buf + PAGE_BYTES - 1) & ~(unsigned long)(PAGE_BYTES - 1);
+    unsigned long end = ((unsigned long)buf + bytes) & ~(unsigned long)(PAGE_BYTES - 1);
+    if (end <= start) {
+        return -1;
+    }
+    long rc = syscall(SYS_mbind, (void *)start, end - start, MPOL_INTERLEAVE,
+                      &mask, (unsigned long)nodes + 1, 0u);
+    return rc == 0 ? 0 : -1;
+#else
+    (void)buf;
+    (void)bytes;
+    return -1;
+#endif
+}
+
+void touch_pages(void *buf, size_t bytes) {
+    volatile unsigned char *p = (volatile unsigned char *)buf;
+    for (size_t off = 0; off < bytes; off += PAGE_BYTES) {
+        p[off] = 0;
+    }
+    if (bytes > 0) {
+        p[bytes - 1] = 0;
+    }
+}
+
+int parse_affinity(const char *name, int *affinity) {
+    if (strcmp(name, "none") == 0) {
+        *affinity = AFFINITY_NONE;
+    } else if (strcmp(name, "compact") == 0) {
+        *affinity = AFFINITY_COMPACT;
+    } else if (strcmp(name, "scatter") == 0) {
+        *affinity = AFFINITY_SCATTER;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+int parse_numa_policy(const char *name, int *policy) {
+    if (strcmp(name, "local") == 0) {
+        *policy = NUMA_FIRST_TOUCH;
+    } else if (strcmp(name, "interleave") == 0) {
+        *policy = NUMA_INTERLEAVE;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+const char *affinity_name(int affinity) {
+    switch (affinity) {
+    case AFFINITY_COMPACT:
+        return "compact";
+    case AFFINITY_SCATTER:
+        return "scatter";
+    default:
+        return "none";
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef NUMA_PLACE_H
+#define NUMA_PLACE_H
+
+#include <stddef.h>
+
+/* CPU topology, thread pinning and page placement helpers shared by the
+   pthread and OpenMP drivers. Everything degrades to a single socket and
+   no pinning when the platform does not expose the information. */
+
+#define NUMA_MAX_SOCKETS 16
+
+enum { AFFINITY_NONE, AFFINITY_COMPACT, AFFINITY_SCATTER };
+enum { NUMA_FIRST_TOUCH, NUMA_INTERLEAVE };
+
+typedef struct {
+    int cpus;
+    int *cpu_ids;    /* CPUs this process may run on, ascending */
+    int *socket_ids; /* physical package of each entry in cpu_ids */
+    int sockets;
+} cpu_topology;
+
+/* Returns 0 on success and -1 if allocation fails. */
+int topology_load(cpu_topology *topo);
+void topology_free(cpu_topology *topo);
+
+/* CPU for worker `worker` under the given AFFINITY_* mode; -1 means unpinned.
+   compact fills one socket before the next, scatter alternates sockets. */
+int topology_worker_cpu(const cpu_topology *topo, int affinity, int worker);
+int topology_socket_of(const cpu_topology *topo, int cpu);
+
+/* Pins the calling thread. Returns 0 on success, -1 otherwise. */
+int pin_to_cpu(int cpu);
+int current_cpu(void);
+
+/* A thread's CPU mask, kept across pin_to_cpu on a thread that is only
+   borrowed (the caller of a sort) so it can be handed back as it was.
+   Threads created while it is pinned would inherit the one-CPU mask. */
+typedef struct {
+    unsigned long bits[1024 / (8 * sizeof(unsigned long))];
+    int valid;
+} cpu_mask;
+
+/* Returns 0 on success, -1 otherwise (restore is then a no-op). */
+int save_cpu_mask(cpu_mask *mask);
+void restore_cpu_mask(const cpu_mask *mask);
+
+/* Requests round-robin page placement over all memory nodes for the
+   page-aligned interior of buf. Must run before the pages are touched.
+   Returns 0 on success, -1 if the policy could not be applied. */
+int numa_interleave(void *buf, size_t bytes);
+
+/* Writes one byte per page so the pages fault in on the calling thread. */
+void touch_pages(void *buf, size_t bytes);
+
+int parse_affinity(const char *name, int *affinity);
+int parse_numa_policy(const char *name, int *policy);
+const char *affinity_name(int affinity);
+
+#endif
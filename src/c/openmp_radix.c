@@ -1,46 +1,48 @@
+#include <errno.h>
 #include <omp.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
+#include "libradix.h"
+#include "numa_place.h"
+#include "scratch_pool.h"
+#include "sort_driver.h"
+#include "tune_profile.h"
+
 #define RADIX_BITS 8
 #define RADIX (1 << RADIX_BITS)
 
-static unsigned int lcg_next(unsigned int *state) {
-    *state = 1664525u * (*state) + 1013904223u;
-    return *state;
-}
+/* MSD: buckets at or below this size are finished with insertion sort. */
+#define MSD_INSERTION_CUTOFF 64
+/* MSD: buckets smaller than this are recursed inline instead of as tasks.
+   This and libradix's minimum keys per thread are defaults; a --tune
+   profile may override both. */
+#define MSD_TASK_GRAIN 16384
 
-static void fill_random(int *dst, long n, unsigned int seed) {
-    unsigned int state = seed ? seed : 1u;
-    for (long i = 0; i < n; ++i) {
-        dst[i] = (int)(lcg_next(&state) % 1000000000u);
-    }
-}
+/* --tune: keys per calibration sort, and runs per setting (the fastest counts). */
+#define TUNE_N 4000000
+#define TUNE_REPS 3
 
-static int verify_sorted(const int *arr, long n) {
-    for (long i = 1; i < n; ++i) {
-        if (arr[i - 1] > arr[i]) {
-            return 0;
-        }
-    }
-    return 1;
-}
+enum { ALGO_LSD, ALGO_MSD };
 
-static int cmp_int(const void *a, const void *b) {
-    int ia = *(const int *)a;
-    int ib = *(const int *)b;
-    return (ia > ib) - (ia < ib);
-}
+typedef struct {
+    sort_placement place;        /* team size, pinning and scratch placement */
+    int algo;
+    long task_grain;             /* smallest MSD bucket that becomes a task (MSD_TASK_GRAIN) */
+} sort_config;
 
-static double radix_sort_openmp(int *arr, long n, int threads) {
+/* Previous structure: one parallel region (fork/join) per pass plus an
+   `omp single` prefix sum. Kept as the baseline for --compare. */
+static double radix_sort_openmp_per_pass(int *arr, long n, int threads) {
     if (n <= 1) {
         return 0.0;
     }
 
     int *tmp = (int *)malloc(sizeof(int) * n);
-    int *counts = (int *)malloc(sizeof(int) * RADIX * threads);
+    long *counts = (long *)malloc(sizeof(long) * RADIX * threads);
     if (!tmp || !counts) {
         fprintf(stderr, "[OpenMP] Allocation failed\n");
         exit(1);
@@ -51,8 +53,8 @@ static double radix_sort_openmp(int *arr, long n, int threads) {
 #pragma omp parallel num_threads(threads)
         {
             int tid = omp_get_thread_num();
-            int *local_counts = counts + tid * RADIX;
-            memset(local_counts, 0, sizeof(int) * RADIX);
+            long *local_counts = counts + tid * RADIX;
+            memset(local_counts, 0, sizeof(long) * RADIX);
 
 #pragma omp for schedule(static)
             for (long i = 0; i < n; ++i) {
@@ -63,12 +65,12 @@ static double radix_sort_openmp(int *arr, long n, int threads) {
 #pragma omp barrier
 #pragma omp single
             {
-                int total = 0;
+                long total = 0;
                 int active = omp_get_num_threads();
                 for (int digit = 0; digit < RADIX; ++digit) {
                     for (int t = 0; t < active; ++t) {
-                        int idx = t * RADIX + digit;
-                        int c = counts[idx];
+                        long idx = (long)t * RADIX + digit;
+                        long c = counts[idx];
                         counts[idx] = total;
                         total += c;
                     }
@@ -77,9 +79,9 @@ static double radix_sort_openmp(int *arr, long n, int threads) {
 
 #pragma omp barrier
 #pragma omp for schedule(static)
-            for (long i = n - 1; i >= 0; --i) {
+            for (long i = 0; i < n; ++i) {
                 unsigned int digit = ((unsigned int)arr[i] >> shift) & (RADIX - 1);
-                int pos = counts[tid * RADIX + digit]++;
+                long pos = counts[tid * RADIX + digit]++;
                 tmp[pos] = arr[i];
             }
 
@@ -97,93 +99,415 @@ static double radix_sort_openmp(int *arr, long n, int threads) {
     return t1 - t0;
 }
 
+/* --algo lsd: the libradix kernel on the OpenMP backend, one parallel
+   region for all passes. */
+static double radix_sort_openmp(int *arr, long n, const sort_config *cfg, sort_bandwidth *bw) {
+    return driver_radix_sort(&cfg->place, RADIX_BACKEND_OPENMP, arr, n, 32, 0, NULL, bw);
+}
+
+/* 64-bit keys from --input --key-bits 64; every --algo uses this kernel. */
+static double radix_sort_openmp64(uint64_t *arr, long n, const sort_config *cfg) {
+    return driver_radix_sort(&cfg->place, RADIX_BACKEND_OPENMP, arr, n, 64, 0, NULL, NULL);
+}
+
+static void insertion_sort(int *a, long n) {
+    for (long i = 1; i < n; ++i) {
+        int v = a[i];
+        unsigned int key = (unsigned int)v;
+        long j = i - 1;
+        while (j >= 0 && (unsigned int)a[j] > key) {
+            a[j + 1] = a[j];
+            --j;
+        }
+        a[j + 1] = v;
+    }
+}
+
+/* Sorts the n keys in src by the digits at `shift` and below. dst is scratch
+   of the same extent; `src_is_arr` tracks which of the two belongs to the
+   caller's array so the result always lands there. Each non-trivial bucket
+   becomes a task, and `final` stops task creation once buckets are small. */
+static void msd_recurse(int *src, int *dst, long n, int shift, int src_is_arr, long grain) {
+    if (n <= MSD_INSERTION_CUTOFF || shift < 0) {
+        insertion_sort(src, n);
+        if (!src_is_arr) {
+            memcpy(dst, src, sizeof(int) * n);
+        }
+        return;
+    }
+
+    long counts[RADIX] = {0};
+    for (long i = 0; i < n; ++i) {
+        counts[((unsigned int)src[i] >> shift) & (RADIX - 1)]++;
+    }
+
+    /* Everything shares this digit: descend without moving data. */
+    for (int digit = 0; digit < RADIX; ++digit) {
+        if (counts[digit] == n) {
+            msd_recurse(src, dst, n, shift - RADIX_BITS, src_is_arr, grain);
+            return;
+        } else if (counts[digit] != 0) {
+            break;
+        }
+    }
+
+    long offsets[RADIX];
+    long total = 0;
+    for (int digit = 0; digit < RADIX; ++digit) {
+        offsets[digit] = total;
+        total += counts[digit];
+    }
+    for (long i = 0; i < n; ++i) {
+        unsigned int digit = ((unsigned int)src[i] >> shift) & (RADIX - 1);
+        dst[offsets[digit]++] = src[i];
+    }
+
+    long off = 0;
+    for (int digit = 0; digit < RADIX; ++digit) {
+        long cnt = counts[digit];
+        if (cnt > 0) {
+#pragma omp task firstprivate(off, cnt) final(cnt < grain) mergeable
+            msd_recurse(dst + off, src + off, cnt, shift - RADIX_BITS, !src_is_arr, grain);
+        }
+        off += cnt;
+    }
+}
+
+/* Task-parallel MSD radix sort: the team partitions the whole array on the
+   most significant populated digit with the libradix kernel, then every
+   bucket recurses as an OpenMP task, so skewed bucket sizes are balanced by
+   the task scheduler. */
+static double radix_sort_openmp_msd(int *arr, long n, const sort_config *cfg) {
+    if (n <= 1) {
+        return 0.0;
+    }
+    int threads = driver_threads(&cfg->place, n);
+    long grain = cfg->task_grain;
+
+    int *tmp = (int *)driver_scratch_alloc(&cfg->place, n, sizeof(int), threads);
+    if (!tmp) {
+        fprintf(stderr, "[OpenMP] Allocation failed\n");
+        exit(1);
+    }
+
+    double t0 = omp_get_wtime();
+    unsigned int key_bits = 0;
+#pragma omp parallel for num_threads(threads) schedule(static) reduction(| : key_bits)
+    for (long i = 0; i < n; ++i) {
+        key_bits |= (unsigned int)arr[i];
+    }
+    int top_shift = 0;
+    while (top_shift + RADIX_BITS < 32 && (key_bits >> (top_shift + RADIX_BITS)) != 0) {
+        top_shift += RADIX_BITS;
+    }
+
+    /* The partition pins the team. Pinning sticks to the pool threads (the
+       caller gets its mask back), so their bucket tasks inherit it. */
+    driver_radix_sort(&cfg->place, RADIX_BACKEND_OPENMP, arr, n, 32,
+                      1u << (top_shift / RADIX_BITS), tmp, NULL);
+    long bucket_end[RADIX];
+    driver_bucket_ends(arr, n, top_shift, bucket_end);
+
+#pragma omp parallel num_threads(threads)
+#pragma omp single
+    {
+        long off = 0;
+        for (int digit = 0; digit < RADIX; ++digit) {
+            long cnt = bucket_end[digit] - off;
+            if (cnt > 0) {
+#pragma omp task firstprivate(off, cnt) final(cnt < grain) mergeable
+                msd_recurse(arr + off, tmp + off, cnt, top_shift - RADIX_BITS, 1, grain);
+            }
+            off += cnt;
+        }
+    }
+    double t1 = omp_get_wtime();
+
+    driver_scratch_free(&cfg->place, tmp);
+    return t1 - t0;
+}
+
+static double radix_sort_algo(const sort_config *cfg, int *arr, long n, sort_bandwidth *bw) {
+    if (bw) {
+        memset(bw, 0, sizeof(*bw));
+    }
+    if (cfg->algo == ALGO_MSD) {
+        return radix_sort_openmp_msd(arr, n, cfg);
+    }
+    return radix_sort_openmp(arr, n, cfg, bw);
+}
+
+static const char *algo_name(int algo) {
+    return algo == ALGO_MSD ? "msd" : "lsd";
+}
+
+static int parse_algo(const char *name, int *algo) {
+    if (strcmp(name, "lsd") == 0) {
+        *algo = ALGO_LSD;
+    } else if (strcmp(name, "msd") == 0) {
+        *algo = ALGO_MSD;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
 static int run_random_case(long n,
-                           int threads,
+                           const sort_config *cfg,
                            int verify,
                            unsigned int seed,
-                           double *elapsed) {
+                           double *elapsed,
+                           sort_bandwidth *bw) {
     int *data = (int *)malloc(sizeof(int) * (n > 0 ? n : 1));
     if (!data) {
         fprintf(stderr, "[OpenMP] Allocation failed for input buffer\n");
         exit(1);
     }
-    fill_random(data, n, seed);
-    double t = radix_sort_openmp(data, n, threads);
+    driver_place_input(&cfg->place, data, n, sizeof(int));
+    radix_fill_random(data, n, seed);
+    double t = radix_sort_algo(cfg, data, n, bw);
     if (elapsed) {
         *elapsed = t;
     }
-    int ok = (!verify) || verify_sorted(data, n);
+    int ok = (!verify) || radix_verify_sorted(data, n);
     free(data);
     return ok;
 }
 
-static void print_array(const int *arr, int n) {
-    for (int i = 0; i < n; ++i) {
-        printf("%d%s", arr[i], (i + 1 == n) ? "\n" : " ");
+/* The OpenMP kernels behind the shared --input sorts. */
+static double input_sort_keys(void *arg, void *keys, long n, int key_bits) {
+    const sort_config *cfg = (const sort_config *)arg;
+    if (key_bits == 64) {
+        return radix_sort_openmp64((uint64_t *)keys, n, cfg);
     }
+    return radix_sort_algo(cfg, (int *)keys, n, NULL);
 }
 
-static void run_correctness_suite(int threads, unsigned int seed) {
-    int tests[][10] = {
-        {0},
-        {5},
-        {3, 1, 2},
-        {1, 2, 3, 4},
-        {4, 3, 2, 1},
-        {5, 5, 5, 5},
-        {10, 0, 100, 7, 7, 3, 999},
-        {170, 45, 75, 90, 802, 24, 2, 66}
-    };
-    int lens[] = {0, 1, 3, 4, 4, 4, 7, 8};
-    int num_tests = (int)(sizeof(lens) / sizeof(lens[0]));
-
-    for (int t = 0; t < num_tests; ++t) {
-        int len = lens[t];
-        int buf[10];
-        memcpy(buf, tests[t], sizeof(int) * len);
-        double elapsed = radix_sort_openmp(buf, len, threads);
-
-        int expected[10];
-        memcpy(expected, tests[t], sizeof(int) * len);
-        qsort(expected, len, sizeof(int), cmp_int);
+static const char *input_sort_name(void *arg, int key_bits) {
+    const sort_config *cfg = (const sort_config *)arg;
+    return key_bits == 64 ? "lsd64" : algo_name(cfg->algo);
+}
 
-        int ok = memcmp(expected, buf, sizeof(int) * len) == 0;
-        printf("[correctness] test %d (n=%d): %s (%.6f s)\n",
-               t, len, ok ? "PASS" : "FAIL", elapsed);
+/* --input: a mapped binary sort, or a text or packed one through a private
+   array. Returns the process exit status. */
+static int run_input_sort(const sort_config *cfg,
+                          const char *input,
+                          const char *output,
+                          int key_bits,
+                          int in_format,
+                          int out_format,
+                          int verify,
+                          int show_stats) {
+    sort_driver drv = {&cfg->place, input_sort_keys, input_sort_name, NULL, (void *)cfg};
+    int rc = in_format == FORMAT_BINARY && out_format == FORMAT_BINARY
+                 ? driver_run_file_sort(&drv, input, output, key_bits, verify)
+                 : driver_run_text_sort(&drv, input, output, key_bits, in_format, out_format,
+                                        verify, show_stats);
+    if (show_stats) {
+        driver_print_alloc_stats();
     }
+    return rc;
+}
 
-    int sample_n = 20;
-    int sample[20];
-    int sorted_sample[20];
-    fill_random(sample, sample_n, seed + 12345u);
-    memcpy(sorted_sample, sample, sizeof(int) * sample_n);
-    (void)radix_sort_openmp(sorted_sample, sample_n, threads);
+/* radix_case_fn over the selected kernel. */
+static double sort_case(int *arr, long n, void *arg) {
+    return radix_sort_algo((const sort_config *)arg, arr, n, NULL);
+}
 
-    printf("\n=== Sample of 20 integers ===\nUnsorted: ");
-    print_array(sample, sample_n);
-    printf("Sorted:   ");
-    print_array(sorted_sample, sample_n);
-    puts("");
+static void run_correctness_suite(const sort_config *cfg, unsigned int seed) {
+    radix_run_cases(sort_case, (void *)cfg);
+    radix_print_sample(sort_case, (void *)cfg, seed + 12345u);
 }
 
-static void run_benchmarks(int threads, int verify, unsigned int seed) {
+static void run_benchmarks(const sort_config *cfg,
+                           int verify,
+                           int show_stats,
+                           int repeat,
+                           unsigned int seed) {
     long sizes[] = {10000, 100000, 1000000, 10000000};
     int num_sizes = (int)(sizeof(sizes) / sizeof(sizes[0]));
     for (int i = 0; i < num_sizes; ++i) {
         double elapsed = 0.0;
-        int ok = run_random_case(sizes[i], threads, verify, seed + (unsigned int)i, &elapsed);
-        printf("n = %10ld | threads = %2d | time = %.3f s%s\n",
+        sort_bandwidth stats;
+        int ok = 1;
+        for (int r = 0; r < repeat; ++r) {
+            double t = 0.0;
+            ok &= run_random_case(sizes[i], cfg, verify, seed + (unsigned int)i, &t, &stats);
+            elapsed += t / repeat;
+        }
+        printf("n = %10ld | %-3s | threads = %2d | time = %.3f s%s\n",
                sizes[i],
-               threads,
+               algo_name(cfg->algo),
+               cfg->place.threads,
                elapsed,
                verify && !ok ? " (verify FAILED)" : "");
+        driver_print_bandwidth(&stats);
+    }
+    if (show_stats) {
+        driver_print_alloc_stats();
+    }
+}
+
+/* Sorts identical inputs with the per-pass baseline and the libradix
+   single-region kernel and reports both times side by side. */
+static void run_compare_benchmarks(const sort_config *cfg, int verify, unsigned int seed) {
+    int threads = cfg->place.threads;
+    long sizes[] = {10000, 100000, 1000000, 10000000};
+    int num_sizes = (int)(sizeof(sizes) / sizeof(sizes[0]));
+    for (int i = 0; i < num_sizes; ++i) {
+        long n = sizes[i];
+        int *base = (int *)malloc(sizeof(int) * n);
+        int *single = (int *)malloc(sizeof(int) * n);
+        if (!base || !single) {
+            fprintf(stderr, "[OpenMP] Allocation failed for input buffer\n");
+            exit(1);
+        }
+        radix_fill_random(base, n, seed + (unsigned int)i);
+        memcpy(single, base, sizeof(int) * n);
+
+        double t_pass = radix_sort_openmp_per_pass(base, n, threads);
+        double t_single = radix_sort_openmp(single, n, cfg, NULL);
+        int ok = !verify || (radix_verify_sorted(base, n) && radix_verify_sorted(single, n));
+        printf("n = %10ld | threads = %2d | per-pass = %.3f s | single-region = %.3f s | "
+               "speedup = %.2fx%s\n",
+               n,
+               threads,
+               t_pass,
+               t_single,
+               t_single > 0.0 ? t_pass / t_single : 0.0,
+               ok ? "" : " (verify FAILED)");
+        free(base);
+        free(single);
+    }
+}
+
+static double tune_time(const sort_config *cfg, long n, unsigned int seed) {
+    double best = 0.0;
+    for (int r = 0; r < TUNE_REPS; ++r) {
+        double t = 0.0;
+        if (!run_random_case(n, cfg, 1, seed + (unsigned int)r, &t, NULL)) {
+            fprintf(stderr, "[tune] %s produced unsorted output\n", algo_name(cfg->algo));
+            exit(1);
+        }
+        if (r == 0 || t < best) {
+            best = t;
+        }
     }
+    return best;
+}
+
+/* Calibration matrix: both kernels at power-of-two team sizes up to
+   cfg->place.threads, then the MSD task grain and the per-thread minimum
+   chunk for the winner. The result is stored under key in the profile at path, unless
+   path is empty. */
+static int run_tune(const sort_config *base, unsigned int seed, const char *path, const char *key) {
+    static const int algos[] = {ALGO_LSD, ALGO_MSD};
+    static const long grains[] = {4096, 16384, 65536, 262144};
+    static const long chunks[] = {16384, 65536, 262144};
+    static const long small_sizes[] = {100000, 500000, 2000000};
+
+    printf("[tune] %s: %d keys, best of %d\n", key, TUNE_N, TUNE_REPS);
+    sort_config cfg = *base;
+    sort_config best = *base;
+    double best_time = -1.0;
+    for (size_t a = 0; a < sizeof(algos) / sizeof(algos[0]); ++a) {
+        int max_threads = base->place.threads;
+        for (int threads = 1;; threads = threads * 2 < max_threads ? threads * 2 : max_threads) {
+            cfg.algo = algos[a];
+            cfg.place.threads = threads;
+            double t = tune_time(&cfg, TUNE_N, seed);
+            printf("[tune] %-3s | threads = %2d | time = %.3f s\n", algo_name(cfg.algo), threads, t);
+            if (best_time < 0.0 || t < best_time) {
+                best = cfg;
+                best_time = t;
+            }
+            if (threads >= max_threads) {
+                break;
+            }
+        }
+    }
+
+    if (best.algo == ALGO_MSD) {
+        cfg = best;
+        for (size_t g = 0; g < sizeof(grains) / sizeof(grains[0]); ++g) {
+            cfg.task_grain = grains[g];
+            double t = tune_time(&cfg, TUNE_N, seed);
+            printf("[tune] task_grain = %7ld | time = %.3f s\n", grains[g], t);
+            if (t < best_time) {
+                best = cfg;
+                best_time = t;
+            }
+        }
+    }
+
+    /* The cutoff only matters for inputs a few chunks long, so time those. */
+    if (best.place.threads > 1) {
+        cfg = best;
+        double best_small = -1.0;
+        for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); ++c) {
+            cfg.place.min_chunk = chunks[c];
+            double t = 0.0;
+            for (size_t i = 0; i < sizeof(small_sizes) / sizeof(small_sizes[0]); ++i) {
+                t += tune_time(&cfg, small_sizes[i], seed);
+            }
+            printf("[tune] min_keys_per_thread = %7ld | time = %.3f s\n", chunks[c], t);
+            if (best_small < 0.0 || t < best_small) {
+                best.place.min_chunk = chunks[c];
+                best_small = t;
+            }
+        }
+    }
+
+    tune_params params;
+    memset(&params, 0, sizeof(params));
+    snprintf(params.algo, sizeof(params.algo), "%s", algo_name(best.algo));
+    params.threads = best.place.threads;
+    params.min_keys_per_thread = best.place.min_chunk;
+    params.task_grain = best.task_grain;
+    printf("[tune] chosen: algo = %s | threads = %d | min_keys_per_thread = %ld | task_grain = %ld\n",
+           params.algo, params.threads, params.min_keys_per_thread, params.task_grain);
+    if (path[0] == '\0') {
+        return 0;
+    }
+    if (tune_profile_save(path, key, &params) != 0) {
+        fprintf(stderr, "[tune] Could not write profile %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    printf("[tune] Saved profile to %s\n", path);
+    return 0;
+}
+
+/* Fills in whatever the command line (or OMP_NUM_THREADS) did not set. */
+static void apply_profile(sort_config *cfg, const char *path, const char *key,
+                          int algo_set, int threads_set) {
+    tune_params params;
+    if (tune_profile_load(path, key, &params) != 0) {
+        return;
+    }
+    int algo;
+    if (!algo_set && parse_algo(params.algo, &algo) == 0) {
+        cfg->algo = algo;
+    }
+    if (!threads_set && params.threads > 0) {
+        cfg->place.threads = params.threads;
+    }
+    if (params.min_keys_per_thread > 0) {
+        cfg->place.min_chunk = params.min_keys_per_thread;
+    }
+    if (params.task_grain > 0) {
+        cfg->task_grain = params.task_grain;
+    }
+    printf("[tune] Loaded profile %s\n", path);
 }
 
 static void usage(const char *prog) {
     fprintf(stderr,
             "Usage: %s [--n <count>] [--threads <t>] [--verify] "
-            "[--seed <s>] [--bench] [--correctness]\n",
+            "[--seed <s>] [--algo lsd|msd] [--affinity none|compact|scatter] "
+            "[--numa local|interleave] [--pool] [--repeat <k>] [--bench] [--compare] [--correctness]\n"
+            "       [--stats] [--tune] [--profile <path>|none] [--input <file> [--output <file>]\n"
+            "       [--key-bits 32|64] [--in-format binary|text|packed] "
+            "[--out-format binary|text|packed]]\n",
             prog);
 }
 
@@ -191,26 +515,87 @@ int main(int argc, char **argv) {
     long n = 100000;
     unsigned int seed = (unsigned int)time(NULL);
     int verify = 0;
+    int show_stats = 0;
     int bench = 0;
+    int compare = 0;
     int correctness = 0;
-    int threads = omp_get_max_threads();
-    if (threads < 1) {
-        threads = 1;
+    int repeat = 1;
+    int tune = 0;
+    int algo_set = 0;
+    int threads_set = 0;
+    const char *profile_arg = NULL;
+    const char *input = NULL;
+    const char *output = NULL;
+    int key_bits = 32;
+    int in_format = FORMAT_BINARY;
+    int out_format = -1;
+    sort_config cfg = {{"[OpenMP]", radix_usable_cpus(), AFFINITY_NONE, NUMA_FIRST_TOUCH, 0,
+                        NULL, 0},
+                       ALGO_LSD, MSD_TASK_GRAIN};
+    /* An explicit OMP_NUM_THREADS still wins over the detected CPU budget. */
+    if (getenv("OMP_NUM_THREADS")) {
+        cfg.place.threads = omp_get_max_threads();
+        threads_set = 1;
     }
 
     for (int i = 1; i < argc; ++i) {
         if (strcmp(argv[i], "--n") == 0 && i + 1 < argc) {
             n = strtol(argv[++i], NULL, 10);
         } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
-            threads = (int)strtol(argv[++i], NULL, 10);
+            cfg.place.threads = (int)strtol(argv[++i], NULL, 10);
+            threads_set = 1;
         } else if (strcmp(argv[i], "--verify") == 0) {
             verify = 1;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            show_stats = 1;
         } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
             seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--algo") == 0 && i + 1 < argc) {
+            if (parse_algo(argv[++i], &cfg.algo) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            algo_set = 1;
+        } else if (strcmp(argv[i], "--affinity") == 0 && i + 1 < argc) {
+            if (parse_affinity(argv[++i], &cfg.place.affinity) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--numa") == 0 && i + 1 < argc) {
+            if (parse_numa_policy(argv[++i], &cfg.place.numa) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--pool") == 0) {
+            cfg.place.use_pool = 1;
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = (int)strtol(argv[++i], NULL, 10);
         } else if (strcmp(argv[i], "--bench") == 0) {
             bench = 1;
+        } else if (strcmp(argv[i], "--compare") == 0) {
+            compare = 1;
         } else if (strcmp(argv[i], "--correctness") == 0) {
             correctness = 1;
+        } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            input = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "--key-bits") == 0 && i + 1 < argc) {
+            key_bits = (int)strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--in-format") == 0 && i + 1 < argc) {
+            if (driver_parse_format(argv[++i], &in_format) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--out-format") == 0 && i + 1 < argc) {
+            if (driver_parse_format(argv[++i], &out_format) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--tune") == 0) {
+            tune = 1;
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profile_arg = argv[++i];
         } else if (strcmp(argv[i], "--help") == 0) {
             usage(argv[0]);
             return 0;
@@ -224,25 +609,102 @@ int main(int argc, char **argv) {
         fprintf(stderr, "n must be non-negative\n");
         return 1;
     }
-    if (threads < 1) {
+    if (cfg.place.threads < 1) {
         fprintf(stderr, "threads must be >= 1\n");
         return 1;
     }
+    if (repeat < 1) {
+        fprintf(stderr, "repeat must be >= 1\n");
+        return 1;
+    }
+    if (key_bits != 32 && key_bits != 64) {
+        fprintf(stderr, "key-bits must be 32 or 64\n");
+        return 1;
+    }
+    if (output && !input) {
+        fprintf(stderr, "--output needs --input\n");
+        return 1;
+    }
+    if (out_format < 0) {
+        out_format = in_format;
+    }
+    if (!radix_backend_available(RADIX_BACKEND_OPENMP)) {
+        fprintf(stderr, "[OpenMP] libradix was built without -fopenmp; link lib/libradix_omp.a\n");
+        return 1;
+    }
+
+    cpu_topology topo;
+    if (topology_load(&topo) != 0) {
+        fprintf(stderr, "[OpenMP] Allocation failed for CPU topology\n");
+        return 1;
+    }
+    cfg.place.topo = &topo;
+
+    char profile_path[TUNE_PATH_MAX] = "";
+    if (profile_arg) {
+        if (strcmp(profile_arg, "none") != 0) {
+            snprintf(profile_path, sizeof(profile_path), "%s", profile_arg);
+        }
+    } else if (tune_default_path(profile_path, sizeof(profile_path)) != 0) {
+        profile_path[0] = '\0';
+    }
+    char profile_key[TUNE_KEY_MAX];
+    tune_machine_key("openmp", profile_key, sizeof(profile_key));
+    if (tune) {
+        int rc = run_tune(&cfg, seed, profile_path, profile_key);
+        if (cfg.place.use_pool) {
+            scratch_pool_trim();
+        }
+        topology_free(&topo);
+        return rc;
+    }
+    if (profile_path[0] != '\0') {
+        apply_profile(&cfg, profile_path, profile_key, algo_set, threads_set);
+    }
+
+    if (input) {
+        int rc = run_input_sort(&cfg, input, output, key_bits, in_format, out_format, verify,
+                                show_stats);
+        topology_free(&topo);
+        return rc;
+    }
 
     if (correctness) {
-        run_correctness_suite(threads, seed);
+        run_correctness_suite(&cfg, seed);
+        topology_free(&topo);
+        return 0;
+    }
+
+    if (compare) {
+        run_compare_benchmarks(&cfg, verify, seed);
+        topology_free(&topo);
         return 0;
     }
 
     if (bench) {
-        run_benchmarks(threads, verify, seed);
+        run_benchmarks(&cfg, verify, show_stats, repeat, seed);
+        if (cfg.place.use_pool) {
+            driver_print_pool_stats();
+            scratch_pool_trim();
+        }
+        topology_free(&topo);
         return 0;
     }
 
     double elapsed = 0.0;
-    int ok = run_random_case(n, threads, verify, seed, &elapsed);
-    printf("[OpenMP] Sorted %ld integers with %d threads in %.3f s.\n",
-           n, threads, elapsed);
+    sort_bandwidth stats;
+    int ok = run_random_case(n, &cfg, verify, seed, &elapsed, &stats);
+    printf("[OpenMP] Sorted %ld integers (%s) with %d threads in %.3f s.\n",
+           n, algo_name(cfg.algo), cfg.place.threads, elapsed);
+    if (show_stats) {
+        driver_print_bandwidth(&stats);
+        driver_print_alloc_stats();
+    }
+    if (cfg.place.use_pool) {
+        driver_print_pool_stats();
+        scratch_pool_trim();
+    }
+    topology_free(&topo);
     if (verify && !ok) {
         fprintf(stderr, "Verification failed.\n");
         return 1;
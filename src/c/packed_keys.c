@@ -0,0 +1,426 @@
+#ifndef _WIN32
+#define _XOPEN_SOURCE 700
+#endif
+
+#include "packed_keys.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sort_util.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define PACKED_MAGIC "RDXPACK1"
+/* Fewest blocks worth a writer thread of their own. */
+#define PACKED_MIN_THREAD_BLOCKS 256
+
+#ifndef _WIN32
+
+static uint64_t get64(const unsigned char *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i) {
+        v = v << 8 | p[i];
+    }
+    return v;
+}
+
+static uint32_t get32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void put64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; ++i) {
+        p[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+static void put32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+        p[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+/* ---- Writer ------------------------------------------------------------ */
+
+/* A slice of blocks, copied and packed in place in its own buffer. */
+typedef struct {
+    const char *keys;
+    long first_block;
+    long blocks;
+    long n;
+    int key_bits;
+    key_block *index;        /* this slice's entries of the file index */
+    char *packed;
+    size_t bytes;
+} packed_slice;
+
+static void *encode_slice(void *arg) {
+    packed_slice *s = (packed_slice *)arg;
+    int kb = s->key_bits / 8;
+    size_t raw = (size_t)s->n * kb;
+    s->packed = (char *)malloc(raw > 0 ? raw : 1);
+    if (!s->packed) {
+        return NULL;
+    }
+    memcpy(s->packed, s->keys + (size_t)s->first_block * KEY_BLOCK_KEYS * kb, raw);
+    s->bytes = key_codec_encode(s->packed, s->n, s->key_bits, s->index);
+    return NULL;
+}
+
+int packed_write(const char *path, const void *keys, long n, int key_bits, int threads,
+                 size_t *bytes) {
+    if (key_bits != 32 && key_bits != 64) {
+        errno = EINVAL;
+        return -1;
+    }
+    long blocks = key_codec_blocks(n);
+    long parts = blocks / PACKED_MIN_THREAD_BLOCKS;
+    parts = parts < threads ? parts : threads;
+    parts = parts > 1 ? parts : 1;
+    key_block *index = (key_block *)malloc(sizeof(key_block) * (size_t)(blocks > 0 ? blocks : 1));
+    packed_slice *slices = (packed_slice *)calloc((size_t)parts, sizeof(packed_slice));
+    unsigned char *entries =
+        (unsigned char *)malloc((size_t)PACKED_INDEX_ENTRY_BYTES * (size_t)(blocks > 0 ? blocks : 1));
+    int rc = -1;
+    int fd = -1;
+    if (!index || !slices || !entries) {
+        errno = ENOMEM;
+        goto done;
+    }
+
+    for (long t = 0; t < parts; ++t) {
+        packed_slice *s = &slices[t];
+        s->keys = (const char *)keys;
+        s->first_block = blocks * t / parts;
+        s->blocks = blocks * (t + 1) / parts - s->first_block;
+        long first_key = s->first_block * KEY_BLOCK_KEYS;
+        long last_key = (s->first_block + s->blocks) * KEY_BLOCK_KEYS;
+        s->n = (last_key < n ? last_key : n) - first_key;
+        s->key_bits = key_bits;
+        s->index = &index[s->first_block];
+    }
+    sort_run_slices(encode_slice, slices, sizeof(packed_slice), (int)parts);
+    for (long t = 0; t < parts; ++t) {
+        if (!slices[t].packed) {
+            errno = ENOMEM;
+            goto done;
+        }
+    }
+
+    /* Slice offsets become file-wide ones, counted from the end of the header. */
+    uint64_t data_bytes = 0;
+    for (long t = 0; t < parts; ++t) {
+        for (long b = 0; b < slices[t].blocks; ++b) {
+            slices[t].index[b].offset += data_bytes;
+        }
+        data_bytes += slices[t].bytes;
+    }
+    for (long b = 0; b < blocks; ++b) {
+        unsigned char *e = entries + (size_t)b * PACKED_INDEX_ENTRY_BYTES;
+        put64(e, index[b].first);
+        put64(e + 8, index[b].base);
+        put64(e + 16, index[b].offset);
+        put32(e + 24, index[b].keys);
+        put32(e + 28, index[b].width);
+    }
+    unsigned char header[PACKED_HEADER_BYTES];
+    memset(header, 0, sizeof(header));
+    memcpy(header, PACKED_MAGIC, 8);
+    put32(header + 8, (uint32_t)key_bits);
+    put32(header + 12, KEY_BLOCK_KEYS);
+    put64(header + 16, (uint64_t)n);
+    put64(header + 24, (uint64_t)blocks);
+    put64(header + 32, PACKED_HEADER_BYTES + data_bytes);
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || sort_write_all(fd, header, sizeof(header)) != 0) {
+        goto done;
+    }
+    for (long t = 0; t < parts; ++t) {
+        if (sort_write_all(fd, slices[t].packed, slices[t].bytes) != 0) {
+            goto done;
+        }
+    }
+    if (sort_write_all(fd, entries, (size_t)PACKED_INDEX_ENTRY_BYTES * blocks) != 0) {
+        goto done;
+    }
+    if (bytes) {
+        *bytes = PACKED_HEADER_BYTES + data_bytes + (size_t)PACKED_INDEX_ENTRY_BYTES * blocks;
+    }
+    rc = 0;
+
+done:;
+    int saved = errno;
+    if (fd >= 0 && close(fd) != 0 && rc == 0) {
+        rc = -1;
+        saved = errno;
+    }
+    if (slices) {
+        for (long t = 0; t < parts; ++t) {
+            free(slices[t].packed);
+        }
+    }
+    free(index);
+    free(slices);
+    free(entries);
+    errno = saved;
+    return rc;
+}
+
+/* ---- Reader ------------------------------------------------------------ */
+
+int packed_open(packed_reader *r, const char *path) {
+    memset(r, 0, sizeof(*r));
+    r->cached_block = -1;
+    r->fd = open(path, O_RDONLY);
+    if (r->fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    unsigned char header[PACKED_HEADER_BYTES];
+    if (fstat(r->fd, &st) != 0) {
+        goto fail;
+    }
+    if ((uint64_t)st.st_size < sizeof(header)) {
+        errno = EINVAL;
+        goto fail;
+    }
+    if (sort_read_full(r->fd, header, sizeof(header), 0) != 0) {
+        goto fail;
+    }
+    uint64_t keys = get64(header + 16);
+    uint64_t blocks = get64(header + 24);
+    uint64_t index_off = get64(header + 32);
+    r->key_bits = (int)get32(header + 8);
+    if (memcmp(header, PACKED_MAGIC, 8) != 0 || (r->key_bits != 32 && r->key_bits != 64) ||
+        get32(header + 12) != KEY_BLOCK_KEYS || blocks != (keys + KEY_BLOCK_KEYS - 1) / KEY_BLOCK_KEYS ||
+        index_off < PACKED_HEADER_BYTES || index_off > (uint64_t)st.st_size ||
+        ((uint64_t)st.st_size - index_off) / PACKED_INDEX_ENTRY_BYTES != blocks ||
+        ((uint64_t)st.st_size - index_off) % PACKED_INDEX_ENTRY_BYTES != 0) {
+        errno = EINVAL;
+        goto fail;
+    }
+    r->keys = (long)keys;
+    r->blocks = (long)blocks;
+
+    size_t entry_bytes = (size_t)PACKED_INDEX_ENTRY_BYTES * r->blocks;
+    unsigned char *entries = (unsigned char *)malloc(entry_bytes > 0 ? entry_bytes : 1);
+    r->index = (key_block *)malloc(sizeof(key_block) * (size_t)(r->blocks > 0 ? r->blocks : 1));
+    r->packed = (char *)malloc((size_t)KEY_BLOCK_KEYS * 8 + KEY_CODEC_PAD);
+    r->cache = (uint64_t *)malloc(sizeof(uint64_t) * KEY_BLOCK_KEYS);
+    if (!entries || !r->index || !r->packed || !r->cache) {
+        free(entries);
+        errno = ENOMEM;
+        goto fail;
+    }
+    if (sort_read_full(r->fd, entries, entry_bytes, (off_t)index_off) != 0) {
+        free(entries);
+        goto fail;
+    }
+    uint64_t data_bytes = index_off - PACKED_HEADER_BYTES;
+    for (long b = 0; b < r->blocks; ++b) {
+        const unsigned char *e = entries + (size_t)b * PACKED_INDEX_ENTRY_BYTES;
+        key_block *blk = &r->index[b];
+        blk->first = get64(e);
+        blk->base = get64(e + 8);
+        blk->offset = get64(e + 16);
+        blk->keys = get32(e + 24);
+        blk->width = get32(e + 28);
+        uint32_t want = b + 1 < r->blocks ? KEY_BLOCK_KEYS
+                                          : (uint32_t)(r->keys - b * KEY_BLOCK_KEYS);
+        if (blk->keys != want || blk->width > (uint32_t)r->key_bits ||
+            blk->offset > data_bytes || key_block_bytes(blk) > data_bytes - blk->offset) {
+            free(entries);
+            errno = EINVAL;
+            goto fail;
+        }
+    }
+    free(entries);
+    return 0;
+
+fail:;
+    int saved = errno;
+    packed_close(r);
+    errno = saved;
+    return -1;
+}
+
+void packed_close(packed_reader *r) {
+    if (r->fd >= 0) {
+        close(r->fd);
+    }
+    free(r->index);
+    free(r->packed);
+    free(r->cache);
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+    r->cached_block = -1;
+}
+
+/* Leaves the keys of block b in r->cache. */
+static int load_block(packed_reader *r, long b) {
+    if (r->cached_block == b) {
+        return 0;
+    }
+    const key_block *blk = &r->index[b];
+    r->cached_block = -1;
+    if (sort_read_full(r->fd, r->packed, key_block_bytes(blk),
+                  (off_t)(PACKED_HEADER_BYTES + blk->offset)) != 0) {
+        return -1;
+    }
+    if (r->key_bits == 64) {
+        key_block_decode(r->packed, blk, 64, r->cache);
+    } else {
+        uint32_t keys[KEY_BLOCK_KEYS];
+        key_block_decode(r->packed, blk, 32, keys);
+        for (uint32_t i = 0; i < blk->keys; ++i) {
+            r->cache[i] = keys[i];
+        }
+    }
+    r->cached_block = b;
+    r->blocks_read++;
+    return 0;
+}
+
+int packed_lower_bound(packed_reader *r, uint64_t key, long *pos) {
+    if (r->blocks == 0) {
+        *pos = 0;
+        return 0;
+    }
+    long b = key_codec_find_block(r->index, r->blocks, key);
+    if (load_block(r, b) != 0) {
+        return -1;
+    }
+    long lo = 0;
+    long hi = r->index[b].keys;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (r->cache[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *pos = b * KEY_BLOCK_KEYS + lo;
+    return 0;
+}
+
+int packed_key_at(packed_reader *r, long pos, uint64_t *key) {
+    if (pos < 0 || pos >= r->keys) {
+        errno = EINVAL;
+        return -1;
+    }
+    long b = pos / KEY_BLOCK_KEYS;
+    if (pos % KEY_BLOCK_KEYS == 0) {
+        *key = r->index[b].first;
+        return 0;
+    }
+    if (load_block(r, b) != 0) {
+        return -1;
+    }
+    *key = r->cache[pos % KEY_BLOCK_KEYS];
+    return 0;
+}
+
+int packed_range_init(packed_range *it, packed_reader *r, uint64_t lo, uint64_t hi) {
+    it->reader = r;
+    it->pos = 0;
+    it->end = 0;
+    if (lo > hi) {
+        return 0;
+    }
+    if (packed_lower_bound(r, lo, &it->pos) != 0) {
+        return -1;
+    }
+    if (hi == UINT64_MAX) {
+        it->end = r->keys;
+        return 0;
+    }
+    return packed_lower_bound(r, hi + 1, &it->end);
+}
+
+long packed_range_next(packed_range *it, uint64_t *out, long max) {
+    packed_reader *r = it->reader;
+    long got = 0;
+    while (got < max && it->pos < it->end) {
+        long b = it->pos / KEY_BLOCK_KEYS;
+        if (load_block(r, b) != 0) {
+            return -1;
+        }
+        long i = it->pos - b * KEY_BLOCK_KEYS;
+        long take = (long)r->index[b].keys - i;
+        take = take < it->end - it->pos ? take : it->end - it->pos;
+        take = take < max - got ? take : max - got;
+        memcpy(out + got, r->cache + i, sizeof(uint64_t) * (size_t)take);
+        got += take;
+        it->pos += take;
+    }
+    return got;
+}
+
+#else
+
+int packed_write(const char *path, const void *keys, long n, int key_bits, int threads,
+                 size_t *bytes) {
+    (void)path;
+    (void)keys;
+    (void)n;
+    (void)key_bits;
+    (void)threads;
+    (void)bytes;
+    errno = ENOSYS;
+    return -1;
+}
+
+int packed_open(packed_reader *r, const char *path) {
+    (void)path;
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+    errno = ENOSYS;
+    return -1;
+}
+
+void packed_close(packed_reader *r) {
+    (void)r;
+}
+
+int packed_lower_bound(packed_reader *r, uint64_t key, long *pos) {
+    (void)r;
+    (void)key;
+    (void)pos;
+    errno = ENOSYS;
+    return -1;
+}
+
+int packed_key_at(packed_reader *r, long pos, uint64_t *key) {
+    (void)r;
+    (void)pos;
+    (void)key;
+    errno = ENOSYS;
+    return -1;
+}
+
+int packed_range_init(packed_range *it, packed_reader *r, uint64_t lo, uint64_t hi) {
+    (void)it;
+    (void)r;
+    (void)lo;
+    (void)hi;
+    errno = ENOSYS;
+    return -1;
+}
+
+long packed_range_next(packed_range *it, uint64_t *out, long max) {
+    (void)it;
+    (void)out;
+    (void)max;
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif
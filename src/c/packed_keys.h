@@ -0,0 +1,73 @@
+#ifndef PACKED_KEYS_H
+#define PACKED_KEYS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "key_codec.h"
+
+/* Packed sorted key files for --out-format packed, and a reader for
+   point and range lookups on them.
+
+   A packed file is a 64-byte header, the sorted keys as key_codec blocks
+   back to back, and the block index: the first key, packing parameters
+   and byte offset of every block, 32 bytes per 1024 keys. All fields are
+   little-endian:
+
+     0   magic "RDXPACK1"       24  u64 block count
+     8   u32 key bits (32, 64)  32  u64 index offset
+     12  u32 keys per block     40  reserved, zero up to 64
+     16  u64 key count
+
+   Index entries are u64 first key, u64 gap base, u64 block offset from
+   the end of the header, u32 key count and u32 bit width. The writer
+   encodes slices of blocks on several threads. The reader keeps only the
+   header and the index in memory and reads and decodes just the blocks a
+   lookup lands in. A reader is not safe to share between threads.
+   Functions return 0 on success and -1 with errno set; EINVAL marks a
+   file that is not a well-formed packed file. */
+
+#define PACKED_HEADER_BYTES 64
+#define PACKED_INDEX_ENTRY_BYTES 32
+
+/* Writes sorted keys[0, n) to path, leaving keys unchanged. *bytes gets
+   the file size when not NULL. */
+int packed_write(const char *path, const void *keys, long n, int key_bits, int threads,
+                 size_t *bytes);
+
+typedef struct {
+    int fd;
+    int key_bits;
+    long keys;
+    long blocks;
+    key_block *index;
+    char *packed;            /* payload of the block being decoded */
+    uint64_t *cache;         /* keys of the last decoded block */
+    long cached_block;       /* -1 if none */
+    long blocks_read;        /* blocks read and decoded so far */
+} packed_reader;
+
+int packed_open(packed_reader *r, const char *path);
+
+void packed_close(packed_reader *r);
+
+/* Position of the first key >= key, from 0 to r->keys. */
+int packed_lower_bound(packed_reader *r, uint64_t key, long *pos);
+
+/* The key at position pos < r->keys. */
+int packed_key_at(packed_reader *r, long pos, uint64_t *key);
+
+/* Keys in [lo, hi], both inclusive, in ascending order. */
+typedef struct {
+    packed_reader *reader;
+    long pos;
+    long end;
+} packed_range;
+
+int packed_range_init(packed_range *it, packed_reader *r, uint64_t lo, uint64_t hi);
+
+/* Copies up to max further keys of the range to out; returns how many, 0
+   at the end of the range and -1 on a read error. */
+long packed_range_next(packed_range *it, uint64_t *out, long max);
+
+#endif
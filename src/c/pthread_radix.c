@@ -2,164 +2,375 @@
 #define _XOPEN_SOURCE 700
 #endif
 
+#include <errno.h>
+#include <limits.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
+#include "arrow_sort.h"
+#include "ext_sort.h"
+#include "io_engine.h"
+#include "key_file.h"
+#include "libradix.h"
+#include "numa_place.h"
+#include "packed_keys.h"
+#include "radix_ctx.h"
+#include "record_sort.h"
+#include "scratch_pool.h"
+#include "sort_driver.h"
+#include "sort_plan.h"
+#include "sort_util.h"
+#include "stream_sort.h"
+#include "tune_profile.h"
+#include "work_steal.h"
+
 #ifdef _WIN32
 #include <windows.h>
 #else
-#include <sys/time.h>
 #include <unistd.h>
 #endif
 
 #define RADIX_BITS 8
 #define RADIX (1 << RADIX_BITS)
+#define RADIX_PASSES (32 / RADIX_BITS)
+#define ALL_DIGITS ((1u << RADIX_PASSES) - 1)   /* digit_mask bit d sorts bits 8d..8d+7 */
+
+/* Onesweep tiles: each tile publishes its bucket counts once per pass. */
+#define ONESWEEP_TILE 4096
+#define LOOKBACK_FLAG_SHIFT 62
+#define LOOKBACK_VALUE_MASK ((1ull << LOOKBACK_FLAG_SHIFT) - 1)
+#define LOOKBACK_NOT_READY 0ull
+#define LOOKBACK_AGGREGATE 1ull
+#define LOOKBACK_INCLUSIVE 2ull
+
+/* MSD / bucket modes: buckets at or below this size use insertion sort. */
+#define MSD_INSERTION_CUTOFF 64
+/* MSD mode: smaller buckets are recursed inline instead of spawned. This and
+   libradix's minimum keys per thread are defaults; a --tune profile may
+   override both. */
+#define MSD_TASK_GRAIN 16384
+#define TOP_SHIFT (32 - RADIX_BITS)
+
+/* Bucket mode: a top-digit bucket holding more than 1/BUCKET_SKEW_SHARE of
+   the keys would leave one worker sorting it alone, so it goes through the
+   barrier-synchronised LSD passes on every thread instead. */
+#define BUCKET_SKEW_SHARE 2
+
+/* --tune: keys per calibration sort, and runs per setting (the fastest counts). */
+#define TUNE_N 4000000
+#define TUNE_REPS 3
+
+enum { ALGO_LSD, ALGO_ONESWEEP, ALGO_BUCKET, ALGO_MSD, ALGO_CTX, ALGO_AUTO };
+
+/* Generated inputs: uniform in [0, 1e9), narrow in [0, 50000), already
+   ascending, or 16 interleaved ascending runs. */
+enum { DIST_UNIFORM, DIST_NARROW, DIST_SORTED, DIST_RUNS };
+
+typedef struct {
+    sort_placement place;        /* threads, pinning, NUMA policy, pool, min chunk */
+    int algo;
+    radix_ctx *ctx;              /* reusable context for ALGO_CTX */
+    long task_grain;             /* smallest MSD bucket that is spawned (MSD_TASK_GRAIN) */
+    int dist;                    /* DIST_* for generated inputs */
+    int cpus;                    /* usable CPUs, bounds the planner's parallelism */
+} sort_config;
+
+/* Per-sort instrumentation; scheduler counters are printed with --stats. */
+typedef struct {
+    int workers;                 /* scheduler workers; 0 if no scheduler ran */
+    unsigned long tasks;
+    unsigned long steals;
+    unsigned long failed_steals;
+    double idle_time;            /* summed over workers */
+    double max_idle_time;
+    sort_bandwidth bw;
+    int planned;                 /* 1 if --algo auto ran a plan */
+    sort_plan plan;
+    double plan_analysis;        /* seconds spent analysing the input */
+    double plan_actual;          /* analysis plus the chosen kernel */
+} sort_stats;
 
 typedef struct {
     int tid;
     int threads;
     long n;
+    long tiles;
     int *arr;
     int *tmp;
-    int *counts;
+    atomic_long *digit_hist;       /* RADIX_PASSES * RADIX global counts */
+    atomic_ullong *status[2];      /* tiles * RADIX look-back words, ping-ponged per pass */
+    atomic_long *next_tile;        /* one tile ticket counter per pass */
+    int cpu;
+    int first_touch;
+    double bytes;
+    double elapsed;
+    int ran_on;
     pthread_barrier_t *barrier;
-} worker_ctx;
-
-static unsigned int lcg_next(unsigned int *state) {
-    *state = 1664525u * (*state) + 1013904223u;
-    return *state;
-}
+} onesweep_ctx;
 
-static void fill_random(int *dst, long n, unsigned int seed) {
+static void fill_input(int *dst, long n, unsigned int seed, int dist) {
     unsigned int state = seed ? seed : 1u;
-    for (long i = 0; i < n; ++i) {
-        dst[i] = (int)(lcg_next(&state) % 1000000000u);
+    if (dist == DIST_NARROW) {
+        for (long i = 0; i < n; ++i) {
+            dst[i] = (int)(radix_lcg_next(&state) % 50000u);
+        }
+    } else if (dist == DIST_SORTED) {
+        for (long i = 0; i < n; ++i) {
+            dst[i] = (int)(i * (1000000000L / (n > 0 ? n : 1)));
+        }
+    } else if (dist == DIST_RUNS) {
+        long run = (n + 15) / 16;
+        unsigned int v = 0;
+        for (long i = 0; i < n; ++i) {
+            v = i % run == 0 ? radix_lcg_next(&state) % 1000u : v + radix_lcg_next(&state) % 64u;
+            dst[i] = (int)v;
+        }
+    } else {
+        radix_fill_random(dst, n, seed);
     }
 }
 
-static int verify_sorted(const int *arr, long n) {
-    for (long i = 1; i < n; ++i) {
-        if (arr[i - 1] > arr[i]) {
+static int parse_dist(const char *name, int *dist) {
+    static const char *names[] = {"uniform", "narrow", "sorted", "runs"};
+    for (int d = 0; d < (int)(sizeof(names) / sizeof(names[0])); ++d) {
+        if (strcmp(name, names[d]) == 0) {
+            *dist = d;
             return 0;
         }
     }
-    return 1;
+    return -1;
 }
 
-static int cmp_int(const void *a, const void *b) {
-    int ia = *(const int *)a;
-    int ib = *(const int *)b;
-    return (ia > ib) - (ia < ib);
+/* --records: RECORD_LINES or RECORD_PREFIXED, in that order. */
+static int parse_framing(const char *name, int *framing) {
+    static const char *names[] = {"lines", "prefixed"};
+    for (int f = 0; f < (int)(sizeof(names) / sizeof(names[0])); ++f) {
+        if (strcmp(name, names[f]) == 0) {
+            *framing = f;
+            return 0;
+        }
+    }
+    return -1;
 }
 
-#ifdef _WIN32
-static double wall_time(void) {
-    static LARGE_INTEGER freq;
-    static int initialized = 0;
-    if (!initialized) {
-        QueryPerformanceFrequency(&freq);
-        initialized = 1;
+/* --io: IO_AUTO, IO_URING or IO_THREADS, in that order. */
+static int parse_io_kind(const char *name, int *kind) {
+    static const char *names[] = {"auto", "uring", "threads"};
+    for (int k = 0; k < (int)(sizeof(names) / sizeof(names[0])); ++k) {
+        if (strcmp(name, names[k]) == 0) {
+            *kind = k;
+            return 0;
+        }
     }
-    LARGE_INTEGER now;
-    QueryPerformanceCounter(&now);
-    return (double)now.QuadPart / (double)freq.QuadPart;
+    return -1;
 }
 
+#ifdef _WIN32
 static int default_thread_count(void) {
     SYSTEM_INFO info;
     GetSystemInfo(&info);
     return (int)(info.dwNumberOfProcessors ? info.dwNumberOfProcessors : 4);
 }
 #else
-static double wall_time(void) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+/* Honours the affinity mask and the cgroup CPU quota, so a container
+   limited to a few CPUs on a large host does not oversubscribe them. */
+static int default_thread_count(void) {
+    return radix_usable_cpus();
 }
+#endif
 
-static int default_thread_count(void) {
-    long nprocs = sysconf(_SC_NPROCESSORS_ONLN);
-    if (nprocs < 1) {
-        nprocs = 4;
+/* --algo lsd: the libradix kernel on the pthreads backend, over the digits
+   in digit_mask (ALL_DIGITS, or the ones --algo auto found to vary). */
+static double radix_sort_pthreads(int *arr,
+                                  long n,
+                                  const sort_config *cfg,
+                                  unsigned int digit_mask,
+                                  sort_stats *stats) {
+    return driver_radix_sort(&cfg->place, RADIX_BACKEND_PTHREADS, arr, n, 32, digit_mask, NULL,
+                             stats ? &stats->bw : NULL);
+}
+
+/* 64-bit keys from --input --key-bits 64; every --algo uses this kernel. */
+static double radix_sort_pthreads64(uint64_t *arr, long n, const sort_config *cfg) {
+    return driver_radix_sort(&cfg->place, RADIX_BACKEND_PTHREADS, arr, n, 64, 0, NULL, NULL);
+}
+
+/* Sums the bucket counts of all tiles before `tile` for one digit by walking
+   backwards over the published descriptors until an inclusive prefix is found. */
+static long onesweep_lookback(atomic_ullong *status, long tile, unsigned int digit) {
+    long exclusive = 0;
+    long prev = tile - 1;
+    while (prev >= 0) {
+        unsigned long long word =
+            atomic_load_explicit(&status[prev * RADIX + digit], memory_order_acquire);
+        unsigned long long flag = word >> LOOKBACK_FLAG_SHIFT;
+        if (flag == LOOKBACK_NOT_READY) {
+            sched_yield();
+            continue;
+        }
+        exclusive += (long)(word & LOOKBACK_VALUE_MASK);
+        if (flag == LOOKBACK_INCLUSIVE) {
+            break;
+        }
+        --prev;
     }
-    return (int)nprocs;
+    return exclusive;
 }
-#endif
 
-static void *radix_worker(void *arg) {
-    worker_ctx *ctx = (worker_ctx *)arg;
-    long chunk = (ctx->n + ctx->threads - 1) / ctx->threads;
+static void *onesweep_worker(void *arg) {
+    onesweep_ctx *ctx = (onesweep_ctx *)arg;
+    if (ctx->cpu >= 0) {
+        pin_to_cpu(ctx->cpu);
+    }
+    double t0 = sort_wall_time();
+    long moved = 0;
+    long start, end;
+    radix_worker_slice(ctx->n, ctx->threads, ctx->tid, &start, &end);
+
+    /* In onesweep, tiles land anywhere, so first-touch can only spread the
+       pages of tmp evenly; each thread faults in its static slice. */
+    if (ctx->first_touch && end > start) {
+        touch_pages(ctx->tmp + start, sizeof(int) * (end - start));
+    }
 
-    for (int shift = 0; shift < 32; shift += RADIX_BITS) {
-        long start = ctx->tid * chunk;
-        long end = start + chunk;
-        if (start > ctx->n) {
-            start = ctx->n;
+    /* Single upfront pass: histograms for every digit at once. */
+    long local_hist[RADIX_PASSES][RADIX];
+    memset(local_hist, 0, sizeof(local_hist));
+    for (long i = start; i < end; ++i) {
+        unsigned int key = (unsigned int)ctx->arr[i];
+        for (int p = 0; p < RADIX_PASSES; ++p) {
+            local_hist[p][(key >> (p * RADIX_BITS)) & (RADIX - 1)]++;
         }
-        if (end > ctx->n) {
-            end = ctx->n;
+    }
+    for (int p = 0; p < RADIX_PASSES; ++p) {
+        for (int digit = 0; digit < RADIX; ++digit) {
+            if (local_hist[p][digit]) {
+                atomic_fetch_add_explicit(&ctx->digit_hist[p * RADIX + digit],
+                                          local_hist[p][digit],
+                                          memory_order_relaxed);
+            }
         }
+    }
+
+    /* Zero this thread's share of both look-back buffers. */
+    long words = ctx->tiles * RADIX;
+    long wchunk = (words + ctx->threads - 1) / ctx->threads;
+    long wstart = ctx->tid * wchunk < words ? ctx->tid * wchunk : words;
+    long wend = wstart + wchunk < words ? wstart + wchunk : words;
+    for (long w = wstart; w < wend; ++w) {
+        atomic_init(&ctx->status[0][w], 0);
+        atomic_init(&ctx->status[1][w], 0);
+    }
+
+    pthread_barrier_wait(ctx->barrier);
 
-        int *local_counts = ctx->counts + ctx->tid * RADIX;
-        memset(local_counts, 0, sizeof(int) * RADIX);
-        for (long i = start; i < end; ++i) {
-            unsigned int digit = ((unsigned int)ctx->arr[i] >> shift) & (RADIX - 1);
-            local_counts[digit]++;
+    /* Every thread derives the bucket bases itself; no serial prefix step. */
+    long bucket_base[RADIX_PASSES][RADIX];
+    for (int p = 0; p < RADIX_PASSES; ++p) {
+        long total = 0;
+        for (int digit = 0; digit < RADIX; ++digit) {
+            bucket_base[p][digit] = total;
+            total += atomic_load_explicit(&ctx->digit_hist[p * RADIX + digit],
+                                          memory_order_relaxed);
         }
+    }
 
-        pthread_barrier_wait(ctx->barrier);
+    int *src = ctx->arr;
+    int *dst = ctx->tmp;
+    for (int p = 0; p < RADIX_PASSES; ++p) {
+        int shift = p * RADIX_BITS;
+        atomic_ullong *status = ctx->status[p & 1];
 
-        if (ctx->tid == 0) {
-            int total = 0;
-            for (int digit = 0; digit < RADIX; ++digit) {
-                for (int t = 0; t < ctx->threads; ++t) {
-                    int idx = t * RADIX + digit;
-                    int c = ctx->counts[idx];
-                    ctx->counts[idx] = total;
-                    total += c;
-                }
+        /* The other buffer was last read in pass p - 1, which has completed. */
+        if (p >= 1 && p + 1 < RADIX_PASSES) {
+            atomic_ullong *next = ctx->status[(p + 1) & 1];
+            for (long w = wstart; w < wend; ++w) {
+                atomic_store_explicit(&next[w], 0, memory_order_relaxed);
             }
         }
 
-        pthread_barrier_wait(ctx->barrier);
+        for (;;) {
+            long tile = atomic_fetch_add_explicit(&ctx->next_tile[p], 1, memory_order_relaxed);
+            if (tile >= ctx->tiles) {
+                break;
+            }
+            long tstart = tile * ONESWEEP_TILE;
+            long tend = tstart + ONESWEEP_TILE < ctx->n ? tstart + ONESWEEP_TILE : ctx->n;
 
-        for (long i = end; i-- > start;) {
-            unsigned int digit = ((unsigned int)ctx->arr[i] >> shift) & (RADIX - 1);
-            int pos = ctx->counts[ctx->tid * RADIX + digit]++;
-            ctx->tmp[pos] = ctx->arr[i];
-        }
+            long tile_counts[RADIX];
+            memset(tile_counts, 0, sizeof(tile_counts));
+            for (long i = tstart; i < tend; ++i) {
+                tile_counts[((unsigned int)src[i] >> shift) & (RADIX - 1)]++;
+            }
 
-        pthread_barrier_wait(ctx->barrier);
+            atomic_ullong *desc = status + tile * RADIX;
+            unsigned long long publish_flag = tile == 0 ? LOOKBACK_INCLUSIVE : LOOKBACK_AGGREGATE;
+            for (int digit = 0; digit < RADIX; ++digit) {
+                atomic_store_explicit(&desc[digit],
+                                      (publish_flag << LOOKBACK_FLAG_SHIFT) |
+                                          (unsigned long long)tile_counts[digit],
+                                      memory_order_release);
+            }
+
+            long offsets[RADIX];
+            for (int digit = 0; digit < RADIX; ++digit) {
+                long exclusive = 0;
+                if (tile > 0) {
+                    exclusive = onesweep_lookback(status, tile, (unsigned int)digit);
+                    atomic_store_explicit(&desc[digit],
+                                          (LOOKBACK_INCLUSIVE << LOOKBACK_FLAG_SHIFT) |
+                                              (unsigned long long)(exclusive + tile_counts[digit]),
+                                          memory_order_release);
+                }
+                offsets[digit] = bucket_base[p][digit] + exclusive;
+            }
 
-        for (long i = start; i < end; ++i) {
-            ctx->arr[i] = ctx->tmp[i];
+            for (long i = tstart; i < tend; ++i) {
+                unsigned int digit = ((unsigned int)src[i] >> shift) & (RADIX - 1);
+                dst[offsets[digit]++] = src[i];
+            }
+            moved += tend - tstart;
         }
 
+        /* Pass boundary: the next pass reads tiles written by any thread. */
         pthread_barrier_wait(ctx->barrier);
+
+        int *swap = src;
+        src = dst;
+        dst = swap;
     }
 
+    /* Histogram read, then per pass a count read, scatter read and write. */
+    ctx->bytes = (double)sizeof(int) * ((double)(end - start) + 3.0 * (double)moved);
+    ctx->elapsed = sort_wall_time() - t0;
+    ctx->ran_on = ctx->cpu >= 0 ? ctx->cpu : current_cpu();
     return NULL;
 }
 
-static double radix_sort_pthreads(int *arr, long n, int threads) {
+/* Onesweep-style LSD: one histogram pass, then per pass tiles are claimed in
+   order and resolve their output offsets via decoupled look-back. RADIX_PASSES
+   is even, so the data ends up back in arr without a copy pass. */
+static double radix_sort_onesweep(int *arr, long n, const sort_config *cfg, sort_stats *stats) {
     if (n <= 1) {
         return 0.0;
     }
-    if (threads < 1) {
-        threads = 1;
-    }
-    if (threads > n && n > 0) {
-        threads = (int)n;
-    }
+    int threads = driver_threads(&cfg->place, n);
 
-    int *tmp = (int *)malloc(sizeof(int) * n);
-    int *counts = (int *)malloc(sizeof(int) * RADIX * threads);
+    long tiles = (n + ONESWEEP_TILE - 1) / ONESWEEP_TILE;
+    int *tmp = (int *)driver_scratch_alloc(&cfg->place, n, sizeof(int), threads);
+    atomic_long *digit_hist = (atomic_long *)calloc(RADIX_PASSES * RADIX, sizeof(atomic_long));
+    atomic_long *next_tile = (atomic_long *)calloc(RADIX_PASSES, sizeof(atomic_long));
+    atomic_ullong *status0 = (atomic_ullong *)malloc(sizeof(atomic_ullong) * tiles * RADIX);
+    atomic_ullong *status1 = (atomic_ullong *)malloc(sizeof(atomic_ullong) * tiles * RADIX);
     pthread_t *tids = (pthread_t *)malloc(sizeof(pthread_t) * threads);
-    worker_ctx *ctx = (worker_ctx *)malloc(sizeof(worker_ctx) * threads);
-    if (!tmp || !counts || !tids || !ctx) {
+    onesweep_ctx *ctx = (onesweep_ctx *)malloc(sizeof(onesweep_ctx) * threads);
+    if (!tmp || !digit_hist || !next_tile || !status0 || !status1 || !tids || !ctx) {
         fprintf(stderr, "[pthread] Allocation failed\n");
         exit(1);
     }
@@ -170,16 +381,22 @@ static double radix_sort_pthreads(int *arr, long n, int threads) {
         exit(1);
     }
 
-    double t0 = wall_time();
+    double t0 = sort_wall_time();
     for (int t = 0; t < threads; ++t) {
         ctx[t].tid = t;
         ctx[t].threads = threads;
         ctx[t].n = n;
+        ctx[t].tiles = tiles;
         ctx[t].arr = arr;
         ctx[t].tmp = tmp;
-        ctx[t].counts = counts;
+        ctx[t].digit_hist = digit_hist;
+        ctx[t].status[0] = status0;
+        ctx[t].status[1] = status1;
+        ctx[t].next_tile = next_tile;
+        ctx[t].cpu = topology_worker_cpu(cfg->place.topo, cfg->place.affinity, t);
+        ctx[t].first_touch = cfg->place.numa == NUMA_FIRST_TOUCH && !cfg->place.use_pool;
         ctx[t].barrier = &barrier;
-        if (pthread_create(&tids[t], NULL, radix_worker, &ctx[t]) != 0) {
+        if (pthread_create(&tids[t], NULL, onesweep_worker, &ctx[t]) != 0) {
             fprintf(stderr, "[pthread] Failed to create thread %d\n", t);
             exit(1);
         }
@@ -188,103 +405,1586 @@ static double radix_sort_pthreads(int *arr, long n, int threads) {
     for (int t = 0; t < threads; ++t) {
         pthread_join(tids[t], NULL);
     }
-    double t1 = wall_time();
+    double t1 = sort_wall_time();
+    for (int t = 0; t < threads; ++t) {
+        driver_record_bandwidth(stats ? &stats->bw : NULL, cfg->place.topo, ctx[t].ran_on,
+                                ctx[t].bytes, ctx[t].elapsed);
+    }
 
     pthread_barrier_destroy(&barrier);
-    free(tmp);
-    free(counts);
+    driver_scratch_free(&cfg->place, tmp);
+    free(digit_hist);
+    free(next_tile);
+    free(status0);
+    free(status1);
     free(tids);
     free(ctx);
     return t1 - t0;
 }
 
+typedef struct {
+    int *src;
+    int *dst;
+    long n;
+    int shift;       /* highest digit still to sort */
+    int src_is_arr;  /* 1 if src is the caller's array, 0 if it is tmp */
+    long grain;      /* sub-buckets of at least this many keys are spawned */
+} bucket_task;
+
+static void insertion_sort(int *a, long n) {
+    for (long i = 1; i < n; ++i) {
+        int v = a[i];
+        unsigned int key = (unsigned int)v;
+        long j = i - 1;
+        while (j >= 0 && (unsigned int)a[j] > key) {
+            a[j + 1] = a[j];
+            --j;
+        }
+        a[j + 1] = v;
+    }
+}
+
+static void bucket_lsd_task(ws_worker *self, void *arg) {
+    (void)self;
+    bucket_task *task = (bucket_task *)arg;
+    if (task->n <= MSD_INSERTION_CUTOFF) {
+        insertion_sort(task->src, task->n);
+        return;
+    }
+    unsigned int below = (1u << ((task->shift + RADIX_BITS) / RADIX_BITS)) - 1;
+    driver_radix_sort_serial(task->src, task->n, 32, below, task->dst);
+}
+
+/* Partitions task->src on task->shift into task->dst and recurses into every
+   bucket; large buckets are spawned so idle workers can steal them. */
+static void msd_task(ws_worker *self, void *arg) {
+    bucket_task *task = (bucket_task *)arg;
+    int *src = task->src;
+    int *dst = task->dst;
+    long n = task->n;
+    int shift = task->shift;
+    int src_is_arr = task->src_is_arr;
+    long grain = task->grain;
+
+    for (;;) {
+        if (n <= MSD_INSERTION_CUTOFF || shift < 0) {
+            insertion_sort(src, n);
+            if (!src_is_arr) {
+                memcpy(dst, src, sizeof(int) * n);
+            }
+            return;
+        }
+
+        long counts[RADIX] = {0};
+        for (long i = 0; i < n; ++i) {
+            counts[((unsigned int)src[i] >> shift) & (RADIX - 1)]++;
+        }
+        /* Everything shares this digit: descend without moving data. */
+        unsigned int first = ((unsigned int)src[0] >> shift) & (RADIX - 1);
+        if (counts[first] != n) {
+            break;
+        }
+        shift -= RADIX_BITS;
+    }
+
+    long counts[RADIX] = {0};
+    for (long i = 0; i < n; ++i) {
+        counts[((unsigned int)src[i] >> shift) & (RADIX - 1)]++;
+    }
+    long offsets[RADIX];
+    long total = 0;
+    for (int digit = 0; digit < RADIX; ++digit) {
+        offsets[digit] = total;
+        total += counts[digit];
+    }
+    for (long i = 0; i < n; ++i) {
+        unsigned int digit = ((unsigned int)src[i] >> shift) & (RADIX - 1);
+        dst[offsets[digit]++] = src[i];
+    }
+
+    long off = 0;
+    for (int digit = 0; digit < RADIX; ++digit) {
+        long cnt = counts[digit];
+        if (cnt > 0) {
+            bucket_task child = {dst + off, src + off, cnt, shift - RADIX_BITS, !src_is_arr, grain};
+            if (cnt >= grain) {
+                /* Out of task memory: recurse inline instead. */
+                bucket_task *spawned = (bucket_task *)ws_alloc(self, sizeof(bucket_task));
+                if (spawned) {
+                    *spawned = child;
+                }
+                if (!spawned || ws_spawn(self, msd_task, spawned) != 0) {
+                    msd_task(self, &child);
+                }
+            } else {
+                msd_task(self, &child);
+            }
+        }
+        off += cnt;
+    }
+}
+
+/* Bucket-parallel and MSD modes: the threads partition the input on the top
+   digit with one barrier-synchronised pass, then every bucket is handed to
+   the work-stealing scheduler, either as a sequential LSD job (bucket) or as
+   a recursive MSD task that spawns its large sub-buckets (msd). top_shift is
+   the partition digit; the digits above it must already be constant. */
+static double radix_sort_ws(int *arr, long n, const sort_config *cfg, int top_shift, sort_stats *stats) {
+    int algo = cfg->algo;
+    if (n <= 1) {
+        return 0.0;
+    }
+    int threads = driver_threads(&cfg->place, n);
+    sort_bandwidth *bw = stats ? &stats->bw : NULL;
+
+    int *tmp = (int *)driver_scratch_alloc(&cfg->place, n, sizeof(int), threads);
+    bucket_task *buckets = (bucket_task *)malloc(sizeof(bucket_task) * RADIX);
+    ws_sched *sched = ws_create(threads);
+    if (!tmp || !buckets || !sched) {
+        fprintf(stderr, "[pthread] Allocation failed\n");
+        exit(1);
+    }
+    driver_pinning pin;
+    memset(&pin, 0, sizeof(pin));
+    pin.pl = &cfg->place;
+    ws_set_hooks(sched, driver_pin_enter, driver_pin_leave, &pin);
+
+    double t0 = sort_wall_time();
+    driver_radix_sort(&cfg->place, RADIX_BACKEND_PTHREADS, arr, n, 32,
+                      1u << (top_shift / RADIX_BITS), tmp, bw);
+
+    long bucket_end[RADIX];
+    driver_bucket_ends(arr, n, top_shift, bucket_end);
+    long off = 0;
+    long skew_off = 0;
+    long skew_n = 0;
+    int queued = 0;
+    for (int digit = 0; digit < RADIX; ++digit) {
+        long cnt = bucket_end[digit] - off;
+        if (algo == ALGO_BUCKET && cnt > n / BUCKET_SKEW_SHARE) {
+            skew_off = off;
+            skew_n = cnt;
+        } else if (cnt > 0) {
+            buckets[digit].src = arr + off;
+            buckets[digit].dst = tmp + off;
+            buckets[digit].n = cnt;
+            buckets[digit].shift = top_shift - RADIX_BITS;
+            buckets[digit].src_is_arr = 1;
+            buckets[digit].grain = cfg->task_grain;
+            if (ws_submit(sched, algo == ALGO_MSD ? msd_task : bucket_lsd_task,
+                          &buckets[digit]) != 0) {
+                fprintf(stderr, "[pthread] Work-stealing queue allocation failed\n");
+                exit(1);
+            }
+            ++queued;
+        }
+        off = bucket_end[digit];
+    }
+    if (queued > 0 && ws_run(sched) != 0) {
+        fprintf(stderr, "[pthread] Some scheduler workers failed to start\n");
+    }
+    if (skew_n > 0) {
+        unsigned int below = (1u << (top_shift / RADIX_BITS)) - 1;
+        driver_radix_sort(&cfg->place, RADIX_BACKEND_PTHREADS, arr + skew_off, skew_n, 32, below,
+                          tmp + skew_off, bw);
+    }
+    double t1 = sort_wall_time();
+
+    if (stats) {
+        stats->workers = ws_worker_count(sched);
+        for (int w = 0; w < stats->workers; ++w) {
+            ws_stats ws;
+            ws_get_stats(sched, w, &ws);
+            stats->tasks += ws.tasks;
+            stats->steals += ws.steals;
+            stats->failed_steals += ws.failed_steals;
+            stats->idle_time += ws.idle_time;
+            if (ws.idle_time > stats->max_idle_time) {
+                stats->max_idle_time = ws.idle_time;
+            }
+        }
+    }
+
+    ws_destroy(sched);
+    driver_scratch_free(&cfg->place, tmp);
+    free(buckets);
+    return t1 - t0;
+}
+
+static int cmp_uint(const void *a, const void *b) {
+    unsigned int ua = *(const unsigned int *)a;
+    unsigned int ub = *(const unsigned int *)b;
+    return (ua > ub) - (ua < ub);
+}
+
+/* One histogram over [lo, hi], rewritten in place; the range is small. */
+static double counting_sort(int *arr, long n, unsigned int lo, unsigned int hi) {
+    double t0 = sort_wall_time();
+    size_t range = (size_t)(hi - lo) + 1;
+    long *counts = (long *)calloc(range, sizeof(long));
+    if (!counts) {
+        fprintf(stderr, "[pthread] Allocation failed\n");
+        exit(1);
+    }
+    for (long i = 0; i < n; ++i) {
+        counts[(unsigned int)arr[i] - lo]++;
+    }
+    long out = 0;
+    for (size_t v = 0; v < range; ++v) {
+        for (long c = counts[v]; c > 0; --c) {
+            arr[out++] = (int)(lo + (unsigned int)v);
+        }
+    }
+    free(counts);
+    return sort_wall_time() - t0;
+}
+
+/* Bottom-up merge of the `runs` ascending runs of arr, pairing neighbours
+   each level and ping-ponging with tmp. */
+static double run_merge_sort(int *arr, long n, long runs, const sort_config *cfg) {
+    int *tmp = (int *)driver_scratch_alloc(&cfg->place, n, sizeof(int), 1);
+    long *bounds = (long *)malloc(sizeof(long) * (size_t)(runs + 1));
+    if (!tmp || !bounds) {
+        fprintf(stderr, "[pthread] Allocation failed\n");
+        exit(1);
+    }
+
+    double t0 = sort_wall_time();
+    long found = 0;
+    bounds[found++] = 0;
+    for (long i = 1; i < n; ++i) {
+        if ((unsigned int)arr[i] < (unsigned int)arr[i - 1]) {
+            bounds[found++] = i;
+        }
+    }
+    bounds[found] = n;
+
+    int *src = arr;
+    int *dst = tmp;
+    while (found > 1) {
+        long merged = 0;
+        for (long r = 0; r < found; r += 2) {
+            long lo = bounds[r];
+            long mid = bounds[r + 1];
+            long hi = r + 2 <= found ? bounds[r + 2] : mid;
+            long i = lo;
+            long j = mid;
+            long k = lo;
+            while (i < mid && j < hi) {
+                dst[k++] = (unsigned int)src[j] < (unsigned int)src[i] ? src[j++] : src[i++];
+            }
+            while (i < mid) {
+                dst[k++] = src[i++];
+            }
+            while (j < hi) {
+                dst[k++] = src[j++];
+            }
+            bounds[merged++] = lo;
+        }
+        bounds[merged] = n;
+        found = merged;
+        int *swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != arr) {
+        memcpy(arr, src, sizeof(int) * n);
+    }
+    double t1 = sort_wall_time();
+
+    driver_scratch_free(&cfg->place, tmp);
+    free(bounds);
+    return t1 - t0;
+}
+
+/* --algo auto: analyse the input, price every strategy with the sort_plan
+   cost model and run the cheapest. The time returned covers both. */
+static double radix_sort_planned(int *arr, long n, const sort_config *cfg, sort_stats *stats) {
+    double t0 = sort_wall_time();
+    plan_input input;
+    plan_analyze(arr, n, &input);
+    sort_plan plan;
+    plan_choose(&input, driver_threads(&cfg->place, n), cfg->cpus, &plan);
+    double analysis = sort_wall_time() - t0;
+
+    double kernel = 0.0;
+    if (plan.kind == PLAN_COMPARISON) {
+        double t1 = sort_wall_time();
+        qsort(arr, (size_t)n, sizeof(int), cmp_uint);
+        kernel = sort_wall_time() - t1;
+    } else if (plan.kind == PLAN_COUNTING) {
+        kernel = counting_sort(arr, n, input.min, input.max);
+    } else if (plan.kind == PLAN_RUN_MERGE) {
+        kernel = run_merge_sort(arr, n, input.runs, cfg);
+    } else if (plan.kind == PLAN_MSD_LSD) {
+        sort_config bucket = *cfg;
+        bucket.algo = ALGO_BUCKET;
+        kernel = radix_sort_ws(arr, n, &bucket, plan.top_shift, stats);
+    } else if (plan.kind == PLAN_LSD) {
+        kernel = radix_sort_pthreads(arr, n, cfg, plan.digit_mask, stats);
+    }
+
+    if (stats) {
+        stats->planned = 1;
+        stats->plan = plan;
+        stats->plan_analysis = analysis;
+        stats->plan_actual = analysis + kernel;
+    }
+    return analysis + kernel;
+}
+
+static double radix_sort_algo(const sort_config *cfg, int *arr, long n, sort_stats *stats) {
+    if (stats) {
+        memset(stats, 0, sizeof(*stats));
+    }
+    if (cfg->algo == ALGO_BUCKET || cfg->algo == ALGO_MSD) {
+        return radix_sort_ws(arr, n, cfg, TOP_SHIFT, stats);
+    }
+    if (cfg->algo == ALGO_ONESWEEP) {
+        return radix_sort_onesweep(arr, n, cfg, stats);
+    }
+    if (cfg->algo == ALGO_CTX) {
+        double t0 = sort_wall_time();
+        int rc = radix_ctx_sort(cfg->ctx, arr, n);
+        double t1 = sort_wall_time();
+        if (rc != RADIX_OK) {
+            fprintf(stderr, "[pthread] Context sort failed: %s\n", radix_strerror(rc));
+            exit(1);
+        }
+        return t1 - t0;
+    }
+    if (cfg->algo == ALGO_AUTO) {
+        return radix_sort_planned(arr, n, cfg, stats);
+    }
+    return radix_sort_pthreads(arr, n, cfg, ALL_DIGITS, stats);
+}
+
+static const char *algo_name(int algo) {
+    switch (algo) {
+    case ALGO_ONESWEEP:
+        return "onesweep";
+    case ALGO_BUCKET:
+        return "bucket";
+    case ALGO_MSD:
+        return "msd";
+    case ALGO_CTX:
+        return "ctx";
+    case ALGO_AUTO:
+        return "auto";
+    default:
+        return "lsd";
+    }
+}
+
+static int parse_algo(const char *name, int *algo) {
+    static const int algos[] = {ALGO_LSD, ALGO_ONESWEEP, ALGO_BUCKET, ALGO_MSD, ALGO_CTX, ALGO_AUTO};
+    for (size_t i = 0; i < sizeof(algos) / sizeof(algos[0]); ++i) {
+        if (strcmp(name, algo_name(algos[i])) == 0) {
+            *algo = algos[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static void print_plan(const sort_stats *stats) {
+    const sort_plan *plan = &stats->plan;
+    const plan_input *in = &plan->input;
+    printf("  [plan] %s | threads = %d | est = %.4f s | actual = %.4f s | analysis = %.4f s\n",
+           plan_name(plan->kind),
+           plan->threads,
+           plan->est_cost,
+           stats->plan_actual,
+           stats->plan_analysis);
+    printf("  [plan] range = [%u, %u] | varying digits = 0x%x | runs = %ld | distinct ~ %.0f | "
+           "entropy = %.1f/%.1f/%.1f/%.1f bits\n",
+           in->min, in->max, in->digit_mask, in->runs, in->distinct,
+           in->entropy[3], in->entropy[2], in->entropy[1], in->entropy[0]);
+    printf("  [plan] candidates:");
+    for (int k = 0; k <= PLAN_RUN_MERGE; ++k) {
+        if (plan->est_costs[k] >= 0.0) {
+            printf(" %s = %.4f s", plan_name(k), plan->est_costs[k]);
+        }
+    }
+    printf("\n");
+}
+
+static void print_stats(const sort_stats *stats) {
+    if (stats->planned) {
+        print_plan(stats);
+    }
+    if (stats->workers == 0) {
+        return;
+    }
+    printf("  [stats] workers = %d | tasks = %lu | steals = %lu | failed steals = %lu | "
+           "idle = %.3f s total, %.3f s max\n",
+           stats->workers,
+           stats->tasks,
+           stats->steals,
+           stats->failed_steals,
+           stats->idle_time,
+           stats->max_idle_time);
+}
+
 static int run_random_case(long n,
-                           int threads,
+                           const sort_config *cfg,
                            int verify,
                            unsigned int seed,
-                           double *elapsed) {
+                           double *elapsed,
+                           sort_stats *stats) {
     int *data = (int *)malloc(sizeof(int) * (n > 0 ? n : 1));
     if (!data) {
         fprintf(stderr, "[pthread] Allocation failed for input buffer\n");
         exit(1);
     }
-    fill_random(data, n, seed);
-    double t = radix_sort_pthreads(data, n, threads);
+    driver_place_input(&cfg->place, data, n, sizeof(int));
+    fill_input(data, n, seed, cfg->dist);
+    double t = radix_sort_algo(cfg, data, n, stats);
     if (elapsed) {
         *elapsed = t;
     }
-    int ok = (!verify) || verify_sorted(data, n);
+    int ok = (!verify) || radix_verify_sorted(data, n);
     free(data);
     return ok;
 }
 
-static void print_array(const int *arr, int n) {
-    for (int i = 0; i < n; ++i) {
-        printf("%d%s", arr[i], (i + 1 == n) ? "\n" : " ");
+/* The pthread kernels behind the shared --input sorts. */
+typedef struct {
+    sort_config *cfg;
+    int show_stats;
+    sort_stats stats;
+} input_sort;
+
+static double input_sort_keys(void *arg, void *keys, long n, int key_bits) {
+    input_sort *in = (input_sort *)arg;
+    sort_config *cfg = in->cfg;
+    if (key_bits == 64) {
+        return radix_sort_pthreads64((uint64_t *)keys, n, cfg);
+    }
+    if (cfg->algo == ALGO_CTX) {
+        int rc = radix_ctx_create(&cfg->ctx, n, cfg->place.threads);
+        if (rc != RADIX_OK) {
+            fprintf(stderr, "[pthread] Failed to create sort context: %s\n", radix_strerror(rc));
+            exit(1);
+        }
+    }
+    double elapsed = radix_sort_algo(cfg, (int *)keys, n, &in->stats);
+    radix_ctx_destroy(cfg->ctx);
+    cfg->ctx = NULL;
+    return elapsed;
+}
+
+static const char *input_sort_name(void *arg, int key_bits) {
+    input_sort *in = (input_sort *)arg;
+    return key_bits == 64 ? "lsd64" : algo_name(in->cfg->algo);
+}
+
+static void input_sort_report(void *arg, int key_bits) {
+    input_sort *in = (input_sort *)arg;
+    if (in->show_stats && key_bits == 32) {
+        driver_print_bandwidth(&in->stats.bw);
+        print_stats(&in->stats);
+    }
+    if (in->show_stats) {
+        driver_print_alloc_stats();
+    }
+}
+
+/* --input without --external, --stream or --records: a mapped binary sort,
+   or a text or packed one through a private array. Returns the process
+   exit status. */
+static int run_input_sort(sort_config *cfg,
+                          const char *input,
+                          const char *output,
+                          int key_bits,
+                          int in_format,
+                          int out_format,
+                          int verify,
+                          int show_stats) {
+    input_sort in;
+    memset(&in, 0, sizeof(in));
+    in.cfg = cfg;
+    in.show_stats = show_stats;
+    sort_driver drv = {&cfg->place, input_sort_keys, input_sort_name, input_sort_report, &in};
+    if (in_format == FORMAT_BINARY && out_format == FORMAT_BINARY) {
+        return driver_run_file_sort(&drv, input, output, key_bits, verify);
+    }
+    return driver_run_text_sort(&drv, input, output, key_bits, in_format, out_format, verify,
+                                show_stats);
+}
+
+/* --query <lo>:<hi>: counts and lists the keys of a packed --input file in
+   [lo, hi], reading only the blocks the range covers. */
+static int run_query(const char *path, const char *range) {
+    char *end = NULL;
+    errno = 0;
+    uint64_t lo = strtoull(range, &end, 10);
+    uint64_t hi = UINT64_MAX;
+    if (errno != 0 || end == range || (*end != ':' && *end != '\0')) {
+        fprintf(stderr, "query must be <lo>:<hi> or <key>\n");
+        return 1;
+    }
+    if (*end == '\0') {
+        hi = lo;
+    } else if (end[1] != '\0') {
+        const char *h = end + 1;
+        hi = strtoull(h, &end, 10);
+        if (errno != 0 || end == h || *end != '\0') {
+            fprintf(stderr, "query must be <lo>:<hi> or <key>\n");
+            return 1;
+        }
+    }
+
+    packed_reader r;
+    double t0 = sort_wall_time();
+    if (packed_open(&r, path) != 0) {
+        fprintf(stderr, "[pthread] Cannot open %s: %s\n", path,
+                errno == EINVAL ? "not a packed key file" : strerror(errno));
+        return 1;
+    }
+    packed_range it;
+    uint64_t sample[10];
+    long shown = 0;
+    long count = 0;
+    int rc = packed_range_init(&it, &r, lo, hi);
+    if (rc == 0) {
+        count = it.end - it.pos;
+        shown = packed_range_next(&it, sample, 10);
+        rc = shown < 0 ? -1 : 0;
+    }
+    double elapsed = sort_wall_time() - t0;
+    if (rc != 0) {
+        fprintf(stderr, "[pthread] Cannot read %s: %s\n", path, strerror(errno));
+        packed_close(&r);
+        return 1;
+    }
+    printf("[pthread] %ld of %ld keys of %s are in [%llu, %llu]; read %ld of %ld blocks "
+           "in %.6f s.\n",
+           count, r.keys, path, (unsigned long long)lo, (unsigned long long)hi, r.blocks_read,
+           r.blocks, elapsed);
+    if (shown > 0) {
+        printf("First:");
+        for (long i = 0; i < shown; ++i) {
+            printf(" %llu", (unsigned long long)sample[i]);
+        }
+        printf("%s\n", count > shown ? " ..." : "");
+    }
+    packed_close(&r);
+    return 0;
+}
+
+/* Key buffers for --external, --stream and Arrow columns go through the
+   selected kernel; 64-bit keys through the 64-bit one. */
+static int sort_chunk(void *keys, long n, int key_bits, void *arg) {
+    const sort_config *cfg = (const sort_config *)arg;
+    if (key_bits == 64) {
+        radix_sort_pthreads64((uint64_t *)keys, n, cfg);
+    } else {
+        radix_sort_algo(cfg, (int *)keys, n, NULL);
+    }
+    return 0;
+}
+
+/* Half of physical memory, or 1 GB if that is unknown. */
+static size_t default_mem_budget(void) {
+#if defined(_SC_PHYS_PAGES) && defined(_SC_PAGESIZE)
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && page > 0) {
+        return (size_t)pages * (size_t)page / 2;
     }
+#endif
+    return (size_t)1 << 30;
 }
 
-static void run_correctness_suite(int threads, unsigned int seed) {
-    int tests[][10] = {
-        {0},
-        {5},
-        {3, 1, 2},
-        {1, 2, 3, 4},
-        {4, 3, 2, 1},
-        {5, 5, 5, 5},
-        {10, 0, 100, 7, 7, 3, 999},
-        {170, 45, 75, 90, 802, 24, 2, 66}
-    };
-    int lens[] = {0, 1, 3, 4, 4, 4, 7, 8};
-    int num_tests = (int)(sizeof(lens) / sizeof(lens[0]));
+/* --external: out-of-core sort of an --input file larger than memory into
+   --output (or back into --input). With --merge-into the sorted --input is
+   merged into that sorted file instead. Run files go next to the output
+   unless --tmp-dir says otherwise, since /tmp is often RAM-backed. Returns
+   the process exit status. */
+static int run_external_sort(sort_config *cfg,
+                             const char *input,
+                             const char *output,
+                             const char *merge_base,
+                             int key_bits,
+                             size_t mem_bytes,
+                             const char *tmpdir,
+                             int io_kind,
+                             int io_depth,
+                             int direct,
+                             int compress_runs,
+                             int verify,
+                             int show_stats) {
+    if (merge_base) {
+        output = merge_base;
+    } else if (!output) {
+        output = input;
+    }
+    char dir[1024];
+    if (!tmpdir) {
+        snprintf(dir, sizeof(dir), "%s", output);
+        char *slash = strrchr(dir, '/');
+        if (!slash) {
+            snprintf(dir, sizeof(dir), ".");
+        } else if (slash == dir) {
+            dir[1] = '\0';
+        } else {
+            *slash = '\0';
+        }
+        tmpdir = dir;
+    }
+    if (mem_bytes == 0) {
+        mem_bytes = default_mem_budget();
+    }
+
+    ext_sort_config ext = {mem_bytes, key_bits, cfg->place.threads, tmpdir, io_kind, io_depth,
+                           direct, compress_runs, sort_chunk, cfg};
+    if (key_bits == 32 && cfg->algo == ALGO_CTX) {
+        long chunk_keys = (long)(ext_chunk_bytes(mem_bytes, 32) / sizeof(int));
+        int rc = radix_ctx_create(&cfg->ctx, chunk_keys, cfg->place.threads);
+        if (rc != RADIX_OK) {
+            fprintf(stderr, "[pthread] Failed to create sort context: %s\n", radix_strerror(rc));
+            return 1;
+        }
+    }
 
-    for (int t = 0; t < num_tests; ++t) {
-        int len = lens[t];
-        int buf[10];
-        memcpy(buf, tests[t], sizeof(int) * len);
-        double elapsed = radix_sort_pthreads(buf, len, threads);
+    ext_sort_stats stats;
+    double t0 = sort_wall_time();
+    int rc = merge_base ? ext_merge_into(merge_base, input, &ext, &stats)
+                        : ext_sort_file(input, output, &ext, &stats);
+    double elapsed = sort_wall_time() - t0;
+    int saved = errno;
+    radix_ctx_destroy(cfg->ctx);
+    cfg->ctx = NULL;
+    if (rc != 0) {
+        fprintf(stderr, "[pthread] External %s of %s failed: %s\n", merge_base ? "merge" : "sort",
+                input, strerror(saved));
+        return 1;
+    }
 
-        int expected[10];
-        memcpy(expected, tests[t], sizeof(int) * len);
-        qsort(expected, len, sizeof(int), cmp_int);
+    if (merge_base) {
+        printf("[pthread] Sorted %ld new %d-bit keys (%s) from %s and merged them into %s "
+               "(%ld keys before, %ld now) in %.3f s (%d runs of %.1f MB, budget %.1f MB).\n",
+               stats.keys, key_bits, key_bits == 64 ? "lsd64" : algo_name(cfg->algo), input,
+               output, stats.base_keys, stats.base_keys + stats.keys, elapsed, stats.runs,
+               (double)stats.chunk_bytes / (1024.0 * 1024.0), (double)mem_bytes / (1024.0 * 1024.0));
+    } else {
+        printf("[pthread] Externally sorted %ld %d-bit keys (%s) from %s into %s in %.3f s "
+               "(%d runs of %.1f MB, budget %.1f MB).\n",
+               stats.keys, key_bits, key_bits == 64 ? "lsd64" : algo_name(cfg->algo), input,
+               output, elapsed, stats.runs, (double)stats.chunk_bytes / (1024.0 * 1024.0),
+               (double)mem_bytes / (1024.0 * 1024.0));
+    }
+    if (show_stats) {
+        printf("[external] io = %s%s%s | runs = %.3f s (read %.3f s | sort %.3f s | write %.3f s | "
+               "sort waited %.3f s) | merge = %.3f s ",
+               io_engine_name(stats.io_kind), stats.registered ? ", registered buffers" : "",
+               stats.direct ? ", O_DIRECT" : "", stats.run_time, stats.read_time,
+               stats.sort_time, stats.write_time, stats.sort_wait, stats.merge_time);
+        if (stats.merge_threads > 0) {
+            printf("(%d threads, %.1f MB buffers)\n", stats.merge_threads,
+                   (double)stats.merge_buffer_bytes / (1024.0 * 1024.0));
+        } else {
+            printf("(single run renamed)\n");
+        }
+        if (compress_runs) {
+            double raw = (double)stats.keys * (key_bits / 8);
+            printf("[external] compressed runs = %.1f MB of %.1f MB raw (%.2fx) | encode = %.3f s\n",
+                   (double)stats.run_bytes / (1024.0 * 1024.0), raw / (1024.0 * 1024.0),
+                   stats.run_bytes ? raw / (double)stats.run_bytes : 0.0, stats.encode_time);
+        }
+        driver_print_alloc_stats();
+    }
+    if (cfg->place.use_pool) {
+        driver_print_pool_stats();
+        scratch_pool_trim();
+    }
 
-        int ok = memcmp(expected, buf, sizeof(int) * len) == 0;
-        printf("[correctness] test %d (n=%d): %s (%.6f s)\n",
-               t, len, ok ? "PASS" : "FAIL", elapsed);
+    if (verify) {
+        key_map out;
+        if (key_map_open(&out, output, 0, cfg->place.threads) != 0) {
+            fprintf(stderr, "[pthread] Cannot map %s: %s\n", output, strerror(errno));
+            return 1;
+        }
+        int ok = radix_verify_sorted_keys(out.data, stats.base_keys + stats.keys, key_bits);
+        key_map_close(&out);
+        if (!ok) {
+            fprintf(stderr, "Verification failed.\n");
+            return 1;
+        }
     }
+    return 0;
+}
+
+static void arrow_release_none(struct ArrowArray *array) {
+    array->release = NULL;
+}
 
-    int sample_n = 20;
-    int sample[20];
-    int sorted_sample[20];
-    fill_random(sample, sample_n, seed + 54321u);
-    memcpy(sorted_sample, sample, sizeof(int) * sample_n);
-    (void)radix_sort_pthreads(sorted_sample, sample_n, threads);
+static void arrow_schema_release_none(struct ArrowSchema *schema) {
+    schema->release = NULL;
+}
 
-    printf("\n=== Sample of 20 integers ===\nUnsorted: ");
-    print_array(sample, sample_n);
-    printf("Sorted:   ");
-    print_array(sorted_sample, sample_n);
-    puts("");
+/* Numeric value of row i of an "i", "l", "f" or "g" column. */
+static double arrow_value(const char *values, char format, long i) {
+    switch (format) {
+    case 'i': {
+        int32_t v;
+        memcpy(&v, values + i * 4, sizeof(v));
+        return v;
+    }
+    case 'l': {
+        int64_t v;
+        memcpy(&v, values + i * 8, sizeof(v));
+        return (double)v;
+    }
+    case 'f': {
+        float v;
+        memcpy(&v, values + i * 4, sizeof(v));
+        return v;
+    }
+    default: {
+        double v;
+        memcpy(&v, values + i * 8, sizeof(v));
+        return v;
+    }
+    }
 }
 
-static void run_benchmarks(int threads, int verify, unsigned int seed) {
+#define ARROW_CHECK_N 100003L
+/* Budget of the --external and --stream checks; under it a few MB of keys
+   take several merge passes. */
+#define EXT_CHECK_MEM ((size_t)4 << 20)
+
+/* Sorts columns of every Arrow type in place and by argsort, with signed
+   values, -0.0 and infinities, and checks both against each other. */
+static void run_arrow_checks(const sort_config *cfg, unsigned int seed) {
+    static const char *formats[] = {"i", "l", "f", "g"};
+    const long n = ARROW_CHECK_N;
+    for (int f = 0; f < 4; ++f) {
+        char fmt = formats[f][0];
+        size_t width = (fmt == 'i' || fmt == 'f') ? 4 : 8;
+        char *data = (char *)malloc(width * (size_t)(n + 1));
+        char *orig = (char *)malloc(width * (size_t)n);
+        if (!data || !orig) {
+            fprintf(stderr, "[pthread] Allocation failed\n");
+            exit(1);
+        }
+        unsigned int state = seed + (unsigned int)f;
+        for (long i = 0; i < n; ++i) {
+            unsigned int hi = radix_lcg_next(&state);
+            int32_t r = (int32_t)(radix_lcg_next(&state) ^ (hi << 16));
+            if (fmt == 'i') {
+                memcpy(orig + i * 4, &r, 4);
+            } else if (fmt == 'l') {
+                int64_t v = (int64_t)r * 1000003 + (int64_t)(radix_lcg_next(&state) % 1000);
+                memcpy(orig + i * 8, &v, 8);
+            } else {
+                double v = (double)r / 1024.0;
+                v = i % 97 == 0 ? (i % 2 ? 1.0 / 0.0 : -1.0 / 0.0) : i % 89 == 0 ? -0.0 : v;
+                if (fmt == 'f') {
+                    float fv = (float)v;
+                    memcpy(orig + i * 4, &fv, 4);
+                } else {
+                    memcpy(orig + i * 8, &v, 8);
+                }
+            }
+        }
+        /* One leading row sits before the array offset and must stay put. */
+        memset(data, 0x5a, width);
+        memcpy(data + width, orig, width * (size_t)n);
+
+        const void *buffers[2] = {NULL, data};
+        struct ArrowSchema schema;
+        struct ArrowArray array;
+        memset(&schema, 0, sizeof(schema));
+        memset(&array, 0, sizeof(array));
+        schema.format = formats[f];
+        schema.release = arrow_schema_release_none;
+        array.length = n;
+        array.offset = 1;
+        array.n_buffers = 2;
+        array.buffers = buffers;
+        array.release = arrow_release_none;
+
+        struct ArrowSchema idx_schema;
+        struct ArrowArray idx;
+        double t0 = sort_wall_time();
+        int ok = arrow_argsort(&schema, &array, sort_chunk, (void *)cfg, &idx_schema, &idx) == 0 &&
+                 arrow_sort(&schema, &array, sort_chunk, (void *)cfg) == 0;
+        double elapsed = sort_wall_time() - t0;
+        const char *sorted = data + width;
+        for (size_t i = 0; ok && i < width; ++i) {
+            ok = (unsigned char)data[i] == 0x5a;
+        }
+        for (long i = 1; ok && i < n; ++i) {
+            ok = arrow_value(sorted, fmt, i - 1) <= arrow_value(sorted, fmt, i);
+        }
+        if (ok) {
+            const uint64_t *rows = (const uint64_t *)idx.buffers[1];
+            ok = strcmp(idx_schema.format, "L") == 0 && idx.length == n;
+            for (long i = 0; ok && i < n; ++i) {
+                ok = rows[i] < (uint64_t)n &&
+                     memcmp(orig + rows[i] * width, sorted + i * width, width) == 0 &&
+                     (i == 0 || memcmp(orig + rows[i - 1] * width, orig + rows[i] * width,
+                                       width) != 0 || rows[i - 1] < rows[i]);
+            }
+            idx.release(&idx);
+            idx_schema.release(&idx_schema);
+        }
+        printf("[correctness] arrow %s (n=%ld): %s (%.6f s)\n",
+               fmt == 'i' ? "int32" : fmt == 'l' ? "int64" : fmt == 'f' ? "float" : "double", n,
+               ok ? "PASS" : "FAIL", elapsed);
+        free(data);
+        free(orig);
+    }
+}
+
+/* radix_case_fn over the selected kernel. */
+static double sort_case(int *arr, long n, void *arg) {
+    return radix_sort_algo((const sort_config *)arg, arr, n, NULL);
+}
+
+/* Reads at most cap bytes of path into buf; returns the length or -1. */
+static long read_small_file(const char *path, char *buf, size_t cap) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return -1;
+    }
+    size_t got = fread(buf, 1, cap, f);
+    fclose(f);
+    return (long)got;
+}
+
+/* Saving a section that is already in the profile must leave the file
+   byte-identical, whether it is the first or the last section. */
+static void run_profile_check(unsigned int seed) {
+    const char *tmpdir = getenv("TMPDIR");
+    char path[TUNE_PATH_MAX];
+    snprintf(path, sizeof(path), "%s/radix_tune_check_%u.profile",
+             tmpdir && tmpdir[0] != '\0' ? tmpdir : "/tmp", seed);
+    remove(path);
+
+    static const char *keys[] = {"check|a|8", "check|b|4"};
+    tune_params params[] = {{"onesweep", 8, 65536, 16384}, {"msd", 4, 16384, 4096}};
+    int ok = tune_profile_save(path, keys[0], &params[0]) == 0 &&
+             tune_profile_save(path, keys[1], &params[1]) == 0;
+    for (int round = 0; ok && round < 4; ++round) {
+        int k = round % 2;
+        char before[4096];
+        char after[4096];
+        long before_len = -1;
+        long after_len = -1;
+        ok = tune_profile_save(path, keys[k], &params[k]) == 0 &&
+             (before_len = read_small_file(path, before, sizeof(before))) >= 0 &&
+             tune_profile_save(path, keys[k], &params[k]) == 0 &&
+             (after_len = read_small_file(path, after, sizeof(after))) >= 0 &&
+             before_len == after_len && memcmp(before, after, (size_t)before_len) == 0;
+    }
+    for (int k = 0; ok && k < 2; ++k) {
+        tune_params loaded;
+        ok = tune_profile_load(path, keys[k], &loaded) == 0 &&
+             strcmp(loaded.algo, params[k].algo) == 0 && loaded.threads == params[k].threads &&
+             loaded.min_keys_per_thread == params[k].min_keys_per_thread &&
+             loaded.task_grain == params[k].task_grain;
+    }
+    printf("[correctness] tune profile re-save: %s\n", ok ? "PASS" : "FAIL");
+    remove(path);
+}
+
+/* --external chunk sizing around the INT_MAX-key cap, which no test
+   machine has the memory to sort through. */
+static void run_chunk_size_check(void) {
+    static const size_t gib = (size_t)1 << 30;
+    static const size_t budgets[] = {0, 1 << 20, 8 * gib, 32 * gib - 16384, 32 * gib,
+                                     32 * gib + 16384, 64 * gib, 256 * gib};
+    int ok = 1;
+    for (int key_bits = 32; key_bits <= 64; key_bits += 32) {
+        size_t key_bytes = (size_t)key_bits / 8;
+        for (size_t b = 0; b < sizeof(budgets) / sizeof(budgets[0]); ++b) {
+            size_t chunk = ext_chunk_bytes(budgets[b], key_bits);
+            size_t quarter = budgets[b] / 4 > 65536 ? budgets[b] / 4 : 65536;
+            ok &= chunk % 4096 == 0 && chunk / key_bytes <= INT_MAX;
+            if (quarter / key_bytes <= INT_MAX) {
+                ok &= chunk == quarter - quarter % 4096;
+            } else {
+                ok &= chunk / key_bytes > INT_MAX - 4096 / key_bytes;
+            }
+        }
+    }
+    printf("[correctness] external chunk sizing: %s\n", ok ? "PASS" : "FAIL");
+}
+
+static uint64_t check_rand64(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static uint64_t check_key_at(const void *keys, int key_bits, long i) {
+    return key_bits == 64 ? ((const uint64_t *)keys)[i] : ((const uint32_t *)keys)[i];
+}
+
+/* Position of the first key >= key, by linear scan. */
+static long check_lower_bound(const void *keys, long n, int key_bits, uint64_t key) {
+    long pos = 0;
+    while (pos < n && check_key_at(keys, key_bits, pos) < key) {
+        ++pos;
+    }
+    return pos;
+}
+
+/* Encodes sorted keys[0, n) and decodes every block back, counting the
+   blocks packed at each width in widths[]; then probes the block index
+   and, through a packed file at path, lower_bound and range queries, all
+   against linear scans of keys. Packed files are POSIX-only. */
+static int codec_case(const void *keys, long n, int key_bits, const char *path,
+                      uint64_t *rng, long *widths) {
+    size_t kb = (size_t)key_bits / 8;
+    long blocks = key_codec_blocks(n);
+    char *buf = (char *)malloc((size_t)n * kb + KEY_CODEC_PAD);
+    key_block *index = (key_block *)malloc((size_t)blocks * sizeof(key_block));
+    uint64_t *out = (uint64_t *)malloc(KEY_BLOCK_KEYS * sizeof(uint64_t));
+    enum { PROBES = 96 };
+    uint64_t probes[PROBES];
+    if (!buf || !index || !out) {
+        free(buf);
+        free(index);
+        free(out);
+        return 0;
+    }
+    memcpy(buf, keys, (size_t)n * kb);
+    memset(buf + (size_t)n * kb, 0, KEY_CODEC_PAD);
+    int ok = key_codec_encode(buf, n, key_bits, index) <= (size_t)n * kb;
+    for (long b = 0; ok && b < blocks; ++b) {
+        long start = b * KEY_BLOCK_KEYS;
+        long m = n - start < KEY_BLOCK_KEYS ? n - start : KEY_BLOCK_KEYS;
+        key_block_decode(buf + index[b].offset, &index[b], key_bits, out);
+        ok = (long)index[b].keys == m && (int)index[b].width <= key_bits &&
+             memcmp(out, (const char *)keys + (size_t)start * kb, (size_t)m * kb) == 0;
+        widths[index[b].width]++;
+    }
+
+    /* Block edges and their neighbours, sampled keys, and both extremes. */
+    uint64_t top = key_bits == 64 ? UINT64_MAX : UINT32_MAX;
+    int probe_count = 0;
+    probes[probe_count++] = 0;
+    probes[probe_count++] = top;
+    for (long b = 0; b < blocks && probe_count + 3 <= PROBES / 2; ++b) {
+        uint64_t first = check_key_at(keys, key_bits, b * KEY_BLOCK_KEYS);
+        probes[probe_count++] = first;
+        probes[probe_count++] = first > 0 ? first - 1 : first;
+        probes[probe_count++] = first < top ? first + 1 : first;
+    }
+    while (probe_count < PROBES) {
+        uint64_t k = check_key_at(keys, key_bits, (long)(check_rand64(rng) % (uint64_t)n));
+        probes[probe_count++] = k + (k < top ? check_rand64(rng) % 2 : 0);
+    }
+    for (int p = 0; ok && p < probe_count; ++p) {
+        long b = key_codec_find_block(index, blocks, probes[p]);
+        long pos = check_lower_bound(keys, n, key_bits, probes[p]);
+        long end = (b + 1) * KEY_BLOCK_KEYS < n ? (b + 1) * KEY_BLOCK_KEYS : n;
+        ok = b >= 0 && b < blocks && (pos == n || (b * KEY_BLOCK_KEYS <= pos && pos <= end));
+    }
+
+#ifndef _WIN32
+    packed_reader reader;
+    ok = ok && packed_write(path, keys, n, key_bits, 2, NULL) == 0 &&
+         packed_open(&reader, path) == 0;
+    if (ok) {
+        for (int p = 0; ok && p < probe_count; ++p) {
+            long pos = -1;
+            ok = packed_lower_bound(&reader, probes[p], &pos) == 0 &&
+                 pos == check_lower_bound(keys, n, key_bits, probes[p]);
+        }
+        for (int p = 0; ok && p + 1 < probe_count; ++p) {
+            uint64_t lo = probes[p] < probes[p + 1] ? probes[p] : probes[p + 1];
+            uint64_t hi = probes[p] < probes[p + 1] ? probes[p + 1] : probes[p];
+            long pos = check_lower_bound(keys, n, key_bits, lo);
+            packed_range it;
+            long got = 0;
+            ok = packed_range_init(&it, &reader, lo, hi) == 0;
+            while (ok && (got = packed_range_next(&it, out, 300)) > 0) {
+                for (long i = 0; ok && i < got; ++i, ++pos) {
+                    ok = pos < n && out[i] == check_key_at(keys, key_bits, pos) && out[i] <= hi;
+                }
+            }
+            ok = ok && got == 0 && (pos == n || check_key_at(keys, key_bits, pos) > hi);
+        }
+        packed_close(&reader);
+    }
+    remove(path);
+#else
+    (void)path;
+#endif
+    free(buf);
+    free(index);
+    free(out);
+    return ok;
+}
+
+/* Key codec and packed files over the widths with their own paths: 0
+   (equal gaps, equal keys), 32 (a 32-bit block spanning the whole key
+   space), 57 to 64 (gaps straddling the 64-bit decode word), partial tail
+   blocks, and runs of duplicates crossing block boundaries. */
+static void run_codec_check(unsigned int seed) {
+    const char *tmpdir = getenv("TMPDIR");
+    char path[TUNE_PATH_MAX];
+    snprintf(path, sizeof(path), "%s/radix_codec_check_%u.packed",
+             tmpdir && tmpdir[0] != '\0' ? tmpdir : "/tmp", seed);
+    enum { MAX_KEYS = 4 * KEY_BLOCK_KEYS + 300 };
+    uint32_t *k32 = (uint32_t *)malloc(MAX_KEYS * sizeof(uint32_t));
+    uint64_t *k64 = (uint64_t *)malloc(MAX_KEYS * sizeof(uint64_t));
+    uint64_t rng = seed;
+    long widths32[33] = {0};
+    long widths64[65] = {0};
+    int ok = k32 && k64;
+
+    if (ok) {
+        long n = 2 * KEY_BLOCK_KEYS + 300;
+        for (long i = 0; i < n; ++i) {
+            k32[i] = 5u + 7u * (uint32_t)i;
+        }
+        ok &= codec_case(k32, n, 32, path, &rng, widths32);
+        n = KEY_BLOCK_KEYS + 17;
+        for (long i = 0; i < n; ++i) {
+            k32[i] = i < 2 ? (uint32_t)i : UINT32_MAX;
+        }
+        ok &= codec_case(k32, n, 32, path, &rng, widths32);
+        n = 3 * KEY_BLOCK_KEYS - 1;
+        for (long i = 0; i < n; ++i) {
+            k32[i] = (uint32_t)check_rand64(&rng);
+        }
+        qsort(k32, (size_t)n, sizeof(uint32_t), cmp_uint);
+        ok &= codec_case(k32, n, 32, path, &rng, widths32);
+        n = 4 * KEY_BLOCK_KEYS + 300;
+        for (long i = 0; i < n; ++i) {
+            k32[i] = (uint32_t)(i / 700) * 3u;
+            k64[i] = (uint64_t)(i / 700) * 3u + (UINT64_MAX - 100);
+        }
+        ok &= codec_case(k32, n, 32, path, &rng, widths32);
+        ok &= codec_case(k64, n, 64, path, &rng, widths64);
+        n = 2 * KEY_BLOCK_KEYS + 5;
+        for (long i = 0; i < n; ++i) {
+            k64[i] = (uint64_t)seed << 32;
+        }
+        ok &= codec_case(k64, n, 64, path, &rng, widths64);
+    }
+
+    /* One block at each width w from 57 to 64: small gaps plus as many
+       gaps in [2^(w-1), 2^w) as fit below 2^64, then a partial tail. */
+    for (int w = 57; ok && w <= 64; ++w) {
+        long n = KEY_BLOCK_KEYS + 100 + w;
+        long big = w == 64 ? 1 : (1L << (64 - w)) - 1;
+        big = big < 32 ? big : 32;
+        uint64_t k = check_rand64(&rng) % 1000;
+        for (long i = 0; i < n; ++i) {
+            k64[i] = k;
+            uint64_t gap = check_rand64(&rng) % (1u << 20);
+            if (i % 29 == 3 && i / 29 < big) {
+                uint64_t low = check_rand64(&rng) & ((1ull << (w - 2)) - 1);
+                gap = (1ull << (w - 1)) + (1u << 20) + low;
+            }
+            k += gap;
+        }
+        ok &= codec_case(k64, n, 64, path, &rng, widths64);
+    }
+
+    ok &= widths32[0] > 0 && widths32[32] > 0 && widths64[0] > 0;
+    for (int w = 57; w <= 64; ++w) {
+        ok &= widths64[w] > 0;
+    }
+    printf("[correctness] key codec and packed queries: %s\n", ok ? "PASS" : "FAIL");
+    free(k32);
+    free(k64);
+}
+
+#ifndef _WIN32
+/* Writes bytes of keys to path; returns 0 on success. */
+static int write_check_file(const char *path, const void *keys, size_t bytes) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        return -1;
+    }
+    size_t put = fwrite(keys, 1, bytes, f);
+    return fclose(f) == 0 && put == bytes ? 0 : -1;
+}
+
+/* 1 if path holds exactly the n 32-bit keys of want. */
+static int check_file_keys(const char *path, const unsigned int *want, long n) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return 0;
+    }
+    unsigned int buf[4096];
+    long pos = 0;
+    int ok = 1;
+    size_t got;
+    while (ok && (got = fread(buf, sizeof(buf[0]), 4096, f)) > 0) {
+        ok = pos + (long)got <= n && memcmp(buf, want + pos, got * sizeof(buf[0])) == 0;
+        pos += (long)got;
+    }
+    fclose(f);
+    return ok && pos == n;
+}
+
+/* --external, --merge-into and --stream under EXT_CHECK_MEM, each checked
+   against a qsort of its input. Nine chunks and more make the external
+   sort merge groups of runs into longer ones before a final merge split
+   into parts; the stream sort spills most batches and merges those runs
+   in groups too. */
+static void run_external_checks(const sort_config *cfg, unsigned int seed) {
+    const char *tmpdir = getenv("TMPDIR");
+    tmpdir = tmpdir && tmpdir[0] != '\0' ? tmpdir : "/tmp";
+    char in_path[TUNE_PATH_MAX];
+    char out_path[TUNE_PATH_MAX];
+    snprintf(in_path, sizeof(in_path), "%s/radix_ext_check_%u.in", tmpdir, seed);
+    snprintf(out_path, sizeof(out_path), "%s/radix_ext_check_%u.out", tmpdir, seed);
+    long chunk_keys = (long)(ext_chunk_bytes(EXT_CHECK_MEM, 32) / sizeof(int));
+    long n = 9 * chunk_keys + 1234;
+    int *keys = (int *)malloc((size_t)n * sizeof(int));
+    unsigned int *want = (unsigned int *)malloc((size_t)n * sizeof(unsigned int));
+    if (!keys || !want) {
+        fprintf(stderr, "[pthread] Allocation failed\n");
+        exit(1);
+    }
+    radix_fill_random(keys, n, seed);
+    memcpy(want, keys, (size_t)n * sizeof(int));
+    qsort(want, (size_t)n, sizeof(unsigned int), cmp_uint);
+    int written = write_check_file(in_path, keys, (size_t)n * sizeof(int)) == 0;
+    int merge_threads = cfg->place.threads > 2 ? cfg->place.threads : 2;
+
+    /* Plain runs on the default engine, compressed ones on the thread pool. */
+    for (int compress = 0; compress <= 1; ++compress) {
+        ext_sort_config ext = {EXT_CHECK_MEM, 32, merge_threads, tmpdir,
+                               compress ? IO_THREADS : IO_AUTO, 0, 0, compress, sort_chunk,
+                               (void *)cfg};
+        ext_sort_stats stats;
+        int ok = written && ext_sort_file(in_path, out_path, &ext, &stats) == 0 &&
+                 stats.keys == n && stats.runs > 8 && stats.merge_threads >= 2 &&
+                 check_file_keys(out_path, want, n);
+        printf("[correctness] external sort, cascaded merge%s: %s\n",
+               compress ? ", compressed runs" : "", ok ? "PASS" : "FAIL");
+    }
+
+    /* The sorted first third becomes the base; the rest, which repeats some
+       of its keys, is the batch merged into it. */
+    long base_n = n / 3;
+    long batch_n = n - base_n;
+    unsigned int *merged = (unsigned int *)malloc((size_t)n * sizeof(unsigned int));
+    if (!merged) {
+        fprintf(stderr, "[pthread] Allocation failed\n");
+        exit(1);
+    }
+    memcpy(merged, keys, (size_t)base_n * sizeof(int));
+    qsort(merged, (size_t)base_n, sizeof(unsigned int), cmp_uint);
+    memcpy(keys + base_n, keys, 1000 * sizeof(int));
+    int ok = write_check_file(out_path, merged, (size_t)base_n * sizeof(int)) == 0 &&
+             write_check_file(in_path, keys + base_n, (size_t)batch_n * sizeof(int)) == 0;
+    memcpy(merged + base_n, keys + base_n, (size_t)batch_n * sizeof(int));
+    qsort(merged, (size_t)n, sizeof(unsigned int), cmp_uint);
+    ext_sort_config ext = {EXT_CHECK_MEM, 32, merge_threads, tmpdir, IO_AUTO, 0, 0, 0,
+                           sort_chunk, (void *)cfg};
+    ext_sort_stats ext_stats;
+    ok = ok && ext_merge_into(out_path, in_path, &ext, &ext_stats) == 0 &&
+         ext_stats.base_keys == base_n && ext_stats.keys == batch_n &&
+         check_file_keys(out_path, merged, n);
+    printf("[correctness] external merge into a sorted base: %s\n", ok ? "PASS" : "FAIL");
+
+    /* The whole input again, as a stream. */
+    radix_fill_random(keys, n, seed + 1u);
+    memcpy(want, keys, (size_t)n * sizeof(int));
+    qsort(want, (size_t)n, sizeof(unsigned int), cmp_uint);
+    stream_sort_config sc = {EXT_CHECK_MEM, 32, 0, 0, cfg->place.threads, tmpdir, sort_chunk,
+                             (void *)cfg};
+    stream_sort_stats stream_stats;
+    FILE *in = NULL;
+    FILE *out = NULL;
+    ok = write_check_file(in_path, keys, (size_t)n * sizeof(int)) == 0 &&
+         (in = fopen(in_path, "rb")) != NULL && (out = fopen(out_path, "wb")) != NULL &&
+         stream_sort_fd(fileno(in), fileno(out), &sc, &stream_stats) == 0;
+    if (in) {
+        fclose(in);
+    }
+    if (out) {
+        ok &= fclose(out) == 0;
+    }
+    ok = ok && stream_stats.keys == n && stream_stats.spilled > 8 &&
+         stream_stats.out_of_order == 0 && check_file_keys(out_path, want, n);
+    printf("[correctness] stream sort with spilled runs: %s\n", ok ? "PASS" : "FAIL");
+
+    remove(in_path);
+    remove(out_path);
+    free(keys);
+    free(want);
+    free(merged);
+}
+#endif
+
+static void run_correctness_suite(const sort_config *cfg, unsigned int seed) {
+    radix_run_cases(sort_case, (void *)cfg);
+    run_arrow_checks(cfg, seed);
+    run_profile_check(seed);
+    run_chunk_size_check();
+    run_codec_check(seed);
+#ifndef _WIN32
+    run_external_checks(cfg, seed);
+#endif
+    radix_print_sample(sort_case, (void *)cfg, seed + 54321u);
+}
+
+static void run_benchmarks(const sort_config *cfg,
+                           int verify,
+                           int show_stats,
+                           int repeat,
+                           unsigned int seed) {
     long sizes[] = {10000, 100000, 1000000, 10000000};
     int num_sizes = (int)(sizeof(sizes) / sizeof(sizes[0]));
     for (int i = 0; i < num_sizes; ++i) {
         double elapsed = 0.0;
-        int ok = run_random_case(sizes[i], threads, verify, seed + (unsigned int)i, &elapsed);
-        printf("n = %10ld | threads = %2d | time = %.3f s%s\n",
+        sort_stats stats;
+        int ok = 1;
+        for (int r = 0; r < repeat; ++r) {
+            double t = 0.0;
+            ok &= run_random_case(sizes[i], cfg, verify, seed + (unsigned int)i, &t, &stats);
+            elapsed += t / repeat;
+        }
+        printf("n = %10ld | %-8s | threads = %2d | time = %.3f s%s\n",
                sizes[i],
-               threads,
+               algo_name(cfg->algo),
+               cfg->place.threads,
                elapsed,
                verify && !ok ? " (verify FAILED)" : "");
+        driver_print_bandwidth(&stats.bw);
+        if (show_stats) {
+            print_stats(&stats);
+        }
+    }
+    if (show_stats) {
+        driver_print_alloc_stats();
+    }
+}
+
+static double tune_time(const sort_config *cfg, long n, unsigned int seed) {
+    double best = 0.0;
+    for (int r = 0; r < TUNE_REPS; ++r) {
+        double t = 0.0;
+        if (!run_random_case(n, cfg, 1, seed + (unsigned int)r, &t, NULL)) {
+            fprintf(stderr, "[tune] %s produced unsorted output\n", algo_name(cfg->algo));
+            exit(1);
+        }
+        if (r == 0 || t < best) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+/* Calibration matrix: every kernel at power-of-two thread counts up to
+   cfg->place.threads, then the MSD spawn grain and the per-worker minimum chunk for
+   the winner. The result is stored under key in the profile at path, unless
+   path is empty. */
+static int run_tune(const sort_config *base, unsigned int seed, const char *path, const char *key) {
+    static const int algos[] = {ALGO_LSD, ALGO_ONESWEEP, ALGO_BUCKET, ALGO_MSD};
+    static const long grains[] = {4096, 16384, 65536, 262144};
+    static const long chunks[] = {16384, 65536, 262144};
+    static const long small_sizes[] = {100000, 500000, 2000000};
+
+    printf("[tune] %s: %d keys, best of %d\n", key, TUNE_N, TUNE_REPS);
+    sort_config cfg = *base;
+    sort_config best = *base;
+    double best_time = -1.0;
+    for (size_t a = 0; a < sizeof(algos) / sizeof(algos[0]); ++a) {
+        int max_threads = base->place.threads;
+        for (int threads = 1;; threads = threads * 2 < max_threads ? threads * 2 : max_threads) {
+            cfg.algo = algos[a];
+            cfg.place.threads = threads;
+            double t = tune_time(&cfg, TUNE_N, seed);
+            printf("[tune] %-8s | threads = %2d | time = %.3f s\n", algo_name(cfg.algo), threads, t);
+            if (best_time < 0.0 || t < best_time) {
+                best = cfg;
+                best_time = t;
+            }
+            if (threads >= max_threads) {
+                break;
+            }
+        }
+    }
+
+    if (best.algo == ALGO_MSD) {
+        cfg = best;
+        for (size_t g = 0; g < sizeof(grains) / sizeof(grains[0]); ++g) {
+            cfg.task_grain = grains[g];
+            double t = tune_time(&cfg, TUNE_N, seed);
+            printf("[tune] task_grain = %7ld | time = %.3f s\n", grains[g], t);
+            if (t < best_time) {
+                best = cfg;
+                best_time = t;
+            }
+        }
+    }
+
+    /* The cutoff only matters for inputs a few chunks long, so time those. */
+    if (best.place.threads > 1) {
+        cfg = best;
+        double best_small = -1.0;
+        for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); ++c) {
+            cfg.place.min_chunk = chunks[c];
+            double t = 0.0;
+            for (size_t i = 0; i < sizeof(small_sizes) / sizeof(small_sizes[0]); ++i) {
+                t += tune_time(&cfg, small_sizes[i], seed);
+            }
+            printf("[tune] min_keys_per_thread = %7ld | time = %.3f s\n", chunks[c], t);
+            if (best_small < 0.0 || t < best_small) {
+                best.place.min_chunk = chunks[c];
+                best_small = t;
+            }
+        }
     }
+
+    tune_params params;
+    memset(&params, 0, sizeof(params));
+    snprintf(params.algo, sizeof(params.algo), "%s", algo_name(best.algo));
+    params.threads = best.place.threads;
+    params.min_keys_per_thread = best.place.min_chunk;
+    params.task_grain = best.task_grain;
+    printf("[tune] chosen: algo = %s | threads = %d | min_keys_per_thread = %ld | task_grain = %ld\n",
+           params.algo, params.threads, params.min_keys_per_thread, params.task_grain);
+    if (path[0] == '\0') {
+        return 0;
+    }
+    if (tune_profile_save(path, key, &params) != 0) {
+        fprintf(stderr, "[tune] Could not write profile %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    printf("[tune] Saved profile to %s\n", path);
+    return 0;
+}
+
+/* Fills in whatever the command line did not set from the saved profile. */
+static void apply_profile(sort_config *cfg, const char *path, const char *key,
+                          int algo_set, int threads_set) {
+    tune_params params;
+    if (tune_profile_load(path, key, &params) != 0) {
+        return;
+    }
+    int algo;
+    if (!algo_set && parse_algo(params.algo, &algo) == 0) {
+        cfg->algo = algo;
+    }
+    if (!threads_set && params.threads > 0) {
+        cfg->place.threads = params.threads;
+    }
+    if (params.min_keys_per_thread > 0) {
+        cfg->place.min_chunk = params.min_keys_per_thread;
+    }
+    if (params.task_grain > 0) {
+        cfg->task_grain = params.task_grain;
+    }
+    printf("[tune] Loaded profile %s\n", path);
+}
+
+/* --stream: sorts keys arriving on stdin to stdout, batch by batch as they
+   come. data_fd is the original stdout; by now stdout itself goes to stderr
+   so that reports never mix with the keys. Returns the process exit status. */
+static int run_stream_sort(sort_config *cfg,
+                           int data_fd,
+                           int key_bits,
+                           size_t mem_bytes,
+                           const char *tmpdir,
+                           int in_text,
+                           int out_text,
+                           int verify,
+                           int show_stats) {
+    if (!tmpdir) {
+        tmpdir = getenv("TMPDIR");
+        if (!tmpdir || tmpdir[0] == '\0') {
+            tmpdir = "/tmp";
+        }
+    }
+    if (mem_bytes == 0) {
+        mem_bytes = default_mem_budget();
+    }
+
+    stream_sort_config sc = {mem_bytes, key_bits, in_text, out_text, cfg->place.threads, tmpdir,
+                             sort_chunk, cfg};
+    if (key_bits == 32 && cfg->algo == ALGO_CTX) {
+        long batch_keys = (long)(mem_bytes / 8 / sizeof(int));
+        int rc = radix_ctx_create(&cfg->ctx, batch_keys, cfg->place.threads);
+        if (rc != RADIX_OK) {
+            fprintf(stderr, "[pthread] Failed to create sort context: %s\n", radix_strerror(rc));
+            return 1;
+        }
+    }
+
+    stream_sort_stats stats;
+    double t0 = sort_wall_time();
+    int rc = stream_sort_fd(0, data_fd, &sc, &stats);
+    double elapsed = sort_wall_time() - t0;
+    int saved = errno;
+    radix_ctx_destroy(cfg->ctx);
+    cfg->ctx = NULL;
+    if (rc != 0) {
+        fprintf(stderr, "[pthread] Stream sort failed: %s\n", strerror(saved));
+        return 1;
+    }
+
+    printf("[pthread] Stream-sorted %ld %d-bit keys (%s, %s in, %s out) in %.3f s "
+           "(%d batches of %.1f MB, %d spilled, budget %.1f MB).\n",
+           stats.keys, key_bits, key_bits == 64 ? "lsd64" : algo_name(cfg->algo),
+           in_text ? "text" : "binary", out_text ? "text" : "binary", elapsed, stats.batches,
+           (double)stats.batch_bytes / (1024.0 * 1024.0), stats.spilled,
+           (double)mem_bytes / (1024.0 * 1024.0));
+    if (show_stats) {
+        printf("[stream] read = %.3f s | sort = %.3f s | spill = %.3f s | merge = %.3f s\n",
+               stats.read_time, stats.sort_time, stats.spill_time, stats.merge_time);
+        driver_print_alloc_stats();
+    }
+    if (cfg->place.use_pool) {
+        driver_print_pool_stats();
+        scratch_pool_trim();
+    }
+    if (verify && stats.out_of_order != 0) {
+        fprintf(stderr, "Verification failed.\n");
+        return 1;
+    }
+    return 0;
+}
+
+/* --records: sorts the lines or length-prefixed blobs of --input by an
+   integer key from each, --key-field of a line or --key-offset into a
+   blob's payload, into --output or back over --input. Returns the process
+   exit status. */
+static int run_record_sort(sort_config *cfg,
+                           const char *input,
+                           const char *output,
+                           record_sort_config *rc_cfg,
+                           int verify,
+                           int show_stats) {
+    key_map in;
+    if (key_map_open(&in, input, 0, cfg->place.threads) != 0) {
+        fprintf(stderr, "[pthread] Cannot map %s: %s\n", input, strerror(errno));
+        return 1;
+    }
+    rc_cfg->threads = cfg->place.threads;
+    rc_cfg->sort_keys = sort_chunk;
+    rc_cfg->sort_arg = cfg;
+
+    record_index index;
+    double t0 = sort_wall_time();
+    if (record_sort_index((const char *)in.data, in.bytes, rc_cfg, &index) != 0) {
+        int saved = errno;
+        if (saved == ENOMEM) {
+            fprintf(stderr, "[pthread] Allocation failed\n");
+            exit(1);
+        }
+        if (index.bad_record >= 0) {
+            /* A record that stops extraction before it starts is one the
+               offset table could not frame. */
+            fprintf(stderr, "[pthread] %s: record %ld: %s\n", input, index.bad_record + 1,
+                    saved == ERANGE ? "key does not fit 64 bits"
+                    : index.extract_time == 0.0 ? "truncated record"
+                    : rc_cfg->extract == RECORD_KEY_FIELD ? "no unsigned decimal key field"
+                                                          : "too short for the key");
+        } else {
+            fprintf(stderr, "[pthread] Record sort of %s failed: %s\n", input, strerror(saved));
+        }
+        key_map_close(&in);
+        return 1;
+    }
+    double sort_time = sort_wall_time() - t0;
+
+    int ok = 1;
+    if (verify) {
+        /* Re-extracting the keys would repeat the code under test, so the
+           check is that every record appears exactly once. */
+        char *seen = (char *)calloc((size_t)(index.n > 0 ? index.n : 1), 1);
+        if (!seen) {
+            fprintf(stderr, "[pthread] Allocation failed\n");
+            exit(1);
+        }
+        for (long i = 0; i < index.n && ok; ++i) {
+            long r = index.order[i];
+            ok = r >= 0 && r < index.n && !seen[r];
+            if (ok) {
+                seen[r] = 1;
+            }
+        }
+        free(seen);
+    }
+
+    /* Writing back over the input needs the records out of the way first. */
+    const char *path = output ? output : input;
+    double t1 = sort_wall_time();
+    key_map out;
+    char *staged = NULL;
+    if (!output) {
+        staged = (char *)malloc(index.out_bytes > 0 ? index.out_bytes : 1);
+        if (!staged) {
+            fprintf(stderr, "[pthread] Allocation failed\n");
+            exit(1);
+        }
+        record_gather((const char *)in.data, &index, rc_cfg->framing, cfg->place.threads, staged);
+        key_map_close(&in);
+    }
+    if (key_map_create(&out, path, index.out_bytes) != 0) {
+        fprintf(stderr, "[pthread] Cannot create %s: %s\n", path, strerror(errno));
+        free(staged);
+        if (output) {
+            key_map_close(&in);
+        }
+        record_index_free(&index);
+        return 1;
+    }
+    if (staged) {
+        key_map_copy(out.data, staged, index.out_bytes, cfg->place.threads);
+        free(staged);
+    } else {
+        record_gather((const char *)in.data, &index, rc_cfg->framing, cfg->place.threads,
+                      (char *)out.data);
+        key_map_close(&in);
+    }
+    key_map_close(&out);
+    double gather_time = sort_wall_time() - t1;
+
+    printf("[pthread] Sorted %ld %s records from %s into %s with %d threads in %.3f s "
+           "(gather %.3f s).\n",
+           index.n, rc_cfg->framing == RECORD_LINES ? "line" : "prefixed", input, path,
+           cfg->place.threads, sort_time, gather_time);
+    if (show_stats) {
+        printf("[records] index = %.3f s | extract = %.3f s | sort = %.3f s (%s) | %.1f MB out\n",
+               index.index_time, index.extract_time, index.sort_time,
+               index.packed ? "packed key+record" : "lsd pairs",
+               (double)index.out_bytes / (1024.0 * 1024.0));
+        driver_print_alloc_stats();
+    }
+    if (cfg->place.use_pool) {
+        driver_print_pool_stats();
+        scratch_pool_trim();
+    }
+    record_index_free(&index);
+    if (verify && !ok) {
+        fprintf(stderr, "Verification failed.\n");
+        return 1;
+    }
+    return 0;
 }
 
 static void usage(const char *prog) {
     fprintf(stderr,
             "Usage: %s [--n <count>] [--threads <t>] [--verify] "
-            "[--seed <s>] [--bench] [--correctness]\n",
+            "[--seed <s>] [--algo lsd|onesweep|bucket|msd|ctx|auto] "
+            "[--affinity none|compact|scatter] [--numa local|interleave] [--pool] [--repeat <k>] "
+            "[--stats] [--dist uniform|narrow|sorted|runs] [--tune] [--profile <path>|none] "
+            "[--input <file> [--output <file>] [--key-bits 32|64] "
+            "[--in-format binary|text|packed] [--out-format binary|text|packed] "
+            "[--query <lo>:<hi>] "
+            "[--records lines|prefixed (--key-field <k> [--delim <c>] | --key-offset <off>:<width>)] "
+            "[--external [--mem <MB>] [--tmp-dir <dir>] [--io auto|uring|threads] "
+            "[--io-depth <d>] [--direct] [--compress-runs]] [--merge-into <sorted file>]] "
+            "[--stream [--mem <MB>] [--tmp-dir <dir>] [--key-bits 32|64] "
+            "[--in-format binary|text] [--out-format binary|text]] "
+            "[--bench] [--correctness]\n",
             prog);
 }
 
@@ -294,21 +1994,135 @@ int main(int argc, char **argv) {
     int verify = 0;
     int bench = 0;
     int correctness = 0;
-    int threads = default_thread_count();
+    int repeat = 1;
+    int show_stats = 0;
+    int tune = 0;
+    int algo_set = 0;
+    int threads_set = 0;
+    const char *profile_arg = NULL;
+    const char *input = NULL;
+    const char *output = NULL;
+    int key_bits = 32;
+    int external = 0;
+    int stream = 0;
+    long mem_mb = 0;
+    const char *tmpdir = NULL;
+    int io_kind = IO_AUTO;
+    int io_depth = IO_DEFAULT_DEPTH;
+    int direct = 0;
+    int compress_runs = 0;
+    int in_format = 0;
+    int out_format = -1;
+    const char *query = NULL;
+    const char *merge_into = NULL;
+    int records = -1;
+    record_sort_config rec_cfg = {RECORD_LINES, -1, 0, ' ', 0, 0, NULL, NULL, 1, NULL, NULL};
+    sort_config cfg = {{"[pthread]", default_thread_count(), AFFINITY_NONE, NUMA_FIRST_TOUCH, 0,
+                        NULL, 0},
+                       ALGO_LSD, NULL, MSD_TASK_GRAIN, DIST_UNIFORM, 0};
+    cfg.cpus = cfg.place.threads;
 
     for (int i = 1; i < argc; ++i) {
         if (strcmp(argv[i], "--n") == 0 && i + 1 < argc) {
             n = strtol(argv[++i], NULL, 10);
         } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
-            threads = (int)strtol(argv[++i], NULL, 10);
+            cfg.place.threads = (int)strtol(argv[++i], NULL, 10);
+            threads_set = 1;
         } else if (strcmp(argv[i], "--verify") == 0) {
             verify = 1;
         } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
             seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--algo") == 0 && i + 1 < argc) {
+            if (parse_algo(argv[++i], &cfg.algo) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            algo_set = 1;
+        } else if (strcmp(argv[i], "--affinity") == 0 && i + 1 < argc) {
+            if (parse_affinity(argv[++i], &cfg.place.affinity) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--numa") == 0 && i + 1 < argc) {
+            if (parse_numa_policy(argv[++i], &cfg.place.numa) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            show_stats = 1;
+        } else if (strcmp(argv[i], "--pool") == 0) {
+            cfg.place.use_pool = 1;
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = (int)strtol(argv[++i], NULL, 10);
         } else if (strcmp(argv[i], "--bench") == 0) {
             bench = 1;
         } else if (strcmp(argv[i], "--correctness") == 0) {
             correctness = 1;
+        } else if (strcmp(argv[i], "--dist") == 0 && i + 1 < argc) {
+            if (parse_dist(argv[++i], &cfg.dist) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            input = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "--key-bits") == 0 && i + 1 < argc) {
+            key_bits = (int)strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--in-format") == 0 && i + 1 < argc) {
+            if (driver_parse_format(argv[++i], &in_format) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--out-format") == 0 && i + 1 < argc) {
+            if (driver_parse_format(argv[++i], &out_format) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--merge-into") == 0 && i + 1 < argc) {
+            merge_into = argv[++i];
+        } else if (strcmp(argv[i], "--records") == 0 && i + 1 < argc) {
+            if (parse_framing(argv[++i], &records) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            rec_cfg.framing = records;
+        } else if (strcmp(argv[i], "--key-field") == 0 && i + 1 < argc) {
+            rec_cfg.extract = RECORD_KEY_FIELD;
+            rec_cfg.field = (int)strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--delim") == 0 && i + 1 < argc) {
+            const char *d = argv[++i];
+            rec_cfg.delim = strcmp(d, "\\t") == 0 ? '\t' : d[0];
+        } else if (strcmp(argv[i], "--key-offset") == 0 && i + 1 < argc) {
+            char *end = NULL;
+            rec_cfg.extract = RECORD_KEY_OFFSET;
+            rec_cfg.offset = (size_t)strtoull(argv[++i], &end, 10);
+            rec_cfg.width = *end == ':' ? (int)strtol(end + 1, NULL, 10) : 0;
+        } else if (strcmp(argv[i], "--query") == 0 && i + 1 < argc) {
+            query = argv[++i];
+        } else if (strcmp(argv[i], "--external") == 0) {
+            external = 1;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            stream = 1;
+        } else if (strcmp(argv[i], "--mem") == 0 && i + 1 < argc) {
+            mem_mb = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--tmp-dir") == 0 && i + 1 < argc) {
+            tmpdir = argv[++i];
+        } else if (strcmp(argv[i], "--io") == 0 && i + 1 < argc) {
+            if (parse_io_kind(argv[++i], &io_kind) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--io-depth") == 0 && i + 1 < argc) {
+            io_depth = (int)strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--direct") == 0) {
+            direct = 1;
+        } else if (strcmp(argv[i], "--compress-runs") == 0) {
+            compress_runs = 1;
+        } else if (strcmp(argv[i], "--tune") == 0) {
+            tune = 1;
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profile_arg = argv[++i];
         } else if (strcmp(argv[i], "--help") == 0) {
             usage(argv[0]);
             return 0;
@@ -322,29 +2136,200 @@ int main(int argc, char **argv) {
         fprintf(stderr, "n must be non-negative\n");
         return 1;
     }
-    if (threads < 1) {
+    if (cfg.place.threads < 1) {
         fprintf(stderr, "threads must be >= 1\n");
         return 1;
     }
+    if (repeat < 1) {
+        fprintf(stderr, "repeat must be >= 1\n");
+        return 1;
+    }
+    if (key_bits != 32 && key_bits != 64) {
+        fprintf(stderr, "key-bits must be 32 or 64\n");
+        return 1;
+    }
+    if (output && !input) {
+        fprintf(stderr, "--output needs --input\n");
+        return 1;
+    }
+    if (external && !input) {
+        fprintf(stderr, "--external needs --input\n");
+        return 1;
+    }
+    if (mem_mb < 0) {
+        fprintf(stderr, "mem must be non-negative\n");
+        return 1;
+    }
+    if (out_format < 0) {
+        out_format = in_format;
+    }
+    if (external && (in_format || out_format)) {
+        fprintf(stderr, "--external sorts binary key files only\n");
+        return 1;
+    }
+    if (io_depth < 1) {
+        fprintf(stderr, "io-depth must be >= 1\n");
+        return 1;
+    }
+    if (stream && (input || external)) {
+        fprintf(stderr, "--stream reads stdin; it does not take --input or --external\n");
+        return 1;
+    }
+    if (stream && (in_format == FORMAT_PACKED || out_format == FORMAT_PACKED)) {
+        fprintf(stderr, "--stream reads and writes binary or text keys only\n");
+        return 1;
+    }
+    if (merge_into && (!input || output)) {
+        fprintf(stderr, "--merge-into takes the new keys from --input and has no --output\n");
+        return 1;
+    }
+    if (merge_into && (in_format || out_format)) {
+        fprintf(stderr, "--merge-into merges binary key files only\n");
+        return 1;
+    }
+    if (records >= 0 && (!input || external || stream || merge_into || query)) {
+        fprintf(stderr, "--records sorts an --input file on its own\n");
+        return 1;
+    }
+    if (records >= 0 && rec_cfg.extract < 0) {
+        fprintf(stderr, "--records needs --key-field or --key-offset\n");
+        return 1;
+    }
+    if (rec_cfg.extract == RECORD_KEY_FIELD && (rec_cfg.field < 0 || rec_cfg.delim == '\0')) {
+        fprintf(stderr, "key-field must be >= 0 with a non-empty delim\n");
+        return 1;
+    }
+    if (rec_cfg.extract == RECORD_KEY_OFFSET && (rec_cfg.width < 1 || rec_cfg.width > 8)) {
+        fprintf(stderr, "key-offset takes <offset>:<width> with a width of 1 to 8 bytes\n");
+        return 1;
+    }
+    if (query && !input) {
+        fprintf(stderr, "--query needs a packed --input file\n");
+        return 1;
+    }
+
+    /* With --stream stdout carries the sorted keys, so everything printed
+       goes to stderr instead. */
+    int data_fd = -1;
+    if (stream) {
+        fflush(stdout);
+        data_fd = dup(1);
+        if (data_fd < 0 || dup2(2, 1) < 0) {
+            fprintf(stderr, "[pthread] Cannot redirect stdout: %s\n", strerror(errno));
+            return 1;
+        }
+    }
+
+    cpu_topology topo;
+    if (topology_load(&topo) != 0) {
+        fprintf(stderr, "[pthread] Allocation failed for CPU topology\n");
+        return 1;
+    }
+    cfg.place.topo = &topo;
+
+    char profile_path[TUNE_PATH_MAX] = "";
+    if (profile_arg) {
+        if (strcmp(profile_arg, "none") != 0) {
+            snprintf(profile_path, sizeof(profile_path), "%s", profile_arg);
+        }
+    } else if (tune_default_path(profile_path, sizeof(profile_path)) != 0) {
+        profile_path[0] = '\0';
+    }
+    char profile_key[TUNE_KEY_MAX];
+    tune_machine_key("pthread", profile_key, sizeof(profile_key));
+    if (tune) {
+        int rc = run_tune(&cfg, seed, profile_path, profile_key);
+        if (cfg.place.use_pool) {
+            scratch_pool_trim();
+        }
+        topology_free(&topo);
+        return rc;
+    }
+    if (profile_path[0] != '\0') {
+        apply_profile(&cfg, profile_path, profile_key, algo_set, threads_set);
+    }
+
+    if (query) {
+        topology_free(&topo);
+        return run_query(input, query);
+    }
+    if (records >= 0) {
+        int rc = run_record_sort(&cfg, input, output, &rec_cfg, verify, show_stats);
+        topology_free(&topo);
+        return rc;
+    }
+    if (stream) {
+        int rc = run_stream_sort(&cfg, data_fd, key_bits, (size_t)mem_mb << 20, tmpdir,
+                                 in_format == FORMAT_TEXT, out_format == FORMAT_TEXT, verify,
+                                 show_stats);
+        close(data_fd);
+        topology_free(&topo);
+        return rc;
+    }
+    if (input && (external || merge_into)) {
+        int rc = run_external_sort(&cfg, input, output, merge_into, key_bits, (size_t)mem_mb << 20, tmpdir,
+                                   io_kind, io_depth, direct, compress_runs, verify, show_stats);
+        topology_free(&topo);
+        return rc;
+    }
+    if (input) {
+        int rc = run_input_sort(&cfg, input, output, key_bits, in_format, out_format, verify,
+                                show_stats);
+        topology_free(&topo);
+        return rc;
+    }
+
+    /* One context serves every sort of this run, sized for the largest. */
+    if (cfg.algo == ALGO_CTX) {
+        long max_n = bench ? 10000000 : (n > 20 ? n : 20);
+        long check_n = (long)(ext_chunk_bytes(EXT_CHECK_MEM, 32) / sizeof(int));
+        check_n = check_n > ARROW_CHECK_N ? check_n : ARROW_CHECK_N;
+        max_n = correctness && max_n < check_n ? check_n : max_n;
+        int rc = radix_ctx_create(&cfg.ctx, max_n, cfg.place.threads);
+        if (rc != RADIX_OK) {
+            fprintf(stderr, "[pthread] Failed to create sort context: %s\n", radix_strerror(rc));
+            topology_free(&topo);
+            return 1;
+        }
+    }
 
     if (correctness) {
-        run_correctness_suite(threads, seed);
+        run_correctness_suite(&cfg, seed);
+        radix_ctx_destroy(cfg.ctx);
+        topology_free(&topo);
         return 0;
     }
 
     if (bench) {
-        run_benchmarks(threads, verify, seed);
+        run_benchmarks(&cfg, verify, show_stats, repeat, seed);
+        if (cfg.place.use_pool) {
+            driver_print_pool_stats();
+            scratch_pool_trim();
+        }
+        radix_ctx_destroy(cfg.ctx);
+        topology_free(&topo);
         return 0;
     }
 
     double elapsed = 0.0;
-    int ok = run_random_case(n, threads, verify, seed, &elapsed);
-    printf("[pthread] Sorted %ld integers with %d threads in %.3f s.\n",
-           n, threads, elapsed);
+    sort_stats stats;
+    int ok = run_random_case(n, &cfg, verify, seed, &elapsed, &stats);
+    printf("[pthread] Sorted %ld integers (%s) with %d threads in %.3f s.\n",
+           n, algo_name(cfg.algo), cfg.place.threads, elapsed);
+    if (show_stats) {
+        driver_print_bandwidth(&stats.bw);
+        print_stats(&stats);
+        driver_print_alloc_stats();
+    }
+    if (cfg.place.use_pool) {
+        driver_print_pool_stats();
+        scratch_pool_trim();
+    }
+    radix_ctx_destroy(cfg.ctx);
+    topology_free(&topo);
     if (verify && !ok) {
         fprintf(stderr, "Verification failed.\n");
         return 1;
     }
     return 0;
 }
-
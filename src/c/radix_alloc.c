@@ -0,0 +1,155 @@
+#include "radix_alloc.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "radix_ctx.h"
+
+static atomic_ulong heap_allocs;
+static atomic_ulong custom_allocs;
+static atomic_ulong frees;
+static atomic_ulong failures;
+static atomic_size_t bytes_total;
+
+void radix_alloc_get_stats(radix_alloc_stats *out) {
+    out->heap_allocs = atomic_load(&heap_allocs);
+    out->custom_allocs = atomic_load(&custom_allocs);
+    out->frees = atomic_load(&frees);
+    out->failures = atomic_load(&failures);
+    out->bytes = atomic_load(&bytes_total);
+}
+
+void radix_alloc_reset_stats(void) {
+    atomic_store(&heap_allocs, 0);
+    atomic_store(&custom_allocs, 0);
+    atomic_store(&frees, 0);
+    atomic_store(&failures, 0);
+    atomic_store(&bytes_total, 0);
+}
+
+/* Every block the kernels use holds keys, values, counts or thread
+   handles, none of which needs more than this. */
+#define SCRATCH_ALIGN 16
+
+void *radix_scratch_alloc(const radix_allocator *a, size_t bytes) {
+    if (bytes == 0) {
+        bytes = 1;
+    }
+    void *p = a ? a->alloc(a->state, bytes, SCRATCH_ALIGN) : malloc(bytes);
+    if (!p) {
+        atomic_fetch_add(&failures, 1);
+        return NULL;
+    }
+    atomic_fetch_add(a ? &custom_allocs : &heap_allocs, 1);
+    atomic_fetch_add(&bytes_total, bytes);
+    return p;
+}
+
+void radix_scratch_free(const radix_allocator *a, void *ptr, size_t bytes) {
+    if (!ptr) {
+        return;
+    }
+    atomic_fetch_add(&frees, 1);
+    if (a) {
+        a->release(a->state, ptr, bytes ? bytes : 1);
+    } else {
+        free(ptr);
+    }
+}
+
+/* ---- Arena ------------------------------------------------------------- */
+
+struct radix_arena {
+    radix_allocator allocator;
+    char *base;
+    size_t capacity;
+    size_t used;
+    size_t peak;
+    unsigned long allocs;
+    unsigned long failures;
+};
+
+/* Block sizes are rounded up to this, so the top stays aligned for the
+   next block and a block of at most this alignment needs no padding. */
+#define ARENA_GRAIN 16
+
+static size_t arena_round(size_t bytes) {
+    return (bytes + ARENA_GRAIN - 1) & ~(size_t)(ARENA_GRAIN - 1);
+}
+
+static void *arena_alloc(void *state, size_t bytes, size_t align) {
+    radix_arena *a = (radix_arena *)state;
+    uintptr_t start = (uintptr_t)a->base + a->used;
+    size_t pad = (size_t)(-start & (uintptr_t)(align - 1));
+    if (bytes > a->capacity) {
+        a->failures++;
+        return NULL;
+    }
+    bytes = arena_round(bytes ? bytes : 1);
+    if (pad > a->capacity - a->used || bytes > a->capacity - a->used - pad) {
+        a->failures++;
+        return NULL;
+    }
+    char *p = a->base + a->used + pad;
+    a->used += pad + bytes;
+    a->peak = a->used > a->peak ? a->used : a->peak;
+    a->allocs++;
+    return p;
+}
+
+/* Only the block on top can be given back. Padding in front of an
+   over-aligned block stays used until the next reset. */
+static void arena_release(void *state, void *ptr, size_t bytes) {
+    radix_arena *a = (radix_arena *)state;
+    char *p = (char *)ptr;
+    if (p + arena_round(bytes) == a->base + a->used) {
+        a->used = (size_t)(p - a->base);
+    }
+}
+
+int radix_arena_create(radix_arena **out, size_t capacity) {
+    if (!out || capacity == 0) {
+        return RADIX_EINVAL;
+    }
+    *out = NULL;
+    radix_arena *a = (radix_arena *)calloc(1, sizeof(radix_arena));
+    if (!a) {
+        return RADIX_ENOMEM;
+    }
+    a->base = (char *)malloc(capacity);
+    if (!a->base) {
+        free(a);
+        return RADIX_ENOMEM;
+    }
+    a->capacity = capacity;
+    a->allocator.alloc = arena_alloc;
+    a->allocator.release = arena_release;
+    a->allocator.state = a;
+    *out = a;
+    return RADIX_OK;
+}
+
+const radix_allocator *radix_arena_allocator(radix_arena *arena) {
+    return &arena->allocator;
+}
+
+void radix_arena_reset(radix_arena *arena) {
+    arena->used = 0;
+}
+
+void radix_arena_get_stats(const radix_arena *arena, radix_arena_stats *out) {
+    out->capacity = arena->capacity;
+    out->used = arena->used;
+    out->peak = arena->peak;
+    out->allocs = arena->allocs;
+    out->failures = arena->failures;
+}
+
+void radix_arena_destroy(radix_arena *arena) {
+    if (!arena) {
+        return;
+    }
+    free(arena->base);
+    free(arena);
+}
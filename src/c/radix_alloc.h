@@ -0,0 +1,76 @@
+#ifndef RADIX_ALLOC_H
+#define RADIX_ALLOC_H
+
+#include <stddef.h>
+
+/* Where libradix and radix_ctx take their scratch memory from.
+
+   Every scratch block (the ping-pong buffer, histograms, thread tables,
+   argsort's key copy) is requested through a radix_allocator. A NULL
+   allocator means malloc/free. The library frees blocks in the reverse of
+   the order it took them, so a stack-like allocator gets all of its space
+   back after every sort.
+
+   radix_arena is the built-in one: a single block taken from malloc when
+   the arena is created, handed out by bumping an offset. It never falls
+   back to the heap; a request that does not fit fails, and the sort
+   returns RADIX_ENOMEM. Freeing the most recent block gives its space back,
+   and radix_arena_reset empties the arena at once. An arena serves one
+   sort at a time. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    /* Returns bytes bytes aligned to align (a power of two), or NULL. */
+    void *(*alloc)(void *state, size_t bytes, size_t align);
+    /* ptr and bytes are those of an earlier alloc. */
+    void (*release)(void *state, void *ptr, size_t bytes);
+    void *state;
+} radix_allocator;
+
+/* Scratch blocks the library took since start or the last reset. */
+typedef struct {
+    unsigned long heap_allocs;      /* from malloc: no allocator was given */
+    unsigned long custom_allocs;    /* from a caller's radix_allocator */
+    unsigned long frees;
+    unsigned long failures;         /* requests either kind could not serve */
+    size_t bytes;                   /* total size of every block handed out */
+} radix_alloc_stats;
+
+void radix_alloc_get_stats(radix_alloc_stats *out);
+void radix_alloc_reset_stats(void);
+
+/* Takes bytes from a (malloc when NULL) and counts it; NULL on failure. */
+void *radix_scratch_alloc(const radix_allocator *a, size_t bytes);
+void radix_scratch_free(const radix_allocator *a, void *ptr, size_t bytes);
+
+typedef struct radix_arena radix_arena;
+
+typedef struct {
+    size_t capacity;
+    size_t used;
+    size_t peak;
+    unsigned long allocs;
+    unsigned long failures;         /* requests that did not fit */
+} radix_arena_stats;
+
+/* Takes capacity bytes from malloc; returns RADIX_OK, RADIX_EINVAL or
+   RADIX_ENOMEM. */
+int radix_arena_create(radix_arena **out, size_t capacity);
+
+/* The arena as an allocator; valid until the arena is destroyed. */
+const radix_allocator *radix_arena_allocator(radix_arena *arena);
+
+/* Forgets every block; the next alloc starts at the beginning again. */
+void radix_arena_reset(radix_arena *arena);
+
+void radix_arena_get_stats(const radix_arena *arena, radix_arena_stats *out);
+void radix_arena_destroy(radix_arena *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,344 @@
+#ifndef _WIN32
+#define _XOPEN_SOURCE 700
+#endif
+
+#include "radix_ctx.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#include "radix_kernel.h"
+
+#define RADIX_BITS 8
+#define RADIX (1 << RADIX_BITS)
+
+/* Inputs this small are sorted on the calling thread without waking the pool. */
+#define RADIX_CTX_SERIAL_CUTOFF 16384
+
+typedef struct {
+    radix_ctx *ctx;
+    int tid;
+} ctx_worker_arg;
+
+typedef struct {
+    int *arr;
+    long n;
+    radix_ctx_done done;
+    void *arg;
+} ctx_job;
+
+struct radix_ctx {
+    long max_n;
+    int threads;
+    const radix_allocator *alloc;
+    int *tmp;
+    size_t *counts;            /* threads * RADIX */
+    pthread_t *tids;           /* threads - 1 pool workers; the caller is tid 0 */
+    ctx_worker_arg *args;
+    int started;
+    pthread_barrier_t pass;    /* synchronises the steps inside a pass */
+
+    /* Job hand-off: the caller publishes the job and bumps `generation`. */
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    unsigned long generation;
+    int stop;
+    radix_lsd_job job;
+
+    /* One sort uses the pool and tmp at a time, whoever runs it. */
+    pthread_mutex_t run;
+
+    /* Submitted sorts wait in a ring, guarded by `lock`, until the runner
+       thread takes them in order and leads the pool as tid 0. Ticket t is
+       in slot (t - 1) % RADIX_CTX_QUEUE. */
+    ctx_job *queue;
+    unsigned long submitted;   /* the last ticket handed out */
+    unsigned long taken;       /* the last ticket the runner took */
+    unsigned long completed;   /* every ticket up to this one is sorted */
+    int busy;                  /* the runner holds a taken ticket or runs its callback */
+    pthread_cond_t queued;     /* the runner waits here for work */
+    pthread_cond_t finished;   /* radix_ctx_wait waits here */
+    pthread_t runner;
+    int runner_started;
+};
+
+/* Sets j up to sort arr[0, n) on `threads` threads through the libradix
+   kernel, with the context's tmp and counts. */
+static void ctx_job_init(radix_lsd_job *j, radix_ctx *ctx, int *arr, long n, int threads) {
+    memset(j, 0, sizeof(*j));
+    j->key_bytes = (int)sizeof(int);
+    j->n = (size_t)n;
+    j->threads = threads;
+    j->keys = (char *)arr;
+    j->tmp_keys = (char *)ctx->tmp;
+    j->counts = ctx->counts;
+    j->alloc = ctx->alloc;
+    j->sync = threads > 1 ? radix_lsd_sync_barrier : radix_lsd_sync_none;
+    j->barrier = &ctx->pass;
+}
+
+/* Thread tid's share of the published job. The kernel's last step is each
+   thread copying its own slice back, so the pool meets once more before
+   the caller may return. */
+static void ctx_lsd(radix_ctx *ctx, int tid) {
+    radix_lsd_run(&ctx->job, tid);
+    pthread_barrier_wait(&ctx->pass);
+}
+
+/* Sorts arr[0, n) with the calling thread as tid 0. */
+static void ctx_run(radix_ctx *ctx, int *arr, long n) {
+    if (n <= 1) {
+        return;
+    }
+    pthread_mutex_lock(&ctx->run);
+    if (ctx->threads == 1 || n <= RADIX_CTX_SERIAL_CUTOFF) {
+        radix_lsd_job serial;
+        ctx_job_init(&serial, ctx, arr, n, 1);
+        radix_lsd_run(&serial, 0);
+    } else {
+        pthread_mutex_lock(&ctx->lock);
+        ctx_job_init(&ctx->job, ctx, arr, n, ctx->threads);
+        ctx->generation++;
+        pthread_cond_broadcast(&ctx->wake);
+        pthread_mutex_unlock(&ctx->lock);
+        ctx_lsd(ctx, 0);
+        /* ctx_lsd ends on a barrier, so every worker has finished writing. */
+    }
+    pthread_mutex_unlock(&ctx->run);
+}
+
+/* Runs queued sorts in ticket order. A ticket counts as completed before
+   its callback runs, so the callback and anything it resumes may wait on
+   it. The runner stays busy until the callback returns, and destroy waits
+   for that, so whatever a callback submits still runs on a live pool. */
+static void *ctx_runner(void *arg) {
+    radix_ctx *ctx = (radix_ctx *)arg;
+    pthread_mutex_lock(&ctx->lock);
+    for (;;) {
+        while (ctx->taken == ctx->submitted && !ctx->stop) {
+            pthread_cond_wait(&ctx->queued, &ctx->lock);
+        }
+        if (ctx->taken == ctx->submitted) {
+            break;
+        }
+        ctx_job job = ctx->queue[ctx->taken % RADIX_CTX_QUEUE];
+        ctx->taken++;
+        ctx->busy = 1;
+        pthread_mutex_unlock(&ctx->lock);
+
+        ctx_run(ctx, job.arr, job.n);
+
+        pthread_mutex_lock(&ctx->lock);
+        ctx->completed++;
+        pthread_cond_broadcast(&ctx->finished);
+        pthread_mutex_unlock(&ctx->lock);
+        if (job.done) {
+            job.done(job.arg, RADIX_OK);
+        }
+        pthread_mutex_lock(&ctx->lock);
+        ctx->busy = 0;
+        pthread_cond_broadcast(&ctx->finished);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    return NULL;
+}
+
+static void *ctx_worker(void *arg) {
+    ctx_worker_arg *w = (ctx_worker_arg *)arg;
+    radix_ctx *ctx = w->ctx;
+    unsigned long seen = 0;
+    for (;;) {
+        pthread_mutex_lock(&ctx->lock);
+        while (ctx->generation == seen && !ctx->stop) {
+            pthread_cond_wait(&ctx->wake, &ctx->lock);
+        }
+        /* A published sort still needs this worker at its barriers, even
+           if stop was set in the meantime. */
+        int run = ctx->generation != seen;
+        seen = ctx->generation;
+        pthread_mutex_unlock(&ctx->lock);
+        if (!run) {
+            break;
+        }
+        ctx_lsd(ctx, w->tid);
+    }
+    return NULL;
+}
+
+const char *radix_strerror(int err) {
+    switch (err) {
+    case RADIX_OK:
+        return "success";
+    case RADIX_EINVAL:
+        return "invalid argument";
+    case RADIX_ENOMEM:
+        return "out of memory";
+    case RADIX_ETHREAD:
+        return "could not start worker threads";
+    case RADIX_EBUSY:
+        return "submission queue full";
+    default:
+        return "unknown error";
+    }
+}
+
+/* Blocks go back in the reverse of the order ctx_create took them. */
+static void ctx_free(radix_ctx *ctx) {
+    const radix_allocator *a = ctx->alloc;
+    radix_scratch_free(a, ctx->queue, sizeof(ctx_job) * RADIX_CTX_QUEUE);
+    radix_scratch_free(a, ctx->args, sizeof(ctx_worker_arg) * ctx->threads);
+    radix_scratch_free(a, ctx->tids, sizeof(pthread_t) * ctx->threads);
+    radix_scratch_free(a, ctx->counts, sizeof(size_t) * RADIX * ctx->threads);
+    radix_scratch_free(a, ctx->tmp, sizeof(int) * (ctx->max_n > 0 ? ctx->max_n : 1));
+    radix_scratch_free(a, ctx, sizeof(radix_ctx));
+}
+
+int radix_ctx_create(radix_ctx **out, long max_n, int threads) {
+    return radix_ctx_create_with(out, max_n, threads, NULL);
+}
+
+int radix_ctx_create_with(radix_ctx **out, long max_n, int threads,
+                          const radix_allocator *alloc) {
+    if (!out || max_n < 0 || threads < 1) {
+        return RADIX_EINVAL;
+    }
+    *out = NULL;
+
+    radix_ctx *ctx = (radix_ctx *)radix_scratch_alloc(alloc, sizeof(radix_ctx));
+    if (!ctx) {
+        return RADIX_ENOMEM;
+    }
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->max_n = max_n;
+    ctx->threads = threads;
+    ctx->alloc = alloc;
+    ctx->tmp = (int *)radix_scratch_alloc(alloc, sizeof(int) * (max_n > 0 ? max_n : 1));
+    ctx->counts = (size_t *)radix_scratch_alloc(alloc, sizeof(size_t) * RADIX * threads);
+    ctx->tids = (pthread_t *)radix_scratch_alloc(alloc, sizeof(pthread_t) * threads);
+    ctx->args = (ctx_worker_arg *)radix_scratch_alloc(alloc, sizeof(ctx_worker_arg) * threads);
+    ctx->queue = (ctx_job *)radix_scratch_alloc(alloc, sizeof(ctx_job) * RADIX_CTX_QUEUE);
+    if (!ctx->tmp || !ctx->counts || !ctx->tids || !ctx->args || !ctx->queue) {
+        ctx_free(ctx);
+        return RADIX_ENOMEM;
+    }
+
+    if (pthread_barrier_init(&ctx->pass, NULL, threads) != 0) {
+        ctx_free(ctx);
+        return RADIX_ETHREAD;
+    }
+    pthread_mutex_init(&ctx->lock, NULL);
+    pthread_cond_init(&ctx->wake, NULL);
+    pthread_mutex_init(&ctx->run, NULL);
+    pthread_cond_init(&ctx->queued, NULL);
+    pthread_cond_init(&ctx->finished, NULL);
+
+    for (int t = 1; t < threads; ++t) {
+        ctx->args[t].ctx = ctx;
+        ctx->args[t].tid = t;
+        if (pthread_create(&ctx->tids[t], NULL, ctx_worker, &ctx->args[t]) != 0) {
+            /* The pass barrier needs every worker, so a partial pool can
+               never run a sort; stop the workers that did start. */
+            radix_ctx_destroy(ctx);
+            return RADIX_ETHREAD;
+        }
+        ctx->started = t;
+    }
+
+    *out = ctx;
+    return RADIX_OK;
+}
+
+int radix_ctx_sort(radix_ctx *ctx, int *arr, long n) {
+    if (!ctx || n < 0 || n > ctx->max_n || (n > 0 && !arr)) {
+        return RADIX_EINVAL;
+    }
+    ctx_run(ctx, arr, n);
+    return RADIX_OK;
+}
+
+int radix_ctx_submit(radix_ctx *ctx, int *arr, long n, radix_ctx_done done, void *arg,
+                     radix_ticket *ticket) {
+    if (!ctx || !ticket || n < 0 || n > ctx->max_n || (n > 0 && !arr)) {
+        return RADIX_EINVAL;
+    }
+    pthread_mutex_lock(&ctx->lock);
+    int rc = RADIX_OK;
+    if (ctx->stop) {
+        rc = RADIX_EINVAL;
+    } else if (ctx->submitted - ctx->taken == RADIX_CTX_QUEUE) {
+        rc = RADIX_EBUSY;
+    } else if (!ctx->runner_started) {
+        /* Started on first use, so synchronous callers never pay for it. */
+        if (pthread_create(&ctx->runner, NULL, ctx_runner, ctx) == 0) {
+            ctx->runner_started = 1;
+        } else {
+            rc = RADIX_ETHREAD;
+        }
+    }
+    if (rc == RADIX_OK) {
+        ctx->queue[ctx->submitted % RADIX_CTX_QUEUE] = (ctx_job){arr, n, done, arg};
+        *ticket = ++ctx->submitted;
+        pthread_cond_signal(&ctx->queued);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    return rc;
+}
+
+int radix_ctx_poll(radix_ctx *ctx, radix_ticket ticket) {
+    if (!ctx) {
+        return RADIX_EINVAL;
+    }
+    pthread_mutex_lock(&ctx->lock);
+    int rc = ticket == 0 || ticket > ctx->submitted ? RADIX_EINVAL : ticket <= ctx->completed;
+    pthread_mutex_unlock(&ctx->lock);
+    return rc;
+}
+
+int radix_ctx_wait(radix_ctx *ctx, radix_ticket ticket) {
+    if (!ctx) {
+        return RADIX_EINVAL;
+    }
+    pthread_mutex_lock(&ctx->lock);
+    int rc = ticket == 0 || ticket > ctx->submitted ? RADIX_EINVAL : RADIX_OK;
+    while (rc == RADIX_OK && ctx->completed < ticket) {
+        pthread_cond_wait(&ctx->finished, &ctx->lock);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    return rc;
+}
+
+void radix_ctx_destroy(radix_ctx *ctx) {
+    if (!ctx) {
+        return;
+    }
+    pthread_mutex_lock(&ctx->lock);
+    /* A callback may still submit more, so wait for an idle runner. */
+    while (ctx->completed < ctx->submitted || ctx->busy) {
+        pthread_cond_wait(&ctx->finished, &ctx->lock);
+    }
+    ctx->stop = 1;
+    pthread_cond_broadcast(&ctx->wake);
+    pthread_cond_broadcast(&ctx->queued);
+    pthread_mutex_unlock(&ctx->lock);
+    if (ctx->runner_started) {
+        pthread_join(ctx->runner, NULL);
+    }
+    for (int t = 1; t <= ctx->started; ++t) {
+        pthread_join(ctx->tids[t], NULL);
+    }
+    pthread_barrier_destroy(&ctx->pass);
+    pthread_mutex_destroy(&ctx->lock);
+    pthread_cond_destroy(&ctx->wake);
+    pthread_mutex_destroy(&ctx->run);
+    pthread_cond_destroy(&ctx->queued);
+    pthread_cond_destroy(&ctx->finished);
+    ctx_free(ctx);
+}
+
+long radix_ctx_max_n(const radix_ctx *ctx) {
+    return ctx->max_n;
+}
+
+int radix_ctx_threads(const radix_ctx *ctx) {
+    return ctx->threads;
+}
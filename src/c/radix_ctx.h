@@ -0,0 +1,85 @@
+#ifndef RADIX_CTX_H
+#define RADIX_CTX_H
+
+/* Reusable sort context for long-running callers.
+
+   A context is created once for a maximum input size and thread count. It
+   owns the scratch buffer, the histogram storage and a pool of worker
+   threads, so radix_ctx_sort performs no allocation and creates no threads.
+   Every function reports failure through its return value; nothing here
+   prints or exits. A context sorts one array at a time: sorts from
+   several threads, or submitted ones, take turns on the pool.
+
+   radix_ctx_submit queues a sort and returns at once with a ticket. Queued
+   sorts run in submission order on the same workers, led by a runner
+   thread the context starts on first use, so the caller can carry on with
+   other work. Completion can be awaited (radix_ctx_wait), polled
+   (radix_ctx_poll), or signalled by a callback, which runs on the runner
+   thread after the ticket counts as completed. A callback may submit more
+   sorts or wait on finished tickets. It must not destroy the context, and
+   until it returns the next queued sort does not start. The array must
+   stay untouched until its sort completes. */
+
+#include "radix_alloc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct radix_ctx radix_ctx;
+
+enum {
+    RADIX_OK = 0,
+    RADIX_EINVAL = -1,  /* bad argument, e.g. n larger than the context's max_n */
+    RADIX_ENOMEM = -2,  /* scratch allocation failed */
+    RADIX_ETHREAD = -3, /* worker threads or their barrier could not be created */
+    RADIX_EBUSY = -4    /* the submission queue is full; wait for a ticket and retry */
+};
+
+/* Sorts a context holds queued at once, not counting the one running. */
+#define RADIX_CTX_QUEUE 64
+
+/* Tickets number submissions from 1 upward; 0 is never a ticket. */
+typedef unsigned long radix_ticket;
+
+/* Called with the arg given to radix_ctx_submit and RADIX_OK. */
+typedef void (*radix_ctx_done)(void *arg, int rc);
+
+/* On success stores the new context in *out and returns RADIX_OK. */
+int radix_ctx_create(radix_ctx **out, long max_n, int threads);
+
+/* The same, with the context and its scratch taken from alloc (malloc when
+   NULL), which must outlive the context. */
+int radix_ctx_create_with(radix_ctx **out, long max_n, int threads,
+                          const radix_allocator *alloc);
+
+/* Sorts arr[0, n) ascending as unsigned 32-bit keys. n may not exceed max_n. */
+int radix_ctx_sort(radix_ctx *ctx, int *arr, long n);
+
+/* Queues a sort of arr[0, n) like radix_ctx_sort and stores its ticket in
+   *ticket. done may be NULL. Returns RADIX_EBUSY when RADIX_CTX_QUEUE sorts
+   are already waiting, and RADIX_EINVAL once radix_ctx_destroy has stopped
+   the context. */
+int radix_ctx_submit(radix_ctx *ctx, int *arr, long n, radix_ctx_done done, void *arg,
+                     radix_ticket *ticket);
+
+/* Blocks until the sort of ticket has completed; RADIX_OK or RADIX_EINVAL. */
+int radix_ctx_wait(radix_ctx *ctx, radix_ticket ticket);
+
+/* 1 if the sort of ticket has completed, 0 if not, or RADIX_EINVAL. */
+int radix_ctx_poll(radix_ctx *ctx, radix_ticket ticket);
+
+/* Waits for every submitted sort, including those the callbacks submit,
+   and for the last callback to return, then stops the workers and frees
+   everything the context owns. */
+void radix_ctx_destroy(radix_ctx *ctx);
+
+long radix_ctx_max_n(const radix_ctx *ctx);
+int radix_ctx_threads(const radix_ctx *ctx);
+const char *radix_strerror(int err);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
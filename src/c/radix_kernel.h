@@ -0,0 +1,46 @@
+#ifndef RADIX_KERNEL_H
+#define RADIX_KERNEL_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "libradix.h"
+
+/* The LSD kernel behind libradix.c, shared with radix_ctx.c; not part of
+   the installed API.
+
+   A job is one sort split over `threads` threads, each running
+   radix_lsd_run with its own tid. sync must make every thread of the job
+   wait for the others; the kernel calls it three times per pass. The data
+   is back in keys (and vals) once every thread has returned, not before. */
+
+typedef struct radix_lsd_job radix_lsd_job;
+
+struct radix_lsd_job {
+    int key_bytes;           /* 4 or 8 */
+    int val_bytes;           /* 0, 4 or 8 */
+    size_t n;
+    int threads;
+    char *keys;
+    char *vals;
+    char *tmp_keys;
+    char *tmp_vals;
+    size_t *counts;          /* threads * RADIX, digit offsets after the prefix */
+    const radix_allocator *alloc;
+    unsigned int digits;     /* as radix_options.digits */
+    int first_touch;
+    radix_worker_begin_fn worker_begin;
+    radix_worker_end_fn worker_end;
+    void *worker_arg;
+    int skip;                /* this pass's digit is the same in every key */
+    void (*sync)(radix_lsd_job *);
+    pthread_barrier_t *barrier;  /* for radix_lsd_sync_barrier */
+};
+
+void radix_lsd_run(radix_lsd_job *j, int tid);
+
+/* sync for a one-thread job, and for a team that shares j->barrier. */
+void radix_lsd_sync_none(radix_lsd_job *j);
+void radix_lsd_sync_barrier(radix_lsd_job *j);
+
+#endif
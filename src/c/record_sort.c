@@ -0,0 +1,458 @@
+#include "record_sort.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libradix.h"
+#include "sort_util.h"
+
+/* Fewest bytes, or records, worth a thread of their own. */
+#define RECORD_MIN_SLICE_BYTES (1L << 20)
+#define RECORD_MIN_SLICE_RECORDS (1L << 15)
+
+static int slices_for(long units, long min_units, int threads) {
+    long t = units / min_units;
+    t = t < threads ? t : threads;
+    return t > 1 ? (int)t : 1;
+}
+
+/* ---- Offset table ------------------------------------------------------ */
+
+typedef struct {
+    const char *in;
+    size_t bytes;
+    size_t from;             /* first line start of the slice */
+    size_t to;               /* first line start of the next slice */
+    long count;
+    long first;              /* index of the slice's first record */
+    size_t *start;
+    size_t *len;
+} line_slice;
+
+static void *count_lines(void *arg) {
+    line_slice *s = (line_slice *)arg;
+    long count = 0;
+    const char *p = s->in + s->from;
+    const char *end = s->in + s->to;
+    while (p < end) {
+        const char *nl = (const char *)memchr(p, '\n', (size_t)(end - p));
+        ++count;
+        p = nl ? nl + 1 : end;
+    }
+    s->count = count;
+    return NULL;
+}
+
+static void *fill_lines(void *arg) {
+    line_slice *s = (line_slice *)arg;
+    long r = s->first;
+    size_t pos = s->from;
+    while (pos < s->to) {
+        const char *nl = (const char *)memchr(s->in + pos, '\n', s->to - pos);
+        size_t stop = nl ? (size_t)(nl - s->in) : s->to;
+        s->start[r] = pos;
+        s->len[r] = stop - pos;
+        ++r;
+        pos = nl ? stop + 1 : s->to;
+    }
+    return NULL;
+}
+
+static int index_lines(const char *in, size_t bytes, int threads, record_index *index) {
+    size_t most = (size_t)RECORD_MIN_SLICE_BYTES * (size_t)threads;
+    int slices = slices_for((long)(bytes < most ? bytes : most), RECORD_MIN_SLICE_BYTES, threads);
+    line_slice *s = (line_slice *)calloc((size_t)slices, sizeof(line_slice));
+    if (!s) {
+        errno = ENOMEM;
+        return -1;
+    }
+    /* Every cut moves forward to the start of a line. */
+    size_t prev = 0;
+    for (int t = 0; t < slices; ++t) {
+        s[t].in = in;
+        s[t].bytes = bytes;
+        s[t].from = prev;
+        size_t cut = t + 1 == slices ? bytes : bytes / slices * (size_t)(t + 1);
+        if (cut < prev) {
+            cut = prev;
+        }
+        if (cut < bytes && cut > 0 && in[cut - 1] != '\n') {
+            const char *nl = (const char *)memchr(in + cut, '\n', bytes - cut);
+            cut = nl ? (size_t)(nl - in) + 1 : bytes;
+        }
+        s[t].to = cut;
+        prev = cut;
+    }
+    sort_run_slices(count_lines, s, sizeof(line_slice), slices);
+    long n = 0;
+    for (int t = 0; t < slices; ++t) {
+        s[t].first = n;
+        n += s[t].count;
+    }
+    index->n = n;
+    index->start = (size_t *)malloc(sizeof(size_t) * (size_t)(n > 0 ? n : 1));
+    index->len = (size_t *)malloc(sizeof(size_t) * (size_t)(n > 0 ? n : 1));
+    if (!index->start || !index->len) {
+        free(s);
+        errno = ENOMEM;
+        return -1;
+    }
+    for (int t = 0; t < slices; ++t) {
+        s[t].start = index->start;
+        s[t].len = index->len;
+    }
+    sort_run_slices(fill_lines, s, sizeof(line_slice), slices);
+    free(s);
+    return 0;
+}
+
+static uint32_t load_u32le(const char *p) {
+    const unsigned char *u = (const unsigned char *)p;
+    return (uint32_t)u[0] | (uint32_t)u[1] << 8 | (uint32_t)u[2] << 16 | (uint32_t)u[3] << 24;
+}
+
+/* Each blob's position depends on the previous one, so this is one walk
+   to count and one to fill. */
+static int index_prefixed(const char *in, size_t bytes, record_index *index) {
+    long n = 0;
+    size_t pos = 0;
+    while (pos < bytes) {
+        if (bytes - pos < 4 || bytes - pos - 4 < load_u32le(in + pos)) {
+            index->bad_record = n;
+            errno = EINVAL;   /* truncated prefix or payload */
+            return -1;
+        }
+        pos += 4 + (size_t)load_u32le(in + pos);
+        ++n;
+    }
+    index->n = n;
+    index->start = (size_t *)malloc(sizeof(size_t) * (size_t)(n > 0 ? n : 1));
+    index->len = (size_t *)malloc(sizeof(size_t) * (size_t)(n > 0 ? n : 1));
+    if (!index->start || !index->len) {
+        errno = ENOMEM;
+        return -1;
+    }
+    pos = 0;
+    for (long r = 0; r < n; ++r) {
+        index->start[r] = pos;
+        index->len[r] = 4 + (size_t)load_u32le(in + pos);
+        pos += index->len[r];
+    }
+    return 0;
+}
+
+/* ---- Key extraction ---------------------------------------------------- */
+
+typedef struct {
+    const char *in;
+    const record_sort_config *cfg;
+    const record_index *index;
+    long from;
+    long to;
+    uint64_t *keys;
+    uint64_t min;
+    uint64_t max;
+    long bad;                /* first record without a key, or -1 */
+    int err;
+} key_slice;
+
+/* Field keys are unsigned decimal; the field must be digits only. */
+static int field_key(const char *rec, size_t len, int field, char delim, uint64_t *key) {
+    size_t p = 0;
+    for (int f = 0; f < field; ++f) {
+        const char *d = (const char *)memchr(rec + p, delim, len - p);
+        if (!d) {
+            errno = EINVAL;
+            return -1;
+        }
+        p = (size_t)(d - rec) + 1;
+    }
+    const char *d = (const char *)memchr(rec + p, delim, len - p);
+    size_t end = d ? (size_t)(d - rec) : len;
+    if (end > p && rec[end - 1] == '\r') {
+        --end;
+    }
+    if (end == p) {
+        errno = EINVAL;
+        return -1;
+    }
+    uint64_t v = 0;
+    for (size_t i = p; i < end; ++i) {
+        unsigned digit = (unsigned char)rec[i] - '0';
+        if (digit > 9) {
+            errno = EINVAL;
+            return -1;
+        }
+        if (v > (UINT64_MAX - digit) / 10) {
+            errno = ERANGE;
+            return -1;
+        }
+        v = v * 10 + digit;
+    }
+    *key = v;
+    return 0;
+}
+
+static int offset_key(const char *rec, size_t len, size_t offset, int width, uint64_t *key) {
+    if (offset > len || len - offset < (size_t)width) {
+        errno = EINVAL;
+        return -1;
+    }
+    const unsigned char *u = (const unsigned char *)rec + offset;
+    uint64_t v = 0;
+    for (int i = width - 1; i >= 0; --i) {
+        v = v << 8 | u[i];
+    }
+    *key = v;
+    return 0;
+}
+
+static void *extract_keys(void *arg) {
+    key_slice *s = (key_slice *)arg;
+    const record_sort_config *cfg = s->cfg;
+    int skip = cfg->framing == RECORD_PREFIXED ? 4 : 0;
+    uint64_t lo = UINT64_MAX;
+    uint64_t hi = 0;
+    s->bad = -1;
+    for (long r = s->from; r < s->to; ++r) {
+        const char *rec = s->in + s->index->start[r] + skip;
+        size_t len = s->index->len[r] - (size_t)skip;
+        uint64_t key = 0;
+        int rc;
+        errno = 0;
+        if (cfg->extract == RECORD_KEY_FIELD) {
+            rc = field_key(rec, len, cfg->field, cfg->delim, &key);
+        } else if (cfg->extract == RECORD_KEY_OFFSET) {
+            rc = offset_key(rec, len, cfg->offset, cfg->width, &key);
+        } else {
+            rc = cfg->key_fn(rec, len, &key, cfg->key_arg);
+        }
+        if (rc != 0) {
+            s->bad = r;
+            s->err = errno == ERANGE ? ERANGE : EINVAL;
+            return NULL;
+        }
+        s->keys[r] = key;
+        lo = key < lo ? key : lo;
+        hi = key > hi ? key : hi;
+    }
+    s->min = lo;
+    s->max = hi;
+    return NULL;
+}
+
+/* ---- Sorting ----------------------------------------------------------- */
+
+/* Keys are rebased on the smallest; when the key range and the record
+   number fit in 64 bits together they become one key for the caller's
+   kernel, with the record number in the low bits for stability. */
+static int sort_records(uint64_t *keys, uint64_t min, uint64_t max, const record_sort_config *cfg,
+                        record_index *index) {
+    long n = index->n;
+    int row_bits = sort_bit_width((uint64_t)(n - 1));
+    int key_bits = sort_bit_width(max - min);
+    uint64_t *rows = (uint64_t *)malloc(sizeof(uint64_t) * (size_t)n);
+    if (!rows) {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (row_bits + key_bits <= 64) {
+        index->packed = 1;
+        uint64_t mask = row_bits == 64 ? ~0ull : (1ull << row_bits) - 1;
+        for (long i = 0; i < n; ++i) {
+            rows[i] = row_bits == 64 ? (uint64_t)i
+                                     : (keys[i] - min) << row_bits | (uint64_t)i;
+        }
+        if (cfg->sort_keys(rows, n, 64, cfg->sort_arg) != 0) {
+            int saved = errno;
+            free(rows);
+            errno = saved ? saved : EIO;
+            return -1;
+        }
+        for (long i = 0; i < n; ++i) {
+            index->order[i] = (long)(rows[i] & mask);
+        }
+    } else {
+        for (long i = 0; i < n; ++i) {
+            rows[i] = (uint64_t)i;
+        }
+        radix_options opt;
+        radix_options_init(&opt);
+        opt.threads = cfg->threads > 0 ? cfg->threads : 1;
+        if (radix_sort_kv_u64(keys, rows, (size_t)n, &opt) != RADIX_OK) {
+            free(rows);
+            errno = ENOMEM;
+            return -1;
+        }
+        for (long i = 0; i < n; ++i) {
+            index->order[i] = (long)rows[i];
+        }
+    }
+    free(rows);
+    return 0;
+}
+
+int record_sort_index(const char *in, size_t bytes, const record_sort_config *cfg,
+                      record_index *index) {
+    memset(index, 0, sizeof(*index));
+    index->bad_record = -1;
+    if ((cfg->framing != RECORD_LINES && cfg->framing != RECORD_PREFIXED) ||
+        (cfg->extract == RECORD_KEY_FIELD && cfg->field < 0) ||
+        (cfg->extract == RECORD_KEY_OFFSET && (cfg->width < 1 || cfg->width > 8)) ||
+        (cfg->extract == RECORD_KEY_CALLBACK && !cfg->key_fn) ||
+        cfg->extract < RECORD_KEY_FIELD || cfg->extract > RECORD_KEY_CALLBACK || !cfg->sort_keys) {
+        errno = EINVAL;
+        return -1;
+    }
+    int threads = cfg->threads > 0 ? cfg->threads : 1;
+
+    double t0 = sort_wall_time();
+    int rc = cfg->framing == RECORD_LINES ? index_lines(in, bytes, threads, index)
+                                          : index_prefixed(in, bytes, index);
+    index->index_time = sort_wall_time() - t0;
+    if (rc != 0) {
+        int saved = errno;
+        record_index_free(index);
+        errno = saved;
+        return -1;
+    }
+    long n = index->n;
+    index->out_bytes = bytes;
+    if (cfg->framing == RECORD_LINES) {
+        index->out_bytes = 0;
+        for (long r = 0; r < n; ++r) {
+            index->out_bytes += index->len[r] + 1;
+        }
+    }
+
+    double t1 = sort_wall_time();
+    uint64_t *keys = (uint64_t *)malloc(sizeof(uint64_t) * (size_t)(n > 0 ? n : 1));
+    int slices = slices_for(n, RECORD_MIN_SLICE_RECORDS, threads);
+    key_slice *ks = (key_slice *)calloc((size_t)slices, sizeof(key_slice));
+    index->order = (long *)malloc(sizeof(long) * (size_t)(n > 0 ? n : 1));
+    if (!keys || !ks || !index->order) {
+        free(keys);
+        free(ks);
+        record_index_free(index);
+        errno = ENOMEM;
+        return -1;
+    }
+    for (int t = 0; t < slices; ++t) {
+        ks[t].in = in;
+        ks[t].cfg = cfg;
+        ks[t].index = index;
+        ks[t].from = n * t / slices;
+        ks[t].to = n * (t + 1) / slices;
+        ks[t].keys = keys;
+    }
+    sort_run_slices(extract_keys, ks, sizeof(key_slice), slices);
+    uint64_t min = UINT64_MAX;
+    uint64_t max = 0;
+    int err = 0;
+    for (int t = 0; t < slices && err == 0; ++t) {
+        if (ks[t].bad >= 0) {
+            index->bad_record = ks[t].bad;
+            err = ks[t].err;
+        }
+        min = ks[t].min < min ? ks[t].min : min;
+        max = ks[t].max > max ? ks[t].max : max;
+    }
+    free(ks);
+    index->extract_time = sort_wall_time() - t1;
+
+    if (err == 0 && n > 0) {
+        double t2 = sort_wall_time();
+        if (sort_records(keys, min, max, cfg, index) != 0) {
+            err = errno;
+        }
+        index->sort_time = sort_wall_time() - t2;
+    }
+    free(keys);
+    if (err != 0) {
+        long bad = index->bad_record;
+        record_index_free(index);
+        index->bad_record = bad;
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+/* ---- Gather ------------------------------------------------------------ */
+
+typedef struct {
+    const char *in;
+    const record_index *index;
+    int newline;
+    long from;
+    long to;
+    size_t out_pos;
+    char *out;
+} gather_slice;
+
+static void *size_slice(void *arg) {
+    gather_slice *s = (gather_slice *)arg;
+    size_t bytes = 0;
+    for (long i = s->from; i < s->to; ++i) {
+        bytes += s->index->len[s->index->order[i]] + (size_t)s->newline;
+    }
+    s->out_pos = bytes;
+    return NULL;
+}
+
+static void *copy_slice(void *arg) {
+    gather_slice *s = (gather_slice *)arg;
+    char *out = s->out + s->out_pos;
+    for (long i = s->from; i < s->to; ++i) {
+        long r = s->index->order[i];
+        size_t len = s->index->len[r];
+        memcpy(out, s->in + s->index->start[r], len);
+        out += len;
+        if (s->newline) {
+            *out++ = '\n';
+        }
+    }
+    return NULL;
+}
+
+void record_gather(const char *in, const record_index *index, int framing, int threads,
+                   char *out) {
+    int slices = slices_for(index->n, RECORD_MIN_SLICE_RECORDS, threads > 0 ? threads : 1);
+    gather_slice *gs = (gather_slice *)calloc((size_t)slices, sizeof(gather_slice));
+    gather_slice one;
+    if (!gs) {
+        gs = &one;
+        slices = 1;
+    }
+    for (int t = 0; t < slices; ++t) {
+        gs[t].in = in;
+        gs[t].index = index;
+        gs[t].newline = framing == RECORD_LINES;
+        gs[t].from = index->n * t / slices;
+        gs[t].to = index->n * (t + 1) / slices;
+        gs[t].out = out;
+    }
+    /* Every slice's output offset is the sum of the sizes before it. */
+    sort_run_slices(size_slice, gs, sizeof(gather_slice), slices);
+    size_t pos = 0;
+    for (int t = 0; t < slices; ++t) {
+        size_t bytes = gs[t].out_pos;
+        gs[t].out_pos = pos;
+        pos += bytes;
+    }
+    sort_run_slices(copy_slice, gs, sizeof(gather_slice), slices);
+    if (gs != &one) {
+        free(gs);
+    }
+}
+
+void record_index_free(record_index *index) {
+    free(index->start);
+    free(index->len);
+    free(index->order);
+    index->start = NULL;
+    index->len = NULL;
+    index->order = NULL;
+    index->n = 0;
+}
@@ -0,0 +1,73 @@
+#ifndef RECORD_SORT_H
+#define RECORD_SORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ext_sort.h"
+
+/* Sorting variable-length records by an integer key taken from each one.
+
+   Records are either lines ending in '\n' (a last line without one counts
+   too) or blobs each led by a little-endian u32 payload length. An offset
+   table of every record is built first: for lines by threads that each
+   scan a slice cut at a line boundary, counting and then filling their
+   share. Keys are then extracted by threads over ranges of records with
+   one of three extractors: a decimal field of a delimited line, an
+   unsigned little-endian integer of 1 to 8 bytes at a fixed offset into
+   the payload, or a caller's callback. The (key, record) pairs are radix
+   sorted, and the records are gathered in sorted order into an output
+   buffer, each thread copying its own slice to offsets computed up front.
+   Equal keys keep their input order. Lines are written with a '\n' each;
+   blobs are copied with their length prefix. Functions return 0 on
+   success and -1 with errno set: EINVAL for a malformed record or one
+   without a key (index->bad_record says which), ERANGE for a decimal key
+   above 2^64 - 1, ENOMEM. */
+
+enum { RECORD_LINES, RECORD_PREFIXED };
+enum { RECORD_KEY_FIELD, RECORD_KEY_OFFSET, RECORD_KEY_CALLBACK };
+
+/* Stores the key of rec[0, len) (the payload, without prefix or '\n');
+   returns 0, or -1 if the record has none. Called from several threads. */
+typedef int (*record_key_fn)(const char *rec, size_t len, uint64_t *key, void *arg);
+
+typedef struct {
+    int framing;             /* RECORD_LINES or RECORD_PREFIXED */
+    int extract;             /* RECORD_KEY_FIELD, _OFFSET or _CALLBACK */
+    int field;               /* 0-based field for RECORD_KEY_FIELD */
+    char delim;              /* field separator */
+    size_t offset;           /* byte offset for RECORD_KEY_OFFSET */
+    int width;               /* key bytes at offset, 1 to 8 */
+    record_key_fn key_fn;
+    void *key_arg;
+    int threads;
+    ext_sort_fn sort_keys;   /* sorts 64-bit keys; (key, record) pairs are
+                                packed into one key when they fit */
+    void *sort_arg;
+} record_sort_config;
+
+typedef struct {
+    long n;
+    size_t *start;           /* record i is in[start[i], start[i] + len[i]) */
+    size_t *len;             /* payload, or prefix and payload for blobs */
+    long *order;             /* records in ascending key order */
+    size_t out_bytes;        /* size of the gathered output */
+    int packed;              /* pairs were sorted as single 64-bit keys */
+    long bad_record;         /* on EINVAL / ERANGE: first offending record */
+    double index_time;
+    double extract_time;
+    double sort_time;
+} record_index;
+
+/* Builds the offset table, extracts the keys and sorts the records of
+   in[0, bytes). */
+int record_sort_index(const char *in, size_t bytes, const record_sort_config *cfg,
+                      record_index *index);
+
+/* Writes the records in sorted order to out, which holds index->out_bytes. */
+void record_gather(const char *in, const record_index *index, int framing, int threads,
+                   char *out);
+
+void record_index_free(record_index *index);
+
+#endif
@@ -0,0 +1,261 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include "scratch_pool.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "libradix.h"
+#include "numa_place.h"
+#include "sort_util.h"
+
+#define SCRATCH_POOL_SLOTS 8
+#define HUGE_PAGE_BYTES (2u * 1024u * 1024u)
+
+typedef struct {
+    void *base;
+    size_t size;
+    int in_use;
+    int huge;      /* 1 if mapped with MAP_HUGETLB */
+} pool_slot;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pool_slot pool_slots[SCRATCH_POOL_SLOTS];
+static scratch_pool_stats pool_stats;
+static double fault_bytes;   /* bytes pre-faulted so far, for the per-byte cost */
+
+static void *map_buffer(size_t size, int *huge) {
+    *huge = 0;
+#ifdef __linux__
+#ifdef MAP_HUGETLB
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+        *huge = 1;
+        return p;
+    }
+#endif
+    /* No reserved huge pages: over-map so the buffer can start on a 2 MB
+       boundary, which THP needs to back it with huge pages. */
+    size_t padded = size + HUGE_PAGE_BYTES;
+    char *raw = (char *)mmap(NULL, padded, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return NULL;
+    }
+    char *aligned = (char *)(((unsigned long)raw + HUGE_PAGE_BYTES - 1) &
+                             ~(unsigned long)(HUGE_PAGE_BYTES - 1));
+    if (aligned > raw) {
+        munmap(raw, (size_t)(aligned - raw));
+    }
+    size_t tail = (size_t)(raw + padded - (aligned + size));
+    if (tail > 0) {
+        munmap(aligned + size, tail);
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+    return aligned;
+#else
+    return malloc(size);
+#endif
+}
+
+static void unmap_buffer(void *base, size_t size) {
+#ifdef __linux__
+    munmap(base, size);
+#else
+    (void)size;
+    free(base);
+#endif
+}
+
+typedef struct {
+    char *buf;
+    size_t bytes;
+    int cpu;
+} prefault_ctx;
+
+static void *prefault_worker(void *arg) {
+    prefault_ctx *ctx = (prefault_ctx *)arg;
+    if (ctx->cpu >= 0) {
+        pin_to_cpu(ctx->cpu);
+    }
+    touch_pages(ctx->buf, ctx->bytes);
+    return NULL;
+}
+
+/* Thread t faults the pages under the elements radix_worker_slice gives it;
+   the mapping's slack past the last element goes to the last thread. */
+static void prefault(char *base, size_t size, long count, size_t elem_size, int threads,
+                     const int *cpus) {
+    if (threads < 1) {
+        threads = 1;
+    }
+    pthread_t *tids = (pthread_t *)malloc(sizeof(pthread_t) * threads);
+    prefault_ctx *ctx = (prefault_ctx *)malloc(sizeof(prefault_ctx) * threads);
+    int *started = (int *)calloc((size_t)threads, sizeof(int));
+    if (!tids || !ctx || !started) {
+        free(tids);
+        free(ctx);
+        free(started);
+        touch_pages(base, size);
+        return;
+    }
+
+    for (int t = 0; t < threads; ++t) {
+        long first, last;
+        radix_worker_slice(count, threads, t, &first, &last);
+        size_t start = elem_size * (size_t)first;
+        size_t end = t == threads - 1 ? size : elem_size * (size_t)last;
+        ctx[t].buf = base + start;
+        ctx[t].bytes = end - start;
+        ctx[t].cpu = cpus ? cpus[t] : -1;
+        if (t > 0) {
+            started[t] = pthread_create(&tids[t], NULL, prefault_worker, &ctx[t]) == 0;
+        }
+    }
+    /* Slice 0 runs on the (unpinned) calling thread, as does any slice whose
+       thread failed to start. */
+    touch_pages(ctx[0].buf, ctx[0].bytes);
+    for (int t = 1; t < threads; ++t) {
+        if (started[t]) {
+            pthread_join(tids[t], NULL);
+        } else {
+            touch_pages(ctx[t].buf, ctx[t].bytes);
+        }
+    }
+    free(tids);
+    free(ctx);
+    free(started);
+}
+
+void *scratch_acquire(long count, size_t elem_size, int threads, const int *cpus) {
+    size_t bytes = elem_size * (size_t)count;
+    if (bytes == 0) {
+        bytes = 1;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    pool_stats.acquires++;
+    int best = -1;
+    for (int i = 0; i < SCRATCH_POOL_SLOTS; ++i) {
+        pool_slot *slot = &pool_slots[i];
+        if (slot->base && !slot->in_use && slot->size >= bytes &&
+            (best < 0 || slot->size < pool_slots[best].size)) {
+            best = i;
+        }
+    }
+    if (best >= 0) {
+        pool_slots[best].in_use = 1;
+        pool_stats.hits++;
+        if (fault_bytes > 0.0) {
+            pool_stats.fault_time_saved += pool_stats.fault_time / fault_bytes * (double)bytes;
+        }
+        void *p = pool_slots[best].base;
+        pthread_mutex_unlock(&pool_lock);
+        return p;
+    }
+
+    /* Miss: take an empty slot, evicting the largest idle buffer if needed. */
+    int target = -1;
+    for (int i = 0; i < SCRATCH_POOL_SLOTS; ++i) {
+        if (!pool_slots[i].base && !pool_slots[i].in_use) {
+            target = i;
+            break;
+        }
+    }
+    if (target < 0) {
+        for (int i = 0; i < SCRATCH_POOL_SLOTS; ++i) {
+            if (pool_slots[i].base && !pool_slots[i].in_use &&
+                (target < 0 || pool_slots[i].size > pool_slots[target].size)) {
+                target = i;
+            }
+        }
+        if (target >= 0) {
+            unmap_buffer(pool_slots[target].base, pool_slots[target].size);
+            pool_stats.bytes_mapped -= pool_slots[target].size;
+            memset(&pool_slots[target], 0, sizeof(pool_slot));
+        }
+    }
+    if (target < 0) {
+        pthread_mutex_unlock(&pool_lock);
+        fprintf(stderr, "[pool] All %d scratch slots are in use\n", SCRATCH_POOL_SLOTS);
+        return NULL;
+    }
+    pool_stats.misses++;
+    pool_slots[target].in_use = 1;   /* reserve while mapping outside the lock */
+    pool_slots[target].base = NULL;
+    pthread_mutex_unlock(&pool_lock);
+
+    size_t size = (bytes + HUGE_PAGE_BYTES - 1) & ~(size_t)(HUGE_PAGE_BYTES - 1);
+    int huge = 0;
+    void *base = map_buffer(size, &huge);
+    double fault = 0.0;
+    if (base) {
+        double t0 = sort_wall_time();
+        prefault((char *)base, size, count, elem_size, threads, cpus);
+        fault = sort_wall_time() - t0;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    if (!base) {
+        pool_slots[target].in_use = 0;
+        pthread_mutex_unlock(&pool_lock);
+        return NULL;
+    }
+    pool_slots[target].base = base;
+    pool_slots[target].size = size;
+    pool_slots[target].huge = huge;
+    pool_stats.bytes_mapped += size;
+    pool_stats.fault_time += fault;
+    fault_bytes += (double)size;
+    if (huge) {
+        pool_stats.huge_mappings++;
+    } else {
+        pool_stats.thp_mappings++;
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return base;
+}
+
+void scratch_release(void *buf) {
+    if (!buf) {
+        return;
+    }
+    pthread_mutex_lock(&pool_lock);
+    for (int i = 0; i < SCRATCH_POOL_SLOTS; ++i) {
+        if (pool_slots[i].base == buf) {
+            pool_slots[i].in_use = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+void scratch_pool_trim(void) {
+    pthread_mutex_lock(&pool_lock);
+    for (int i = 0; i < SCRATCH_POOL_SLOTS; ++i) {
+        pool_slot *slot = &pool_slots[i];
+        if (slot->base && !slot->in_use) {
+            unmap_buffer(slot->base, slot->size);
+            pool_stats.bytes_mapped -= slot->size;
+            memset(slot, 0, sizeof(*slot));
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+void scratch_pool_get_stats(scratch_pool_stats *out) {
+    pthread_mutex_lock(&pool_lock);
+    *out = pool_stats;
+    pthread_mutex_unlock(&pool_lock);
+}
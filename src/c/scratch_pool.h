@@ -0,0 +1,41 @@
+#ifndef SCRATCH_POOL_H
+#define SCRATCH_POOL_H
+
+#include <stddef.h>
+
+/* Process-wide pool of large scratch buffers that outlive a single sort.
+
+   New buffers are mapped in 2 MB multiples, backed by explicit huge pages
+   (MAP_HUGETLB) when the system has them reserved and by transparent huge
+   pages (MADV_HUGEPAGE) otherwise, and pre-faulted by several threads so the
+   first sort does not take the page faults inside its scatter loop. Released
+   buffers stay mapped and are handed out again to any request that fits. */
+
+typedef struct {
+    unsigned long acquires;
+    unsigned long hits;            /* served from an already mapped buffer */
+    unsigned long misses;          /* needed a fresh mapping */
+    unsigned long huge_mappings;   /* fresh mappings backed by MAP_HUGETLB */
+    unsigned long thp_mappings;    /* fresh mappings advised with MADV_HUGEPAGE */
+    size_t bytes_mapped;           /* currently mapped by the pool */
+    double fault_time;             /* seconds spent pre-faulting fresh mappings */
+    double fault_time_saved;       /* estimated fault time avoided by hits */
+} scratch_pool_stats;
+
+/* Returns a buffer for `count` elements of `elem_size` bytes, or NULL if
+   mapping fails. Fresh mappings are pre-faulted by `threads` threads; when
+   `cpus` is non-NULL, thread t is pinned to cpus[t] (-1 entries stay
+   unpinned) and faults the elements radix_worker_slice (libradix.h)
+   gives worker t, so pages land on the node of the worker that owns that
+   slice. */
+void *scratch_acquire(long count, size_t elem_size, int threads, const int *cpus);
+
+/* Returns a buffer to the pool; it stays mapped for the next acquire. */
+void scratch_release(void *buf);
+
+/* Unmaps every buffer that is not currently acquired. */
+void scratch_pool_trim(void);
+
+void scratch_pool_get_stats(scratch_pool_stats *out);
+
+#endif
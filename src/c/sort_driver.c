@@ -0,0 +1,542 @@
+#ifndef _WIN32
+#define _XOPEN_SOURCE 700
+#endif
+
+#include "sort_driver.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "key_codec.h"
+#include "key_file.h"
+#include "libradix.h"
+#include "packed_keys.h"
+#include "radix_alloc.h"
+#include "scratch_pool.h"
+#include "sort_util.h"
+#include "text_keys.h"
+
+#define RADIX_BITS 8
+#define RADIX (1 << RADIX_BITS)
+
+/* ---- Placement --------------------------------------------------------- */
+
+int driver_threads(const sort_placement *pl, long n) {
+    radix_options opt;
+    radix_options_init(&opt);
+    opt.threads = pl->threads;
+    opt.min_keys_per_thread = pl->min_chunk;
+    return radix_sort_threads(n > 0 ? (size_t)n : 0, &opt);
+}
+
+void *driver_scratch_alloc(const sort_placement *pl, long n, size_t elem_size, int threads) {
+    if (pl->use_pool) {
+        int *cpus = NULL;
+        if (pl->affinity != AFFINITY_NONE) {
+            cpus = (int *)malloc(sizeof(int) * threads);
+            for (int t = 0; cpus && t < threads; ++t) {
+                cpus[t] = topology_worker_cpu(pl->topo, pl->affinity, t);
+            }
+        }
+        void *buf = scratch_acquire(n, elem_size, threads, cpus);
+        free(cpus);
+        return buf;
+    }
+    void *buf = malloc(elem_size * (size_t)n);
+    if (buf && pl->numa == NUMA_INTERLEAVE) {
+        numa_interleave(buf, elem_size * (size_t)n);
+    }
+    return buf;
+}
+
+void driver_scratch_free(const sort_placement *pl, void *buf) {
+    if (pl->use_pool) {
+        scratch_release(buf);
+    } else {
+        free(buf);
+    }
+}
+
+typedef struct {
+    char *buf;
+    size_t bytes;
+    int cpu;
+} touch_job;
+
+/* sort_run_slices may run any slice on the calling thread, so the mask is
+   put back once the slice is touched. */
+static void *touch_worker(void *arg) {
+    touch_job *job = (touch_job *)arg;
+    cpu_mask saved;
+    saved.valid = 0;
+    if (job->cpu >= 0) {
+        save_cpu_mask(&saved);
+        pin_to_cpu(job->cpu);
+    }
+    touch_pages(job->buf, job->bytes);
+    restore_cpu_mask(&saved);
+    return NULL;
+}
+
+void driver_place_input(const sort_placement *pl, void *data, long n, size_t elem_size) {
+    if (n <= 0) {
+        return;
+    }
+    if (pl->numa == NUMA_INTERLEAVE) {
+        numa_interleave(data, elem_size * (size_t)n);
+        return;
+    }
+    int threads = driver_threads(pl, n);
+    touch_job *jobs = (touch_job *)malloc(sizeof(touch_job) * threads);
+    if (!jobs) {
+        fprintf(stderr, "%s Allocation failed\n", pl->tag);
+        exit(1);
+    }
+    for (int t = 0; t < threads; ++t) {
+        long start, end;
+        radix_worker_slice(n, threads, t, &start, &end);
+        jobs[t].buf = (char *)data + elem_size * (size_t)start;
+        jobs[t].bytes = elem_size * (size_t)(end - start);
+        jobs[t].cpu = topology_worker_cpu(pl->topo, pl->affinity, t);
+    }
+    sort_run_slices(touch_worker, jobs, sizeof(touch_job), threads);
+    free(jobs);
+}
+
+void driver_pin_enter(void *arg, int worker) {
+    driver_pinning *pin = (driver_pinning *)arg;
+    int cpu = topology_worker_cpu(pin->pl->topo, pin->pl->affinity, worker);
+    if (cpu >= 0) {
+        if (worker == 0) {
+            save_cpu_mask(&pin->saved);
+        }
+        pin_to_cpu(cpu);
+    }
+}
+
+void driver_pin_leave(void *arg, int worker) {
+    driver_pinning *pin = (driver_pinning *)arg;
+    if (worker == 0) {
+        restore_cpu_mask(&pin->saved);
+    }
+}
+
+/* ---- Bandwidth --------------------------------------------------------- */
+
+void driver_record_bandwidth(sort_bandwidth *bw, const cpu_topology *topo, int cpu, double bytes,
+                             double elapsed) {
+    if (!bw) {
+        return;
+    }
+    int socket = topo ? topology_socket_of(topo, cpu) : 0;
+    bw->socket_bytes[socket] += bytes;
+    if (elapsed > bw->socket_time[socket]) {
+        bw->socket_time[socket] = elapsed;
+    }
+    if (socket + 1 > bw->sockets) {
+        bw->sockets = socket + 1;
+    }
+}
+
+void driver_print_bandwidth(const sort_bandwidth *bw) {
+    if (bw->sockets == 0) {
+        return;
+    }
+    printf("  [numa]");
+    for (int socket = 0; socket < bw->sockets; ++socket) {
+        double t = bw->socket_time[socket];
+        printf("%s socket %d = %.2f GB/s",
+               socket == 0 ? "" : " |",
+               socket,
+               t > 0.0 ? bw->socket_bytes[socket] / t * 1e-9 : 0.0);
+    }
+    printf("\n");
+}
+
+void driver_print_pool_stats(void) {
+    scratch_pool_stats ps;
+    scratch_pool_get_stats(&ps);
+    printf("[pool] acquires = %lu | hits = %lu | misses = %lu | huge pages = %lu | thp = %lu | "
+           "mapped = %.1f MB | fault time = %.3f s | saved ~ %.3f s\n",
+           ps.acquires,
+           ps.hits,
+           ps.misses,
+           ps.huge_mappings,
+           ps.thp_mappings,
+           (double)ps.bytes_mapped / (1024.0 * 1024.0),
+           ps.fault_time,
+           ps.fault_time_saved);
+}
+
+void driver_print_alloc_stats(void) {
+    radix_alloc_stats as;
+    radix_alloc_get_stats(&as);
+    printf("[alloc] heap = %lu | custom = %lu | frees = %lu | failures = %lu | bytes = %zu\n",
+           as.heap_allocs,
+           as.custom_allocs,
+           as.frees,
+           as.failures,
+           as.bytes);
+}
+
+/* ---- libradix sorts ---------------------------------------------------- */
+
+typedef struct {
+    double t0;
+    double elapsed;
+    double bytes;
+    int cpu;
+} worker_time;
+
+/* One libradix sort: how its workers are pinned and what each measured. */
+typedef struct {
+    const sort_placement *pl;
+    driver_pinning pin;
+    worker_time *workers;
+} driver_run;
+
+/* On every libradix backend worker 0 is the caller's thread. The others
+   are libradix's own threads, or OpenMP pool threads that keep their
+   pinning for later regions. */
+static void run_begin(void *arg, int worker) {
+    driver_run *r = (driver_run *)arg;
+    driver_pin_enter(&r->pin, worker);
+    r->workers[worker].cpu = topology_worker_cpu(r->pl->topo, r->pl->affinity, worker);
+    r->workers[worker].t0 = sort_wall_time();
+}
+
+static void run_end(void *arg, int worker, double bytes) {
+    driver_run *r = (driver_run *)arg;
+    worker_time *w = &r->workers[worker];
+    w->elapsed = sort_wall_time() - w->t0;
+    w->bytes = bytes;
+    if (w->cpu < 0) {
+        w->cpu = current_cpu();
+    }
+    driver_pin_leave(&r->pin, worker);
+}
+
+static int run_sort(void *keys, long n, int key_bits, const radix_options *opt) {
+    return key_bits == 64 ? radix_sort_u64((uint64_t *)keys, (size_t)n, opt)
+                          : radix_sort_u32((uint32_t *)keys, (size_t)n, opt);
+}
+
+double driver_radix_sort(const sort_placement *pl, int backend, void *keys, long n, int key_bits,
+                         unsigned int digits, void *lend, sort_bandwidth *bw) {
+    if (n <= 1) {
+        return 0.0;
+    }
+    int threads = driver_threads(pl, n);
+    void *tmp = lend ? lend : driver_scratch_alloc(pl, n, (size_t)key_bits / 8, threads);
+    driver_run r;
+    memset(&r, 0, sizeof(r));
+    r.pl = pl;
+    r.pin.pl = pl;
+    r.workers = (worker_time *)calloc((size_t)threads, sizeof(worker_time));
+    if (!tmp || !r.workers) {
+        fprintf(stderr, "%s Allocation failed\n", pl->tag);
+        exit(1);
+    }
+
+    radix_options opt;
+    radix_options_init(&opt);
+    opt.backend = backend;
+    opt.threads = pl->threads;
+    opt.digits = digits;
+    opt.min_keys_per_thread = pl->min_chunk;
+    opt.first_touch = pl->numa == NUMA_FIRST_TOUCH && !pl->use_pool;
+    opt.worker_begin = run_begin;
+    opt.worker_end = run_end;
+    opt.worker_arg = &r;
+    opt.scratch_keys = tmp;
+
+    double t0 = sort_wall_time();
+    int rc = run_sort(keys, n, key_bits, &opt);
+    double t1 = sort_wall_time();
+    if (rc != RADIX_OK) {
+        fprintf(stderr, "%s Sort failed: %s\n", pl->tag, radix_strerror(rc));
+        exit(1);
+    }
+    for (int t = 0; t < threads; ++t) {
+        if (r.workers[t].elapsed > 0.0) {
+            driver_record_bandwidth(bw, pl->topo, r.workers[t].cpu, r.workers[t].bytes,
+                                    r.workers[t].elapsed);
+        }
+    }
+    free(r.workers);
+    if (!lend) {
+        driver_scratch_free(pl, tmp);
+    }
+    return t1 - t0;
+}
+
+void driver_radix_sort_serial(void *keys, long n, int key_bits, unsigned int digits,
+                              void *scratch) {
+    radix_options opt;
+    radix_options_init(&opt);
+    opt.backend = RADIX_BACKEND_SERIAL;
+    opt.digits = digits;
+    opt.scratch_keys = scratch;
+    if (run_sort(keys, n, key_bits, &opt) != RADIX_OK) {
+        fprintf(stderr, "Sort allocation failed\n");
+        exit(1);
+    }
+}
+
+void driver_bucket_ends(const int *arr, long n, int shift, long *ends) {
+    long lo = 0;
+    for (int digit = 0; digit < RADIX; ++digit) {
+        long hi = n;
+        while (lo < hi) {
+            long mid = lo + (hi - lo) / 2;
+            if ((int)(((unsigned int)arr[mid] >> shift) & (RADIX - 1)) <= digit) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        ends[digit] = lo;
+    }
+}
+
+/* ---- Key files --------------------------------------------------------- */
+
+const char *driver_format_name(int format) {
+    static const char *names[] = {"binary", "text", "packed"};
+    return names[format];
+}
+
+int driver_parse_format(const char *name, int *format) {
+    for (int f = FORMAT_BINARY; f <= FORMAT_PACKED; ++f) {
+        if (strcmp(name, driver_format_name(f)) == 0) {
+            *format = f;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int driver_load_packed(const char *tag, const char *path, int key_bits, void **keys, long *n) {
+    packed_reader r;
+    if (packed_open(&r, path) != 0) {
+        fprintf(stderr, "%s Cannot open %s: %s\n", tag, path,
+                errno == EINVAL ? "not a packed key file" : strerror(errno));
+        return -1;
+    }
+    if (r.key_bits != key_bits) {
+        fprintf(stderr, "%s %s holds %d-bit keys; pass --key-bits %d\n", tag, path, r.key_bits,
+                r.key_bits);
+        packed_close(&r);
+        return -1;
+    }
+    size_t key_bytes = (size_t)key_bits / 8;
+    *n = r.keys;
+    *keys = malloc(r.keys > 0 ? (size_t)r.keys * key_bytes : 1);
+    uint64_t *chunk = (uint64_t *)malloc(sizeof(uint64_t) * KEY_BLOCK_KEYS);
+    if (!*keys || !chunk) {
+        fprintf(stderr, "%s Allocation failed\n", tag);
+        exit(1);
+    }
+    packed_range it;
+    long pos = 0;
+    long got = 0;
+    if (packed_range_init(&it, &r, 0, UINT64_MAX) == 0) {
+        while ((got = packed_range_next(&it, chunk, KEY_BLOCK_KEYS)) > 0) {
+            for (long i = 0; i < got; ++i, ++pos) {
+                if (key_bits == 64) {
+                    ((uint64_t *)*keys)[pos] = chunk[i];
+                } else {
+                    ((uint32_t *)*keys)[pos] = (uint32_t)chunk[i];
+                }
+            }
+        }
+    } else {
+        got = -1;
+    }
+    int saved = errno;
+    free(chunk);
+    packed_close(&r);
+    if (got < 0) {
+        fprintf(stderr, "%s Cannot read %s: %s\n", tag, path, strerror(saved));
+        free(*keys);
+        *keys = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int driver_run_file_sort(const sort_driver *drv, const char *input, const char *output,
+                         int key_bits, int verify) {
+    const sort_placement *pl = drv->place;
+    size_t key_bytes = (size_t)key_bits / 8;
+    int in_place = !output || key_file_same(input, output);
+    key_map in;
+    key_map out;
+    memset(&out, 0, sizeof(out));
+    out.fd = -1;
+
+    double t0 = sort_wall_time();
+    if (key_map_open(&in, input, in_place, pl->threads) != 0) {
+        fprintf(stderr, "%s Cannot map %s: %s\n", pl->tag, input, strerror(errno));
+        return 1;
+    }
+    if (in.bytes % key_bytes != 0) {
+        fprintf(stderr, "%s %s is %zu bytes, not a multiple of %zu-byte keys\n",
+                pl->tag, input, in.bytes, key_bytes);
+        key_map_close(&in);
+        return 1;
+    }
+    long n = (long)(in.bytes / key_bytes);
+    void *keys = in.data;
+    if (!in_place) {
+        if (key_map_create(&out, output, in.bytes) != 0) {
+            fprintf(stderr, "%s Cannot create %s: %s\n", pl->tag, output, strerror(errno));
+            key_map_close(&in);
+            return 1;
+        }
+        key_map_copy(out.data, in.data, in.bytes, driver_threads(pl, n));
+        keys = out.data;
+    }
+    double map_time = sort_wall_time() - t0;
+
+    double elapsed = drv->sort(drv->arg, keys, n, key_bits);
+    int ok = !verify || radix_verify_sorted_keys(keys, n, key_bits);
+    printf("%s Sorted %ld %d-bit keys (%s) from %s%s%s with %d threads in %.3f s "
+           "(map + copy %.3f s).\n",
+           pl->tag, n, key_bits, drv->name(drv->arg, key_bits), input,
+           in_place ? "" : " into ", in_place ? "" : output,
+           pl->threads, elapsed, map_time);
+    if (drv->report) {
+        drv->report(drv->arg, key_bits);
+    }
+    if (pl->use_pool) {
+        driver_print_pool_stats();
+        scratch_pool_trim();
+    }
+
+    key_map_close(&out);
+    key_map_close(&in);
+    if (verify && !ok) {
+        fprintf(stderr, "Verification failed.\n");
+        return 1;
+    }
+    return 0;
+}
+
+int driver_run_text_sort(const sort_driver *drv, const char *input, const char *output,
+                         int key_bits, int in_format, int out_format, int verify, int show_stats) {
+    const sort_placement *pl = drv->place;
+    size_t key_bytes = (size_t)key_bits / 8;
+    key_map in;
+    void *keys = NULL;
+    long n = 0;
+
+    double t0 = sort_wall_time();
+    if (in_format != FORMAT_PACKED && key_map_open(&in, input, 0, pl->threads) != 0) {
+        fprintf(stderr, "%s Cannot map %s: %s\n", pl->tag, input, strerror(errno));
+        return 1;
+    }
+    if (in_format == FORMAT_PACKED) {
+        if (driver_load_packed(pl->tag, input, key_bits, &keys, &n) != 0) {
+            return 1;
+        }
+    } else if (in_format == FORMAT_TEXT) {
+        size_t bad = 0;
+        if (text_parse_keys((const char *)in.data, in.bytes, key_bits, pl->threads, &keys, &n,
+                            &bad) != 0) {
+            int saved = errno;
+            long line = 1;
+            for (size_t i = 0; saved != ENOMEM && i < bad; ++i) {
+                line += ((const char *)in.data)[i] == '\n';
+            }
+            if (saved == ENOMEM) {
+                fprintf(stderr, "%s Allocation failed\n", pl->tag);
+            } else {
+                fprintf(stderr, "%s %s:%ld: %s\n", pl->tag, input, line,
+                        saved == ERANGE ? "key does not fit the key width"
+                                        : "not an unsigned decimal key");
+            }
+            key_map_close(&in);
+            return 1;
+        }
+    } else {
+        if (in.bytes % key_bytes != 0) {
+            fprintf(stderr, "%s %s is %zu bytes, not a multiple of %zu-byte keys\n",
+                    pl->tag, input, in.bytes, key_bytes);
+            key_map_close(&in);
+            return 1;
+        }
+        n = (long)(in.bytes / key_bytes);
+        keys = malloc(in.bytes > 0 ? in.bytes : 1);
+        if (!keys) {
+            fprintf(stderr, "%s Allocation failed\n", pl->tag);
+            exit(1);
+        }
+        key_map_copy(keys, in.data, in.bytes, driver_threads(pl, n));
+    }
+    if (in_format != FORMAT_PACKED) {
+        key_map_close(&in);
+    }
+    double load_time = sort_wall_time() - t0;
+
+    double elapsed = drv->sort(drv->arg, keys, n, key_bits);
+    int ok = !verify || radix_verify_sorted_keys(keys, n, key_bits);
+
+    /* The input is closed, so writing back over it is safe. */
+    const char *path = output ? output : input;
+    double t1 = sort_wall_time();
+    size_t out_bytes = 0;
+    if (out_format == FORMAT_PACKED) {
+        if (packed_write(path, keys, n, key_bits, pl->threads, &out_bytes) != 0) {
+            fprintf(stderr, "%s Cannot write %s: %s\n", pl->tag, path, strerror(errno));
+            free(keys);
+            return 1;
+        }
+    } else {
+        out_bytes = out_format == FORMAT_TEXT ? text_format_size(keys, n, key_bits, pl->threads)
+                                              : (size_t)n * key_bytes;
+        key_map out;
+        if (key_map_create(&out, path, out_bytes) != 0) {
+            fprintf(stderr, "%s Cannot create %s: %s\n", pl->tag, path, strerror(errno));
+            free(keys);
+            return 1;
+        }
+        if (out_format == FORMAT_TEXT) {
+            text_format_keys(keys, n, key_bits, pl->threads, (char *)out.data);
+        } else {
+            key_map_copy(out.data, keys, out_bytes, driver_threads(pl, n));
+        }
+        key_map_close(&out);
+    }
+    double store_time = sort_wall_time() - t1;
+
+    printf("%s Sorted %ld %d-bit keys (%s) from %s (%s) into %s (%s) with %d threads "
+           "in %.3f s (%s %.3f s, %s %.3f s).\n",
+           pl->tag, n, key_bits, drv->name(drv->arg, key_bits), input,
+           driver_format_name(in_format), path, driver_format_name(out_format), pl->threads,
+           elapsed, in_format == FORMAT_TEXT ? "parse" : "load", load_time,
+           out_format == FORMAT_BINARY ? "store" : out_format == FORMAT_TEXT ? "format" : "pack",
+           store_time);
+    if (show_stats && out_format == FORMAT_PACKED) {
+        double raw = (double)n * key_bytes;
+        printf("[packed] %.1f MB for %.1f MB of keys (%.2fx) in %ld blocks\n",
+               (double)out_bytes / (1024.0 * 1024.0), raw / (1024.0 * 1024.0),
+               out_bytes ? raw / (double)out_bytes : 0.0, key_codec_blocks(n));
+    }
+    if (drv->report) {
+        drv->report(drv->arg, key_bits);
+    }
+    if (pl->use_pool) {
+        driver_print_pool_stats();
+        scratch_pool_trim();
+    }
+    free(keys);
+    if (verify && !ok) {
+        fprintf(stderr, "Verification failed.\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+#ifndef SORT_DRIVER_H
+#define SORT_DRIVER_H
+
+#include <stddef.h>
+
+#include "numa_place.h"
+
+/* What the pthread and OpenMP drivers share around their kernels: worker
+   counts, scratch and input placement, per-socket bandwidth, libradix
+   sorts run with the driver's pinning and placement, and the --input
+   sorts of raw, text and packed key files. As in the drivers, a failed
+   allocation prints and exits; file errors print and come back as the
+   process exit status. */
+
+/* The part of a driver's sort_config these helpers read. */
+typedef struct {
+    const char *tag;             /* "[pthread]" or "[OpenMP]", starts every message */
+    int threads;
+    int affinity;                /* AFFINITY_* from numa_place.h */
+    int numa;                    /* NUMA_FIRST_TOUCH or NUMA_INTERLEAVE */
+    int use_pool;                /* take tmp from the huge-page scratch pool */
+    const cpu_topology *topo;
+    long min_chunk;              /* fewest keys per worker; 0: libradix's default */
+} sort_placement;
+
+/* Kernel traffic per socket, printed as one "[numa]" line. */
+typedef struct {
+    int sockets;                 /* sockets with at least one kernel worker */
+    double socket_bytes[NUMA_MAX_SOCKETS];
+    double socket_time[NUMA_MAX_SOCKETS];  /* slowest worker on the socket */
+} sort_bandwidth;
+
+/* Workers actually used for an n-key sort, as radix_sort_threads counts
+   them for pl->threads and pl->min_chunk. */
+int driver_threads(const sort_placement *pl, long n);
+
+/* Scratch buffer for n keys of elem_size bytes: from the reusable
+   huge-page pool with --pool, otherwise a fresh malloc that is interleaved
+   across nodes on request. */
+void *driver_scratch_alloc(const sort_placement *pl, long n, size_t elem_size, int threads);
+void driver_scratch_free(const sort_placement *pl, void *buf);
+
+/* Places an n-key input buffer before it is written: either interleaved
+   across nodes, or faulted in by the worker that will own each slice. */
+void driver_place_input(const sort_placement *pl, void *data, long n, size_t elem_size);
+
+/* Pinning for a team whose worker 0 is the calling thread (ws_set_hooks,
+   radix_options.worker_begin): enter pins worker w per pl->affinity, and
+   leave hands worker 0 back the mask it had, so threads the caller starts
+   later are not confined to one CPU. Zero the struct before use. */
+typedef struct {
+    const sort_placement *pl;
+    cpu_mask saved;
+} driver_pinning;
+
+void driver_pin_enter(void *arg, int worker);
+void driver_pin_leave(void *arg, int worker);
+
+/* Adds one worker's traffic to bw, which may be NULL. */
+void driver_record_bandwidth(sort_bandwidth *bw, const cpu_topology *topo, int cpu, double bytes,
+                             double elapsed);
+void driver_print_bandwidth(const sort_bandwidth *bw);
+void driver_print_pool_stats(void);
+/* libradix scratch blocks so far: from the heap and from an allocator. */
+void driver_print_alloc_stats(void);
+
+/* Sorts keys[0, n) of key_bits (32 or 64) bits with the libradix LSD
+   kernel on `backend`, over the digits in `digits` (radix_options.digits).
+   Worker t is pinned per pl->affinity, the scratch comes from
+   driver_scratch_alloc (or is `lend`, n keys the caller holds) and is
+   faulted in by its workers under NUMA_FIRST_TOUCH, and each worker's
+   traffic is added to bw. Returns the seconds the sort took. */
+double driver_radix_sort(const sort_placement *pl, int backend, void *keys, long n, int key_bits,
+                         unsigned int digits, void *lend, sort_bandwidth *bw);
+
+/* The same kernel on the calling thread alone, unpinned and with scratch
+   (n keys) as its buffer: for sorts inside scheduler tasks. */
+void driver_radix_sort_serial(void *keys, long n, int key_bits, unsigned int digits,
+                              void *scratch);
+
+/* ends[d] for d in [0, 256): one past the last key of arr[0, n) whose 8-bit
+   digit at shift is d. arr must be ordered on that digit. */
+void driver_bucket_ends(const int *arr, long n, int shift, long *ends);
+
+/* --in-format / --out-format: FORMAT_BINARY, FORMAT_TEXT or FORMAT_PACKED. */
+enum { FORMAT_BINARY, FORMAT_TEXT, FORMAT_PACKED };
+
+const char *driver_format_name(int format);
+int driver_parse_format(const char *name, int *format);
+
+/* --in-format packed: every key of a packed file into a malloc'd array.
+   Returns 0, or -1 after printing why not. */
+int driver_load_packed(const char *tag, const char *path, int key_bits, void **keys, long *n);
+
+/* A driver's kernels, as the shared --input sorts call them. */
+typedef struct {
+    const sort_placement *place;
+    /* Sorts keys[0, n) and returns the seconds the kernel took. */
+    double (*sort)(void *arg, void *keys, long n, int key_bits);
+    /* The kernel sort uses for key_bits, for the summary line. */
+    const char *(*name)(void *arg, int key_bits);
+    /* Optional: the driver's --stats lines, printed after the summary. */
+    void (*report)(void *arg, int key_bits);
+    void *arg;
+} sort_driver;
+
+/* --input: sorts a raw little-endian key file through a shared mapping,
+   either in place or in a freshly created --output file that the workers
+   fill in parallel. Returns the process exit status. */
+int driver_run_file_sort(const sort_driver *drv, const char *input, const char *output,
+                         int key_bits, int verify);
+
+/* --in-format / --out-format text or packed: keys are parsed from decimal
+   text, decoded from a packed file or copied from a binary mapping into a
+   private array, sorted there and then written to --output, or back over
+   --input, as binary, text or packed blocks. show_stats adds the packed
+   size line. Returns the process exit status. */
+int driver_run_text_sort(const sort_driver *drv, const char *input, const char *output,
+                         int key_bits, int in_format, int out_format, int verify, int show_stats);
+
+#endif
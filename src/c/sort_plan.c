@@ -0,0 +1,235 @@
+#ifndef _WIN32
+#define _XOPEN_SOURCE 700
+#endif
+
+#include "sort_plan.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#define RADIX_BITS 8
+#define RADIX (1 << RADIX_BITS)
+
+/* Cost model, in nanoseconds per key unless noted. The figures are rough
+   single-core measurements of the pthread kernels; only their ratios matter
+   for the choice, and --stats prints estimated next to actual cost. */
+#define PLAN_NS_SCAN 1.5          /* analysis pass, run-boundary scan */
+#define PLAN_NS_PASS_MEM 9.0      /* one LSD pass whose buffers exceed the LLC */
+#define PLAN_NS_PASS_CACHE 3.0    /* one LSD pass that stays in the LLC */
+#define PLAN_NS_COUNT 3.0         /* counting sort: histogram + rewrite */
+#define PLAN_NS_COUNT_BIN 0.5     /* counting sort: per value in [min, max] */
+#define PLAN_NS_MERGE 2.5         /* one merge level */
+#define PLAN_NS_COMPARE 4.0       /* qsort, per key per log2(n) */
+#define PLAN_NS_THREAD 30000.0    /* per worker per parallel phase (start, barriers) */
+
+#define PLAN_COUNTING_MAX_RANGE (1L << 20)
+#define PLAN_MAX_RUNS 256
+#define PLAN_DEFAULT_LLC (8L * 1024 * 1024)
+
+static long llc_bytes(void) {
+#if defined(_SC_LEVEL3_CACHE_SIZE)
+    long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (llc > 0) {
+        return llc;
+    }
+#endif
+    return PLAN_DEFAULT_LLC;
+}
+
+static int cmp_uint(const void *a, const void *b) {
+    unsigned int ua = *(const unsigned int *)a;
+    unsigned int ub = *(const unsigned int *)b;
+    return (ua > ub) - (ua < ub);
+}
+
+static long sample_size(long n) {
+    long s = n / 16;
+    return s > PLAN_SAMPLE ? PLAN_SAMPLE : s;
+}
+
+void plan_analyze(const int *arr, long n, plan_input *out) {
+    memset(out, 0, sizeof(*out));
+    out->n = n;
+    out->runs = n > 0 ? 1 : 0;
+    if (n == 0) {
+        return;
+    }
+
+    const unsigned int *keys = (const unsigned int *)arr;
+    unsigned int lo = keys[0];
+    unsigned int hi = keys[0];
+    unsigned int varying = 0;
+    long descents = 0;
+    for (long i = 1; i < n; ++i) {
+        unsigned int k = keys[i];
+        lo = k < lo ? k : lo;
+        hi = k > hi ? k : hi;
+        varying |= k ^ keys[0];
+        descents += k < keys[i - 1];
+    }
+    out->min = lo;
+    out->max = hi;
+    out->runs = descents + 1;
+    for (int d = 0; d < PLAN_DIGITS; ++d) {
+        if ((varying >> (d * RADIX_BITS)) & (RADIX - 1)) {
+            out->digit_mask |= 1u << d;
+        }
+    }
+
+    /* Too few keys to be worth sampling: assume all distinct, full entropy. */
+    long s = sample_size(n);
+    out->distinct = (double)n;
+    for (int d = 0; d < PLAN_DIGITS; ++d) {
+        out->entropy[d] = (out->digit_mask >> d) & 1u ? (double)RADIX_BITS : 0.0;
+    }
+    if (s < 64) {
+        return;
+    }
+
+    unsigned int sample[PLAN_SAMPLE];
+    long counts[PLAN_DIGITS][RADIX];
+    memset(counts, 0, sizeof(counts));
+    for (long i = 0; i < s; ++i) {
+        unsigned int k = keys[(long)((double)i * (double)n / (double)s)];
+        sample[i] = k;
+        for (int d = 0; d < PLAN_DIGITS; ++d) {
+            counts[d][(k >> (d * RADIX_BITS)) & (RADIX - 1)]++;
+        }
+    }
+    for (int d = 0; d < PLAN_DIGITS; ++d) {
+        double h = 0.0;
+        for (int v = 0; v < RADIX; ++v) {
+            if (counts[d][v] > 0) {
+                double p = (double)counts[d][v] / (double)s;
+                h -= p * log2(p);
+            }
+        }
+        out->entropy[d] = h;
+    }
+
+    /* GEE estimator: values seen once in the sample are scaled up by
+       sqrt(n / s), values seen repeatedly are counted as they are. */
+    qsort(sample, (size_t)s, sizeof(unsigned int), cmp_uint);
+    long once = 0;
+    long repeated = 0;
+    for (long i = 0; i < s;) {
+        long j = i + 1;
+        while (j < s && sample[j] == sample[i]) {
+            ++j;
+        }
+        if (j - i == 1) {
+            ++once;
+        } else {
+            ++repeated;
+        }
+        i = j;
+    }
+    double distinct = sqrt((double)n / (double)s) * (double)once + (double)repeated;
+    double range = (double)hi - (double)lo + 1.0;
+    distinct = distinct > range ? range : distinct;
+    out->distinct = distinct > (double)n ? (double)n : distinct;
+}
+
+static int popcount4(unsigned int mask) {
+    int c = 0;
+    for (int d = 0; d < PLAN_DIGITS; ++d) {
+        c += (mask >> d) & 1u;
+    }
+    return c;
+}
+
+static double pass_ns(double bytes, long llc) {
+    return bytes <= (double)llc ? PLAN_NS_PASS_CACHE : PLAN_NS_PASS_MEM;
+}
+
+void plan_choose(const plan_input *input, int threads, int cpus, sort_plan *out) {
+    memset(out, 0, sizeof(*out));
+    out->input = *input;
+    out->threads = threads < 1 ? 1 : threads;
+    out->digit_mask = input->digit_mask;
+    for (int k = 0; k <= PLAN_RUN_MERGE; ++k) {
+        out->est_costs[k] = -1.0;
+    }
+
+    double n = (double)input->n;
+    double t = (double)(cpus >= 1 && cpus < out->threads ? cpus : out->threads);
+    long llc = llc_bytes();
+    double analysis = n * PLAN_NS_SCAN + (double)sample_size(input->n) * PLAN_NS_COMPARE * 12.0;
+    double spawn = out->threads > 1 ? out->threads * PLAN_NS_THREAD : 0.0;
+
+    if (input->runs <= 1) {
+        out->est_costs[PLAN_SORTED] = 0.0;
+    }
+    if (input->n >= 2) {
+        out->est_costs[PLAN_COMPARISON] = n * log2(n) * PLAN_NS_COMPARE;
+    }
+    double range = (double)input->max - (double)input->min + 1.0;
+    if (range <= (double)PLAN_COUNTING_MAX_RANGE) {
+        out->est_costs[PLAN_COUNTING] = n * PLAN_NS_COUNT + range * PLAN_NS_COUNT_BIN;
+    }
+
+    int passes = popcount4(input->digit_mask);
+    double lsd_pass = pass_ns(n * 2.0 * sizeof(int), llc);
+    out->est_costs[PLAN_LSD] = n * passes * lsd_pass / t + spawn;
+
+    /* Partition on the top varying digit, then sequential LSD over every
+       digit below it per bucket; buckets that fit the LLC pass cheaply and
+       only as many workers as there are sizeable buckets help. */
+    int top = -1;
+    for (int d = PLAN_DIGITS - 1; d >= 0; --d) {
+        if ((input->digit_mask >> d) & 1u) {
+            top = d;
+            break;
+        }
+    }
+    if (passes >= 2) {
+        double buckets = pow(2.0, input->entropy[top]);
+        buckets = buckets < input->distinct ? buckets : input->distinct;
+        buckets = buckets < 1.0 ? 1.0 : buckets;
+        double parallel = buckets < t ? buckets : t;
+        double lower = pass_ns(n / buckets * 2.0 * sizeof(int), llc);
+        out->est_costs[PLAN_MSD_LSD] = n * PLAN_NS_PASS_MEM / t + spawn +
+                                       n * top * lower / parallel + spawn;
+        out->top_shift = top * RADIX_BITS;
+    }
+
+    if (input->runs > 1 && input->runs <= PLAN_MAX_RUNS) {
+        double levels = ceil(log2((double)input->runs));
+        out->est_costs[PLAN_RUN_MERGE] = n * PLAN_NS_SCAN + n * levels * PLAN_NS_MERGE;
+    }
+
+    out->kind = PLAN_LSD;
+    for (int k = 0; k <= PLAN_RUN_MERGE; ++k) {
+        if (out->est_costs[k] >= 0.0 && out->est_costs[k] < out->est_costs[out->kind]) {
+            out->kind = k;
+        }
+    }
+    for (int k = 0; k <= PLAN_RUN_MERGE; ++k) {
+        if (out->est_costs[k] >= 0.0) {
+            out->est_costs[k] = (out->est_costs[k] + analysis) * 1e-9;
+        }
+    }
+    out->est_cost = out->est_costs[out->kind];
+}
+
+const char *plan_name(int kind) {
+    switch (kind) {
+    case PLAN_SORTED:
+        return "sorted";
+    case PLAN_COMPARISON:
+        return "comparison";
+    case PLAN_COUNTING:
+        return "counting";
+    case PLAN_MSD_LSD:
+        return "msd+lsd";
+    case PLAN_RUN_MERGE:
+        return "run-merge";
+    default:
+        return "lsd";
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef SORT_PLAN_H
+#define SORT_PLAN_H
+
+/* Cost-model planner for `--algo auto`.
+
+   plan_analyze makes one streaming pass over the keys for the exact facts a
+   plan depends on for correctness (min/max, which digits vary, descents),
+   and looks at an evenly spaced sample of at most PLAN_SAMPLE keys for the
+   statistical ones (distinct count, per-digit byte entropy). plan_choose
+   prices every strategy with a simple per-key cost model and picks the
+   cheapest. Keys are ordered as unsigned 32-bit values, like the kernels. */
+
+#define PLAN_SAMPLE 4096
+#define PLAN_DIGITS 4
+
+enum {
+    PLAN_SORTED,      /* input already ascending: nothing to do */
+    PLAN_COMPARISON,  /* qsort, for tiny inputs */
+    PLAN_COUNTING,    /* one histogram over [min, max] when the range is small */
+    PLAN_LSD,         /* parallel LSD over the digits that vary only */
+    PLAN_MSD_LSD,     /* partition on the top varying digit, LSD per bucket in cache */
+    PLAN_RUN_MERGE    /* merge the ascending runs of a nearly sorted input */
+};
+
+typedef struct {
+    long n;
+    unsigned int min;
+    unsigned int max;
+    unsigned int digit_mask;        /* bit d set if digit d (bits 8d..8d+7) varies */
+    long runs;                      /* maximal ascending runs */
+    double distinct;                /* estimated from the sample */
+    double entropy[PLAN_DIGITS];    /* bits per digit in the sample, 0..8 */
+} plan_input;
+
+typedef struct {
+    int kind;                       /* PLAN_* */
+    int threads;                    /* workers the kernels will use */
+    unsigned int digit_mask;        /* digits LSD sorts (PLAN_LSD, PLAN_MSD_LSD) */
+    int top_shift;                  /* partition digit for PLAN_MSD_LSD */
+    double est_cost;                /* seconds, analysis included */
+    double est_costs[PLAN_RUN_MERGE + 1];  /* every candidate; < 0 if not applicable */
+    plan_input input;
+} sort_plan;
+
+void plan_analyze(const int *arr, long n, plan_input *out);
+/* threads is the worker count the kernels will use; cpus bounds how much
+   of that is real parallelism. */
+void plan_choose(const plan_input *input, int threads, int cpus, sort_plan *out);
+const char *plan_name(int kind);
+
+#endif
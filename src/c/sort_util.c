@@ -0,0 +1,100 @@
+#ifndef _WIN32
+#define _XOPEN_SOURCE 700
+#endif
+
+#include "sort_util.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+void sort_run_slices(sort_slice_fn fn, void *jobs, size_t job_bytes, int count) {
+    pthread_t *tids = count > 1 ? (pthread_t *)malloc(sizeof(pthread_t) * count) : NULL;
+    int *started = count > 1 ? (int *)calloc((size_t)count, sizeof(int)) : NULL;
+    for (int t = 1; t < count && tids && started; ++t) {
+        started[t] = pthread_create(&tids[t], NULL, fn, (char *)jobs + t * job_bytes) == 0;
+    }
+    fn(jobs);
+    for (int t = 1; t < count; ++t) {
+        if (started && started[t]) {
+            pthread_join(tids[t], NULL);
+        } else {
+            fn((char *)jobs + t * job_bytes);
+        }
+    }
+    free(tids);
+    free(started);
+}
+
+#ifdef _WIN32
+double sort_wall_time(void) {
+    static LARGE_INTEGER freq;
+    static int initialized = 0;
+    if (!initialized) {
+        QueryPerformanceFrequency(&freq);
+        initialized = 1;
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart / (double)freq.QuadPart;
+}
+#else
+double sort_wall_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+int sort_write_all(int fd, const void *buf, size_t bytes) {
+    const char *p = (const char *)buf;
+    while (bytes > 0) {
+        ssize_t put = write(fd, p, bytes);
+        if (put < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += put;
+        bytes -= (size_t)put;
+    }
+    return 0;
+}
+
+int sort_read_full(int fd, void *buf, size_t bytes, off_t off) {
+    char *p = (char *)buf;
+    while (bytes > 0) {
+        ssize_t got = pread(fd, p, bytes, off);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (got == 0) {
+            errno = EIO;   /* shorter than the caller was told */
+            return -1;
+        }
+        p += got;
+        off += got;
+        bytes -= (size_t)got;
+    }
+    return 0;
+}
+
+ssize_t sort_read_some(int fd, void *buf, size_t bytes) {
+    for (;;) {
+        ssize_t got = read(fd, buf, bytes);
+        if (got >= 0 || errno != EINTR) {
+            return got;
+        }
+    }
+}
+#endif
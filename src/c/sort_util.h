@@ -0,0 +1,85 @@
+#ifndef SORT_UTIL_H
+#define SORT_UTIL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+/* Helpers shared by the drivers and the file, stream and record sorts: a
+   wall clock, a fan-out of slices over threads, whole-buffer file I/O, bit
+   and key helpers, and the min-heap every k-way merge is built on. The
+   small ones are inline because they sit in per-key loops. The I/O
+   functions retry on EINTR and return 0 on success and -1 with errno set. */
+
+/* Seconds on a monotonic clock. */
+double sort_wall_time(void);
+
+/* Runs fn over jobs[0, count), each job_bytes apart, job 0 on the calling
+   thread; a job whose thread cannot be started runs on the caller after
+   the others are joined. */
+typedef void *(*sort_slice_fn)(void *);
+void sort_run_slices(sort_slice_fn fn, void *jobs, size_t job_bytes, int count);
+
+#ifndef _WIN32
+/* Writes all of buf. */
+int sort_write_all(int fd, const void *buf, size_t bytes);
+/* Reads exactly bytes at off; a file that ends first is EIO. */
+int sort_read_full(int fd, void *buf, size_t bytes, off_t off);
+/* One read(2): what the input has ready, 0 at end of file, -1 on error. */
+ssize_t sort_read_some(int fd, void *buf, size_t bytes);
+#endif
+
+static inline int sort_is_digit(char c) {
+    return (unsigned char)(c - '0') < 10;
+}
+
+/* Bits needed to hold x: 0 for 0, 64 for values with the top bit set. */
+static inline int sort_bit_width(uint64_t x) {
+#if defined(__GNUC__)
+    return x ? 64 - __builtin_clzll(x) : 0;
+#else
+    int w = 0;
+    for (; x; x >>= 1) {
+        ++w;
+    }
+    return w;
+#endif
+}
+
+/* The native-endian 4- or 8-byte key at p, widened. */
+static inline uint64_t sort_load_key(const char *p, int key_bytes) {
+    if (key_bytes == 8) {
+        uint64_t k;
+        memcpy(&k, p, sizeof(k));
+        return k;
+    }
+    uint32_t k;
+    memcpy(&k, p, sizeof(k));
+    return k;
+}
+
+/* Min-heap of source indices ordered by top[index]: moves heap[i] down
+   until neither child is smaller. After the smallest source advances, its
+   new key goes into top and the root is sifted again. */
+static inline void sort_heap_sift(int *heap, const uint64_t *top, int size, int i) {
+    for (;;) {
+        int l = 2 * i + 1;
+        int m = i;
+        if (l < size && top[heap[l]] < top[heap[m]]) {
+            m = l;
+        }
+        if (l + 1 < size && top[heap[l + 1]] < top[heap[m]]) {
+            m = l + 1;
+        }
+        if (m == i) {
+            return;
+        }
+        int swap = heap[i];
+        heap[i] = heap[m];
+        heap[m] = swap;
+        i = m;
+    }
+}
+
+#endif
@@ -0,0 +1,678 @@
+#ifndef _WIN32
+#define _XOPEN_SOURCE 700
+#endif
+
+#include "stream_sort.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sort_util.h"
+#include "text_keys.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define STREAM_MIN_BATCH (64L * 1024)
+/* Text is read in pieces of at most this size; a key may not be longer. */
+#define STREAM_TEXT_BYTES (8L * 1024 * 1024)
+/* File-backed runs are merged through buffers of at least this size. */
+#define STREAM_MIN_MERGE_BUFFER (256L * 1024)
+#define STREAM_OUT_KEYS (64L * 1024)
+#define STREAM_PATH_MAX 1024
+
+#ifndef _WIN32
+
+typedef struct {
+    char *data;                  /* sorted keys, or NULL once spilled */
+    long keys;
+    char path[STREAM_PATH_MAX];  /* spilled run; empty while in memory */
+} stream_batch;
+
+typedef struct {
+    const stream_sort_config *cfg;
+    int key_bytes;
+    size_t batch_bytes;
+    size_t retain_bytes;         /* budget left for sorted batches in memory */
+    size_t retained;
+    stream_batch *batches;
+    int count;
+    int cap;
+    int next_run;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    char *pending;               /* full batch waiting for the sorter */
+    long pending_keys;
+    int finished;
+    int error;
+    pthread_t sorter;
+    double sort_time;
+    double spill_time;
+    int spilled;
+} stream_state;
+
+static int run_path(stream_state *st, char *path) {
+    int len = snprintf(path, STREAM_PATH_MAX, "%s/radix_stream_%ld_%d.tmp",
+                       st->cfg->tmpdir, (long)getpid(), st->next_run++);
+    if (len < 0 || len >= STREAM_PATH_MAX) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    return 0;
+}
+
+static int write_run(stream_state *st, char *path, const char *data, size_t bytes) {
+    if (run_path(st, path) != 0) {
+        path[0] = '\0';
+        return -1;
+    }
+    int fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        path[0] = '\0';
+        return -1;
+    }
+    int rc = sort_write_all(fd, data, bytes);
+    int saved = errno;
+    if (close(fd) != 0 && rc == 0) {
+        rc = -1;
+        saved = errno;
+    }
+    errno = saved;
+    return rc;
+}
+
+static void set_error(stream_state *st, int err) {
+    pthread_mutex_lock(&st->lock);
+    if (st->error == 0) {
+        st->error = err ? err : EIO;
+    }
+    pthread_cond_broadcast(&st->changed);
+    pthread_mutex_unlock(&st->lock);
+}
+
+/* ---- Batches ----------------------------------------------------------- */
+
+/* Sorts the batch and keeps it, in memory while the budget allows and in a
+   run file after that. Only the sorter thread touches st->batches. */
+static int keep_batch(stream_state *st, char *data, long keys) {
+    double t0 = sort_wall_time();
+    if (st->cfg->sort_batch(data, keys, st->cfg->key_bits, st->cfg->sort_arg) != 0) {
+        free(data);
+        return -1;
+    }
+    st->sort_time += sort_wall_time() - t0;
+
+    if (st->count == st->cap) {
+        int cap = st->cap ? st->cap * 2 : 16;
+        stream_batch *grown = (stream_batch *)realloc(st->batches, sizeof(stream_batch) * cap);
+        if (!grown) {
+            free(data);
+            errno = ENOMEM;
+            return -1;
+        }
+        st->batches = grown;
+        st->cap = cap;
+    }
+    stream_batch *b = &st->batches[st->count++];
+    memset(b, 0, sizeof(*b));
+    b->keys = keys;
+    size_t bytes = (size_t)keys * st->key_bytes;
+    if (st->retained + bytes <= st->retain_bytes) {
+        b->data = data;
+        st->retained += bytes;
+        return 0;
+    }
+    double s0 = sort_wall_time();
+    int rc = write_run(st, b->path, data, bytes);
+    free(data);
+    st->spill_time += sort_wall_time() - s0;
+    st->spilled++;
+    return rc;
+}
+
+static void *sorter_main(void *arg) {
+    stream_state *st = (stream_state *)arg;
+    for (;;) {
+        pthread_mutex_lock(&st->lock);
+        while (!st->pending && !st->finished && st->error == 0) {
+            pthread_cond_wait(&st->changed, &st->lock);
+        }
+        char *data = st->pending;
+        long keys = st->pending_keys;
+        st->pending = NULL;
+        int stop = st->error != 0 || (!data && st->finished);
+        pthread_cond_broadcast(&st->changed);
+        pthread_mutex_unlock(&st->lock);
+        if (stop) {
+            free(data);
+            return NULL;
+        }
+        if (keep_batch(st, data, keys) != 0) {
+            set_error(st, errno);
+            return NULL;
+        }
+    }
+}
+
+/* Passes a full batch to the sorter, waiting while it still has one queued. */
+static int hand_off(stream_state *st, char *data, long keys) {
+    pthread_mutex_lock(&st->lock);
+    while (st->pending && st->error == 0) {
+        pthread_cond_wait(&st->changed, &st->lock);
+    }
+    int err = st->error;
+    if (err == 0) {
+        st->pending = data;
+        st->pending_keys = keys;
+        pthread_cond_broadcast(&st->changed);
+    }
+    pthread_mutex_unlock(&st->lock);
+    if (err != 0) {
+        free(data);
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+/* ---- Input ------------------------------------------------------------- */
+
+typedef struct {
+    char *data;
+    size_t have;
+} fill_buf;
+
+/* Appends keys to the batch being filled, handing off every batch that fills. */
+static int append_keys(stream_state *st, fill_buf *fill, const char *keys, size_t bytes) {
+    while (bytes > 0) {
+        if (!fill->data) {
+            fill->data = (char *)malloc(st->batch_bytes);
+            fill->have = 0;
+            if (!fill->data) {
+                errno = ENOMEM;
+                return -1;
+            }
+        }
+        size_t take = st->batch_bytes - fill->have < bytes ? st->batch_bytes - fill->have : bytes;
+        memcpy(fill->data + fill->have, keys, take);
+        fill->have += take;
+        keys += take;
+        bytes -= take;
+        if (fill->have == st->batch_bytes) {
+            char *full = fill->data;
+            fill->data = NULL;
+            if (hand_off(st, full, (long)(st->batch_bytes / st->key_bytes)) != 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Binary keys are read straight into the batch being filled. */
+static int read_binary(stream_state *st, int in_fd, fill_buf *fill, long *total) {
+    for (;;) {
+        if (!fill->data) {
+            fill->data = (char *)malloc(st->batch_bytes);
+            fill->have = 0;
+            if (!fill->data) {
+                errno = ENOMEM;
+                return -1;
+            }
+        }
+        ssize_t got = sort_read_some(in_fd, fill->data + fill->have, st->batch_bytes - fill->have);
+        if (got < 0) {
+            return -1;
+        }
+        if (got == 0) {
+            break;
+        }
+        fill->have += (size_t)got;
+        if (fill->have == st->batch_bytes) {
+            char *full = fill->data;
+            fill->data = NULL;
+            *total += (long)(st->batch_bytes / st->key_bytes);
+            if (hand_off(st, full, (long)(st->batch_bytes / st->key_bytes)) != 0) {
+                return -1;
+            }
+        }
+    }
+    if (fill->data && fill->have % st->key_bytes != 0) {
+        errno = EINVAL;   /* the stream ended inside a key */
+        return -1;
+    }
+    *total += fill->data ? (long)(fill->have / st->key_bytes) : 0;
+    return 0;
+}
+
+/* Text is parsed up to the last separator of every piece read; the digits
+   after it are carried over to the next piece. */
+static int read_text(stream_state *st, int in_fd, fill_buf *fill, long *total) {
+    size_t cap = st->batch_bytes < (size_t)STREAM_TEXT_BYTES ? st->batch_bytes
+                                                             : (size_t)STREAM_TEXT_BYTES;
+    char *text = (char *)malloc(cap);
+    if (!text) {
+        errno = ENOMEM;
+        return -1;
+    }
+    size_t have = 0;
+    int eof = 0;
+    while (!eof) {
+        ssize_t got = sort_read_some(in_fd, text + have, cap - have);
+        if (got < 0) {
+            free(text);
+            return -1;
+        }
+        eof = got == 0;
+        have += (size_t)got;
+        size_t cut = have;
+        while (!eof && cut > 0 && sort_is_digit(text[cut - 1])) {
+            --cut;
+        }
+        if (cut == 0 && !eof) {
+            if (have == cap) {
+                free(text);
+                errno = ERANGE;   /* a digit run longer than the read buffer */
+                return -1;
+            }
+            continue;
+        }
+        void *keys = NULL;
+        long n = 0;
+        size_t bad = 0;
+        if (text_parse_keys(text, cut, st->cfg->key_bits, st->cfg->threads, &keys, &n, &bad) != 0) {
+            free(text);
+            return -1;
+        }
+        int rc = append_keys(st, fill, (const char *)keys, (size_t)n * st->key_bytes);
+        free(keys);
+        if (rc != 0) {
+            free(text);
+            return -1;
+        }
+        *total += n;
+        memmove(text, text + cut, have - cut);
+        have -= cut;
+    }
+    free(text);
+    return 0;
+}
+
+/* ---- Merge ------------------------------------------------------------- */
+
+typedef struct {
+    int fd;
+    char *buf;
+    long keys;               /* valid keys in buf */
+    long pos;
+    off_t next;              /* file offset of the next refill */
+    long left;               /* keys still in the file */
+} merge_cursor;
+
+typedef struct {
+    int fd;
+    int text;
+    int key_bytes;
+    int key_bits;
+    int threads;
+    char *buf;
+    long cap;
+    long n;
+    char *text_buf;
+    size_t text_cap;
+    uint64_t last;
+    int any;
+    long out_of_order;
+} merge_sink;
+
+static int cursor_refill(merge_cursor *c, long cap, int key_bytes) {
+    long n = c->left < cap ? c->left : cap;
+    c->keys = n;
+    c->pos = 0;
+    if (n == 0) {
+        return 0;
+    }
+    size_t bytes = (size_t)n * key_bytes;
+    size_t done = 0;
+    while (done < bytes) {
+        ssize_t got = pread(c->fd, c->buf + done, bytes - done, c->next + (off_t)done);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            if (got == 0) {
+                errno = EIO;
+            }
+            return -1;
+        }
+        done += (size_t)got;
+    }
+    c->next += (off_t)bytes;
+    c->left -= n;
+    return 0;
+}
+
+static int sink_flush(merge_sink *s) {
+    if (s->n == 0) {
+        return 0;
+    }
+    long n = s->n;
+    s->n = 0;
+    if (!s->text) {
+        return sort_write_all(s->fd, s->buf, (size_t)n * s->key_bytes);
+    }
+    size_t bytes = text_format_size(s->buf, n, s->key_bits, s->threads);
+    if (bytes > s->text_cap) {
+        char *grown = (char *)realloc(s->text_buf, bytes);
+        if (!grown) {
+            errno = ENOMEM;
+            return -1;
+        }
+        s->text_buf = grown;
+        s->text_cap = bytes;
+    }
+    text_format_keys(s->buf, n, s->key_bits, s->threads, s->text_buf);
+    return sort_write_all(s->fd, s->text_buf, bytes);
+}
+
+static int sink_put(merge_sink *s, const char *keys, long n) {
+    for (long i = 0; i < n; ++i) {
+        uint64_t k = sort_load_key(keys + (size_t)i * s->key_bytes, s->key_bytes);
+        s->out_of_order += s->any && k < s->last;
+        s->last = k;
+        s->any = 1;
+    }
+    while (n > 0) {
+        long take = s->cap - s->n < n ? s->cap - s->n : n;
+        memcpy(s->buf + (size_t)s->n * s->key_bytes, keys, (size_t)take * s->key_bytes);
+        s->n += take;
+        keys += (size_t)take * s->key_bytes;
+        n -= take;
+        if (s->n == s->cap && sink_flush(s) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Merges batches src[0, k) into the sink. Spilled batches are read through
+   buffers of buf_keys keys; in-memory ones are used where they are. Once a
+   single source is left, the rest of it is copied in bulk. */
+static int merge_batches(stream_batch *src, int k, int key_bytes, long buf_keys, merge_sink *sink) {
+    merge_cursor *cur = (merge_cursor *)calloc((size_t)k, sizeof(merge_cursor));
+    int *heap = (int *)malloc(sizeof(int) * (k > 0 ? k : 1));
+    uint64_t *top = (uint64_t *)malloc(sizeof(uint64_t) * (k > 0 ? k : 1));
+    int rc = -1;
+    if (!cur || !heap || !top) {
+        errno = ENOMEM;
+        goto done;
+    }
+    for (int r = 0; r < k; ++r) {
+        cur[r].fd = -1;
+    }
+    int size = 0;
+    for (int r = 0; r < k; ++r) {
+        merge_cursor *c = &cur[r];
+        if (src[r].data) {
+            c->buf = src[r].data;
+            c->keys = src[r].keys;
+        } else {
+            c->fd = open(src[r].path, O_RDONLY);
+            c->buf = (char *)malloc((size_t)buf_keys * key_bytes);
+            if (c->fd < 0 || !c->buf) {
+                if (!c->buf) {
+                    errno = ENOMEM;
+                }
+                goto done;
+            }
+            c->left = src[r].keys;
+            if (cursor_refill(c, buf_keys, key_bytes) != 0) {
+                goto done;
+            }
+        }
+        if (c->keys > 0) {
+            top[r] = sort_load_key(c->buf, key_bytes);
+            heap[size++] = r;
+        }
+    }
+    for (int i = size / 2 - 1; i >= 0; --i) {
+        sort_heap_sift(heap, top, size, i);
+    }
+
+    while (size > 1) {
+        int r = heap[0];
+        merge_cursor *c = &cur[r];
+        if (sink_put(sink, c->buf + (size_t)c->pos * key_bytes, 1) != 0) {
+            goto done;
+        }
+        if (++c->pos == c->keys && c->fd >= 0 && cursor_refill(c, buf_keys, key_bytes) != 0) {
+            goto done;
+        }
+        if (c->pos < c->keys) {
+            top[r] = sort_load_key(c->buf + (size_t)c->pos * key_bytes, key_bytes);
+        } else {
+            heap[0] = heap[--size];
+        }
+        sort_heap_sift(heap, top, size, 0);
+    }
+    if (size == 1) {
+        merge_cursor *c = &cur[heap[0]];
+        for (;;) {
+            if (sink_put(sink, c->buf + (size_t)c->pos * key_bytes, c->keys - c->pos) != 0) {
+                goto done;
+            }
+            if (c->fd < 0 || c->left == 0) {
+                break;
+            }
+            if (cursor_refill(c, buf_keys, key_bytes) != 0) {
+                goto done;
+            }
+        }
+    }
+    rc = sink_flush(sink);
+
+done:;
+    int saved = errno;
+    if (cur) {
+        for (int r = 0; r < k; ++r) {
+            if (cur[r].fd >= 0) {
+                close(cur[r].fd);
+                free(cur[r].buf);
+            } else if (!src[r].data) {
+                free(cur[r].buf);
+            }
+        }
+    }
+    free(cur);
+    free(heap);
+    free(top);
+    errno = saved;
+    return rc;
+}
+
+static void remove_batches(stream_batch *batches, int count) {
+    for (int b = 0; b < count; ++b) {
+        free(batches[b].data);
+        batches[b].data = NULL;
+        if (batches[b].path[0] != '\0') {
+            unlink(batches[b].path);
+            batches[b].path[0] = '\0';
+        }
+    }
+}
+
+/* Spilled runs beyond what the leftover budget can buffer are merged, a
+   group at a time, into longer runs; then everything goes to the output. */
+static int merge_all(stream_state *st, int out_fd, stream_sort_stats *stats) {
+    int kb = st->key_bytes;
+    size_t free_bytes = st->cfg->mem_bytes > st->retained ? st->cfg->mem_bytes - st->retained : 0;
+    long fanin = (long)(free_bytes / STREAM_MIN_MERGE_BUFFER) - 1;
+    fanin = fanin > 2 ? fanin : 2;
+
+    merge_sink sink;
+    memset(&sink, 0, sizeof(sink));
+    sink.key_bytes = kb;
+    sink.key_bits = st->cfg->key_bits;
+    sink.threads = st->cfg->threads;
+    sink.cap = STREAM_OUT_KEYS;
+    sink.buf = (char *)malloc((size_t)sink.cap * kb);
+    if (!sink.buf) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    /* Spilled runs are moved to the front so groups of them can be merged. */
+    int files = 0;
+    for (int b = 0; b < st->count; ++b) {
+        if (!st->batches[b].data) {
+            stream_batch swap = st->batches[files];
+            st->batches[files++] = st->batches[b];
+            st->batches[b] = swap;
+        }
+    }
+    int rc = 0;
+    while (files > fanin && rc == 0) {
+        int k = (int)fanin;
+        stream_batch longer;
+        memset(&longer, 0, sizeof(longer));
+        for (int r = 0; r < k; ++r) {
+            longer.keys += st->batches[r].keys;
+        }
+        long buf_keys = (long)(free_bytes / (size_t)(k + 1) / kb);
+        sink.fd = -1;
+        if (run_path(st, longer.path) == 0) {
+            sink.fd = open(longer.path, O_WRONLY | O_CREAT | O_EXCL, 0600);
+        }
+        if (sink.fd < 0) {
+            rc = -1;
+            break;
+        }
+        sink.text = 0;
+        sink.any = 0;
+        rc = merge_batches(st->batches, k, kb, buf_keys, &sink);
+        int saved = errno;
+        if (close(sink.fd) != 0 && rc == 0) {
+            rc = -1;
+            saved = errno;
+        }
+        remove_batches(st->batches, k);
+        memmove(&st->batches[1], &st->batches[k], sizeof(stream_batch) * (st->count - k));
+        st->batches[0] = longer;
+        st->count -= k - 1;
+        files -= k - 1;
+        if (rc != 0) {
+            unlink(longer.path);
+            st->batches[0].path[0] = '\0';
+            errno = saved;
+        }
+    }
+
+    if (rc == 0) {
+        long buf_keys = files > 0 ? (long)(free_bytes / (size_t)(files + 1) / kb) : 1;
+        buf_keys = buf_keys > 1 ? buf_keys : 1;
+        sink.fd = out_fd;
+        sink.text = st->cfg->out_text;
+        sink.any = 0;
+        sink.out_of_order = 0;
+        rc = merge_batches(st->batches, st->count, kb, buf_keys, &sink);
+        stats->out_of_order = sink.out_of_order;
+    }
+    int saved = errno;
+    free(sink.buf);
+    free(sink.text_buf);
+    errno = saved;
+    return rc;
+}
+
+int stream_sort_fd(int in_fd, int out_fd, const stream_sort_config *cfg, stream_sort_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    int key_bytes = cfg->key_bits / 8;
+    if ((key_bytes != 4 && key_bytes != 8) || !cfg->sort_batch || !cfg->tmpdir) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* One batch filling, one queued, one being sorted plus its scratch; the
+       rest of the budget holds sorted batches. */
+    stream_state st;
+    memset(&st, 0, sizeof(st));
+    st.cfg = cfg;
+    st.key_bytes = key_bytes;
+    st.batch_bytes = cfg->mem_bytes / 8;
+    st.batch_bytes = st.batch_bytes > STREAM_MIN_BATCH ? st.batch_bytes : STREAM_MIN_BATCH;
+    st.batch_bytes -= st.batch_bytes % 8;
+    size_t working = 4 * st.batch_bytes;
+    st.retain_bytes = cfg->mem_bytes > working ? cfg->mem_bytes - working : 0;
+    stats->batch_bytes = st.batch_bytes;
+    pthread_mutex_init(&st.lock, NULL);
+    pthread_cond_init(&st.changed, NULL);
+    if (pthread_create(&st.sorter, NULL, sorter_main, &st) != 0) {
+        pthread_cond_destroy(&st.changed);
+        pthread_mutex_destroy(&st.lock);
+        errno = EAGAIN;
+        return -1;
+    }
+
+    double t0 = sort_wall_time();
+    fill_buf fill = {NULL, 0};
+    long total = 0;
+    int rc = cfg->in_text ? read_text(&st, in_fd, &fill, &total)
+                          : read_binary(&st, in_fd, &fill, &total);
+    if (rc != 0) {
+        set_error(&st, errno);
+    } else if (fill.data && fill.have > 0) {
+        char *last = fill.data;
+        fill.data = NULL;
+        rc = hand_off(&st, last, (long)(fill.have / key_bytes));
+    }
+    free(fill.data);
+    stats->read_time = sort_wall_time() - t0;
+
+    pthread_mutex_lock(&st.lock);
+    st.finished = 1;
+    pthread_cond_broadcast(&st.changed);
+    pthread_mutex_unlock(&st.lock);
+    pthread_join(st.sorter, NULL);
+    int err = st.error;
+
+    stats->keys = total;
+    stats->batches = st.count;
+    stats->spilled = st.spilled;
+    stats->sort_time = st.sort_time;
+    stats->spill_time = st.spill_time;
+    if (err == 0) {
+        double m0 = sort_wall_time();
+        if (merge_all(&st, out_fd, stats) != 0) {
+            err = errno;
+        }
+        stats->merge_time = sort_wall_time() - m0;
+    }
+    remove_batches(st.batches, st.count);
+    free(st.batches);
+    pthread_cond_destroy(&st.changed);
+    pthread_mutex_destroy(&st.lock);
+    if (err != 0) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+#else
+
+int stream_sort_fd(int in_fd, int out_fd, const stream_sort_config *cfg, stream_sort_stats *stats) {
+    (void)in_fd;
+    (void)out_fd;
+    (void)cfg;
+    memset(stats, 0, sizeof(*stats));
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef STREAM_SORT_H
+#define STREAM_SORT_H
+
+#include <stddef.h>
+
+#include "ext_sort.h"
+
+/* Streaming sort from one file descriptor to another, typically a pipe.
+
+   Keys are read as they arrive into fixed-size batches. Each full batch is
+   handed to a sorter thread while reading goes on into the next one.
+   Sorted batches are kept in memory until they would exceed the budget;
+   from then on each newly sorted batch is spilled to a run file in tmpdir.
+   At end of input the in-memory batches and the spilled runs are k-way
+   merged and written out sequentially, so the output may be a pipe. When
+   there are more runs than the budget can buffer, groups of them are merged
+   into longer runs first. Keys are raw little-endian 32- or 64-bit values,
+   or decimal text as described in text_keys.h. Functions return 0 on
+   success and -1 with errno set. */
+
+typedef struct {
+    size_t mem_bytes;        /* budget for batches, scratch and merge buffers */
+    int key_bits;            /* 32 or 64 */
+    int in_text;             /* decimal text in, rather than binary keys */
+    int out_text;            /* one decimal key per line out */
+    int threads;             /* for parsing and formatting text */
+    const char *tmpdir;      /* where spilled runs go; removed afterwards */
+    ext_sort_fn sort_batch;
+    void *sort_arg;
+} stream_sort_config;
+
+typedef struct {
+    long keys;
+    int batches;
+    int spilled;                 /* batches written to run files */
+    size_t batch_bytes;
+    long out_of_order;           /* adjacent output keys found descending; 0 */
+    double read_time;            /* time spent reading and parsing input */
+    double sort_time;            /* busy time of the sorter thread */
+    double spill_time;
+    double merge_time;           /* merging and writing the output */
+} stream_sort_stats;
+
+int stream_sort_fd(int in_fd, int out_fd, const stream_sort_config *cfg, stream_sort_stats *stats);
+
+#endif
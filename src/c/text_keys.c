@@ -0,0 +1,405 @@
+#include "text_keys.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sort_util.h"
+
+/* Fewest bytes of text, or keys, worth a thread of their own. */
+#define TEXT_MIN_SLICE_BYTES (1L << 20)
+#define TEXT_MIN_SLICE_KEYS (1L << 16)
+
+#define ONES 0x0101010101010101ull
+#define HIGH_BITS 0x8080808080808080ull
+
+static const uint64_t pow10_table[8] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000};
+
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/* The SWAR code wants the first byte of the text in the low byte. */
+static uint64_t load8(const char *p) {
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    return w;
+}
+
+static int popcount64(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(x);
+#else
+    int c = 0;
+    for (; x; x &= x - 1) {
+        ++c;
+    }
+    return c;
+#endif
+}
+
+static int ctz64(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#else
+    int c = 0;
+    for (; !(x & 1); x >>= 1) {
+        ++c;
+    }
+    return c;
+#endif
+}
+
+static int is_separator(char c) {
+    return c == '\n' || c == '\r' || c == ' ' || c == '\t' || c == ',';
+}
+
+/* 0x80 in every byte of w that is an ASCII digit. A byte is a digit when
+   its high nibble is 3 and its low nibble plus 6 does not carry into the
+   high nibble. Nonzero bytes of the combined test are then found without
+   letting carries cross byte boundaries. */
+static uint64_t digit_bits(uint64_t w) {
+    uint64_t hi = (w & (0xF0 * ONES)) ^ (0x30 * ONES);
+    uint64_t lo = ((w & (0x0F * ONES)) + 0x06 * ONES) & (0xF0 * ONES);
+    uint64_t v = hi | lo;
+    uint64_t nonzero = (((v & (0x7F * ONES)) + 0x7F * ONES) | v) & HIGH_BITS;
+    return ~nonzero & HIGH_BITS;
+}
+
+/* Eight ASCII digits, most significant in the low byte, to their value:
+   neighbouring digits, then pairs, then quads are combined by multiplies. */
+static uint64_t parse8(uint64_t w) {
+    w = (w & (0x0F * ONES)) * 2561 >> 8;
+    w = (w & 0x00FF00FF00FF00FFull) * 6553601 >> 16;
+    return (w & 0x0000FFFF0000FFFFull) * 42949672960001ull >> 32;
+}
+
+/* Parses the digit run at *pp, which starts with a digit, and leaves *pp
+   just past it. Loads may read up to `limit`, never past it. */
+static int parse_token(const char **pp, const char *limit, int key_bits, uint64_t *value) {
+    const char *p = *pp;
+    while (p < limit && *p == '0') {
+        ++p;
+    }
+    const char *s = p;
+    for (;;) {
+        if (p + 8 > limit) {
+            while (p < limit && sort_is_digit(*p)) {
+                ++p;
+            }
+            break;
+        }
+        uint64_t stop = ~digit_bits(load8(p)) & HIGH_BITS;
+        if (stop) {
+            p += ctz64(stop) >> 3;
+            break;
+        }
+        p += 8;
+    }
+    *pp = p;
+
+    size_t len = (size_t)(p - s);
+    if (len > (key_bits == 64 ? 20u : 10u)) {
+        return -1;
+    }
+    /* 19 digits always fit in 64 bits; a 20th is added with a check. */
+    size_t rest = len < 20 ? len : 19;
+    uint64_t v = 0;
+    const char *d = s;
+    for (; rest >= 8; rest -= 8, d += 8) {
+        v = v * 100000000ull + parse8(load8(d));
+    }
+    if (rest > 0 && d + 8 <= limit) {
+        /* Shifting left drops the bytes after the token and leaves zero
+           bytes, which parse as leading zeros. */
+        v = v * pow10_table[rest] + parse8(load8(d) << (8 * (8 - rest)));
+        d += rest;
+    } else {
+        for (; rest > 0; --rest) {
+            v = v * 10 + (uint64_t)(*d++ - '0');
+        }
+    }
+    if (len == 20) {
+        uint64_t last = (uint64_t)(*d - '0');
+        if (v > (UINT64_MAX - last) / 10) {
+            return -1;
+        }
+        v = v * 10 + last;
+    }
+    if (key_bits == 32 && v > UINT32_MAX) {
+        return -1;
+    }
+    *value = v;
+    return 0;
+}
+
+/* ---- Parsing ----------------------------------------------------------- */
+
+typedef struct {
+    const char *text;
+    const char *begin;
+    const char *end;
+    const char *limit;       /* end of the whole text, bound for loads */
+    int key_bits;
+    long count;              /* keys in the slice, from the first pass */
+    void *keys;              /* second pass: output array and first index */
+    long first;
+    int error;
+    size_t bad_offset;
+} parse_slice;
+
+/* A key starts at every digit whose predecessor is not a digit. */
+static void *count_slice(void *arg) {
+    parse_slice *s = (parse_slice *)arg;
+    const char *p = s->begin;
+    long count = 0;
+    uint64_t carry = 0;      /* 0x80 if the byte before p was a digit */
+    for (; p + 8 <= s->end; p += 8) {
+        uint64_t digits = digit_bits(load8(p));
+        count += popcount64(digits & ~((digits << 8) | carry));
+        carry = (digits >> 56) & 0x80;
+    }
+    int prev = carry != 0;
+    for (; p < s->end; ++p) {
+        int digit = sort_is_digit(*p);
+        count += digit && !prev;
+        prev = digit;
+    }
+    s->count = count;
+    return NULL;
+}
+
+static void *parse_slice_keys(void *arg) {
+    parse_slice *s = (parse_slice *)arg;
+    const char *p = s->begin;
+    long i = s->first;
+    while (p < s->end) {
+        if (sort_is_digit(*p)) {
+            const char *start = p;
+            uint64_t v;
+            if (parse_token(&p, s->limit, s->key_bits, &v) != 0) {
+                s->error = ERANGE;
+                s->bad_offset = (size_t)(start - s->text);
+                return NULL;
+            }
+            if (s->key_bits == 64) {
+                ((uint64_t *)s->keys)[i++] = v;
+            } else {
+                ((uint32_t *)s->keys)[i++] = (uint32_t)v;
+            }
+        } else if (is_separator(*p)) {
+            ++p;
+        } else {
+            s->error = EINVAL;
+            s->bad_offset = (size_t)(p - s->text);
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+int text_parse_keys(const char *text,
+                    size_t bytes,
+                    int key_bits,
+                    int threads,
+                    void **keys,
+                    long *n,
+                    size_t *bad_offset) {
+    *keys = NULL;
+    *n = 0;
+    *bad_offset = 0;
+    long by_size = (long)(bytes / TEXT_MIN_SLICE_BYTES);
+    threads = threads < by_size ? threads : (int)by_size;
+    threads = threads > 1 ? threads : 1;
+
+    parse_slice *slices = (parse_slice *)calloc((size_t)threads, sizeof(parse_slice));
+    if (!slices) {
+        errno = ENOMEM;
+        return -1;
+    }
+    /* Slices end at separators, so no key is cut in two. */
+    const char *limit = text + bytes;
+    const char *begin = text;
+    for (int t = 0; t < threads; ++t) {
+        const char *end = t + 1 == threads ? limit : text + (size_t)(t + 1) * (bytes / threads);
+        end = end > begin ? end : begin;
+        while (end < limit && sort_is_digit(*end)) {
+            ++end;
+        }
+        slices[t].text = text;
+        slices[t].begin = begin;
+        slices[t].end = end;
+        slices[t].limit = limit;
+        slices[t].key_bits = key_bits;
+        begin = end;
+    }
+
+    sort_run_slices(count_slice, slices, sizeof(parse_slice), threads);
+    long total = 0;
+    for (int t = 0; t < threads; ++t) {
+        slices[t].first = total;
+        total += slices[t].count;
+    }
+    void *out = malloc((total > 0 ? (size_t)total : 1) * (size_t)(key_bits / 8));
+    if (!out) {
+        free(slices);
+        errno = ENOMEM;
+        return -1;
+    }
+    for (int t = 0; t < threads; ++t) {
+        slices[t].keys = out;
+    }
+    sort_run_slices(parse_slice_keys, slices, sizeof(parse_slice), threads);
+
+    for (int t = 0; t < threads; ++t) {
+        if (slices[t].error != 0) {
+            int err = slices[t].error;
+            *bad_offset = slices[t].bad_offset;
+            free(slices);
+            free(out);
+            errno = err;
+            return -1;
+        }
+    }
+    free(slices);
+    *keys = out;
+    *n = total;
+    return 0;
+}
+
+/* ---- Formatting -------------------------------------------------------- */
+
+typedef struct {
+    const void *keys;
+    long begin;
+    long end;
+    int key_bits;
+    size_t bytes;            /* first pass: text length of the slice */
+    char *out;               /* second pass: where the slice's text goes */
+} format_slice;
+
+static uint64_t key_at(const void *keys, long i, int key_bits) {
+    return key_bits == 64 ? ((const uint64_t *)keys)[i] : ((const uint32_t *)keys)[i];
+}
+
+static int digits10(uint64_t v) {
+    int d = 1;
+    for (;;) {
+        if (v < 10) {
+            return d;
+        }
+        if (v < 100) {
+            return d + 1;
+        }
+        if (v < 1000) {
+            return d + 2;
+        }
+        if (v < 10000) {
+            return d + 3;
+        }
+        v /= 10000;
+        d += 4;
+    }
+}
+
+/* Writes v as `len` digits and a newline, two digits per step from the right. */
+static char *format_key(char *out, uint64_t v, int len) {
+    char *p = out + len;
+    while (v >= 100) {
+        unsigned r = (unsigned)(v % 100);
+        v /= 100;
+        p -= 2;
+        memcpy(p, &digit_pairs[2 * r], 2);
+    }
+    if (v >= 10) {
+        p -= 2;
+        memcpy(p, &digit_pairs[2 * v], 2);
+    } else {
+        *--p = (char)('0' + v);
+    }
+    out[len] = '\n';
+    return out + len + 1;
+}
+
+static void *size_slice(void *arg) {
+    format_slice *s = (format_slice *)arg;
+    size_t bytes = 0;
+    for (long i = s->begin; i < s->end; ++i) {
+        bytes += (size_t)digits10(key_at(s->keys, i, s->key_bits)) + 1;
+    }
+    s->bytes = bytes;
+    return NULL;
+}
+
+static void *format_slice_keys(void *arg) {
+    format_slice *s = (format_slice *)arg;
+    char *p = s->out;
+    for (long i = s->begin; i < s->end; ++i) {
+        uint64_t v = key_at(s->keys, i, s->key_bits);
+        p = format_key(p, v, digits10(v));
+    }
+    return NULL;
+}
+
+/* Splits keys[0, n) into slices and sizes each; NULL if out of memory, in
+   which case the work is done as a single slice. */
+static format_slice *size_slices(const void *keys, long n, int key_bits, int *threads,
+                                 format_slice *single) {
+    long by_keys = n / TEXT_MIN_SLICE_KEYS;
+    int count = *threads < by_keys ? *threads : (int)by_keys;
+    count = count > 1 ? count : 1;
+    format_slice *slices = count > 1 ? (format_slice *)calloc((size_t)count, sizeof(format_slice))
+                                     : NULL;
+    if (!slices) {
+        count = 1;
+        slices = single;
+        memset(single, 0, sizeof(*single));
+    }
+    for (int t = 0; t < count; ++t) {
+        slices[t].keys = keys;
+        slices[t].begin = (long)((double)n * t / count);
+        slices[t].end = t + 1 == count ? n : (long)((double)n * (t + 1) / count);
+        slices[t].key_bits = key_bits;
+    }
+    sort_run_slices(size_slice, slices, sizeof(format_slice), count);
+    *threads = count;
+    return slices;
+}
+
+size_t text_format_size(const void *keys, long n, int key_bits, int threads) {
+    format_slice single;
+    format_slice *slices = size_slices(keys, n, key_bits, &threads, &single);
+    size_t total = 0;
+    for (int t = 0; t < threads; ++t) {
+        total += slices[t].bytes;
+    }
+    if (slices != &single) {
+        free(slices);
+    }
+    return total;
+}
+
+void text_format_keys(const void *keys, long n, int key_bits, int threads, char *out) {
+    format_slice single;
+    format_slice *slices = size_slices(keys, n, key_bits, &threads, &single);
+    for (int t = 0; t < threads; ++t) {
+        slices[t].out = out;
+        out += slices[t].bytes;
+    }
+    sort_run_slices(format_slice_keys, slices, sizeof(format_slice), threads);
+    if (slices != &single) {
+        free(slices);
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef TEXT_KEYS_H
+#define TEXT_KEYS_H
+
+#include <stddef.h>
+
+/* Decimal text keys for --in-format / --out-format text.
+
+   Input is unsigned decimal integers separated by newlines, carriage
+   returns, spaces, tabs or commas, so both one-key-per-line files and CSV
+   rows of keys parse. The text is cut into one slice per thread at
+   separator bytes. A first pass counts the keys in every slice, and a
+   second pass parses each slice straight into its place in the key array.
+   Both passes look at 8 bytes per step with SWAR (SIMD within a register)
+   arithmetic: digit classification, token starts, run lengths and the
+   conversion of 8 digits at once. This stays portable to any 64-bit
+   target. Output is one key per line, formatted from a two-digit table by
+   threads that each own a precomputed region of the output. */
+
+/* Parses text[0, bytes) into a malloc'd array of 32- or 64-bit keys. On
+   failure returns -1 with errno EINVAL (a byte that is neither a digit nor
+   a separator), ERANGE (a key too large for key_bits) or ENOMEM, and
+   *bad_offset is the offset of the offending byte or key. */
+int text_parse_keys(const char *text,
+                    size_t bytes,
+                    int key_bits,
+                    int threads,
+                    void **keys,
+                    long *n,
+                    size_t *bad_offset);
+
+/* Bytes text_format_keys will write for keys[0, n): digits plus a newline each. */
+size_t text_format_size(const void *keys, long n, int key_bits, int threads);
+
+/* Writes keys[0, n) to out, one per line; out holds text_format_size bytes. */
+void text_format_keys(const void *keys, long n, int key_bits, int threads, char *out);
+
+#endif
@@ -0,0 +1,231 @@
+#ifndef _WIN32
+#define _XOPEN_SOURCE 700
+#endif
+
+#include "tune_profile.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#include "libradix.h"
+
+#define LINE_MAX_BYTES 1024
+
+static void trim(char *s) {
+    size_t len = strlen(s);
+    while (len > 0 && (s[len - 1] == '\n' || s[len - 1] == '\r' ||
+                       s[len - 1] == ' ' || s[len - 1] == '\t')) {
+        s[--len] = '\0';
+    }
+    size_t lead = strspn(s, " \t");
+    if (lead > 0) {
+        memmove(s, s + lead, len - lead + 1);
+    }
+}
+
+static void cpu_model(char *out, size_t len) {
+    snprintf(out, len, "unknown");
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    if (!f) {
+        return;
+    }
+    char line[LINE_MAX_BYTES];
+    while (fgets(line, sizeof(line), f)) {
+        /* x86 reports "model name", most other architectures "Model" or "cpu model". */
+        if (strncmp(line, "model name", 10) == 0 || strncmp(line, "Model", 5) == 0 ||
+            strncmp(line, "cpu model", 9) == 0) {
+            char *colon = strchr(line, ':');
+            if (colon) {
+                char *value = colon + 1;
+                trim(value);
+                if (value[0] != '\0') {
+                    snprintf(out, len, "%s", value);
+                    break;
+                }
+            }
+        }
+    }
+    fclose(f);
+    /* '|' separates the key fields and ']' ends the section header. */
+    for (char *p = out; *p; ++p) {
+        if (*p == '|' || *p == ']') {
+            *p = '_';
+        }
+    }
+}
+
+void tune_machine_key(const char *backend, char *key, size_t len) {
+    char model[160];
+    cpu_model(model, sizeof(model));
+    snprintf(key, len, "%s|%s|%d", backend, model, radix_usable_cpus());
+}
+
+int tune_default_path(char *path, size_t len) {
+    const char *explicit_path = getenv("RADIX_TUNE_PROFILE");
+    if (explicit_path && explicit_path[0] != '\0') {
+        snprintf(path, len, "%s", explicit_path);
+        return 0;
+    }
+    const char *cache = getenv("XDG_CACHE_HOME");
+    if (cache && cache[0] != '\0') {
+        snprintf(path, len, "%s/radix_sort/tune.profile", cache);
+        return 0;
+    }
+    const char *home = getenv("HOME");
+    if (home && home[0] != '\0') {
+        snprintf(path, len, "%s/.cache/radix_sort/tune.profile", home);
+        return 0;
+    }
+    return -1;
+}
+
+/* 1 if line is the header of key's section, 0 if another header, -1 otherwise. */
+static int section_header(const char *line, const char *key) {
+    if (line[0] != '[') {
+        return -1;
+    }
+    const char *end = strrchr(line, ']');
+    if (!end) {
+        return -1;
+    }
+    size_t klen = strlen(key);
+    return (size_t)(end - line - 1) == klen && strncmp(line + 1, key, klen) == 0;
+}
+
+int tune_profile_load(const char *path, const char *key, tune_params *out) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+    memset(out, 0, sizeof(*out));
+    int found = 0;
+    int in_section = 0;
+    char line[LINE_MAX_BYTES];
+    while (fgets(line, sizeof(line), f)) {
+        trim(line);
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+        int header = section_header(line, key);
+        if (header >= 0) {
+            if (in_section) {
+                break;
+            }
+            in_section = header;
+            found |= header;
+            continue;
+        }
+        if (!in_section) {
+            continue;
+        }
+        char *eq = strchr(line, '=');
+        if (!eq) {
+            continue;
+        }
+        *eq = '\0';
+        char *name = line;
+        char *value = eq + 1;
+        trim(name);
+        trim(value);
+        if (strcmp(name, "algo") == 0) {
+            snprintf(out->algo, sizeof(out->algo), "%s", value);
+        } else if (strcmp(name, "threads") == 0) {
+            out->threads = (int)strtol(value, NULL, 10);
+        } else if (strcmp(name, "min_keys_per_thread") == 0) {
+            out->min_keys_per_thread = strtol(value, NULL, 10);
+        } else if (strcmp(name, "task_grain") == 0) {
+            out->task_grain = strtol(value, NULL, 10);
+        }
+    }
+    fclose(f);
+    return found ? 0 : -1;
+}
+
+static void make_parent_dirs(const char *path) {
+#ifndef _WIN32
+    char dir[TUNE_PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s", path);
+    char *slash = strrchr(dir, '/');
+    if (!slash || slash == dir) {
+        return;
+    }
+    *slash = '\0';
+    for (char *p = dir + 1; *p; ++p) {
+        if (*p == '/') {
+            *p = '\0';
+            mkdir(dir, 0755);
+            *p = '/';
+        }
+    }
+    mkdir(dir, 0755);
+#else
+    (void)path;
+#endif
+}
+
+int tune_profile_save(const char *path, const char *key, const tune_params *params) {
+    make_parent_dirs(path);
+
+    char tmp_path[TUNE_PATH_MAX + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *out = fopen(tmp_path, "w");
+    if (!out) {
+        return -1;
+    }
+
+    /* Copy every other machine's section, dropping the stale one for key.
+       Blank lines are held back until the next copied line, so the ones
+       that trailed the file or the dropped section do not pile up in front
+       of the section appended below. */
+    FILE *in = fopen(path, "r");
+    if (in) {
+        int skipping = 0;
+        int blanks = 0;
+        char line[LINE_MAX_BYTES];
+        while (fgets(line, sizeof(line), in)) {
+            char probe[LINE_MAX_BYTES];
+            snprintf(probe, sizeof(probe), "%s", line);
+            trim(probe);
+            int header = section_header(probe, key);
+            if (header >= 0) {
+                skipping = header;
+            }
+            if (skipping) {
+                continue;
+            }
+            if (probe[0] == '\0') {
+                blanks++;
+                continue;
+            }
+            for (; blanks > 0; --blanks) {
+                fputc('\n', out);
+            }
+            fputs(line, out);
+        }
+        fclose(in);
+    } else {
+        fputs("# Radix sort tuning profiles, written by --tune.\n", out);
+    }
+
+    fprintf(out, "\n[%s]\n", key);
+    fprintf(out, "algo = %s\n", params->algo);
+    fprintf(out, "threads = %d\n", params->threads);
+    fprintf(out, "min_keys_per_thread = %ld\n", params->min_keys_per_thread);
+    fprintf(out, "task_grain = %ld\n", params->task_grain);
+
+    int failed = ferror(out);
+    failed |= fclose(out) != 0;
+    if (failed || rename(tmp_path, path) != 0) {
+        int saved = errno;
+        remove(tmp_path);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
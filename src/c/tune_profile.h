@@ -0,0 +1,44 @@
+#ifndef TUNE_PROFILE_H
+#define TUNE_PROFILE_H
+
+#include <stddef.h>
+
+/* Per-machine tuning profiles written by `--tune` and read at startup.
+
+   A profile file holds one section per machine key, e.g.
+
+       [pthread|Intel(R) Xeon(R) Gold 6248 CPU @ 2.50GHz|8]
+       algo = onesweep
+       threads = 8
+       min_keys_per_thread = 65536
+       task_grain = 16384
+
+   The key combines the backend, the CPU model string and the usable CPU
+   count, so one file can be shared by several machine types and backends.
+   Unknown lines are ignored; missing values are left at 0. */
+
+#define TUNE_KEY_MAX 256
+#define TUNE_PATH_MAX 512
+
+typedef struct {
+    char algo[16];
+    int threads;
+    long min_keys_per_thread;
+    long task_grain;
+} tune_params;
+
+/* Builds "<backend>|<cpu model>|<usable cpus>" into key. */
+void tune_machine_key(const char *backend, char *key, size_t len);
+
+/* $RADIX_TUNE_PROFILE, else $XDG_CACHE_HOME/radix_sort/tune.profile, else
+   $HOME/.cache/radix_sort/tune.profile. Returns -1 if none can be formed. */
+int tune_default_path(char *path, size_t len);
+
+/* Returns 0 and fills *out if the file has a section for key, -1 otherwise. */
+int tune_profile_load(const char *path, const char *key, tune_params *out);
+
+/* Replaces (or appends) the section for key, keeping every other section.
+   Creates the parent directory if needed. Returns 0 on success, -1 otherwise. */
+int tune_profile_save(const char *path, const char *key, const tune_params *params);
+
+#endif
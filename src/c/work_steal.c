@@ -0,0 +1,382 @@
+#ifndef _WIN32
+#define _XOPEN_SOURCE 700
+#endif
+
+#include "work_steal.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sort_util.h"
+
+#define WS_INITIAL_CAPACITY 1024
+#define WS_ARENA_BLOCK (64 * 1024)
+
+typedef struct {
+    ws_task_fn fn;
+    void *arg;
+} ws_task;
+
+typedef struct ws_array {
+    long capacity;
+    _Atomic(ws_task *) *slots;
+    struct ws_array *retired; /* older, smaller arrays kept until teardown */
+} ws_array;
+
+/* Chase-Lev deque as described by Le, Pop, Cohen and Zappa Nardelli for
+   C11 atomics: the owner works at `bottom`, thieves advance `top`. */
+typedef struct {
+    atomic_long top;
+    atomic_long bottom;
+    _Atomic(ws_array *) array;
+} ws_deque;
+
+typedef struct ws_arena_block {
+    struct ws_arena_block *next;
+    size_t used;
+    size_t size;
+    unsigned char data[];
+} ws_arena_block;
+
+struct ws_worker {
+    int id;
+    ws_sched *sched;
+    ws_deque deque;
+    ws_arena_block *arena;
+    unsigned int rng;
+    ws_stats stats;
+    pthread_t thread;
+};
+
+struct ws_sched {
+    int workers;
+    int next_submit;
+    atomic_long pending;
+    ws_worker *pool;
+    ws_hook_fn enter;
+    ws_hook_fn leave;
+    void *hook_arg;
+};
+
+static ws_array *ws_array_new(long capacity) {
+    ws_array *a = (ws_array *)malloc(sizeof(ws_array));
+    if (!a) {
+        return NULL;
+    }
+    a->slots = (_Atomic(ws_task *) *)malloc(sizeof(*a->slots) * capacity);
+    if (!a->slots) {
+        free(a);
+        return NULL;
+    }
+    a->capacity = capacity;
+    a->retired = NULL;
+    return a;
+}
+
+static void ws_array_free(ws_array *a) {
+    while (a) {
+        ws_array *next = a->retired;
+        free(a->slots);
+        free(a);
+        a = next;
+    }
+}
+
+static int ws_deque_init(ws_deque *q) {
+    ws_array *a = ws_array_new(WS_INITIAL_CAPACITY);
+    if (!a) {
+        return -1;
+    }
+    atomic_init(&q->top, 0);
+    atomic_init(&q->bottom, 0);
+    atomic_init(&q->array, a);
+    return 0;
+}
+
+static ws_array *ws_deque_grow(ws_deque *q, ws_array *a, long top, long bottom) {
+    ws_array *bigger = ws_array_new(a->capacity * 2);
+    if (!bigger) {
+        return NULL;
+    }
+    for (long i = top; i < bottom; ++i) {
+        ws_task *t = atomic_load_explicit(&a->slots[i % a->capacity], memory_order_relaxed);
+        atomic_store_explicit(&bigger->slots[i % bigger->capacity], t, memory_order_relaxed);
+    }
+    /* Thieves may still read the old array, so it lives until teardown. */
+    bigger->retired = a;
+    atomic_store_explicit(&q->array, bigger, memory_order_release);
+    return bigger;
+}
+
+/* Returns -1, leaving the deque as it was, if a full deque cannot grow. */
+static int ws_deque_push(ws_deque *q, ws_task *task) {
+    long b = atomic_load_explicit(&q->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&q->top, memory_order_acquire);
+    ws_array *a = atomic_load_explicit(&q->array, memory_order_relaxed);
+    if (b - t > a->capacity - 1) {
+        a = ws_deque_grow(q, a, t, b);
+        if (!a) {
+            return -1;
+        }
+    }
+    atomic_store_explicit(&a->slots[b % a->capacity], task, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+    return 0;
+}
+
+static ws_task *ws_deque_take(ws_deque *q) {
+    long b = atomic_load_explicit(&q->bottom, memory_order_relaxed) - 1;
+    ws_array *a = atomic_load_explicit(&q->array, memory_order_relaxed);
+    atomic_store_explicit(&q->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&q->top, memory_order_relaxed);
+    if (t > b) {
+        atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+        return NULL;
+    }
+    ws_task *task = atomic_load_explicit(&a->slots[b % a->capacity], memory_order_relaxed);
+    if (t == b) {
+        /* Last element: race the thieves for it. */
+        if (!atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1,
+                                                     memory_order_seq_cst,
+                                                     memory_order_relaxed)) {
+            task = NULL;
+        }
+        atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+static ws_task *ws_deque_steal(ws_deque *q) {
+    long t = atomic_load_explicit(&q->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&q->bottom, memory_order_acquire);
+    if (t >= b) {
+        return NULL;
+    }
+    ws_array *a = atomic_load_explicit(&q->array, memory_order_acquire);
+    ws_task *task = atomic_load_explicit(&a->slots[t % a->capacity], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed)) {
+        return NULL;
+    }
+    return task;
+}
+
+void *ws_alloc(ws_worker *self, size_t bytes) {
+    bytes = (bytes + 15) & ~(size_t)15;
+    ws_arena_block *blk = self->arena;
+    if (!blk || blk->used + bytes > blk->size) {
+        size_t size = bytes > WS_ARENA_BLOCK ? bytes : WS_ARENA_BLOCK;
+        blk = (ws_arena_block *)malloc(sizeof(ws_arena_block) + size);
+        if (!blk) {
+            return NULL;
+        }
+        blk->next = self->arena;
+        blk->used = 0;
+        blk->size = size;
+        self->arena = blk;
+    }
+    void *p = blk->data + blk->used;
+    blk->used += bytes;
+    return p;
+}
+
+/* Keeps the newest block for the next run and frees the rest. */
+static void ws_arena_reset(ws_worker *w) {
+    ws_arena_block *blk = w->arena;
+    if (!blk) {
+        return;
+    }
+    ws_arena_block *rest = blk->next;
+    while (rest) {
+        ws_arena_block *next = rest->next;
+        free(rest);
+        rest = next;
+    }
+    blk->next = NULL;
+    blk->used = 0;
+}
+
+static int ws_push_task(ws_worker *w, ws_task_fn fn, void *arg) {
+    ws_task *task = (ws_task *)ws_alloc(w, sizeof(ws_task));
+    if (!task) {
+        return -1;
+    }
+    task->fn = fn;
+    task->arg = arg;
+    /* Counted before it is visible, so no thief can finish it first. */
+    atomic_fetch_add_explicit(&w->sched->pending, 1, memory_order_relaxed);
+    if (ws_deque_push(&w->deque, task) != 0) {
+        atomic_fetch_sub_explicit(&w->sched->pending, 1, memory_order_relaxed);
+        return -1;
+    }
+    return 0;
+}
+
+int ws_spawn(ws_worker *self, ws_task_fn fn, void *arg) {
+    return ws_push_task(self, fn, arg);
+}
+
+int ws_submit(ws_sched *sched, ws_task_fn fn, void *arg) {
+    ws_worker *w = &sched->pool[sched->next_submit];
+    sched->next_submit = (sched->next_submit + 1) % sched->workers;
+    return ws_push_task(w, fn, arg);
+}
+
+static unsigned int ws_rand(ws_worker *w) {
+    unsigned int x = w->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    w->rng = x;
+    return x;
+}
+
+static void *ws_worker_loop(void *arg) {
+    ws_worker *self = (ws_worker *)arg;
+    ws_sched *sched = self->sched;
+    double idle_since = 0.0;
+    if (sched->enter) {
+        sched->enter(sched->hook_arg, self->id);
+    }
+
+    for (;;) {
+        ws_task *task = ws_deque_take(&self->deque);
+        if (!task && sched->workers > 1) {
+            int victim = (int)(ws_rand(self) % (unsigned int)(sched->workers - 1));
+            if (victim >= self->id) {
+                ++victim;
+            }
+            task = ws_deque_steal(&sched->pool[victim].deque);
+            if (task) {
+                self->stats.steals++;
+            } else {
+                self->stats.failed_steals++;
+            }
+        }
+
+        if (task) {
+            if (idle_since != 0.0) {
+                self->stats.idle_time += sort_wall_time() - idle_since;
+                idle_since = 0.0;
+            }
+            task->fn(self, task->arg);
+            self->stats.tasks++;
+            atomic_fetch_sub_explicit(&sched->pending, 1, memory_order_acq_rel);
+            continue;
+        }
+
+        if (idle_since == 0.0) {
+            idle_since = sort_wall_time();
+        }
+        if (atomic_load_explicit(&sched->pending, memory_order_acquire) == 0) {
+            break;
+        }
+        sched_yield();
+    }
+
+    if (idle_since != 0.0) {
+        self->stats.idle_time += sort_wall_time() - idle_since;
+    }
+    if (sched->leave) {
+        sched->leave(sched->hook_arg, self->id);
+    }
+    return NULL;
+}
+
+ws_sched *ws_create(int workers) {
+    if (workers < 1) {
+        workers = 1;
+    }
+    ws_sched *sched = (ws_sched *)calloc(1, sizeof(ws_sched));
+    if (!sched) {
+        return NULL;
+    }
+    sched->pool = (ws_worker *)calloc((size_t)workers, sizeof(ws_worker));
+    if (!sched->pool) {
+        free(sched);
+        return NULL;
+    }
+    sched->workers = workers;
+    atomic_init(&sched->pending, 0);
+    for (int i = 0; i < workers; ++i) {
+        ws_worker *w = &sched->pool[i];
+        w->id = i;
+        w->sched = sched;
+        w->rng = 2463534242u + 7919u * (unsigned int)i;
+        if (ws_deque_init(&w->deque) != 0) {
+            sched->workers = i;
+            ws_destroy(sched);
+            return NULL;
+        }
+    }
+    return sched;
+}
+
+void ws_destroy(ws_sched *sched) {
+    if (!sched) {
+        return;
+    }
+    for (int i = 0; i < sched->workers; ++i) {
+        ws_worker *w = &sched->pool[i];
+        ws_array_free(atomic_load_explicit(&w->deque.array, memory_order_relaxed));
+        ws_arena_block *blk = w->arena;
+        while (blk) {
+            ws_arena_block *next = blk->next;
+            free(blk);
+            blk = next;
+        }
+    }
+    free(sched->pool);
+    free(sched);
+}
+
+void ws_set_hooks(ws_sched *sched, ws_hook_fn enter, ws_hook_fn leave, void *arg) {
+    sched->enter = enter;
+    sched->leave = leave;
+    sched->hook_arg = arg;
+}
+
+int ws_run(ws_sched *sched) {
+    for (int i = 0; i < sched->workers; ++i) {
+        memset(&sched->pool[i].stats, 0, sizeof(ws_stats));
+    }
+
+    /* Worker 0 runs on the calling thread. */
+    int started = 1;
+    for (int i = 1; i < sched->workers; ++i) {
+        if (pthread_create(&sched->pool[i].thread, NULL, ws_worker_loop, &sched->pool[i]) != 0) {
+            break;
+        }
+        ++started;
+    }
+    ws_worker_loop(&sched->pool[0]);
+    for (int i = 1; i < started; ++i) {
+        pthread_join(sched->pool[i].thread, NULL);
+    }
+
+    for (int i = 0; i < sched->workers; ++i) {
+        ws_arena_reset(&sched->pool[i]);
+    }
+    sched->next_submit = 0;
+    return started == sched->workers ? 0 : -1;
+}
+
+int ws_worker_id(const ws_worker *self) {
+    return self->id;
+}
+
+int ws_worker_count(const ws_sched *sched) {
+    return sched->workers;
+}
+
+void ws_get_stats(const ws_sched *sched, int worker, ws_stats *out) {
+    *out = sched->pool[worker].stats;
+}
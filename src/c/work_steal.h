@@ -0,0 +1,56 @@
+#ifndef WORK_STEAL_H
+#define WORK_STEAL_H
+
+#include <stddef.h>
+
+/* Work-stealing task scheduler for the pthread backend.
+
+   Every worker owns a Chase-Lev deque: it pushes and pops tasks at the bottom,
+   idle workers steal from the top of a randomly chosen victim. A run ends once
+   every submitted or spawned task has finished. Nothing here prints or
+   exits: allocation failures come back as -1 or NULL, and a task that
+   cannot be queued is left for the caller to run itself. */
+
+typedef struct ws_sched ws_sched;
+typedef struct ws_worker ws_worker;
+
+typedef void (*ws_task_fn)(ws_worker *self, void *arg);
+typedef void (*ws_hook_fn)(void *arg, int worker);
+
+typedef struct {
+    unsigned long tasks;         /* tasks executed by this worker */
+    unsigned long steals;        /* tasks taken from another worker's deque */
+    unsigned long failed_steals; /* steal attempts that found nothing or lost a race */
+    double idle_time;            /* seconds spent looking for work */
+} ws_stats;
+
+/* Returns NULL if allocation fails. */
+ws_sched *ws_create(int workers);
+void ws_destroy(ws_sched *sched);
+
+/* Queues a task before ws_run; tasks are dealt round-robin over the workers.
+   Returns 0, or -1 if the task could not be queued for lack of memory. */
+int ws_submit(ws_sched *sched, ws_task_fn fn, void *arg);
+
+/* Optional: enter runs on every worker's thread before it takes a task,
+   leave once it is done, both with the worker's id. Worker 0 runs on the
+   thread that called ws_run. Either may be NULL. */
+void ws_set_hooks(ws_sched *sched, ws_hook_fn enter, ws_hook_fn leave, void *arg);
+
+/* Starts the workers and blocks until all tasks are done. Returns 0 on
+   success and -1 if a worker thread could not be created. */
+int ws_run(ws_sched *sched);
+
+/* Called from inside a task: queues a child task on the calling worker.
+   Returns 0, or -1 if it could not be queued; the caller then runs it. */
+int ws_spawn(ws_worker *self, ws_task_fn fn, void *arg);
+
+/* Per-worker bump allocation for task arguments; released after ws_run.
+   Returns NULL if allocation fails. */
+void *ws_alloc(ws_worker *self, size_t bytes);
+
+int ws_worker_id(const ws_worker *self);
+int ws_worker_count(const ws_sched *sched);
+void ws_get_stats(const ws_sched *sched, int worker, ws_stats *out);
+
+#endif
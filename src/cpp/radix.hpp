@@ -0,0 +1,648 @@
+#ifndef RADIX_HPP
+#define RADIX_HPP
+
+// Header-only C++ radix sort.
+//
+// radix::sort<Key, Bits>(policy, range, proj) sorts a contiguous range
+// (std::vector, std::array, std::span, or a pointer pair) by proj(element),
+// taken as a Key; Key defaults to what proj returns. Bits is the digit
+// width, 1 to 16. Everything that depends on Key and Bits is fixed at
+// compile time: the unsigned type the key maps to, the order-preserving
+// transform (sign bit flipped for signed integers; for IEEE floats the sign
+// bit flipped on positives and every bit on negatives), the histogram size
+// and the number of passes. The inner loops carry no runtime tests of key
+// type or width.
+//
+// The sort is a stable LSD radix sort. The sequential policy counts every
+// digit in one read pass up front. The parallel policy gives each thread a
+// slice and a histogram per pass, and thread 0 turns them into offsets
+// between two barriers, as the C kernels do. In both, a pass whose digit is
+// the same in every key is skipped. radix::sort_kv sorts keys and moves a
+// payload array along with them. Needs C++17; std::span (C++20) is accepted
+// like any other range with data() and size().
+//
+// Elements that are not small trivially copyable values (structs of more
+// than 16 bytes, strings, anything in a non-contiguous random-access range)
+// are not moved once per pass. Their keys are projected once into a packed
+// buffer of (key, index) pairs, the pairs are radix sorted, and the
+// elements are then moved to their places: along the cycles of the
+// permutation, one temporary per cycle, with the sequential policy; by
+// parallel slices through one uninitialized buffer with the parallel policy
+// when moves cannot throw. radix::sort_by_key sorts a range of values by a
+// separate range of keys the same way, permuting both.
+//
+// Every scratch buffer (the ping-pong copy, histograms, the (key, index)
+// pairs, the gather buffer, the thread table) comes from the policy's
+// std::pmr::memory_resource, set with with_resource(); without one they
+// come from new/delete. Allocation happens on the calling thread only.
+// With a std::pmr::monotonic_buffer_resource over a fixed buffer, or any
+// other arena, a seq sort makes no heap allocation; a par sort still
+// starts std::threads, whose state the library allocates itself.
+// counting_resource counts what passes through to another resource.
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace radix {
+
+struct sequenced_policy {
+    std::pmr::memory_resource *resource = nullptr;  // nullptr: new/delete
+    constexpr sequenced_policy with_resource(std::pmr::memory_resource *r) const {
+        return sequenced_policy{r};
+    }
+};
+
+struct parallel_policy {
+    unsigned threads = 0;  // 0: std::thread::hardware_concurrency()
+    std::pmr::memory_resource *resource = nullptr;
+    constexpr parallel_policy with_threads(unsigned t) const { return parallel_policy{t, resource}; }
+    constexpr parallel_policy with_resource(std::pmr::memory_resource *r) const {
+        return parallel_policy{threads, r};
+    }
+};
+
+inline constexpr sequenced_policy seq{};
+inline constexpr parallel_policy par{};
+
+template <class P>
+struct is_execution_policy
+    : std::bool_constant<std::is_same_v<std::decay_t<P>, sequenced_policy> ||
+                         std::is_same_v<std::decay_t<P>, parallel_policy>> {};
+
+struct identity {
+    template <class T>
+    constexpr T &&operator()(T &&t) const noexcept {
+        return std::forward<T>(t);
+    }
+};
+
+// Forwards to an upstream resource and counts what passes through. The
+// counters are not synchronized; radix::sort allocates from one thread.
+class counting_resource : public std::pmr::memory_resource {
+public:
+    explicit counting_resource(
+        std::pmr::memory_resource *upstream = std::pmr::get_default_resource()) noexcept
+        : upstream_(upstream) {}
+
+    std::size_t allocations() const noexcept { return allocations_; }
+    std::size_t deallocations() const noexcept { return deallocations_; }
+    std::size_t bytes_in_use() const noexcept { return in_use_; }
+    std::size_t peak_bytes() const noexcept { return peak_; }
+
+    void reset_counts() noexcept {
+        allocations_ = deallocations_ = 0;
+        peak_ = in_use_;
+    }
+
+private:
+    void *do_allocate(std::size_t bytes, std::size_t align) override {
+        void *p = upstream_->allocate(bytes, align);
+        ++allocations_;
+        in_use_ += bytes;
+        peak_ = in_use_ > peak_ ? in_use_ : peak_;
+        return p;
+    }
+
+    void do_deallocate(void *p, std::size_t bytes, std::size_t align) override {
+        upstream_->deallocate(p, bytes, align);
+        ++deallocations_;
+        in_use_ -= bytes;
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+
+    std::pmr::memory_resource *upstream_;
+    std::size_t allocations_ = 0;
+    std::size_t deallocations_ = 0;
+    std::size_t in_use_ = 0;
+    std::size_t peak_ = 0;
+};
+
+// Maps a key to an unsigned integer of the same width that sorts the same way.
+template <class Key, class = void>
+struct key_traits;
+
+template <class Key>
+struct key_traits<Key, std::enable_if_t<std::is_integral_v<Key> && std::is_unsigned_v<Key> &&
+                                        !std::is_same_v<Key, bool>>> {
+    using bits_type = Key;
+    static constexpr bits_type to_bits(Key k) noexcept { return k; }
+};
+
+template <class Key>
+struct key_traits<Key, std::enable_if_t<std::is_integral_v<Key> && std::is_signed_v<Key>>> {
+    using bits_type = std::make_unsigned_t<Key>;
+    static constexpr bits_type sign = bits_type(bits_type(1) << (sizeof(Key) * 8 - 1));
+    static constexpr bits_type to_bits(Key k) noexcept { return bits_type(bits_type(k) ^ sign); }
+};
+
+template <class Key>
+struct key_traits<Key, std::enable_if_t<std::is_floating_point_v<Key>>> {
+    static_assert(std::numeric_limits<Key>::is_iec559 && (sizeof(Key) == 4 || sizeof(Key) == 8),
+                  "radix::sort supports IEEE float and double keys");
+    using bits_type = std::conditional_t<sizeof(Key) == 4, std::uint32_t, std::uint64_t>;
+    static constexpr bits_type sign = bits_type(1) << (sizeof(Key) * 8 - 1);
+    static bits_type to_bits(Key k) noexcept {
+        bits_type b;
+        std::memcpy(&b, &k, sizeof(b));
+        return (b & sign) ? bits_type(~b) : bits_type(b | sign);
+    }
+};
+
+namespace detail {
+
+// Each thread gets at least this many elements, as in libradix.
+inline constexpr std::size_t min_per_thread = 65536;
+
+template <class U, int Bits>
+struct digits {
+    static_assert(Bits >= 1 && Bits <= 16, "digit width must be 1 to 16 bits");
+    static constexpr int key_bits = int(sizeof(U) * 8);
+    static constexpr std::size_t radix = std::size_t(1) << Bits;
+    static constexpr int passes = (key_bits + Bits - 1) / Bits;
+    static constexpr U mask = U(radix - 1);
+
+    static constexpr std::size_t of(U bits, int pass) noexcept {
+        return std::size_t((bits >> (pass * Bits)) & mask);
+    }
+};
+
+struct no_payload {};
+
+inline std::pmr::memory_resource *resource_of(std::pmr::memory_resource *r) noexcept {
+    return r ? r : std::pmr::new_delete_resource();
+}
+
+// Uninitialized storage for n T from a memory resource.
+template <class T>
+class raw_buffer {
+public:
+    raw_buffer(std::pmr::memory_resource *r, std::size_t n)
+        : resource_(resource_of(r)), n_(n),
+          data_(n ? static_cast<T *>(resource_->allocate(n * sizeof(T), alignof(T))) : nullptr) {}
+    ~raw_buffer() {
+        if (data_) {
+            resource_->deallocate(data_, n_ * sizeof(T), alignof(T));
+        }
+    }
+    raw_buffer(const raw_buffer &) = delete;
+    raw_buffer &operator=(const raw_buffer &) = delete;
+
+    T *get() const noexcept { return data_; }
+    std::size_t size() const noexcept { return n_; }
+
+private:
+    std::pmr::memory_resource *resource_;
+    std::size_t n_;
+    T *data_;
+};
+
+// The same storage holding n default-initialized T, like new T[n].
+template <class T>
+class scratch : public raw_buffer<T> {
+public:
+    scratch(std::pmr::memory_resource *r, std::size_t n) : raw_buffer<T>(r, n) {
+        std::uninitialized_default_construct_n(this->get(), n);
+    }
+    ~scratch() { std::destroy_n(this->get(), this->size()); }
+};
+
+// What the passes move: the elements, and the payload if there is one.
+template <class T, class V>
+struct buffers {
+    T *data;
+    T *tmp;
+    V *vals;
+    V *tmp_vals;
+
+    void swap() noexcept {
+        std::swap(data, tmp);
+        if constexpr (!std::is_same_v<V, no_payload>) {
+            std::swap(vals, tmp_vals);
+        }
+    }
+};
+
+template <class T, class V>
+inline void move_slice(T *from, T *to, V *vfrom, V *vto, std::size_t begin, std::size_t end) {
+    std::move(from + begin, from + end, to + begin);
+    if constexpr (!std::is_same_v<V, no_payload>) {
+        std::move(vfrom + begin, vfrom + end, vto + begin);
+    }
+}
+
+template <class D, class T, class V, class KeyOf>
+inline void scatter(const buffers<T, V> &b, std::size_t begin, std::size_t end, int pass,
+                    std::size_t *offsets, KeyOf &key_of) {
+    for (std::size_t i = begin; i < end; ++i) {
+        std::size_t at = offsets[D::of(key_of(b.data[i]), pass)]++;
+        b.tmp[at] = std::move(b.data[i]);
+        if constexpr (!std::is_same_v<V, no_payload>) {
+            b.tmp_vals[at] = std::move(b.vals[i]);
+        }
+    }
+}
+
+template <class D, class T, class V, class KeyOf>
+void lsd_sequential(T *data, V *vals, std::size_t n, std::pmr::memory_resource *resource,
+                    KeyOf key_of) {
+    constexpr std::size_t R = D::radix;
+    scratch<std::size_t> counts(resource, R * D::passes);
+    std::fill(counts.get(), counts.get() + R * D::passes, std::size_t(0));
+    for (std::size_t i = 0; i < n; ++i) {
+        auto bits = key_of(data[i]);
+        for (int p = 0; p < D::passes; ++p) {
+            counts.get()[std::size_t(p) * R + D::of(bits, p)]++;
+        }
+    }
+    constexpr bool payload = !std::is_same_v<V, no_payload>;
+    scratch<T> tmp(resource, n);
+    scratch<V> tmp_vals(resource, payload ? n : 0);
+    buffers<T, V> b{data, tmp.get(), vals, tmp_vals.get()};
+    for (int p = 0; p < D::passes; ++p) {
+        std::size_t *offsets = counts.get() + std::size_t(p) * R;
+        std::size_t total = 0;
+        bool trivial = false;
+        for (std::size_t d = 0; d < R; ++d) {
+            std::size_t c = offsets[d];
+            trivial |= c == n;
+            offsets[d] = total;
+            total += c;
+        }
+        if (trivial) {
+            continue;
+        }
+        scatter<D>(b, 0, n, p, offsets, key_of);
+        b.swap();
+    }
+    if (b.data != data) {
+        move_slice(b.data, data, b.vals, vals, 0, n);
+    }
+}
+
+// std::barrier is C++20; this one only needs a mutex and a condition variable.
+class barrier {
+public:
+    explicit barrier(unsigned count) : count_(count) {}
+
+    void arrive_and_wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        unsigned gen = generation_;
+        if (++waiting_ == count_) {
+            waiting_ = 0;
+            ++generation_;
+            wake_.notify_all();
+            return;
+        }
+        wake_.wait(lock, [&] { return gen != generation_; });
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    unsigned count_;
+    unsigned waiting_ = 0;
+    unsigned generation_ = 0;
+};
+
+template <class D, class T, class V, class KeyOf>
+void lsd_parallel(T *data, V *vals, std::size_t n, unsigned threads,
+                  std::pmr::memory_resource *resource, KeyOf key_of) {
+    constexpr std::size_t R = D::radix;
+    constexpr bool payload = !std::is_same_v<V, no_payload>;
+    scratch<T> tmp(resource, n);
+    scratch<V> tmp_vals(resource, payload ? n : 0);
+    scratch<std::size_t> counts(resource, R * threads);
+    std::size_t *all = counts.get();
+    barrier sync(threads);
+    bool skip = false;
+
+    auto run = [&](unsigned tid) {
+        std::size_t begin = n * tid / threads;
+        std::size_t end = n * (tid + 1) / threads;
+        std::size_t *local = all + std::size_t(tid) * R;
+        buffers<T, V> b{data, tmp.get(), vals, tmp_vals.get()};
+        for (int p = 0; p < D::passes; ++p) {
+            std::fill(local, local + R, std::size_t(0));
+            for (std::size_t i = begin; i < end; ++i) {
+                local[D::of(key_of(b.data[i]), p)]++;
+            }
+            sync.arrive_and_wait();
+            if (tid == 0) {
+                // Digit-major over the slices, so the sort stays stable.
+                std::size_t total = 0;
+                skip = false;
+                for (std::size_t d = 0; d < R; ++d) {
+                    std::size_t first = total;
+                    for (unsigned t = 0; t < threads; ++t) {
+                        std::size_t c = all[t * R + d];
+                        all[t * R + d] = total;
+                        total += c;
+                    }
+                    skip |= total - first == n;
+                }
+            }
+            sync.arrive_and_wait();
+            bool trivial = skip;
+            if (!trivial) {
+                scatter<D>(b, begin, end, p, local, key_of);
+            }
+            sync.arrive_and_wait();
+            if (!trivial) {
+                b.swap();
+            }
+        }
+        if (b.data != data) {
+            move_slice(b.data, data, b.vals, vals, begin, end);
+        }
+    };
+
+    std::pmr::vector<std::thread> team(resource_of(resource));
+    team.reserve(threads - 1);
+    for (unsigned t = 1; t < threads; ++t) {
+        team.emplace_back(run, t);
+    }
+    run(0);
+    for (auto &th : team) {
+        th.join();
+    }
+}
+
+inline unsigned team_size(const parallel_policy &policy, std::size_t n) {
+    unsigned threads = policy.threads ? policy.threads : std::thread::hardware_concurrency();
+    std::size_t cap = n / min_per_thread;
+    threads = std::size_t(threads) < cap ? threads : unsigned(cap);
+    return threads ? threads : 1;
+}
+
+struct deduce {};
+
+template <class Key, class T, class Proj>
+using key_t = std::conditional_t<std::is_same_v<Key, deduce>,
+                                 std::decay_t<std::invoke_result_t<Proj &, const T &>>, Key>;
+
+template <class Key, int Bits, class Policy, class T, class V, class Proj>
+void sort_impl(const Policy &policy, T *data, V *vals, std::size_t n, Proj proj) {
+    using K = key_t<Key, T, Proj>;
+    using traits = key_traits<K>;
+    using D = digits<typename traits::bits_type, Bits>;
+    auto key_of = [&proj](const T &x) {
+        return traits::to_bits(static_cast<K>(std::invoke(proj, x)));
+    };
+    if (n < 2) {
+        return;
+    }
+    if constexpr (std::is_same_v<std::decay_t<Policy>, parallel_policy>) {
+        unsigned threads = team_size(policy, n);
+        if (threads > 1) {
+            lsd_parallel<D>(data, vals, n, threads, policy.resource, key_of);
+            return;
+        }
+    }
+    lsd_sequential<D>(data, vals, n, policy.resource, key_of);
+}
+
+template <class R, class = void>
+struct is_contiguous_range : std::false_type {};
+
+template <class R>
+struct is_contiguous_range<R, std::void_t<decltype(std::data(std::declval<R &>())),
+                                          decltype(std::size(std::declval<R &>()))>>
+    : std::true_type {};
+
+template <class R, class = void>
+struct is_random_access_range : std::false_type {};
+
+template <class R>
+struct is_random_access_range<R, std::void_t<decltype(std::begin(std::declval<R &>())),
+                                             decltype(std::end(std::declval<R &>()))>>
+    : std::is_base_of<std::random_access_iterator_tag,
+                      typename std::iterator_traits<decltype(std::begin(
+                          std::declval<R &>()))>::iterator_category> {};
+
+// Elements cheap enough to move on every pass themselves.
+template <class T>
+inline constexpr bool moves_directly = std::is_trivially_copyable_v<T> && sizeof(T) <= 16;
+
+// The packed buffer of the indexed path: the key's unsigned image and the
+// element it came from.
+template <class U, class I>
+struct keyed {
+    U key;
+    I index;
+};
+
+template <class Fn>
+void parallel_for(unsigned threads, std::size_t n, std::pmr::memory_resource *resource, Fn fn) {
+    std::pmr::vector<std::thread> team(resource_of(resource));
+    team.reserve(threads - 1);
+    for (unsigned t = 1; t < threads; ++t) {
+        team.emplace_back(fn, n * t / threads, n * (t + 1) / threads);
+    }
+    fn(std::size_t(0), n / threads);
+    for (auto &th : team) {
+        th.join();
+    }
+}
+
+// Moves every range's element at order[j] to position j, following the
+// cycles of the permutation; order[j] is reset to j as each place is filled.
+template <class Order, class... Its>
+void permute_cycles(Order order, std::size_t n, Its... its) {
+    for (std::size_t i = 0; i < n; ++i) {
+        if (std::size_t(order[i]) == i) {
+            continue;
+        }
+        std::tuple<typename std::iterator_traits<Its>::value_type...> saved(std::move(its[i])...);
+        std::size_t j = i;
+        for (;;) {
+            std::size_t k = std::size_t(order[j]);
+            order[j] = j;
+            if (k == i) {
+                std::apply([&](auto &...v) { ((its[j] = std::move(v)), ...); }, saved);
+                break;
+            }
+            ((its[j] = std::move(its[k])), ...);
+            j = k;
+        }
+    }
+}
+
+// Gathers it[order[j]] into a raw buffer by slices, then moves it back.
+template <class Order, class It>
+void permute_gather(Order order, std::size_t n, unsigned threads,
+                    std::pmr::memory_resource *resource, It it) {
+    using T = typename std::iterator_traits<It>::value_type;
+    raw_buffer<T> buf(resource, n);
+    T *tmp = buf.get();
+    parallel_for(threads, n, resource, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t j = begin; j < end; ++j) {
+            ::new (static_cast<void *>(tmp + j)) T(std::move(it[std::size_t(order[j])]));
+        }
+    });
+    parallel_for(threads, n, resource, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t j = begin; j < end; ++j) {
+            it[j] = std::move(tmp[j]);
+            tmp[j].~T();
+        }
+    });
+}
+
+template <class U, class I>
+struct index_view {
+    keyed<U, I> *pairs;
+    I &operator[](std::size_t j) const { return pairs[j].index; }
+};
+
+template <class Key, int Bits, class Policy, class I, class KeyIt, class Proj, class... Its>
+void sort_indexed_as(const Policy &policy, KeyIt keys, std::size_t n, Proj &proj, Its... its) {
+    using K = key_t<Key, typename std::iterator_traits<KeyIt>::value_type, Proj>;
+    using traits = key_traits<K>;
+    using U = typename traits::bits_type;
+    scratch<keyed<U, I>> pairs(policy.resource, n);
+    keyed<U, I> *p = pairs.get();
+    auto extract = [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            p[i] = {traits::to_bits(static_cast<K>(std::invoke(proj, keys[i]))), I(i)};
+        }
+    };
+    unsigned threads = 1;
+    if constexpr (std::is_same_v<std::decay_t<Policy>, parallel_policy>) {
+        threads = team_size(policy, n);
+    }
+    if (threads > 1) {
+        parallel_for(threads, n, policy.resource, extract);
+    } else {
+        extract(0, n);
+    }
+    // The keys are already unsigned, so they sort as themselves.
+    sort_impl<U, Bits>(policy, p, static_cast<no_payload *>(nullptr), n, &keyed<U, I>::key);
+
+    index_view<U, I> order{p};
+    constexpr bool nothrow = (... && (std::is_nothrow_move_constructible_v<
+                                          typename std::iterator_traits<Its>::value_type> &&
+                                      std::is_nothrow_move_assignable_v<
+                                          typename std::iterator_traits<Its>::value_type>));
+    if constexpr (nothrow) {
+        if (threads > 1) {
+            (permute_gather(order, n, threads, policy.resource, its), ...);
+            return;
+        }
+    }
+    permute_cycles(order, n, its...);
+}
+
+// Sorts the elements of its... by proj(keys[i]) through a (key, index) buffer.
+template <class Key, int Bits, class Policy, class KeyIt, class Proj, class... Its>
+void sort_indexed(const Policy &policy, KeyIt keys, std::size_t n, Proj proj, Its... its) {
+    if (n < 2) {
+        return;
+    }
+    if (n <= std::numeric_limits<std::uint32_t>::max()) {
+        sort_indexed_as<Key, Bits, Policy, std::uint32_t>(policy, keys, n, proj, its...);
+    } else {
+        sort_indexed_as<Key, Bits, Policy, std::uint64_t>(policy, keys, n, proj, its...);
+    }
+}
+
+}  // namespace detail
+
+// ---- sort -------------------------------------------------------------------
+
+template <class Key = detail::deduce, int Bits = 8, class Policy, class T, class Proj = identity,
+          std::enable_if_t<is_execution_policy<Policy>::value, int> = 0>
+void sort(const Policy &policy, T *first, T *last, Proj proj = {}) {
+    std::size_t n = std::size_t(last - first);
+    if constexpr (detail::moves_directly<T>) {
+        detail::sort_impl<Key, Bits>(policy, first, static_cast<detail::no_payload *>(nullptr), n,
+                                     std::move(proj));
+    } else {
+        detail::sort_indexed<Key, Bits>(policy, first, n, std::move(proj), first);
+    }
+}
+
+// Any random-access range: contiguous ones of small trivially copyable
+// elements are sorted in place, the rest through the indexed path.
+template <class Key = detail::deduce, int Bits = 8, class Policy, class Range, class Proj = identity,
+          std::enable_if_t<is_execution_policy<Policy>::value &&
+                               detail::is_random_access_range<Range>::value, int> = 0>
+void sort(const Policy &policy, Range &&range, Proj proj = {}) {
+    if constexpr (detail::is_contiguous_range<Range>::value) {
+        auto *data = std::data(range);
+        sort<Key, Bits>(policy, data, data + std::size(range), std::move(proj));
+    } else {
+        auto first = std::begin(range);
+        std::size_t n = std::size_t(std::end(range) - first);
+        detail::sort_indexed<Key, Bits>(policy, first, n, std::move(proj), first);
+    }
+}
+
+template <class Key = detail::deduce, int Bits = 8, class Range, class Proj = identity,
+          std::enable_if_t<detail::is_random_access_range<Range>::value, int> = 0>
+void sort(Range &&range, Proj proj = {}) {
+    sort<Key, Bits>(seq, std::forward<Range>(range), std::move(proj));
+}
+
+// ---- sort_by_key ------------------------------------------------------------
+
+// Sorts values by proj(keys[i]) and keys along with them; the keys are read
+// once, and both ranges are permuted by moves. Elements past the shorter
+// range are left alone.
+template <class Key = detail::deduce, int Bits = 8, class Policy, class VR, class KR,
+          class Proj = identity,
+          std::enable_if_t<is_execution_policy<Policy>::value &&
+                               detail::is_random_access_range<VR>::value &&
+                               detail::is_random_access_range<KR>::value, int> = 0>
+void sort_by_key(const Policy &policy, VR &&values, KR &&keys, Proj proj = {}) {
+    auto v = std::begin(values);
+    auto k = std::begin(keys);
+    std::size_t n = std::min<std::size_t>(std::size_t(std::end(values) - v),
+                                          std::size_t(std::end(keys) - k));
+    detail::sort_indexed<Key, Bits>(policy, k, n, std::move(proj), v, k);
+}
+
+template <class Key = detail::deduce, int Bits = 8, class VR, class KR, class Proj = identity,
+          std::enable_if_t<detail::is_random_access_range<VR>::value &&
+                               detail::is_random_access_range<KR>::value, int> = 0>
+void sort_by_key(VR &&values, KR &&keys, Proj proj = {}) {
+    sort_by_key<Key, Bits>(seq, std::forward<VR>(values), std::forward<KR>(keys), std::move(proj));
+}
+
+// ---- sort_kv ----------------------------------------------------------------
+
+// Sorts keys[0, n) and applies the same permutation to values[0, n).
+template <class Key = detail::deduce, int Bits = 8, class Policy, class K, class V,
+          std::enable_if_t<is_execution_policy<Policy>::value, int> = 0>
+void sort_kv(const Policy &policy, K *keys, V *values, std::size_t n) {
+    detail::sort_impl<Key, Bits>(policy, keys, values, n, identity{});
+}
+
+template <class Key = detail::deduce, int Bits = 8, class Policy, class KR, class VR,
+          std::enable_if_t<is_execution_policy<Policy>::value &&
+                               detail::is_contiguous_range<KR>::value &&
+                               detail::is_contiguous_range<VR>::value, int> = 0>
+void sort_kv(const Policy &policy, KR &&keys, VR &&values) {
+    std::size_t n = std::min<std::size_t>(std::size(keys), std::size(values));
+    sort_kv<Key, Bits>(policy, std::data(keys), std::data(values), n);
+}
+
+}  // namespace radix
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef RADIX_ASYNC_HPP
+#define RADIX_ASYNC_HPP
+
+// Asynchronous sorts on a persistent worker pool.
+//
+// radix::pool owns a radix_ctx (radix_ctx.h): its scratch buffer and its
+// worker threads live as long as the pool. submit() queues a sort of
+// 32-bit keys and returns a radix::sort_future at once; sorts submitted
+// from any thread run one after another on the same workers, in order.
+// A future can be polled with ready(), blocked on with wait(), or, in
+// C++20, co_awaited. An awaiting coroutine resumes on the pool's runner
+// thread as soon as its sort completes, and the next queued sort starts
+// only once the coroutine suspends again or returns, so long work after
+// the co_await belongs on another executor. Destroying a future neither
+// waits for its sort nor cancels it, and the keys must stay alive until
+// the sort completes; destroying the pool waits for every sort. Failures
+// of the C API (a full queue, n above max_n) are thrown as radix::error.
+//
+// Unlike radix.hpp this links against libradix.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define RADIX_HAS_COROUTINES 1
+#endif
+
+#include "radix_ctx.h"
+
+namespace radix {
+
+class error : public std::runtime_error {
+public:
+    explicit error(int code) : std::runtime_error(radix_strerror(code)), code_(code) {}
+    int code() const noexcept { return code_; }
+
+private:
+    int code_;
+};
+
+namespace detail {
+
+// Shared by a future and the completion callback. The callback holds the
+// state through `keep` until it has run, so a future may go away first.
+struct async_state {
+    std::shared_ptr<async_state> keep;
+    std::atomic<bool> signalled{false};  // set by whichever of callback and awaiter comes first
+#ifdef RADIX_HAS_COROUTINES
+    std::coroutine_handle<> waiter;
+#endif
+
+    static void on_done(void *arg, int) {
+        auto *st = static_cast<async_state *>(arg);
+        std::shared_ptr<async_state> self = std::move(st->keep);
+        if (st->signalled.exchange(true, std::memory_order_acq_rel)) {
+#ifdef RADIX_HAS_COROUTINES
+            st->waiter.resume();
+#endif
+        }
+    }
+};
+
+}  // namespace detail
+
+class sort_future {
+public:
+    sort_future() = default;
+
+    bool valid() const noexcept { return ctx_ != nullptr; }
+    radix_ticket ticket() const noexcept { return ticket_; }
+
+    // True once the keys are sorted.
+    bool ready() const { return radix_ctx_poll(ctx_, ticket_) == 1; }
+
+    void wait() const {
+        int rc = radix_ctx_wait(ctx_, ticket_);
+        if (rc != RADIX_OK) {
+            throw error(rc);
+        }
+    }
+
+#ifdef RADIX_HAS_COROUTINES
+    auto operator co_await() const noexcept {
+        struct awaiter {
+            detail::async_state *st;
+
+            bool await_ready() const noexcept {
+                return st->signalled.load(std::memory_order_acquire);
+            }
+            bool await_suspend(std::coroutine_handle<> h) noexcept {
+                st->waiter = h;
+                // If the callback got there first, carry on without suspending.
+                return !st->signalled.exchange(true, std::memory_order_acq_rel);
+            }
+            void await_resume() const noexcept {}
+        };
+        return awaiter{state_.get()};
+    }
+#endif
+
+private:
+    friend class pool;
+
+    sort_future(radix_ctx *ctx, radix_ticket ticket, std::shared_ptr<detail::async_state> state)
+        : ctx_(ctx), ticket_(ticket), state_(std::move(state)) {}
+
+    radix_ctx *ctx_ = nullptr;
+    radix_ticket ticket_ = 0;
+    std::shared_ptr<detail::async_state> state_;
+};
+
+class pool {
+public:
+    // threads 0: std::thread::hardware_concurrency().
+    explicit pool(long max_n, int threads = 0, const radix_allocator *alloc = nullptr) {
+        if (threads == 0) {
+            threads = int(std::thread::hardware_concurrency());
+            threads = threads > 0 ? threads : 1;
+        }
+        int rc = radix_ctx_create_with(&ctx_, max_n, threads, alloc);
+        if (rc != RADIX_OK) {
+            throw error(rc);
+        }
+    }
+
+    ~pool() { radix_ctx_destroy(ctx_); }
+
+    pool(const pool &) = delete;
+    pool &operator=(const pool &) = delete;
+
+    radix_ctx *get() const noexcept { return ctx_; }
+    long max_n() const noexcept { return radix_ctx_max_n(ctx_); }
+    int threads() const noexcept { return radix_ctx_threads(ctx_); }
+
+    // Keys sort as unsigned 32-bit integers.
+    template <class T>
+    sort_future submit(T *keys, std::size_t n) {
+        static_assert(std::is_integral_v<T> && sizeof(T) == sizeof(int),
+                      "radix::pool sorts 32-bit integer keys");
+        auto state = std::make_shared<detail::async_state>();
+        state->keep = state;
+        radix_ticket ticket = 0;
+        int rc = radix_ctx_submit(ctx_, reinterpret_cast<int *>(keys), long(n),
+                                  &detail::async_state::on_done, state.get(), &ticket);
+        if (rc != RADIX_OK) {
+            state->keep.reset();
+            throw error(rc);
+        }
+        return sort_future(ctx_, ticket, std::move(state));
+    }
+
+    template <class Range>
+    auto submit(Range &&keys) -> decltype(std::data(keys), std::size(keys), sort_future()) {
+        return submit(std::data(keys), std::size(keys));
+    }
+
+    // Sorts on the calling thread and the workers, taking its turn with
+    // submitted sorts.
+    template <class T>
+    void sort(T *keys, std::size_t n) {
+        static_assert(std::is_integral_v<T> && sizeof(T) == sizeof(int),
+                      "radix::pool sorts 32-bit integer keys");
+        int rc = radix_ctx_sort(ctx_, reinterpret_cast<int *>(keys), long(n));
+        if (rc != RADIX_OK) {
+            throw error(rc);
+        }
+    }
+
+private:
+    radix_ctx *ctx_ = nullptr;
+};
+
+}  // namespace radix
+
+#endif
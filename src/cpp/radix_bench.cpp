@@ -0,0 +1,664 @@
+// Benchmarks the header-only radix::sort against the runtime-parameter C
+// kernels of libradix and against std::sort, over the same keys.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "libradix.h"
+#include "radix.hpp"
+#include "radix_async.hpp"
+
+// Every operator new in the process, so the steady-state check can see
+// allocations that bypass the memory resource. All of them are replaced,
+// array, nothrow and aligned forms included, so each one is counted and
+// every delete frees what its new took from malloc. Kept out of line so
+// GCC does not pair the inlined malloc/free with new/delete and warn.
+static std::atomic<unsigned long> heap_news{0};
+
+static void *counted_alloc(std::size_t bytes, std::size_t align) noexcept {
+    heap_news.fetch_add(1, std::memory_order_relaxed);
+    if (bytes == 0) {
+        bytes = 1;
+    }
+    if (align <= alignof(std::max_align_t)) {
+        return std::malloc(bytes);
+    }
+    // aligned_alloc wants a size that is a multiple of the alignment.
+    return std::aligned_alloc(align, (bytes + align - 1) / align * align);
+}
+
+static void *counted_new(std::size_t bytes, std::size_t align) {
+    if (void *p = counted_alloc(bytes, align)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void *operator new(std::size_t bytes) {
+    return counted_new(bytes, 0);
+}
+
+__attribute__((noinline)) void *operator new[](std::size_t bytes) {
+    return counted_new(bytes, 0);
+}
+
+__attribute__((noinline)) void *operator new(std::size_t bytes, const std::nothrow_t &) noexcept {
+    return counted_alloc(bytes, 0);
+}
+
+__attribute__((noinline)) void *operator new[](std::size_t bytes, const std::nothrow_t &) noexcept {
+    return counted_alloc(bytes, 0);
+}
+
+__attribute__((noinline)) void *operator new(std::size_t bytes, std::align_val_t align) {
+    return counted_new(bytes, static_cast<std::size_t>(align));
+}
+
+__attribute__((noinline)) void *operator new[](std::size_t bytes, std::align_val_t align) {
+    return counted_new(bytes, static_cast<std::size_t>(align));
+}
+
+__attribute__((noinline)) void *operator new(std::size_t bytes, std::align_val_t align,
+                                             const std::nothrow_t &) noexcept {
+    return counted_alloc(bytes, static_cast<std::size_t>(align));
+}
+
+__attribute__((noinline)) void *operator new[](std::size_t bytes, std::align_val_t align,
+                                               const std::nothrow_t &) noexcept {
+    return counted_alloc(bytes, static_cast<std::size_t>(align));
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, const std::nothrow_t &) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p, const std::nothrow_t &) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, std::align_val_t,
+                                               const std::nothrow_t &) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p, std::align_val_t,
+                                                 const std::nothrow_t &) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+double now() {
+    using clock = std::chrono::steady_clock;
+    return std::chrono::duration<double>(clock::now().time_since_epoch()).count();
+}
+
+template <class T>
+std::vector<T> random_keys(long n, unsigned int seed) {
+    std::vector<T> keys(static_cast<std::size_t>(n));
+    unsigned int state = seed ? seed : 1u;
+    for (auto &k : keys) {
+        std::uint64_t hi = radix_lcg_next(&state);
+        std::uint64_t bits = hi << 32 | radix_lcg_next(&state);
+        if constexpr (std::is_floating_point_v<T>) {
+            k = static_cast<T>(static_cast<std::int64_t>(bits) >> 11) * T(1e-6);
+        } else {
+            k = static_cast<T>(bits);
+        }
+    }
+    return keys;
+}
+
+struct bench_opts {
+    int threads;
+    int repeat;
+    bool verify;
+};
+
+// Best of `repeat` runs of sort over a fresh copy of keys; flags a result
+// that differs from std::sort when verifying.
+template <class T, class Sort>
+void time_case(const char *type, const char *name, const std::vector<T> &keys,
+               const std::vector<T> &expected, const bench_opts &opts, Sort sort) {
+    double best = 0.0;
+    bool ok = true;
+    for (int r = 0; r < opts.repeat; ++r) {
+        std::vector<T> work(keys);
+        double t0 = now();
+        sort(work);
+        double t = now() - t0;
+        best = r == 0 || t < best ? t : best;
+        if (opts.verify) {
+            ok &= std::memcmp(work.data(), expected.data(), sizeof(T) * work.size()) == 0;
+        }
+    }
+    std::printf("n = %10zu | %-4s | %-22s | time = %.4f s | %7.1f Mkeys/s%s\n", keys.size(), type,
+                name, best, best > 0.0 ? keys.size() / best / 1e6 : 0.0,
+                opts.verify && !ok ? " (verify FAILED)" : "");
+}
+
+template <class T>
+std::vector<T> reference(const std::vector<T> &keys) {
+    std::vector<T> expected(keys);
+    if constexpr (std::is_floating_point_v<T>) {
+        // The radix order is IEEE total order; the generated keys hold no
+        // NaNs, so only -0.0 and +0.0 could differ from operator<.
+        std::stable_sort(expected.begin(), expected.end(), [](T a, T b) {
+            return a < b || (a == b && std::signbit(a) && !std::signbit(b));
+        });
+    } else {
+        std::sort(expected.begin(), expected.end());
+    }
+    return expected;
+}
+
+struct record {
+    std::uint32_t id;
+    std::int16_t priority;
+};
+
+// Too large and not trivially copyable: sorted through the indexed path.
+struct named {
+    std::uint64_t key;
+    std::string name;
+    double weight[4];
+};
+
+std::vector<named> random_named(long n, unsigned int seed) {
+    auto keys = random_keys<std::uint64_t>(n, seed);
+    std::vector<named> v(keys.size());
+    for (std::size_t i = 0; i < v.size(); ++i) {
+        v[i].key = keys[i] % 100000;
+        v[i].name = "item-" + std::to_string(i);
+        v[i].weight[0] = double(i);
+    }
+    return v;
+}
+
+bool same_order(const std::vector<named> &a, const std::vector<named> &b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const named &x, const named &y) {
+        return x.key == y.key && x.name == y.name && x.weight[0] == y.weight[0];
+    });
+}
+
+void bench_objects(long n, unsigned int seed, const bench_opts &opts) {
+    auto items = random_named(n, seed);
+    auto expected = items;
+    std::stable_sort(expected.begin(), expected.end(),
+                     [](const named &x, const named &y) { return x.key < y.key; });
+    auto par = radix::par.with_threads(static_cast<unsigned>(opts.threads));
+    auto run = [&](const char *name, auto sort) {
+        double best = 0.0;
+        bool ok = true;
+        for (int r = 0; r < opts.repeat; ++r) {
+            auto work = items;
+            double t0 = now();
+            sort(work);
+            double t = now() - t0;
+            best = r == 0 || t < best ? t : best;
+            ok &= !opts.verify || same_order(work, expected);
+        }
+        std::printf("n = %10zu | %-4s | %-22s | time = %.4f s | %7.1f Mkeys/s%s\n", items.size(),
+                    "obj", name, best, best > 0.0 ? items.size() / best / 1e6 : 0.0,
+                    opts.verify && !ok ? " (verify FAILED)" : "");
+    };
+    using V = std::vector<named>;
+    run("std::stable_sort", [](V &v) {
+        std::stable_sort(v.begin(), v.end(),
+                         [](const named &x, const named &y) { return x.key < y.key; });
+    });
+    run("radix::sort seq", [](V &v) { radix::sort(radix::seq, v, &named::key); });
+    run("radix::sort par", [&](V &v) { radix::sort(par, v, &named::key); });
+}
+
+void bench_size(long n, unsigned int seed, const bench_opts &opts) {
+    radix_options serial;
+    radix_options_init(&serial);
+    serial.backend = RADIX_BACKEND_SERIAL;
+    radix_options threaded;
+    radix_options_init(&threaded);
+    threaded.backend = RADIX_BACKEND_PTHREADS;
+    threaded.threads = opts.threads;
+    auto par = radix::par.with_threads(static_cast<unsigned>(opts.threads));
+
+    {
+        auto keys = random_keys<std::uint32_t>(n, seed);
+        auto expected = reference(keys);
+        using V = std::vector<std::uint32_t>;
+        time_case("u32", "std::sort", keys, expected, opts,
+                  [](V &v) { std::sort(v.begin(), v.end()); });
+        time_case("u32", "libradix serial", keys, expected, opts,
+                  [&](V &v) { radix_sort_u32(v.data(), v.size(), &serial); });
+        time_case("u32", "libradix pthreads", keys, expected, opts,
+                  [&](V &v) { radix_sort_u32(v.data(), v.size(), &threaded); });
+        time_case("u32", "radix::sort<8> seq", keys, expected, opts,
+                  [](V &v) { radix::sort<std::uint32_t, 8>(radix::seq, v); });
+        time_case("u32", "radix::sort<11> seq", keys, expected, opts,
+                  [](V &v) { radix::sort<std::uint32_t, 11>(radix::seq, v); });
+        time_case("u32", "radix::sort<16> seq", keys, expected, opts,
+                  [](V &v) { radix::sort<std::uint32_t, 16>(radix::seq, v); });
+        time_case("u32", "radix::sort<8> par", keys, expected, opts,
+                  [&](V &v) { radix::sort<std::uint32_t, 8>(par, v); });
+    }
+    {
+        auto keys = random_keys<std::uint64_t>(n, seed);
+        auto expected = reference(keys);
+        using V = std::vector<std::uint64_t>;
+        time_case("u64", "std::sort", keys, expected, opts,
+                  [](V &v) { std::sort(v.begin(), v.end()); });
+        time_case("u64", "libradix serial", keys, expected, opts,
+                  [&](V &v) { radix_sort_u64(v.data(), v.size(), &serial); });
+        time_case("u64", "libradix pthreads", keys, expected, opts,
+                  [&](V &v) { radix_sort_u64(v.data(), v.size(), &threaded); });
+        time_case("u64", "radix::sort<8> seq", keys, expected, opts,
+                  [](V &v) { radix::sort<std::uint64_t, 8>(radix::seq, v); });
+        time_case("u64", "radix::sort<16> seq", keys, expected, opts,
+                  [](V &v) { radix::sort<std::uint64_t, 16>(radix::seq, v); });
+        time_case("u64", "radix::sort<8> par", keys, expected, opts,
+                  [&](V &v) { radix::sort<std::uint64_t, 8>(par, v); });
+    }
+    // The C API has no signed or floating-point keys; these show the cost
+    // of the compile-time key transforms against std::sort.
+    {
+        auto keys = random_keys<std::int32_t>(n, seed);
+        auto expected = reference(keys);
+        using V = std::vector<std::int32_t>;
+        time_case("i32", "std::sort", keys, expected, opts,
+                  [](V &v) { std::sort(v.begin(), v.end()); });
+        time_case("i32", "radix::sort<8> seq", keys, expected, opts,
+                  [](V &v) { radix::sort(radix::seq, v); });
+        time_case("i32", "radix::sort<8> par", keys, expected, opts,
+                  [&](V &v) { radix::sort(par, v); });
+    }
+    {
+        auto keys = random_keys<double>(n, seed);
+        auto expected = reference(keys);
+        using V = std::vector<double>;
+        time_case("f64", "std::sort", keys, expected, opts,
+                  [](V &v) { std::sort(v.begin(), v.end()); });
+        time_case("f64", "radix::sort<8> seq", keys, expected, opts,
+                  [](V &v) { radix::sort(radix::seq, v); });
+        time_case("f64", "radix::sort<8> par", keys, expected, opts,
+                  [&](V &v) { radix::sort(par, v); });
+    }
+    bench_objects(n, seed, opts);
+}
+
+double sort_case_seq(int *arr, long n, void *) {
+    double t0 = now();
+    radix::sort(radix::seq, arr, arr + n);
+    return now() - t0;
+}
+
+double sort_case_par(int *arr, long n, void *) {
+    double t0 = now();
+    radix::sort(radix::par, arr, arr + n);
+    return now() - t0;
+}
+
+template <class T>
+void check(const char *name, long n, unsigned int seed) {
+    auto keys = random_keys<T>(n, seed);
+    auto expected = reference(keys);
+    auto a = keys;
+    auto b = keys;
+    radix::sort(radix::seq, a);
+    radix::sort(radix::par.with_threads(4), b);
+    bool ok = a == expected && b == expected;
+    std::printf("[correctness] %s (n=%ld): %s\n", name, n, ok ? "PASS" : "FAIL");
+}
+
+#ifdef RADIX_HAS_COROUTINES
+// A coroutine nobody waits for; it only counts the sorts it saw finish.
+struct detached {
+    struct promise_type {
+        detached get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+detached await_sort(radix::sort_future f, const std::vector<std::uint32_t> &keys,
+                    std::atomic<int> &sorted) {
+    co_await f;
+    sorted += std::is_sorted(keys.begin(), keys.end());
+}
+#endif
+
+void count_done(void *arg, int rc) {
+    if (rc == RADIX_OK) {
+        static_cast<std::atomic<int> *>(arg)->fetch_add(1);
+    }
+}
+
+// Each callback submits the next array of the chain, until none is left.
+struct resubmit_chain {
+    radix_ctx *ctx;
+    std::vector<std::vector<std::uint32_t>> *keys;
+    std::size_t next;
+    int rc;
+};
+
+void resubmit_done(void *arg, int rc) {
+    auto *chain = static_cast<resubmit_chain *>(arg);
+    chain->rc |= rc;
+    if (chain->next < chain->keys->size()) {
+        auto &k = (*chain->keys)[chain->next++];
+        radix_ticket ticket = 0;
+        chain->rc |= radix_ctx_submit(chain->ctx, reinterpret_cast<int *>(k.data()),
+                                      long(k.size()), resubmit_done, chain, &ticket);
+    }
+}
+
+// Independent sorts queue onto one pool without blocking the submitter.
+void check_async(unsigned int seed) {
+    const int jobs = 8;
+    const long n = 300000;
+    std::vector<std::vector<std::uint32_t>> keys;
+    for (int j = 0; j < jobs; ++j) {
+        keys.push_back(random_keys<std::uint32_t>(n, seed + unsigned(j)));
+    }
+    std::atomic<int> callbacks{0};
+    std::atomic<int> resumed{0};
+    auto extra = random_keys<std::uint32_t>(n, seed + 99);
+    auto awaited = random_keys<std::uint32_t>(n, seed + 98);
+    bool ok = true;
+    {
+        radix::pool workers(n, 4);
+        std::vector<radix::sort_future> futures;
+        for (auto &k : keys) {
+            futures.push_back(workers.submit(k));
+        }
+        radix_ticket ticket = 0;
+        ok &= radix_ctx_submit(workers.get(), reinterpret_cast<int *>(extra.data()), n,
+                               count_done, &callbacks, &ticket) == RADIX_OK;
+#ifdef RADIX_HAS_COROUTINES
+        await_sort(workers.submit(awaited), awaited, resumed);
+#endif
+        for (auto &f : futures) {
+            f.wait();
+        }
+        ok &= radix_ctx_wait(workers.get(), ticket) == RADIX_OK;
+        ok &= std::is_sorted(extra.begin(), extra.end());
+        for (auto &k : keys) {
+            ok &= std::is_sorted(k.begin(), k.end());
+        }
+        // Ticket numbers past the last submission are rejected.
+        ok &= radix_ctx_poll(workers.get(), ticket + 100) == RADIX_EINVAL;
+    }  // the pool waits for the runner, so every callback has run
+    ok &= callbacks == 1;
+#ifdef RADIX_HAS_COROUTINES
+    ok &= resumed == 1;
+#endif
+
+    // Destroying the pool right after the first submission must still run
+    // every sort the callbacks submit, on a pool that is still there.
+    std::vector<std::vector<std::uint32_t>> chained;
+    for (int j = 0; j < 3; ++j) {
+        chained.push_back(random_keys<std::uint32_t>(100000, seed + 50 + unsigned(j)));
+    }
+    resubmit_chain chain{nullptr, &chained, 1, 0};
+    {
+        radix::pool workers(100000, 2);
+        chain.ctx = workers.get();
+        radix_ticket ticket = 0;
+        chain.rc |= radix_ctx_submit(chain.ctx, reinterpret_cast<int *>(chained[0].data()),
+                                     long(chained[0].size()), resubmit_done, &chain, &ticket);
+    }
+    ok &= chain.rc == RADIX_OK && chain.next == chained.size();
+    for (auto &k : chained) {
+        ok &= std::is_sorted(k.begin(), k.end());
+    }
+    std::printf("[correctness] async pool (%d sorts, n=%ld): %s\n", jobs + 5, n,
+                ok ? "PASS" : "FAIL");
+}
+
+// After one warm-up round, sorting through an arena must take nothing from
+// the heap: operator new for the header, malloc for libradix.
+void check_steady_state(unsigned int seed) {
+    const long n = 200000;
+    auto keys = random_keys<std::uint64_t>(n, seed);
+    auto items = random_named(n / 4, seed);
+    std::vector<std::uint64_t> work(keys.size());
+    std::vector<named> objs(items.size());
+    std::vector<std::uint64_t> order(keys.size());
+
+    std::vector<std::byte> backing(std::size_t(64) << 20);
+    std::pmr::monotonic_buffer_resource arena(backing.data(), backing.size(),
+                                              std::pmr::null_memory_resource());
+    radix::counting_resource counted(&arena);
+    auto seq = radix::seq.with_resource(&counted);
+
+    radix_arena *c_arena = nullptr;
+    if (radix_arena_create(&c_arena, std::size_t(32) << 20) != RADIX_OK) {
+        std::printf("[correctness] steady-state allocations: FAIL (no arena)\n");
+        return;
+    }
+    radix_options opt;
+    radix_options_init(&opt);
+    opt.backend = RADIX_BACKEND_SERIAL;
+    opt.alloc = radix_arena_allocator(c_arena);
+
+    bool ok = true;
+    unsigned long news = 0;
+    radix_alloc_stats before{};
+    for (int round = 0; round < 4; ++round) {
+        if (round == 1) {
+            news = heap_news.load();
+            radix_alloc_get_stats(&before);
+            counted.reset_counts();
+        }
+        std::copy(keys.begin(), keys.end(), work.begin());
+        radix::sort(seq, work);
+        std::move(items.begin(), items.end(), objs.begin());
+        radix::sort(seq, objs, &named::key);
+        std::move(objs.begin(), objs.end(), items.begin());
+        arena.release();
+
+        std::copy(keys.begin(), keys.end(), work.begin());
+        ok &= radix_sort_u64(work.data(), work.size(), &opt) == RADIX_OK;
+        ok &= radix_argsort_u64(keys.data(), keys.size(), order.data(), &opt) == RADIX_OK;
+        ok &= std::is_sorted(work.begin(), work.end());
+    }
+    radix_alloc_stats after{};
+    radix_alloc_get_stats(&after);
+    radix_arena_stats ast{};
+    radix_arena_get_stats(c_arena, &ast);
+    radix_arena_destroy(c_arena);
+    unsigned long steady_news = heap_news.load() - news;
+    ok &= steady_news == 0 && after.heap_allocs == before.heap_allocs && ast.used == 0;
+    std::printf("[correctness] steady-state allocations (3 rounds): %s\n"
+                "  radix.hpp: %zu resource allocations, peak %zu bytes, %lu operator new\n"
+                "  libradix: %lu arena allocations, peak %zu bytes, %lu malloc\n",
+                ok ? "PASS" : "FAIL", counted.allocations(), counted.peak_bytes(), steady_news,
+                after.custom_allocs - before.custom_allocs, ast.peak,
+                after.heap_allocs - before.heap_allocs);
+}
+
+void run_correctness(unsigned int seed) {
+    radix_run_cases(sort_case_seq, nullptr);
+    radix_run_cases(sort_case_par, nullptr);
+    check<std::uint8_t>("uint8", 300000, seed);
+    check<std::int16_t>("int16", 300000, seed);
+    check<std::int32_t>("int32", 300000, seed);
+    check<std::int64_t>("int64", 300000, seed);
+    check<float>("float", 300000, seed);
+    check<double>("double", 300000, seed);
+
+    // A projection sorts whole structs by a member; equal keys keep their order.
+    std::vector<record> recs(300000);
+    unsigned int state = seed ? seed : 1u;
+    for (std::size_t i = 0; i < recs.size(); ++i) {
+        recs[i] = {static_cast<std::uint32_t>(i),
+                   static_cast<std::int16_t>(radix_lcg_next(&state) % 200 - 100)};
+    }
+    auto expected = recs;
+    std::stable_sort(expected.begin(), expected.end(),
+                     [](const record &x, const record &y) { return x.priority < y.priority; });
+    auto by_member = recs;
+    radix::sort(radix::par.with_threads(4), by_member, &record::priority);
+    bool ok = std::equal(by_member.begin(), by_member.end(), expected.begin(),
+                         [](const record &x, const record &y) { return x.id == y.id; });
+    std::printf("[correctness] projection (n=%zu): %s\n", recs.size(), ok ? "PASS" : "FAIL");
+
+    // sort_kv carries a payload along with its keys.
+    std::vector<std::int16_t> keys(recs.size());
+    std::vector<std::uint32_t> ids(recs.size());
+    for (std::size_t i = 0; i < recs.size(); ++i) {
+        keys[i] = recs[i].priority;
+        ids[i] = recs[i].id;
+    }
+    radix::sort_kv(radix::seq, keys, ids);
+    ok = true;
+    for (std::size_t i = 0; i < recs.size(); ++i) {
+        ok &= ids[i] == expected[i].id && keys[i] == expected[i].priority;
+    }
+    std::printf("[correctness] sort_kv (n=%zu): %s\n", recs.size(), ok ? "PASS" : "FAIL");
+
+    // Strings and wide structs are moved once, after the keys are sorted.
+    auto items = random_named(300000, seed);
+    auto sorted = items;
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const named &x, const named &y) { return x.key < y.key; });
+    auto a = items;
+    auto b = items;
+    radix::sort(radix::seq, a, &named::key);
+    radix::sort(radix::par.with_threads(4), b, [](const named &x) { return x.key; });
+    ok = same_order(a, sorted) && same_order(b, sorted);
+    std::printf("[correctness] indexed objects (n=%zu): %s\n", items.size(), ok ? "PASS" : "FAIL");
+
+    // A non-contiguous random-access range.
+    std::deque<named> d(items.begin(), items.end());
+    radix::sort(radix::par.with_threads(4), d, &named::key);
+    ok = std::equal(d.begin(), d.end(), sorted.begin(),
+                    [](const named &x, const named &y) { return x.name == y.name; });
+    std::printf("[correctness] deque (n=%zu): %s\n", d.size(), ok ? "PASS" : "FAIL");
+
+    // sort_by_key permutes values and keys together, reading each key once.
+    std::vector<std::string> names(items.size());
+    std::vector<std::int64_t> order_keys(items.size());
+    for (std::size_t i = 0; i < items.size(); ++i) {
+        names[i] = items[i].name;
+        order_keys[i] = -static_cast<std::int64_t>(items[i].key);
+    }
+    radix::sort_by_key(radix::par.with_threads(4), names, order_keys,
+                       [](std::int64_t k) { return -k; });
+    ok = true;
+    for (std::size_t i = 0; i < items.size(); ++i) {
+        ok &= names[i] == sorted[i].name && -order_keys[i] == std::int64_t(sorted[i].key);
+    }
+    std::vector<std::string> few = {"c", "a", "b"};
+    std::vector<int> few_keys = {3, 1, 2};
+    radix::sort_by_key(few, few_keys);
+    ok &= few == std::vector<std::string>{"a", "b", "c"} && few_keys == std::vector<int>{1, 2, 3};
+    std::printf("[correctness] sort_by_key (n=%zu): %s\n", names.size(), ok ? "PASS" : "FAIL");
+
+    check_steady_state(seed);
+    check_async(seed);
+}
+
+void usage(const char *prog) {
+    std::fprintf(stderr,
+                 "Usage: %s [--n <count>] [--threads <t>] [--repeat <k>] [--seed <s>] "
+                 "[--verify] [--bench] [--correctness]\n",
+                 prog);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    long n = 1000000;
+    unsigned int seed = static_cast<unsigned int>(std::time(nullptr));
+    bool bench = false;
+    bool correctness = false;
+    bench_opts opts{0, 3, false};
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--n") == 0 && i + 1 < argc) {
+            n = std::strtol(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            opts.threads = static_cast<int>(std::strtol(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            opts.repeat = static_cast<int>(std::strtol(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--verify") == 0) {
+            opts.verify = true;
+        } else if (std::strcmp(argv[i], "--bench") == 0) {
+            bench = true;
+        } else if (std::strcmp(argv[i], "--correctness") == 0) {
+            correctness = true;
+        } else if (std::strcmp(argv[i], "--help") == 0) {
+            usage(argv[0]);
+            return 0;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (n < 0 || opts.threads < 0 || opts.repeat < 1) {
+        std::fprintf(stderr, "n and threads must be non-negative, repeat >= 1\n");
+        return 1;
+    }
+
+    if (correctness) {
+        run_correctness(seed);
+        return 0;
+    }
+    if (bench) {
+        for (long size : {100000L, 1000000L, 10000000L}) {
+            bench_size(size, seed, opts);
+        }
+        return 0;
+    }
+    bench_size(n, seed, opts);
+    return 0;
+}
@@ -0,0 +1,110 @@
+"""ctypes binding for libradix, the C sort library built from src/c/libradix.c.
+
+The library is looked up in $RADIX_LIB, then lib/libradix.so at the repo root.
+Keys are sorted as unsigned 32- or 64-bit integers, so they must be
+non-negative and fit the chosen width.
+"""
+import ctypes
+import os
+from array import array
+
+_HERE = os.path.dirname(os.path.abspath(__file__))
+_DEFAULT = os.path.join(_HERE, "..", "..", "lib", "libradix.so")
+
+RADIX_OK = 0
+BACKENDS = {"auto": 0, "serial": 1, "pthreads": 2, "openmp": 3}
+
+
+class _Options(ctypes.Structure):
+    _fields_ = [
+        ("size", ctypes.c_size_t),
+        ("backend", ctypes.c_int),
+        ("threads", ctypes.c_int),
+        ("ctx", ctypes.c_void_p),
+        ("alloc", ctypes.c_void_p),
+        ("digits", ctypes.c_uint),
+        ("min_keys_per_thread", ctypes.c_long),
+        ("first_touch", ctypes.c_int),
+        ("worker_begin", ctypes.c_void_p),
+        ("worker_end", ctypes.c_void_p),
+        ("worker_arg", ctypes.c_void_p),
+        ("scratch_keys", ctypes.c_void_p),
+    ]
+
+
+_lib = None
+
+
+def load(path=None):
+    """Loads the library once; returns None if it is not there."""
+    global _lib
+    if _lib is not None:
+        return _lib
+    path = path or os.environ.get("RADIX_LIB") or _DEFAULT
+    try:
+        lib = ctypes.CDLL(path)
+    except OSError:
+        return None
+    size_t = ctypes.c_size_t
+    opts = ctypes.POINTER(_Options)
+    u32p = ctypes.POINTER(ctypes.c_uint32)
+    u64p = ctypes.POINTER(ctypes.c_uint64)
+    for name, argtypes in [
+        ("radix_sort_u32", [u32p, size_t, opts]),
+        ("radix_sort_u64", [u64p, size_t, opts]),
+        ("radix_argsort_u32", [u32p, size_t, u64p, opts]),
+        ("radix_argsort_u64", [u64p, size_t, u64p, opts]),
+    ]:
+        fn = getattr(lib, name)
+        fn.argtypes = argtypes
+        fn.restype = ctypes.c_int
+    lib.radix_options_init.argtypes = [opts]
+    lib.radix_options_init.restype = None
+    _lib = lib
+    return lib
+
+
+def _options(lib, backend, threads):
+    opt = _Options()
+    lib.radix_options_init(ctypes.byref(opt))
+    opt.backend = BACKENDS[backend]
+    if threads:
+        opt.threads = threads
+    return opt
+
+
+def _call(fn, *args):
+    rc = fn(*args)
+    if rc != RADIX_OK:
+        raise RuntimeError(f"libradix error {rc}")
+
+
+def radix_sort(A, bits=32, backend="auto", threads=0):
+    """Sorts the list A in place through libradix and returns it."""
+    lib = load()
+    if lib is None:
+        raise OSError("libradix not found; build lib/libradix.so or set RADIX_LIB")
+    buf = array("I" if bits == 32 else "Q", A)
+    ptr, n = buf.buffer_info()
+    ctype = ctypes.c_uint32 if bits == 32 else ctypes.c_uint64
+    fn = lib.radix_sort_u32 if bits == 32 else lib.radix_sort_u64
+    _call(fn, ctypes.cast(ptr, ctypes.POINTER(ctype)), n,
+          ctypes.byref(_options(lib, backend, threads)))
+    A[:] = buf.tolist()
+    return A
+
+
+def argsort(A, bits=32, backend="auto", threads=0):
+    """Returns the indices that sort A; stable for equal keys."""
+    lib = load()
+    if lib is None:
+        raise OSError("libradix not found; build lib/libradix.so or set RADIX_LIB")
+    buf = array("I" if bits == 32 else "Q", A)
+    order = array("Q", bytes(8 * len(buf)))
+    ptr, n = buf.buffer_info()
+    ctype = ctypes.c_uint32 if bits == 32 else ctypes.c_uint64
+    fn = lib.radix_argsort_u32 if bits == 32 else lib.radix_argsort_u64
+    _call(fn, ctypes.cast(ptr, ctypes.POINTER(ctype)), n,
+          ctypes.cast(order.buffer_info()[0], ctypes.POINTER(ctypes.c_uint64)),
+          ctypes.byref(_options(lib, backend, threads)))
+    return order.tolist()
@@ -91,6 +91,21 @@ def benchmark_sequential():
         print(f"n = {n:>10,}  →  time = {end - start:.3f} s")
 
 
+def benchmark_libradix():
+    """The same sizes through the C library (src/python/libradix.py), if built."""
+    import libradix
+    if libradix.load() is None:
+        print("\n(libradix not built; skipping the C library comparison)")
+        return
+    print("\n=== libradix (C) Radix Sort Performance ===")
+    for n in [10_000, 100_000, 1_000_000]:
+        A = [random.randint(0, 10**9) for _ in range(n)]
+        start = time.time()
+        libradix.radix_sort(A)
+        end = time.time()
+        print(f"n = {n:>10,}  →  time = {end - start:.3f} s")
+
+
 if __name__ == "__main__":
     # 1) Basic small tests (correctness)
     test_correctness()
@@ -106,3 +121,6 @@ if __name__ == "__main__":
     # radix_sort(A)
     # end = time.time()
     # print(f"n = 10,000,000 → time = {end - start:.3f} s")
+
+    # 4) The C library behind the C drivers, for comparison
+    benchmark_libradix()